@@ -0,0 +1,78 @@
+/**
+ * @file Bench.cpp
+ * @brief Bench class source file
+ *
+ */
+
+#include "Bench.h"
+
+#include <stdio.h>
+
+Bench::Bench()
+{
+#if BENCH_CYCLES
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    printf("%-32s %12s %12s %12s\n", "case", "cycles/op", "ns/op", "MB/s");
+#else
+    printf("%-32s %12s %12s\n", "case", "ns/op", "MB/s");
+#endif
+}
+
+double_t Bench::toNs(uint64_t time)
+{
+#if BENCH_CYCLES
+    return (double_t)time*1e9/SystemCoreClock;
+#else
+    return (double_t)time;
+#endif
+}
+
+uint64_t Bench::median(uint64_t* sample, uint8_t nb_sample)
+{
+    // insertion sort, there are only a few samples
+    for(uint8_t i = 1; i < nb_sample; ++i)
+    {
+        uint64_t value = sample[i];
+        int8_t j = i - 1;
+        while(j >= 0 && sample[j] > value)
+        {
+            sample[j + 1] = sample[j];
+            --j;
+        }
+        sample[j + 1] = value;
+    }
+    return sample[nb_sample/2];
+}
+
+bench_result Bench::report(const char* name, uint32_t bytes_per_op, uint64_t time, uint32_t batch)
+{
+    bench_result result;
+
+    result.name = name;
+    result.ns_per_op = toNs(time)/batch;
+#if BENCH_CYCLES
+    result.cycles_per_op = (double_t)time/batch;
+#else
+    result.cycles_per_op = 0;
+#endif
+    result.bytes_per_s = bytes_per_op ? (double_t)bytes_per_op*1e9/result.ns_per_op : 0;
+
+#if BENCH_CYCLES
+    printf("%-32s %12.1f %12.1f", name, result.cycles_per_op, result.ns_per_op);
+#else
+    printf("%-32s %12.1f", name, result.ns_per_op);
+#endif
+    if(bytes_per_op)
+    {
+        printf(" %12.2f\n", result.bytes_per_s/1e6);
+    }
+    else
+    {
+        printf(" %12s\n", "-");
+    }
+
+    return result;
+}
@@ -0,0 +1,178 @@
+/**
+ * @file Bench.h
+ * @brief Micro benchmark of the hot paths of the library
+ *
+ * The same cases run on the host (with the mbed stand-in of Host/) and on the target.
+ * On the host the time comes from the steady clock and the result is in ns per operation,
+ * on the target it comes from the DWT cycle counter and the result is in cycles per operation.
+ *
+ * Every case is run in batches, the batch size grows until one batch takes BENCH_MIN_BATCH_NS,
+ * and the median of BENCH_NB_BATCH batches is reported, so a preemption in one batch doesn't
+ * move the result.
+ *
+ *  host:   g++ -std=gnu++14 -O2 -IHost -I. -IRS485 Benchmark/Bench.cpp Benchmark/BenchCases.cpp Benchmark/BenchMain.cpp
+ *              RS485/RS485.cpp RS485/RS485_frame.cpp RS485/RS485Subscriber.cpp RS485/RS485Serializer.cpp
+ *              Utility/utility.cpp Utility/VoltageDivider.cpp Utility/Timebase.cpp Utility/MemoryAlloc.cpp INA228/INA228.cpp
+ *              I2CBus/I2CBus.cpp Host/INA228Sim.cpp Host/mbed_host.cpp -lpthread -o bench
+ *  target: build Benchmark/ as an mbed application with the library, the results are printed on the console
+ *
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "mbed.h"
+
+#define BENCH_NB_BATCH 9
+#define BENCH_MIN_BATCH_NS 2000000 // 2 ms
+#define BENCH_MAX_BATCH 1000000
+
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+#define BENCH_CYCLES 1
+#else
+#define BENCH_CYCLES 0
+#endif
+
+#if !BENCH_CYCLES && defined(HOST_MBED_H)
+#include <chrono>
+#endif
+
+/**
+ * @brief Keep a value alive, the compiler can't remove the computation of it
+ *
+ * @param value the value
+ */
+template<typename T>
+static inline void benchKeep(const T& value)
+{
+    __asm__ __volatile__("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * @brief result of one case
+ *
+ */
+typedef struct
+{
+    const char* name;
+    double_t ns_per_op;
+    double_t cycles_per_op; // 0 on the host
+    double_t bytes_per_s;   // 0 if the case has no bytes
+} bench_result;
+
+/**
+ * @brief runner of the benchmark cases
+ *
+ */
+class Bench
+{
+    public:
+
+        /**
+         * @brief Bench constructor, starts the cycle counter on the target
+         *
+         */
+        Bench();
+
+        /**
+         * @brief Measure one operation
+         *
+         * @param name the name of the case
+         * @param bytes_per_op the bytes processed by one operation, 0 if not relevant
+         * @param op the operation, called many times
+         * @return bench_result the result, printed too
+         */
+        template<typename F>
+        bench_result run(const char* name, uint32_t bytes_per_op, F op)
+        {
+            uint32_t batch = 1;
+
+            // calibration, and warm up of the caches
+            while(batch < BENCH_MAX_BATCH && toNs(measure(op, batch)) < BENCH_MIN_BATCH_NS)
+            {
+                batch *= 2;
+            }
+
+            uint64_t sample[BENCH_NB_BATCH];
+            for(uint8_t i = 0; i < BENCH_NB_BATCH; ++i)
+            {
+                sample[i] = measure(op, batch);
+            }
+
+            return report(name, bytes_per_op, median(sample, BENCH_NB_BATCH), batch);
+        }
+
+    private:
+
+        /**
+         * @brief Get the time
+         *
+         * @return uint64_t cycles on the target, ns on the host
+         */
+        static inline uint64_t now()
+        {
+#if BENCH_CYCLES
+            return DWT->CYCCNT;
+#elif defined(HOST_MBED_H)
+            return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+            return (uint64_t)us_ticker_read()*1000;
+#endif
+        }
+
+        template<typename F>
+        uint64_t measure(F& op, uint32_t batch)
+        {
+            uint64_t start = now();
+            for(uint32_t i = 0; i < batch; ++i)
+            {
+                op();
+            }
+            uint64_t end = now();
+
+#if BENCH_CYCLES
+            return (uint32_t)(end - start); // the counter is 32 bits
+#else
+            return end - start;
+#endif
+        }
+
+        /**
+         * @brief Convert a measure to ns
+         *
+         * @param time cycles on the target, ns on the host
+         * @return double_t the time in ns
+         */
+        double_t toNs(uint64_t time);
+
+        /**
+         * @brief Get the median of the samples, the samples are sorted
+         *
+         * @param sample the samples
+         * @param nb_sample the number of samples
+         * @return uint64_t the median
+         */
+        uint64_t median(uint64_t* sample, uint8_t nb_sample);
+
+        /**
+         * @brief Print the result of a case
+         *
+         * @param name the name of the case
+         * @param bytes_per_op the bytes processed by one operation
+         * @param time the median time of one batch
+         * @param batch the number of operations of one batch
+         * @return bench_result the result
+         */
+        bench_result report(const char* name, uint32_t bytes_per_op, uint64_t time, uint32_t batch);
+};
+
+/**
+ * @brief Run all the cases of the library
+ *
+ * The RS485 and INA228 cases need the host stand-in of the bus and are skipped on the target.
+ *
+ * @param bench the runner
+ */
+void benchRunAll(Bench& bench);
+
+#endif
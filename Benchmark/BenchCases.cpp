@@ -0,0 +1,142 @@
+/**
+ * @file BenchCases.cpp
+ * @brief Benchmark cases of the library
+ *
+ */
+
+#include "Bench.h"
+
+#include "RS485/RS485_definition.h"
+#include "RS485/RS485.h"
+#include "RS485/RS485Serializer.h"
+#include "Utility/utility.h"
+#include "Utility/VoltageDivider.h"
+
+#if defined(HOST_MBED_H)
+#include "INA228/INA228.h"
+#include "INA228Sim.h"
+#endif
+
+#define BENCH_SHORT_PAYLOAD 8
+#define BENCH_FRAME_PAYLOAD 46
+
+void benchRunAll(Bench& bench)
+{
+    uint8_t data[255];
+    for(uint16_t i = 0; i < sizeof(data); ++i)
+    {
+        data[i] = (uint8_t)(i*31 + 7);
+    }
+
+    // RS485 checksum
+    bench.run("rs485 checksum 8 B", BENCH_SHORT_PAYLOAD, [&]() {
+        benchKeep(RS485::calculateCheckSum(SLAVE_PSU0, CMD_VOLTAGE, BENCH_SHORT_PAYLOAD, data));
+    });
+    bench.run("rs485 checksum 255 B", 255, [&]() {
+        benchKeep(RS485::calculateCheckSum(SLAVE_PSU0, CMD_POWER_RAW, 255, data));
+    });
+
+    // frame parser alone, one byte at a time like the boards and one chunk at a time like the Linux master
+    uint8_t frame[RS485_FRAME_MAX_SIZE];
+    uint16_t frame_size = RS485_frameEncode(SLAVE_PSU0, CMD_POWER_WINDOW, BENCH_FRAME_PAYLOAD, data, frame);
+    uint8_t parsed[RS485_MAX_PAYLOAD];
+    RS485_frame_parser parser;
+    RS485_frameParserInit(&parser, parsed);
+
+    bench.run("frame parse bytes 46 B", frame_size, [&]() {
+        for(uint16_t i = 0; i < frame_size; ++i)
+        {
+            benchKeep(RS485_frameParse(&parser, frame[i]));
+        }
+    });
+    bench.run("frame parse chunk 46 B", frame_size, [&]() {
+        RS485_parse_status status;
+        benchKeep(RS485_frameParseChunk(&parser, frame, frame_size, status));
+        benchKeep(status);
+    });
+    bench.run("frame parse and accept 46 B", frame_size, [&]() {
+        for(uint16_t i = 0; i < frame_size; ++i)
+        {
+            if(RS485_frameParse(&parser, frame[i]) == RS485_PARSE_FRAME)
+            {
+                benchKeep(RS485_frameAccept(SLAVE_STATE_SCREEN, &parser));
+            }
+        }
+    });
+
+    // float packing of the payloads
+    float_t value = 12.5f;
+    uint8_t array[4];
+    bench.run("putFloatInArray", 4, [&]() {
+        putFloatInArray(array, value);
+        benchKeep(array);
+    });
+
+    char text[16] = {'1', '2', '.', '5', '0', '3', '1', '2', '.', '5', '0', '3', '1', '2', '.', '5'};
+    bench.run("putCharInFloat", sizeof(text), [&]() {
+        benchKeep(putCharInFloat(text));
+    });
+
+    // voltage divider, the double version and the precomputed one
+    double_t reading = 0.4321;
+    uint16_t raw = 28318;
+    constexpr VoltageDivider divider(3.3, 100000, 10000);
+    bench.run("calcul_tension", 0, [&]() {
+        benchKeep(calcul_tension(reading, 3.3, 100000, 10000));
+        benchKeep(reading);
+    });
+    bench.run("VoltageDivider::toVolts", 0, [&]() {
+        benchKeep(divider.toVolts((float_t)reading));
+        benchKeep(reading);
+    });
+    bench.run("VoltageDivider::toMillivolts", 0, [&]() {
+        benchKeep(divider.toMillivolts(raw));
+        benchKeep(raw);
+    });
+
+    // payload serializer of the power window
+    RS485Serializer encoder(SCHEMA_PSU_POWER_WINDOW);
+    RS485Serializer decoder(SCHEMA_PSU_POWER_WINDOW);
+    int32_t fields[16] = {0};
+    int32_t decoded[16];
+    uint8_t payload[RS485_MAX_PAYLOAD];
+    uint8_t payload_size = 0;
+    uint32_t frame_count = 0;
+    bench.run("serializer encode power window", 0, [&]() {
+        fields[0] = 12000 + (frame_count & 0x1F);
+        fields[1] = 3200 - (frame_count & 0x0F);
+        frame_count++;
+        payload_size = encoder.encode(fields, payload);
+        benchKeep(payload);
+    });
+    encoder.requestKeyFrame();
+    payload_size = encoder.encode(fields, payload);
+    bench.run("serializer decode power window", payload_size, [&]() {
+        benchKeep(decoder.decode(payload, payload_size, decoded));
+        benchKeep(decoded);
+    });
+
+#if defined(HOST_MBED_H)
+    // INA228 conversions of the register values, the simulated device only applies the plan
+    I2C i2c(NC, NC);
+    INA228Sim sim(&i2c, 0x80, 0.002);
+    INA228 ina(&i2c, 0x80);
+    ina.applyPlan(INA228::planCalibration(0.002, 50.0, 1000.0));
+    uint32_t current_register = 0x3A5C70;
+    uint32_t bus_register = 0x0C5A20;
+    uint64_t energy_register = 0x12345678ULL;
+
+    bench.run("INA228::currentFromRegister", 0, [&]() {
+        benchKeep(ina.currentFromRegister(current_register));
+        benchKeep(current_register);
+    });
+    bench.run("INA228::busVoltFromRegister", 0, [&]() {
+        benchKeep(ina.busVoltFromRegister(bus_register));
+        benchKeep(bus_register);
+    });
+    bench.run("INA228::energyFromRegister", 0, [&]() {
+        benchKeep(ina.energyFromRegister(energy_register));
+        benchKeep(energy_register);
+    });
+#endif
+}
@@ -0,0 +1,16 @@
+/**
+ * @file BenchMain.cpp
+ * @brief Entry point of the benchmark, on the host or as an mbed application on the target
+ *
+ */
+
+#include "Bench.h"
+
+int main()
+{
+    Bench bench;
+
+    benchRunAll(bench);
+
+    return 0;
+}
@@ -0,0 +1,425 @@
+/**
+ * @file INA228Sim.cpp
+ * @brief INA228Sim class source file
+ *
+ */
+
+#include "INA228Sim.h"
+
+#define SIM_MANUFACTURER_ID 0x5449 // "TI"
+#define SIM_DEVICE_ID 0x2281
+#define SIM_MAX_CONVERSION_PER_UPDATE 10000
+#define SIM_MAX_SAMPLE_PER_CONVERSION 16
+
+static const uint16_t sim_conversion_time_us[8] = {50, 84, 150, 280, 540, 1052, 2074, 4120};
+static const uint16_t sim_averaging_count[8] = {1, 4, 16, 64, 128, 256, 512, 1024};
+
+// sign extend a two's complement value of nb_bit bits
+static int64_t signExtend(uint64_t value, uint8_t nb_bit)
+{
+    uint64_t sign = 1ULL << (nb_bit - 1);
+    value &= (sign << 1) - 1;
+    return (int64_t)(value ^ sign) - (int64_t)sign;
+}
+
+// saturate a value to a two's complement register of nb_bit bits
+static uint64_t toRegister(double_t value, uint8_t nb_bit, bool is_signed)
+{
+    double_t max = is_signed ? (double_t)((1LL << (nb_bit - 1)) - 1) : (double_t)((1LL << nb_bit) - 1);
+    double_t min = is_signed ? -(double_t)(1LL << (nb_bit - 1)) : 0;
+
+    if(value > max) value = max;
+    if(value < min) value = min;
+
+    return (uint64_t)(int64_t)llround(value) & ((1ULL << nb_bit) - 1);
+}
+
+INA228Sim::INA228Sim(I2C* i2c, char address, float_t shunt_r, PinName alert_pin)
+{
+    this->shunt_r = shunt_r;
+    this->alert_pin = alert_pin;
+
+    resetRegisters();
+    last_time = host_time_us();
+
+    i2c->host_attach(address, this);
+    updateAlert();
+}
+
+void INA228Sim::setWaveform(Callback<float_t(uint64_t)> current, Callback<float_t(uint64_t)> voltage, Callback<float_t(uint64_t)> temperature)
+{
+    sim_mutex.lock();
+    current_waveform = current;
+    voltage_waveform = voltage;
+    temperature_waveform = temperature;
+    sim_mutex.unlock();
+}
+
+void INA228Sim::setConstant(float_t current, float_t voltage, float_t temperature)
+{
+    sim_mutex.lock();
+    current_waveform = Callback<float_t(uint64_t)>();
+    voltage_waveform = Callback<float_t(uint64_t)>();
+    temperature_waveform = Callback<float_t(uint64_t)>();
+    constant_current = current;
+    constant_voltage = voltage;
+    constant_temperature = temperature;
+    sim_mutex.unlock();
+}
+
+uint32_t INA228Sim::getConversionPeriod()
+{
+    uint16_t adc_config = (uint16_t)reg[ADC_CONFIG];
+    uint8_t mode = adc_config >> 12;
+    uint32_t conversion = 0;
+
+    if(mode & 0x1) conversion += sim_conversion_time_us[(adc_config >> 9) & 0x7];
+    if(mode & 0x2) conversion += sim_conversion_time_us[(adc_config >> 6) & 0x7];
+    if(mode & 0x4) conversion += sim_conversion_time_us[(adc_config >> 3) & 0x7];
+
+    return conversion*sim_averaging_count[adc_config & 0x7];
+}
+
+uint32_t INA228Sim::getConversionCount()
+{
+    sim_mutex.lock();
+    uint32_t count = conversion_count;
+    sim_mutex.unlock();
+    return count;
+}
+
+uint64_t INA228Sim::getRegister(uint8_t reg)
+{
+    update();
+
+    sim_mutex.lock();
+    uint64_t value = this->reg[reg & 0x3F];
+    sim_mutex.unlock();
+    return value;
+}
+
+void INA228Sim::update()
+{
+    sim_mutex.lock();
+
+    uint64_t now = host_time_us();
+    uint32_t period = getConversionPeriod();
+    bool continuous = ((reg[ADC_CONFIG] >> 12) & 0x8) && period;
+
+    if(single_pending && period && now >= last_time + period)
+    {
+        // triggered mode, one conversion then the ADC stops
+        convert(last_time + period, period);
+        single_pending = false;
+        last_time = now;
+    }
+    else if(continuous)
+    {
+        uint64_t nb_conversion = (now - last_time) / period;
+
+        // after a long pause the first conversions cover the missing time in one step
+        if(nb_conversion > SIM_MAX_CONVERSION_PER_UPDATE)
+        {
+            uint64_t skipped = nb_conversion - SIM_MAX_CONVERSION_PER_UPDATE;
+            convert(last_time + skipped*period, (uint32_t)(skipped*period));
+            last_time += skipped*period;
+            nb_conversion = SIM_MAX_CONVERSION_PER_UPDATE;
+        }
+
+        for(uint64_t i = 0; i < nb_conversion; ++i)
+        {
+            last_time += period;
+            convert(last_time, period);
+        }
+    }
+    else if(!single_pending)
+    {
+        last_time = now;
+    }
+
+    updateAlert();
+    sim_mutex.unlock();
+}
+
+int INA228Sim::i2cWrite(const char* data, int length)
+{
+    update();
+
+    sim_mutex.lock();
+    if(length >= 1)
+    {
+        pointer = data[0] & 0x3F;
+    }
+    if(length >= 3)
+    {
+        writeRegister(pointer, (uint16_t)(((uint8_t)data[1] << 8) | (uint8_t)data[2]));
+    }
+    updateAlert();
+    sim_mutex.unlock();
+
+    return 0;
+}
+
+int INA228Sim::i2cRead(char* data, int length)
+{
+    update();
+
+    sim_mutex.lock();
+    uint8_t size = registerSize(pointer);
+    uint64_t value = reg[pointer];
+
+    for(int i = 0; i < length; ++i)
+    {
+        data[i] = i < size ? (char)((value >> (8*(size - 1 - i))) & 0xFF) : (char)0xFF;
+    }
+
+    // the conversion ready flag and the latched alerts are cleared by the read
+    if(pointer == DIAG_ALRT)
+    {
+        uint64_t clear = DIAG_ALRT_CNVRF | DIAG_ALRT_ENERGYOF | DIAG_ALRT_CHARGEOF | DIAG_ALRT_MATHOF;
+        if(reg[DIAG_ALRT] & DIAG_ALRT_ALATCH)
+        {
+            clear |= DIAG_ALRT_TMPOL | DIAG_ALRT_SHNTOL | DIAG_ALRT_SHNTUL | DIAG_ALRT_BUSOL | DIAG_ALRT_BUSUL | DIAG_ALRT_POL;
+        }
+        reg[DIAG_ALRT] &= ~clear;
+        updateAlert();
+    }
+    sim_mutex.unlock();
+
+    return 0;
+}
+
+void INA228Sim::resetRegisters()
+{
+    memset(reg, 0, sizeof(reg));
+
+    reg[ADC_CONFIG] = 0xFB68;
+    reg[SHUNT_CAL] = 0x1000;
+    reg[DIAG_ALRT] = DIAG_ALRT_MEMSTAT;
+    reg[SOVL] = 0x7FFF;
+    reg[SUVL] = 0x8000;
+    reg[BOVL] = 0x7FFF;
+    reg[BUVL] = 0x0000;
+    reg[TEMP_LIMIT] = 0x7FFF;
+    reg[PWR_LIMIT] = 0xFFFF;
+    reg[MANUFACTURER_ID] = SIM_MANUFACTURER_ID;
+    reg[DEVICE_ID] = SIM_DEVICE_ID;
+
+    energy_acc = 0;
+    charge_acc = 0;
+}
+
+uint8_t INA228Sim::registerSize(uint8_t reg)
+{
+    switch(reg)
+    {
+        case VSHUNT:
+        case VBUS:
+        case CURRENT:
+        case POWER:
+            return 3;
+        case ENERGY:
+        case CHARGE:
+            return 5;
+        default:
+            return 2;
+    }
+}
+
+double_t INA228Sim::currentLSB()
+{
+    double_t range = (reg[CONF] & CONF_ADCRANGE) ? 4.0 : 1.0;
+    return (double_t)reg[SHUNT_CAL]/(SHUNT_CAL_FACTOR*shunt_r*range);
+}
+
+void INA228Sim::convert(uint64_t time_us, uint32_t period_us)
+{
+    uint16_t adc_config = (uint16_t)reg[ADC_CONFIG];
+    uint8_t mode = adc_config >> 12;
+
+    // the result is the average of the signal during the conversion
+    uint32_t nb_sample = sim_averaging_count[adc_config & 0x7];
+    if(nb_sample > SIM_MAX_SAMPLE_PER_CONVERSION) nb_sample = SIM_MAX_SAMPLE_PER_CONVERSION;
+
+    double_t current = 0;
+    double_t voltage = 0;
+    double_t temperature = 0;
+    for(uint32_t i = 0; i < nb_sample; ++i)
+    {
+        uint64_t t = time_us - (uint64_t)period_us*(nb_sample - 1 - i)/nb_sample;
+        current += sampleCurrent(t);
+        voltage += sampleVoltage(t);
+        temperature += sampleTemperature(t);
+    }
+    current /= nb_sample;
+    voltage /= nb_sample;
+    temperature /= nb_sample;
+
+    double_t shunt_voltage = current*shunt_r;
+    double_t shunt_lsb = (reg[CONF] & CONF_ADCRANGE) ? SHUNT_LSB : SHUNT_LSB*4.0;
+    double_t current_lsb = currentLSB();
+
+    if(mode & 0x2)
+    {
+        reg[VSHUNT] = toRegister(shunt_voltage/shunt_lsb, 20, true) << 4;
+    }
+    if(mode & 0x1)
+    {
+        reg[VBUS] = toRegister(voltage/BUS_LSB, 20, true) << 4;
+    }
+    if(mode & 0x4)
+    {
+        reg[DIETEMP] = toRegister(temperature/TEMP_LSB, 16, true);
+    }
+
+    double_t measured_shunt = (double_t)signExtend(reg[VSHUNT] >> 4, 20)*shunt_lsb;
+    double_t measured_bus = (double_t)signExtend(reg[VBUS] >> 4, 20)*BUS_LSB;
+    double_t measured_current = 0;
+    double_t measured_power = 0;
+
+    if(current_lsb > 0)
+    {
+        measured_current = measured_shunt/shunt_r;
+        measured_power = fabs(measured_current*measured_bus);
+
+        reg[CURRENT] = toRegister(measured_current/current_lsb, 20, true) << 4;
+        reg[POWER] = toRegister(measured_power/(3.2*current_lsb), 24, false);
+
+        // accumulators in LSB, they wrap on 40 bits
+        double_t dt = (double_t)period_us/1000000.0;
+        energy_acc += measured_power*dt/(16.0*3.2*current_lsb);
+        charge_acc += measured_current*dt/current_lsb;
+
+        if(energy_acc >= (double_t)(ACCUMULATOR_MASK + 1))
+        {
+            energy_acc -= (double_t)(ACCUMULATOR_MASK + 1);
+            reg[DIAG_ALRT] |= DIAG_ALRT_ENERGYOF;
+        }
+        double_t charge_half = (double_t)((ACCUMULATOR_MASK + 1) >> 1);
+        if(charge_acc >= charge_half || charge_acc < -charge_half)
+        {
+            charge_acc += charge_acc > 0 ? -2.0*charge_half : 2.0*charge_half;
+            reg[DIAG_ALRT] |= DIAG_ALRT_CHARGEOF;
+        }
+        reg[ENERGY] = (uint64_t)energy_acc & ACCUMULATOR_MASK;
+        reg[CHARGE] = (uint64_t)(int64_t)floor(charge_acc) & ACCUMULATOR_MASK;
+    }
+
+    // limits, in transparent mode the flags follow the last conversion
+    uint64_t limit_flags = 0;
+    double_t shunt_limit_lsb = (reg[CONF] & CONF_ADCRANGE) ? SHUNT_OVER_UNDER_VOLTAGE_LSB : SHUNT_OVER_UNDER_VOLTAGE_LSB_RANGE0;
+
+    if(measured_shunt > (double_t)signExtend(reg[SOVL], 16)*shunt_limit_lsb) limit_flags |= DIAG_ALRT_SHNTOL;
+    if(measured_shunt < (double_t)signExtend(reg[SUVL], 16)*shunt_limit_lsb) limit_flags |= DIAG_ALRT_SHNTUL;
+    if(measured_bus > (double_t)reg[BOVL]*BUS_OVER_UNDER_VOLTAGE_LSB) limit_flags |= DIAG_ALRT_BUSOL;
+    if(measured_bus < (double_t)reg[BUVL]*BUS_OVER_UNDER_VOLTAGE_LSB) limit_flags |= DIAG_ALRT_BUSUL;
+    if((double_t)signExtend(reg[DIETEMP], 16)*TEMP_LSB > (double_t)signExtend(reg[TEMP_LIMIT], 16)*TEMP_LIMIT_LSB) limit_flags |= DIAG_ALRT_TMPOL;
+    if(current_lsb > 0 && measured_power > (double_t)reg[PWR_LIMIT]*POWER_LIMIT_FACTOR*3.2*current_lsb) limit_flags |= DIAG_ALRT_POL;
+
+    uint64_t limit_mask = DIAG_ALRT_TMPOL | DIAG_ALRT_SHNTOL | DIAG_ALRT_SHNTUL | DIAG_ALRT_BUSOL | DIAG_ALRT_BUSUL | DIAG_ALRT_POL;
+    if(!(reg[DIAG_ALRT] & DIAG_ALRT_ALATCH))
+    {
+        reg[DIAG_ALRT] &= ~limit_mask;
+    }
+    reg[DIAG_ALRT] |= limit_flags | DIAG_ALRT_CNVRF;
+
+    conversion_count++;
+}
+
+void INA228Sim::writeRegister(uint8_t reg, uint16_t value)
+{
+    switch(reg)
+    {
+        case CONF:
+            if(value & 0x8000)
+            {
+                resetRegisters();
+                return;
+            }
+            if(value & CONF_RSTACC)
+            {
+                energy_acc = 0;
+                charge_acc = 0;
+                this->reg[ENERGY] = 0;
+                this->reg[CHARGE] = 0;
+            }
+            this->reg[CONF] = value & ~(0x8000 | CONF_RSTACC);
+            return;
+
+        case ADC_CONFIG:
+            this->reg[ADC_CONFIG] = value;
+            last_time = host_time_us();
+            single_pending = (value >> 12) != 0 && !((value >> 12) & 0x8);
+            return;
+
+        case DIAG_ALRT:
+            // only the configuration bits can be written
+            this->reg[DIAG_ALRT] = (this->reg[DIAG_ALRT] & 0x0FFF) | (value & 0xF000);
+            return;
+
+        case SHUNT_CAL:
+            this->reg[SHUNT_CAL] = value & 0x7FFF;
+            return;
+
+        case SHUNT_TEMPCO:
+            this->reg[SHUNT_TEMPCO] = value & 0x3FFF;
+            return;
+
+        case BOVL:
+            this->reg[BOVL] = value & 0x7FFF;
+            return;
+
+        case BUVL:
+            this->reg[BUVL] = value & 0x7FFF;
+            return;
+
+        case SOVL:
+        case SUVL:
+        case TEMP_LIMIT:
+        case PWR_LIMIT:
+            this->reg[reg] = value;
+            return;
+
+        default:
+            // read only register
+            return;
+    }
+}
+
+void INA228Sim::updateAlert()
+{
+    if(alert_pin == NC)
+    {
+        return;
+    }
+
+    uint64_t diag = reg[DIAG_ALRT];
+    uint64_t active = diag & DIAG_ALRT_CAUSE_MASK;
+    if(diag & DIAG_ALRT_CNVR)
+    {
+        active |= diag & DIAG_ALRT_CNVRF;
+    }
+
+    int level = active ? 0 : 1;
+    if(diag & DIAG_ALRT_APOL)
+    {
+        level = !level;
+    }
+
+    host_set_pin(alert_pin, level);
+}
+
+float_t INA228Sim::sampleCurrent(uint64_t time_us)
+{
+    return current_waveform ? current_waveform(time_us) : constant_current;
+}
+
+float_t INA228Sim::sampleVoltage(uint64_t time_us)
+{
+    return voltage_waveform ? voltage_waveform(time_us) : constant_voltage;
+}
+
+float_t INA228Sim::sampleTemperature(uint64_t time_us)
+{
+    return temperature_waveform ? temperature_waveform(time_us) : constant_temperature;
+}
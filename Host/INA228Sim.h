@@ -0,0 +1,149 @@
+/**
+ * @file INA228Sim.h
+ * @brief Register level model of the INA228 for the host build
+ *
+ * The model is attached to a host I2C bus and answers like the device:
+ * register pointer, 16, 24 and 40 bits registers, SHUNT_CAL based current and power,
+ * ENERGY and CHARGE accumulators, limits, DIAG_ALRT flags and the ALERT pin.
+ *
+ * The conversions follow the timing programmed in ADC_CONFIG on the host clock.
+ * The shunt current, the bus voltage and the die temperature come from waveforms (functions of the time in us).
+ * The model is updated on every I2C access and with INA228Sim::update().
+ *
+ */
+
+#ifndef INA228_SIM_H
+#define INA228_SIM_H
+
+#include "mbed.h"
+
+#include "INA228/INA228.h"
+
+/**
+ * @brief INA228 simulated on a host I2C bus
+ *
+ */
+class INA228Sim : public HostI2CDevice
+{
+    public:
+
+        /**
+         * @brief INA228Sim constructor
+         *
+         * @param i2c the host I2C bus of the device
+         * @param address 8 bits address of the device
+         * @param shunt_r value of the simulated shunt resistor in Ohms
+         * @param alert_pin the pin driven by the ALERT output (NC if not connected)
+         */
+        INA228Sim(I2C* i2c, char address, float_t shunt_r, PinName alert_pin = NC);
+
+        /**
+         * @brief Set the waveforms of the simulated signals
+         *
+         * @param current shunt current in Amperes function of the time in us
+         * @param voltage bus voltage in Volts function of the time in us
+         * @param temperature die temperature in °C function of the time in us (optional)
+         */
+        void setWaveform(Callback<float_t(uint64_t)> current, Callback<float_t(uint64_t)> voltage, Callback<float_t(uint64_t)> temperature = Callback<float_t(uint64_t)>());
+
+        /**
+         * @brief Set constant simulated signals
+         *
+         * @param current shunt current in Amperes
+         * @param voltage bus voltage in Volts
+         * @param temperature die temperature in °C
+         */
+        void setConstant(float_t current, float_t voltage, float_t temperature = 25.0);
+
+        /**
+         * @brief Run the conversions up to the host clock and update the ALERT pin
+         *
+         */
+        void update();
+
+        /**
+         * @brief Get the value of a register without touching the bus
+         *
+         * @param reg address of the register
+         * @return uint64_t value of the register
+         */
+        uint64_t getRegister(uint8_t reg);
+
+        /**
+         * @brief Get the time between two conversion results with the current ADC_CONFIG
+         *
+         * @return uint32_t period in us (0 if the device is not converting continuously)
+         */
+        uint32_t getConversionPeriod();
+
+        /**
+         * @brief Get the number of conversion results since the start
+         *
+         * @return uint32_t number of conversions
+         */
+        uint32_t getConversionCount();
+
+        int i2cWrite(const char* data, int length);
+        int i2cRead(char* data, int length);
+
+    private:
+
+        Mutex sim_mutex;
+
+        float_t shunt_r;
+        PinName alert_pin;
+
+        Callback<float_t(uint64_t)> current_waveform;
+        Callback<float_t(uint64_t)> voltage_waveform;
+        Callback<float_t(uint64_t)> temperature_waveform;
+        float_t constant_current = 0;
+        float_t constant_voltage = 0;
+        float_t constant_temperature = 25.0;
+
+        uint64_t reg[0x40];
+        uint8_t pointer = 0;
+
+        uint64_t last_time;
+        uint32_t conversion_count = 0;
+        bool single_pending = false;
+
+        double_t energy_acc = 0;
+        double_t charge_acc = 0;
+
+        /**
+         * @brief put all the registers to their reset value
+         *
+         */
+        void resetRegisters();
+
+        /**
+         * @brief size of a register in bytes
+         */
+        static uint8_t registerSize(uint8_t reg);
+
+        /**
+         * @brief current LSB that results from SHUNT_CAL and ADCRANGE
+         */
+        double_t currentLSB();
+
+        /**
+         * @brief do one conversion that ends at time_us and lasts period_us
+         */
+        void convert(uint64_t time_us, uint32_t period_us);
+
+        /**
+         * @brief write a register from the bus
+         */
+        void writeRegister(uint8_t reg, uint16_t value);
+
+        /**
+         * @brief compute the level of the ALERT pin from DIAG_ALRT
+         */
+        void updateAlert();
+
+        float_t sampleCurrent(uint64_t time_us);
+        float_t sampleVoltage(uint64_t time_us);
+        float_t sampleTemperature(uint64_t time_us);
+};
+
+#endif
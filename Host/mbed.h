@@ -0,0 +1,588 @@
+/**
+ * @file mbed.h
+ * @brief Host stand-in of the mbed API used by the library
+ *
+ * Only the part of the mbed OS 5 API used by the library is provided, on top of the C++ standard library.
+ * The RTOS objects are real threads, the peripherals are connected to the simulated devices of the Host directory.
+ *
+ * Build the library on the host with the Host directory first in the include path:
+ *  g++ -std=gnu++14 -IHost -I. -IRS485 ... Host/mbed_host.cpp Host/INA228Sim.cpp INA228/INA228.cpp -lpthread
+ *
+ * The functions that don't exist in mbed start with host_ and are only meant for the simulators.
+ *
+ */
+
+#ifndef HOST_MBED_H
+#define HOST_MBED_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+//###################################################
+//
+// TYPES AND CALLBACK
+//
+//###################################################
+
+typedef int PinName;
+#define NC (-1)
+
+typedef enum
+{
+    PullNone = 0,
+    PullUp = 1,
+    PullDown = 2
+} PinMode;
+
+template<typename F> class Callback;
+
+/**
+ * @brief stand-in of mbed::Callback on top of std::function
+ *
+ */
+template<typename R, typename... A>
+class Callback<R(A...)>
+{
+    public:
+        Callback() {}
+        Callback(R (*function)(A...)) { if(function) this->function = function; }
+        template<typename T, typename M>
+        Callback(T* object, M method) { function = [object, method](A... args) { return (object->*method)(args...); }; }
+        template<typename T, typename U>
+        Callback(R (*bound)(T*, A...), U* argument) { function = [bound, argument](A... args) { return bound(argument, args...); }; }
+
+        R call(A... args) const { return function(args...); }
+        R operator()(A... args) const { return function(args...); }
+        explicit operator bool() const { return (bool)function; }
+
+    private:
+        std::function<R(A...)> function;
+};
+
+template<typename T, typename R, typename... A>
+Callback<R(A...)> callback(T* object, R (T::*method)(A...))
+{
+    return Callback<R(A...)>(object, method);
+}
+
+template<typename R, typename... A>
+Callback<R(A...)> callback(R (*function)(A...))
+{
+    return Callback<R(A...)>(function);
+}
+
+template<typename T, typename U, typename R, typename... A>
+Callback<R(A...)> callback(R (*function)(T*, A...), U* argument)
+{
+    return Callback<R(A...)>(function, argument);
+}
+
+//###################################################
+//
+// HOST CLOCK
+//
+//###################################################
+
+/**
+ * @brief time since the start of the program in us
+ *
+ * The clock follows the real time plus the time added by host_advance_us().
+ */
+uint64_t host_time_us();
+
+/**
+ * @brief move the host clock forward without waiting
+ *
+ * @param us the time to add in us
+ */
+void host_advance_us(uint64_t us);
+
+/**
+ * @brief stand-in of wait_us, the host clock moves forward instead of spinning
+ *
+ * @param us the time to wait
+ */
+void wait_us(int us);
+
+//###################################################
+//
+// RTOS
+//
+//###################################################
+
+typedef enum
+{
+    osPriorityIdle = 1,
+    osPriorityLow = 8,
+    osPriorityBelowNormal = 16,
+    osPriorityNormal = 24,
+    osPriorityAboveNormal = 32,
+    osPriorityHigh = 40,
+    osPriorityRealtime = 48
+} osPriority;
+
+typedef int32_t osStatus;
+#define osOK 0
+#define osErrorTimeout (-2)
+#define osWaitForever 0xFFFFFFFFU
+#define osFlagsError 0x80000000U
+#define osFlagsErrorTimeout 0xFFFFFFFEU
+#define OS_STACK_SIZE 4096
+
+namespace rtos
+{
+    /**
+     * @brief stand-in of rtos::Mutex, recursive like the RTX mutex
+     *
+     */
+    class Mutex
+    {
+        public:
+            Mutex(const char* = NULL) {}
+            osStatus lock(uint32_t = osWaitForever) { mutex.lock(); return osOK; }
+            bool trylock() { return mutex.try_lock(); }
+            osStatus unlock() { mutex.unlock(); return osOK; }
+
+        private:
+            std::recursive_mutex mutex;
+    };
+
+    /**
+     * @brief stand-in of rtos::Semaphore
+     *
+     * The condition variable is never destroyed, a detached thread can still wait on it at the exit.
+     */
+    class Semaphore
+    {
+        public:
+            Semaphore(int32_t count = 0, uint16_t max_count = 0xFFFF);
+            int32_t wait(uint32_t millisec = osWaitForever);
+            void acquire() { wait(); }
+            bool try_acquire() { return wait(0) > 0; }
+            bool try_acquire_for(uint32_t millisec) { return wait(millisec) > 0; }
+            osStatus release();
+
+        private:
+            std::mutex& mutex = *new std::mutex;
+            std::condition_variable& condition = *new std::condition_variable;
+            int32_t count;
+            uint16_t max_count;
+    };
+
+    /**
+     * @brief stand-in of rtos::EventFlags
+     *
+     * The condition variable is never destroyed, a detached thread can still wait on it at the exit.
+     * There is no thread priority on the host: set() gives the threads waiting on the flags
+     * a moment to take them, like a higher priority thread would on the target.
+     */
+    class EventFlags
+    {
+        public:
+            EventFlags(const char* = NULL) {}
+            uint32_t set(uint32_t flags);
+            uint32_t clear(uint32_t flags = 0x7FFFFFFF);
+            uint32_t get() const;
+            uint32_t wait_all(uint32_t flags = 0, uint32_t millisec = osWaitForever, bool clear = true);
+            uint32_t wait_any(uint32_t flags = 0, uint32_t millisec = osWaitForever, bool clear = true);
+
+        private:
+            std::mutex& mutex = *new std::mutex;
+            std::condition_variable& condition = *new std::condition_variable;
+            uint32_t flags = 0;
+            uint16_t waiting[32] = {0}; // number of threads waiting on each flag
+
+            uint32_t wait(uint32_t flags, uint32_t millisec, bool clear, bool all);
+    };
+
+    /**
+     * @brief stand-in of rtos::Thread on top of std::thread
+     *
+     * The priority and the stack size are only stored.
+     */
+    class Thread
+    {
+        public:
+            Thread(osPriority priority = osPriorityNormal, uint32_t stack_size = OS_STACK_SIZE, unsigned char* stack_mem = NULL, const char* name = NULL);
+            ~Thread();
+            osStatus start(Callback<void()> task);
+            osStatus join();
+            osStatus terminate();
+            osStatus set_priority(osPriority priority) { this->priority = priority; return osOK; }
+            osPriority get_priority() const { return priority; }
+            uint32_t stack_size() const { return size; }
+            uint32_t free_stack() const { return size; }
+            uint32_t used_stack() const { return 0; }
+            uint32_t max_stack() const { return 0; }
+            const char* get_name() const { return name; }
+
+        private:
+            std::thread* thread = NULL;
+            osPriority priority;
+            uint32_t size;
+            const char* name;
+    };
+
+    namespace ThisThread
+    {
+        void sleep_for(uint32_t millisec);
+        void sleep_until(uint64_t millisec);
+        void yield();
+    }
+
+    namespace Kernel
+    {
+        uint64_t get_ms_count();
+    }
+}
+
+using namespace rtos;
+
+typedef void* osThreadId_t;
+
+/**
+ * @brief stand-in of the CMSIS-RTOS2 thread enumeration, only the rtos::Thread objects are listed
+ *
+ * The stack of a std::thread can't be measured, osThreadGetStackSpace() returns the whole stack.
+ */
+uint32_t osThreadEnumerate(osThreadId_t* thread_array, uint32_t array_items);
+const char* osThreadGetName(osThreadId_t thread_id);
+uint32_t osThreadGetStackSize(osThreadId_t thread_id);
+uint32_t osThreadGetStackSpace(osThreadId_t thread_id);
+
+//###################################################
+//
+// PERIPHERALS
+//
+//###################################################
+
+/**
+ * @brief stand-in of the critical section, one global lock
+ *
+ */
+class CriticalSectionLock
+{
+    public:
+        CriticalSectionLock();
+        ~CriticalSectionLock();
+};
+
+/**
+ * @brief stand-in of the atomic increment of mbed_critical.h
+ *
+ * @return uint32_t the new value
+ */
+inline uint32_t core_util_atomic_incr_u32(volatile uint32_t* value, uint32_t delta)
+{
+    return __atomic_add_fetch(value, delta, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief stand-in of the atomic decrement of mbed_critical.h
+ *
+ * @return uint32_t the new value
+ */
+inline uint32_t core_util_atomic_decr_u32(volatile uint32_t* value, uint32_t delta)
+{
+    return __atomic_sub_fetch(value, delta, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief stand-in of mbed::Timer on the host clock
+ *
+ */
+class Timer
+{
+    public:
+        void start();
+        void stop();
+        void reset();
+        int read_us();
+        int read_ms();
+        float read();
+        uint64_t read_high_resolution_us();
+
+    private:
+        bool running = false;
+        uint64_t start_time = 0;
+        uint64_t elapsed = 0;
+};
+
+/**
+ * @brief stand-in of mbed::DigitalOut, the value is only stored
+ *
+ */
+class DigitalOut
+{
+    public:
+        DigitalOut(PinName, int value = 0) : value(value) {}
+        void write(int value) { this->value = value; }
+        int read() { return value; }
+        DigitalOut& operator=(int value) { write(value); return *this; }
+        operator int() { return value; }
+
+    private:
+        int value;
+};
+
+/**
+ * @brief stand-in of mbed::AnalogIn, the value is set with host_set_analog()
+ *
+ */
+class AnalogIn
+{
+    public:
+        AnalogIn(PinName pin) : pin(pin) {}
+        float read();
+        unsigned short read_u16();
+        operator float() { return read(); }
+
+    private:
+        PinName pin;
+};
+
+/**
+ * @brief set the value read by every AnalogIn of a pin
+ *
+ * @param pin the pin
+ * @param value the normalized value (0.0 to 1.0)
+ */
+void host_set_analog(PinName pin, float value);
+
+/**
+ * @brief stand-in of mbed::InterruptIn, the edges are generated with host_set_pin()
+ *
+ */
+class InterruptIn
+{
+    public:
+        InterruptIn(PinName pin);
+        ~InterruptIn();
+        void rise(Callback<void()> function) { rise_callback = function; }
+        void fall(Callback<void()> function) { fall_callback = function; }
+        void mode(PinMode) {}
+        void enable_irq() { enabled = true; }
+        void disable_irq() { enabled = false; }
+        int read() { return value; }
+
+    private:
+        friend void host_set_pin(PinName pin, int value);
+
+        PinName pin;
+        int value = 1;
+        bool enabled = true;
+        Callback<void()> rise_callback;
+        Callback<void()> fall_callback;
+};
+
+/**
+ * @brief drive the level of a pin and call the InterruptIn of the edge
+ *
+ * The callback is executed in the context of the caller like an interrupt.
+ *
+ * @param pin the pin
+ * @param value the new level
+ */
+void host_set_pin(PinName pin, int value);
+
+//###################################################
+//
+// SERIAL
+//
+//###################################################
+
+namespace mbed
+{
+    class SerialBase
+    {
+        public:
+            enum Flow
+            {
+                Disabled = 0,
+                RTS,
+                CTS,
+                RTSCTS
+            };
+
+            enum IrqType
+            {
+                RxIrq = 0,
+                TxIrq
+            };
+    };
+}
+
+using namespace mbed;
+
+/**
+ * @brief stand-in of mbed::RawSerial on a shared multi-drop bus
+ *
+ * Every RawSerial of the program is connected to the same bus, like the RS485 transceivers of the boards.
+ * A byte written by one RawSerial is received by all the others (not by itself) with the same baud rate.
+ * Every byte moves the host clock forward by its duration on the line (10 bits).
+ */
+class RawSerial : public mbed::SerialBase
+{
+    public:
+        RawSerial(PinName tx, PinName rx, int baud = 9600);
+        ~RawSerial();
+        void baud(int baudrate) { this->baudrate = baudrate; }
+        void set_flow_control(Flow, PinName = NC, PinName = NC) {}
+        bool readable();
+        bool writeable() { return true; }
+        int getc();
+        int putc(int c);
+        void attach(Callback<void()>, IrqType = RxIrq) {}
+
+        /**
+         * @brief get the baud rate of the port
+         *
+         * @return int the baud rate
+         */
+        int host_baud() { return baudrate; }
+
+        /**
+         * @brief push a byte in the receiver of the port like it came from the bus
+         *
+         * @param c the byte
+         */
+        void host_receive(uint8_t c);
+
+    private:
+        friend void host_serial_error_rate(double_t probability);
+
+        int baudrate;
+        std::mutex mutex;
+        std::deque<uint8_t> rx;
+};
+
+/**
+ * @brief set the probability that a bit is flipped on the serial bus
+ *
+ * @param probability probability of a bit error (0.0 to 1.0)
+ */
+void host_serial_error_rate(double_t probability);
+
+/**
+ * @brief get the number of bytes written on the serial bus since the start
+ *
+ * @return uint64_t the number of bytes
+ */
+uint64_t host_serial_byte_count();
+
+//###################################################
+//
+// I2C
+//
+//###################################################
+
+#define I2C_EVENT_ERROR (1 << 1)
+#define I2C_EVENT_ERROR_NO_SLAVE (1 << 2)
+#define I2C_EVENT_TRANSFER_COMPLETE (1 << 3)
+#define I2C_EVENT_TRANSFER_EARLY_NACK (1 << 4)
+#define I2C_EVENT_ALL (I2C_EVENT_ERROR | I2C_EVENT_TRANSFER_COMPLETE | I2C_EVENT_ERROR_NO_SLAVE | I2C_EVENT_TRANSFER_EARLY_NACK)
+#define DEVICE_I2C_ASYNCH 1
+
+typedef Callback<void(int)> event_callback_t;
+
+/**
+ * @brief simulated I2C slave connected to a host I2C bus
+ *
+ */
+class HostI2CDevice
+{
+    public:
+        virtual ~HostI2CDevice() {}
+
+        /**
+         * @brief the master wrote bytes to the device
+         *
+         * @return 0 on ACK, -1 on NACK
+         */
+        virtual int i2cWrite(const char* data, int length) = 0;
+
+        /**
+         * @brief the master read bytes from the device
+         *
+         * @return 0 on ACK, -1 on NACK
+         */
+        virtual int i2cRead(char* data, int length) = 0;
+};
+
+/**
+ * @brief bus usage counted by the host I2C
+ *
+ */
+typedef struct HostI2CStats_struct
+{
+    uint32_t transactions;
+    uint32_t bytes;
+    uint64_t bus_time_ns;
+} HostI2CStats;
+
+/**
+ * @brief stand-in of mbed::I2C that dispatches to the HostI2CDevice attached to it
+ *
+ * The addresses are 8 bits like in mbed, the R/W bit is ignored.
+ * Every transaction moves the host clock forward by its duration on the bus.
+ */
+class I2C
+{
+    public:
+        I2C(PinName sda, PinName scl);
+        void frequency(int hz) { this->hz = hz; }
+        int write(int address, const char* data, int length, bool repeated = false);
+        int read(int address, char* data, int length, bool repeated = false);
+        int transfer(int address, const char* tx_buffer, int tx_length, char* rx_buffer, int rx_length,
+                     const event_callback_t& callback, int event = I2C_EVENT_TRANSFER_COMPLETE, bool repeated = false);
+        void lock() { mutex.lock(); }
+        void unlock() { mutex.unlock(); }
+
+        /**
+         * @brief attach a simulated device to the bus
+         *
+         * @param address 8 bits address of the device
+         * @param device the simulated device
+         */
+        void host_attach(int address, HostI2CDevice* device);
+
+        /**
+         * @brief get the bus usage since the start or the last host_reset_stats()
+         *
+         * @return HostI2CStats the bus usage
+         */
+        HostI2CStats host_stats();
+
+        /**
+         * @brief restart the bus usage counters
+         *
+         */
+        void host_reset_stats();
+
+    private:
+        static const uint8_t max_device = 16;
+
+        std::recursive_mutex mutex;
+        int hz = 100000;
+        bool in_transaction = false;
+
+        uint8_t nb_device = 0;
+        int device_address[max_device];
+        HostI2CDevice* device[max_device];
+
+        HostI2CStats stats = {0, 0, 0};
+
+        HostI2CDevice* find(int address);
+        void account(int length, bool repeated);
+};
+
+#endif
@@ -0,0 +1,671 @@
+/**
+ * @file mbed_host.cpp
+ * @brief Host stand-in of the mbed API source file
+ *
+ */
+
+#include "mbed.h"
+
+#include <chrono>
+#include <atomic>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+//###################################################
+//
+// HOST CLOCK
+//
+//###################################################
+
+static const std::chrono::steady_clock::time_point host_start = std::chrono::steady_clock::now();
+static std::atomic<uint64_t> host_offset_us(0);
+
+uint64_t host_time_us()
+{
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - host_start;
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() + host_offset_us.load();
+}
+
+void host_advance_us(uint64_t us)
+{
+    host_offset_us += us;
+}
+
+void wait_us(int us)
+{
+    host_advance_us((uint64_t)us);
+}
+
+//###################################################
+//
+// RTOS
+//
+//###################################################
+
+namespace rtos
+{
+    Semaphore::Semaphore(int32_t count, uint16_t max_count)
+    {
+        this->count = count;
+        this->max_count = max_count;
+    }
+
+    int32_t Semaphore::wait(uint32_t millisec)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if(millisec == osWaitForever)
+        {
+            condition.wait(lock, [this] { return count > 0; });
+        }
+        else if(!condition.wait_for(lock, std::chrono::milliseconds(millisec), [this] { return count > 0; }))
+        {
+            return 0;
+        }
+
+        return count--;
+    }
+
+    osStatus Semaphore::release()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if(count < max_count)
+        {
+            count++;
+        }
+        condition.notify_one();
+        return osOK;
+    }
+
+    uint32_t EventFlags::set(uint32_t flags)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        this->flags |= flags;
+        condition.notify_all();
+        uint32_t result = this->flags;
+
+        // let the waiting threads run before the caller goes on, until they clear their flags
+        uint32_t awaited = 0;
+        for(uint8_t bit = 0; bit < 32; ++bit)
+        {
+            if(waiting[bit] && (flags & (1UL << bit)))
+            {
+                awaited |= 1UL << bit;
+            }
+        }
+        if(awaited)
+        {
+            condition.wait_for(lock, std::chrono::milliseconds(5), [this, awaited] { return (this->flags & awaited) == 0; });
+        }
+
+        return result;
+    }
+
+    uint32_t EventFlags::clear(uint32_t flags)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        uint32_t previous = this->flags;
+        this->flags &= ~flags;
+        condition.notify_all();
+        return previous;
+    }
+
+    uint32_t EventFlags::get() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return flags;
+    }
+
+    uint32_t EventFlags::wait_all(uint32_t flags, uint32_t millisec, bool clear)
+    {
+        return wait(flags, millisec, clear, true);
+    }
+
+    uint32_t EventFlags::wait_any(uint32_t flags, uint32_t millisec, bool clear)
+    {
+        return wait(flags, millisec, clear, false);
+    }
+
+    uint32_t EventFlags::wait(uint32_t flags, uint32_t millisec, bool clear, bool all)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        auto ready = [this, flags, all] { return all ? (this->flags & flags) == flags : (this->flags & flags) != 0; };
+        bool timeout = false;
+
+        for(uint8_t bit = 0; bit < 32; ++bit)
+        {
+            waiting[bit] += (flags >> bit) & 1;
+        }
+
+        if(millisec == osWaitForever)
+        {
+            condition.wait(lock, ready);
+        }
+        else
+        {
+            timeout = !condition.wait_for(lock, std::chrono::milliseconds(millisec), ready);
+        }
+
+        for(uint8_t bit = 0; bit < 32; ++bit)
+        {
+            waiting[bit] -= (flags >> bit) & 1;
+        }
+
+        if(timeout)
+        {
+            return osFlagsErrorTimeout;
+        }
+
+        uint32_t result = this->flags;
+        if(clear)
+        {
+            this->flags &= ~flags;
+            condition.notify_all();
+        }
+        return result;
+    }
+
+    static std::mutex thread_list_mutex;
+    static std::vector<Thread*> thread_list;
+
+    Thread::Thread(osPriority priority, uint32_t stack_size, unsigned char*, const char* name)
+    {
+        this->priority = priority;
+        this->size = stack_size;
+        this->name = name;
+
+        std::lock_guard<std::mutex> lock(thread_list_mutex);
+        thread_list.push_back(this);
+    }
+
+    Thread::~Thread()
+    {
+        {
+            std::lock_guard<std::mutex> lock(thread_list_mutex);
+            thread_list.erase(std::remove(thread_list.begin(), thread_list.end(), this), thread_list.end());
+        }
+
+        // the RTX thread is terminated, a std::thread can only be left running
+        if(thread)
+        {
+            if(thread->joinable())
+            {
+                thread->detach();
+            }
+            delete thread;
+        }
+    }
+
+    osStatus Thread::start(Callback<void()> task)
+    {
+        if(thread)
+        {
+            return -1;
+        }
+
+        thread = new std::thread([task] { task(); });
+        return osOK;
+    }
+
+    osStatus Thread::join()
+    {
+        if(thread && thread->joinable())
+        {
+            thread->join();
+        }
+        return osOK;
+    }
+
+    osStatus Thread::terminate()
+    {
+        if(thread && thread->joinable())
+        {
+            thread->detach();
+        }
+        return osOK;
+    }
+
+    namespace ThisThread
+    {
+        void sleep_for(uint32_t millisec)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(millisec));
+        }
+
+        void sleep_until(uint64_t millisec)
+        {
+            uint64_t now = Kernel::get_ms_count();
+            if(millisec > now)
+            {
+                sleep_for((uint32_t)(millisec - now));
+            }
+        }
+
+        void yield()
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    namespace Kernel
+    {
+        uint64_t get_ms_count()
+        {
+            return host_time_us() / 1000;
+        }
+    }
+}
+
+//###################################################
+//
+// PERIPHERALS
+//
+//###################################################
+
+static std::recursive_mutex critical_section;
+
+CriticalSectionLock::CriticalSectionLock()
+{
+    critical_section.lock();
+}
+
+CriticalSectionLock::~CriticalSectionLock()
+{
+    critical_section.unlock();
+}
+
+void Timer::start()
+{
+    if(!running)
+    {
+        start_time = host_time_us();
+        running = true;
+    }
+}
+
+void Timer::stop()
+{
+    if(running)
+    {
+        elapsed += host_time_us() - start_time;
+        running = false;
+    }
+}
+
+void Timer::reset()
+{
+    elapsed = 0;
+    start_time = host_time_us();
+}
+
+uint64_t Timer::read_high_resolution_us()
+{
+    return elapsed + (running ? host_time_us() - start_time : 0);
+}
+
+int Timer::read_us()
+{
+    return (int)read_high_resolution_us();
+}
+
+int Timer::read_ms()
+{
+    return (int)(read_high_resolution_us() / 1000);
+}
+
+float Timer::read()
+{
+    return (float)read_high_resolution_us() / 1000000.0f;
+}
+
+static const uint8_t max_pin = 64;
+
+static float analog_value[max_pin] = {0};
+static InterruptIn* interrupt_pin[max_pin] = {NULL};
+
+void host_set_analog(PinName pin, float value)
+{
+    if(pin >= 0 && pin < max_pin)
+    {
+        analog_value[pin] = value;
+    }
+}
+
+float AnalogIn::read()
+{
+    return (pin >= 0 && pin < max_pin) ? analog_value[pin] : 0;
+}
+
+unsigned short AnalogIn::read_u16()
+{
+    float value = read();
+    if(value <= 0) return 0;
+    if(value >= 1.0f) return 0xFFFF;
+    return (unsigned short)(value*65535.0f);
+}
+
+InterruptIn::InterruptIn(PinName pin)
+{
+    this->pin = pin;
+    if(pin >= 0 && pin < max_pin)
+    {
+        interrupt_pin[pin] = this;
+    }
+}
+
+InterruptIn::~InterruptIn()
+{
+    if(pin >= 0 && pin < max_pin && interrupt_pin[pin] == this)
+    {
+        interrupt_pin[pin] = NULL;
+    }
+}
+
+void host_set_pin(PinName pin, int value)
+{
+    if(pin < 0 || pin >= max_pin || interrupt_pin[pin] == NULL)
+    {
+        return;
+    }
+
+    InterruptIn* input = interrupt_pin[pin];
+    int previous = input->value;
+    input->value = value;
+
+    if(!input->enabled || previous == value)
+    {
+        return;
+    }
+
+    if(value && input->rise_callback)
+    {
+        input->rise_callback();
+    }
+    else if(!value && input->fall_callback)
+    {
+        input->fall_callback();
+    }
+}
+
+//###################################################
+//
+// SERIAL
+//
+//###################################################
+
+static const uint8_t max_serial = 16;
+
+static std::mutex serial_bus_mutex;
+static RawSerial* serial_bus[max_serial] = {NULL};
+static double_t serial_error_probability = 0;
+static std::mt19937 serial_random(1);
+static uint64_t serial_byte_count = 0;
+
+void host_serial_error_rate(double_t probability)
+{
+    std::lock_guard<std::mutex> lock(serial_bus_mutex);
+    serial_error_probability = probability;
+}
+
+uint64_t host_serial_byte_count()
+{
+    std::lock_guard<std::mutex> lock(serial_bus_mutex);
+    return serial_byte_count;
+}
+
+RawSerial::RawSerial(PinName, PinName, int baud)
+{
+    baudrate = baud;
+
+    std::lock_guard<std::mutex> lock(serial_bus_mutex);
+    for(uint8_t i = 0; i < max_serial; ++i)
+    {
+        if(serial_bus[i] == NULL)
+        {
+            serial_bus[i] = this;
+            break;
+        }
+    }
+}
+
+RawSerial::~RawSerial()
+{
+    std::lock_guard<std::mutex> lock(serial_bus_mutex);
+    for(uint8_t i = 0; i < max_serial; ++i)
+    {
+        if(serial_bus[i] == this)
+        {
+            serial_bus[i] = NULL;
+        }
+    }
+}
+
+bool RawSerial::readable()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(!rx.empty())
+        {
+            return true;
+        }
+    }
+
+    // the drivers poll the port, give the CPU to the other simulated boards
+    std::this_thread::yield();
+    return false;
+}
+
+int RawSerial::getc()
+{
+    while(1)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!rx.empty())
+            {
+                uint8_t c = rx.front();
+                rx.pop_front();
+                return c;
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+int RawSerial::putc(int c)
+{
+    std::lock_guard<std::mutex> lock(serial_bus_mutex);
+
+    serial_byte_count++;
+
+    // every data bit is flipped with the bit error probability
+    uint8_t data = (uint8_t)c;
+    if(serial_error_probability > 0)
+    {
+        std::uniform_real_distribution<double_t> distribution(0.0, 1.0);
+        for(uint8_t bit = 0; bit < 8; ++bit)
+        {
+            if(distribution(serial_random) < serial_error_probability)
+            {
+                data ^= (uint8_t)(1 << bit);
+            }
+        }
+    }
+
+    // the byte is received once its stop bit is on the line
+    host_advance_us(10000000ULL/baudrate);
+
+    for(uint8_t i = 0; i < max_serial; ++i)
+    {
+        if(serial_bus[i] && serial_bus[i] != this && serial_bus[i]->baudrate == baudrate)
+        {
+            serial_bus[i]->host_receive(data);
+        }
+    }
+    return c;
+}
+
+void RawSerial::host_receive(uint8_t c)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    rx.push_back(c);
+}
+
+//###################################################
+//
+// I2C
+//
+//###################################################
+
+I2C::I2C(PinName, PinName)
+{
+}
+
+void I2C::host_attach(int address, HostI2CDevice* device)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    if(nb_device < max_device)
+    {
+        device_address[nb_device] = address & 0xFE;
+        this->device[nb_device] = device;
+        nb_device++;
+    }
+}
+
+HostI2CStats I2C::host_stats()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    return stats;
+}
+
+void I2C::host_reset_stats()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    stats.transactions = 0;
+    stats.bytes = 0;
+    stats.bus_time_ns = 0;
+}
+
+HostI2CDevice* I2C::find(int address)
+{
+    for(uint8_t i = 0; i < nb_device; ++i)
+    {
+        if(device_address[i] == (address & 0xFE))
+        {
+            return device[i];
+        }
+    }
+    return NULL;
+}
+
+void I2C::account(int length, bool repeated)
+{
+    // start (or repeated start) + address byte + data bytes with their ACK + stop
+    uint32_t bits = 1 + 9*(1 + length) + (repeated ? 0 : 1);
+    uint64_t time_ns = (uint64_t)bits*1000000000ULL/(uint64_t)hz;
+
+    if(!in_transaction)
+    {
+        stats.transactions++;
+    }
+    in_transaction = repeated;
+
+    stats.bytes += 1 + length;
+    stats.bus_time_ns += time_ns;
+    host_advance_us(time_ns / 1000);
+}
+
+int I2C::write(int address, const char* data, int length, bool repeated)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    account(length, repeated);
+
+    HostI2CDevice* slave = find(address);
+    if(slave == NULL)
+    {
+        return -1;
+    }
+    return slave->i2cWrite(data, length);
+}
+
+int I2C::read(int address, char* data, int length, bool repeated)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    account(length, repeated);
+
+    HostI2CDevice* slave = find(address);
+    if(slave == NULL)
+    {
+        memset(data, 0xFF, length);
+        return -1;
+    }
+    return slave->i2cRead(data, length);
+}
+
+int I2C::transfer(int address, const char* tx_buffer, int tx_length, char* rx_buffer, int rx_length,
+                  const event_callback_t& callback, int event, bool repeated)
+{
+    int result = 0;
+
+    // the transfer is done right away, the callback is called like the end of transfer interrupt
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        if(tx_length)
+        {
+            result = write(address, tx_buffer, tx_length, rx_length > 0 || repeated);
+        }
+        if(result == 0 && rx_length)
+        {
+            result = read(address, rx_buffer, rx_length, repeated);
+        }
+    }
+
+    int flags = result == 0 ? I2C_EVENT_TRANSFER_COMPLETE : I2C_EVENT_ERROR_NO_SLAVE;
+    if(callback && (flags & event))
+    {
+        callback(flags);
+    }
+    return 0;
+}
+
+//###################################################
+//
+// CMSIS-RTOS2
+//
+//###################################################
+
+uint32_t osThreadEnumerate(osThreadId_t* thread_array, uint32_t array_items)
+{
+    std::lock_guard<std::mutex> lock(rtos::thread_list_mutex);
+
+    uint32_t count = 0;
+    for(uint32_t i = 0; i < rtos::thread_list.size() && count < array_items; ++i)
+    {
+        thread_array[count++] = rtos::thread_list[i];
+    }
+    return count;
+}
+
+const char* osThreadGetName(osThreadId_t thread_id)
+{
+    return ((Thread*)thread_id)->get_name();
+}
+
+uint32_t osThreadGetStackSize(osThreadId_t thread_id)
+{
+    return ((Thread*)thread_id)->stack_size();
+}
+
+uint32_t osThreadGetStackSpace(osThreadId_t thread_id)
+{
+    return ((Thread*)thread_id)->free_stack();
+}
@@ -0,0 +1,16 @@
+/**
+ * @file pinDef.h
+ * @brief Pins of the host build, every board firmware provides its own pinDef.h
+ *
+ */
+
+#ifndef HOST_PINDEF_H
+#define HOST_PINDEF_H
+
+#define RS485_TX_PIN 1
+#define RS485_RX_PIN 2
+#define RS485_RE_PIN 3
+#define RS485_TE_PIN 4
+#define RS485_DE_PIN 5
+
+#endif
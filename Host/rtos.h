@@ -0,0 +1,12 @@
+/**
+ * @file rtos.h
+ * @brief Host stand-in of the mbed RTOS header, everything is in mbed.h
+ *
+ */
+
+#ifndef HOST_RTOS_H
+#define HOST_RTOS_H
+
+#include "mbed.h"
+
+#endif
@@ -0,0 +1,124 @@
+/**
+ * @file baud_sim.cpp
+ * @brief Simulation of RS485Baud with slaves supporting different rates
+ *
+ * One master and three slaves share the simulated RS485 bus, a board only receives the bytes
+ * sent at its own rate. The slaves send a CMD_IS_ALIVE frame every SIM_TRAFFIC_MS as traffic.
+ * The steps:
+ * - round trip of a query at RS485_BAUDRATE, negotiation, round trip at the negotiated rate
+ * - bit errors on the bus, the master steps down, the slaves that missed a switch go back to
+ *   RS485_BAUDRATE after RS485_BAUD_SILENCE_MS and the next negotiation finds them
+ * - the end of the exclusion, the master moves the bus back to the negotiated rate by itself
+ *
+ *  g++ -std=gnu++14 -O2 -IHost -I. -IRS485 Host/sim/baud_sim.cpp RS485/RS485.cpp RS485/RS485_frame.cpp RS485/RS485Subscriber.cpp RS485/RS485Baud.cpp
+ *      Utility/Timebase.cpp Utility/MemoryAlloc.cpp Host/mbed_host.cpp -lpthread -o baud_sim
+ *
+ */
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "RS485/RS485_definition.h"
+#include "RS485/RS485.h"
+#include "RS485/RS485Baud.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#define SIM_NB_SLAVE 3
+#define SIM_NB_QUERY 50
+#define SIM_TRAFFIC_MS 10
+#define SIM_NOISE_MS 4000
+#define SIM_ERROR_RATE 3e-3
+
+static RS485* slave_rs[SIM_NB_SLAVE];
+
+static void traffic_thread()
+{
+    while(1)
+    {
+        for(uint8_t i = 0; i < SIM_NB_SLAVE; ++i)
+        {
+            slave_rs[i]->write(slave_rs[i]->getBoardAdress(), CMD_IS_ALIVE, 0, NULL);
+        }
+        ThisThread::sleep_for(SIM_TRAFFIC_MS);
+    }
+}
+
+static float_t round_trip(RS485Baud* master, uint8_t slave)
+{
+    Timer timer;
+    uint8_t mask;
+    uint32_t answered = 0;
+
+    timer.start();
+    for(uint16_t i = 0; i < SIM_NB_QUERY; ++i)
+    {
+        answered += master->query(slave, mask);
+    }
+    return answered ? timer.read_high_resolution_us()/1000.0f/answered : 0.0f;
+}
+
+static void print_state(const char* step, RS485* master_rs, RS485Baud* master, RS485Baud** slave)
+{
+    RS485_baud_stats stats = master->getStats();
+
+    printf("%-28s master %7lu baud, switches %2lu, step downs %lu, step ups %lu, failed %lu | slaves", step, (unsigned long)master_rs->getBaud(),
+           (unsigned long)stats.switches, (unsigned long)stats.step_downs, (unsigned long)stats.step_ups, (unsigned long)stats.failed);
+    for(uint8_t i = 0; i < SIM_NB_SLAVE; ++i)
+    {
+        stats = slave[i]->getStats();
+        printf(" %7lu (silences %lu, failed %lu)", (unsigned long)slave_rs[i]->getBaud(), (unsigned long)stats.silences, (unsigned long)stats.failed);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+int main()
+{
+    const uint8_t address[SIM_NB_SLAVE] = {SLAVE_PSU0, SLAVE_IO, SLAVE_ESC};
+    const uint8_t supported[SIM_NB_SLAVE] = {0x0F, 0x07, 0x0F}; // up to 921600, 460800, 921600
+
+    RS485 master_rs(SLAVE_STATE_SCREEN);
+    RS485Baud master(&master_rs, true, 0x3F);
+    RS485Baud* slave[SIM_NB_SLAVE];
+
+    for(uint8_t i = 0; i < SIM_NB_SLAVE; ++i)
+    {
+        slave_rs[i] = new RS485(address[i]);
+        slave[i] = new RS485Baud(slave_rs[i], false, supported[i]);
+    }
+    ThisThread::sleep_for(50);
+
+    printf("query round trip at %lu baud: %.2f ms\n", (unsigned long)master_rs.getBaud(), round_trip(&master, SLAVE_PSU0));
+
+    Timer timer;
+    timer.start();
+    bool success = master.negotiate(address, SIM_NB_SLAVE);
+    printf("negotiation %s in %.1f ms\n", success ? "done" : "failed", timer.read_high_resolution_us()/1000.0f);
+    print_state("negotiated", &master_rs, &master, slave);
+    printf("query round trip at %lu baud: %.2f ms\n", (unsigned long)master_rs.getBaud(), round_trip(&master, SLAVE_PSU0));
+
+    Thread traffic;
+    traffic.start(callback(traffic_thread));
+    ThisThread::sleep_for(RS485_BAUD_CHECK_MS);
+    print_state("traffic without errors", &master_rs, &master, slave);
+
+    host_serial_error_rate(SIM_ERROR_RATE);
+    ThisThread::sleep_for(SIM_NOISE_MS);
+    RS485_stats bus = master_rs.getStats();
+    print_state("bit errors", &master_rs, &master, slave);
+    printf("master frames %lu, errors %lu\n", (unsigned long)bus.rx_frames, (unsigned long)bus.rx_errors);
+
+    host_serial_error_rate(0.0);
+    ThisThread::sleep_for(RS485_BAUD_SILENCE_MS + 2*RS485_BAUD_POLL_MS);
+    print_state("after the silence", &master_rs, &master, slave);
+    success = master.negotiate(address, SIM_NB_SLAVE);
+    print_state(success ? "negotiated, rates excluded" : "negotiation failed", &master_rs, &master, slave);
+
+    ThisThread::sleep_for(RS485_BAUD_EXCLUDE_MS + 2*RS485_BAUD_CHECK_MS);
+    print_state("end of the exclusion", &master_rs, &master, slave);
+
+    // the threads of the boards are never stopped
+    _exit(0);
+}
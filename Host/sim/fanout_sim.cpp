@@ -0,0 +1,163 @@
+/**
+ * @file fanout_sim.cpp
+ * @brief Simulation of several consumers of the same telemetry on the state screen
+ *
+ * A PSU sends CMD_POWER_WINDOW every SIM_PERIOD_MS with the index of the frame in the payload.
+ * - read: two threads wait in RS485::read() on the command, each frame wakes only one of them
+ * - subscribers: a fast consumer and two slow ones (one drop-oldest, one drop-newest), each with its RS485Subscriber
+ * - single: one slow drop-oldest subscriber alone, its packet being read and its full queue must not
+ *   leave the reader thread without a packet for the newest frame
+ * The age of a frame read is the number of frames sent after it.
+ * Each case runs in its own process, so the boards of a case never see the next one.
+ *
+ *  g++ -std=gnu++14 -O2 -IHost -I. -IRS485 Host/sim/fanout_sim.cpp RS485/RS485.cpp RS485/RS485_frame.cpp RS485/RS485Subscriber.cpp
+ *      Utility/Timebase.cpp Utility/MemoryAlloc.cpp Host/mbed_host.cpp -lpthread -o fanout_sim
+ *
+ */
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "RS485/RS485_definition.h"
+#include "RS485/RS485.h"
+#include "RS485/RS485Subscriber.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define SIM_NB_FRAME 200
+#define SIM_PERIOD_MS 10
+#define SIM_SLOW_MS 35
+#define SIM_NB_CONSUMER 3
+
+#define SIM_MODE_READ 0
+#define SIM_MODE_SUBSCRIBERS 1
+#define SIM_MODE_SINGLE 2
+
+/**
+ * @brief what one consumer got
+ *
+ */
+typedef struct consumer_struct
+{
+    const char* name;
+    uint32_t processing_ms;
+    RS485Subscriber* subscriber;
+    volatile uint32_t received;
+    volatile uint32_t age;      // sum of the frames sent after the one read
+} consumer;
+
+static RS485* screen_rs;
+static volatile uint16_t sent = 0;
+static consumer consumers[SIM_NB_CONSUMER];
+
+static void read_thread(consumer* self)
+{
+    uint8_t cmd_array[1] = {CMD_POWER_WINDOW};
+    uint8_t buffer[255];
+
+    while(1)
+    {
+        screen_rs->read(cmd_array, 1, buffer);
+        self->received++;
+        self->age += sent - 1 - (buffer[0] | (buffer[1] << 8));
+    }
+}
+
+static void subscriber_thread(consumer* self)
+{
+    while(1)
+    {
+        const RS485_packet* packet = self->subscriber->read();
+        self->received++;
+        self->age += sent - 1 - (packet->data[0] | (packet->data[1] << 8));
+
+        // the packet is used without copy while it is processed
+        ThisThread::sleep_for(self->processing_ms);
+        self->subscriber->release(packet);
+    }
+}
+
+static void run(uint8_t mode)
+{
+    RS485 psu_rs(SLAVE_PSU0);
+    RS485 rs(SLAVE_STATE_SCREEN);
+    screen_rs = &rs;
+
+    uint8_t cmd_array[1] = {CMD_POWER_WINDOW};
+    Thread threads[SIM_NB_CONSUMER];
+    uint8_t nb_consumer;
+
+    bool subscribers = mode != SIM_MODE_READ;
+
+    if(mode == SIM_MODE_SINGLE)
+    {
+        consumers[0] = {"alone, drop oldest", SIM_SLOW_MS, new RS485Subscriber(&rs, cmd_array, 1, 2, RS485_SUBSCRIBER_DROP_OLDEST), 0, 0};
+        nb_consumer = 1;
+    }
+    else if(subscribers)
+    {
+        consumers[0] = {"fast", 0, new RS485Subscriber(&rs, cmd_array, 1), 0, 0};
+        consumers[1] = {"slow, drop oldest", SIM_SLOW_MS, new RS485Subscriber(&rs, cmd_array, 1, 2, RS485_SUBSCRIBER_DROP_OLDEST), 0, 0};
+        consumers[2] = {"slow, drop newest", SIM_SLOW_MS, new RS485Subscriber(&rs, cmd_array, 1, 2, RS485_SUBSCRIBER_DROP_NEWEST), 0, 0};
+        nb_consumer = 3;
+    }
+    else
+    {
+        consumers[0] = {"read() 1", 0, NULL, 0, 0};
+        consumers[1] = {"read() 2", 0, NULL, 0, 0};
+        nb_consumer = 2;
+    }
+
+    for(uint8_t i = 0; i < nb_consumer; ++i)
+    {
+        threads[i].start(callback(subscribers ? subscriber_thread : read_thread, &consumers[i]));
+    }
+    ThisThread::sleep_for(50);
+
+    uint8_t payload[46] = {0};
+    for(uint16_t i = 0; i < SIM_NB_FRAME; ++i)
+    {
+        payload[0] = i & 0xFF;
+        payload[1] = i >> 8;
+        sent = i + 1;
+        psu_rs.write(SLAVE_PSU0, CMD_POWER_WINDOW, sizeof(payload), payload);
+        ThisThread::sleep_for(SIM_PERIOD_MS);
+    }
+    ThisThread::sleep_for(200);
+
+    for(uint8_t i = 0; i < nb_consumer; ++i)
+    {
+        printf("%-20s %9lu %8lu %9.2f\n", consumers[i].name, (unsigned long)consumers[i].received,
+               consumers[i].subscriber ? (unsigned long)consumers[i].subscriber->getDropped() : 0UL,
+               consumers[i].received ? (double_t)consumers[i].age/consumers[i].received : 0.0);
+    }
+    if(subscribers)
+    {
+        printf("pool empty: %lu\n", (unsigned long)rs.getPoolEmptyCount());
+    }
+    fflush(stdout);
+
+    // the threads of the boards are never stopped
+    _exit(0);
+}
+
+int main()
+{
+    printf("%d frames every %d ms, slow consumers take %d ms per frame\n", SIM_NB_FRAME, SIM_PERIOD_MS, SIM_SLOW_MS);
+    printf("%-20s %9s %8s %9s\n", "consumer", "received", "dropped", "mean age");
+    fflush(stdout);
+
+    for(uint8_t mode = SIM_MODE_READ; mode <= SIM_MODE_SINGLE; ++mode)
+    {
+        pid_t pid = fork();
+        if(pid == 0)
+        {
+            run(mode);
+        }
+        waitpid(pid, NULL, 0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,237 @@
+/**
+ * @file liveness_sim.cpp
+ * @brief Simulation of the liveness of four PSUs seen by the master
+ *
+ * The PSUs answer CMD_IS_ALIVE like isAliveThread(), some of them also send CMD_POWER_WINDOW
+ * every SIM_TELEMETRY_MS. The cases:
+ * - ping all: the master pings every PSU every RS485_LIVENESS_PING_MS, without tracker
+ * - tracker: RS485Liveness with every PSU sending telemetry, then with two of them silent
+ * - other master: two silent PSUs, another master pings every PSU every SIM_OTHER_PING_MS,
+ *   its pings must not count as heartbeats of the muted PSU
+ * PSU1 stops at SIM_MUTE_MS (no telemetry, no answer) and comes back at SIM_UNMUTE_MS,
+ * the times are from these events to the state changes. The pings are counted before SIM_MUTE_MS.
+ * Each case runs in its own process, so the boards of a case never see the next one.
+ *
+ *  g++ -std=gnu++14 -O2 -IHost -I. -IRS485 Host/sim/liveness_sim.cpp RS485/RS485.cpp RS485/RS485_frame.cpp RS485/RS485Subscriber.cpp
+ *      RS485/RS485Liveness.cpp Utility/Timebase.cpp Utility/MemoryAlloc.cpp Host/mbed_host.cpp -lpthread -o liveness_sim
+ *
+ */
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "RS485/RS485_definition.h"
+#include "RS485/RS485.h"
+#include "RS485/RS485Liveness.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define SIM_NB_PSU 4
+#define SIM_TELEMETRY_MS 100
+#define SIM_MUTE_MS 5000
+#define SIM_UNMUTE_MS 8000
+#define SIM_END_MS 10000
+#define SIM_MUTED 1 // index of PSU1
+#define SIM_OTHER_PING_MS 100
+#define SIM_PING_BYTES (2*RS485_FRAME_OVERHEAD) // ping and answer
+
+/**
+ * @brief one simulated PSU
+ *
+ */
+typedef struct psu_struct
+{
+    RS485* rs;
+    bool telemetry;
+    volatile bool muted;
+} psu;
+
+static psu psus[SIM_NB_PSU];
+static volatile uint32_t pings = 0;
+static uint64_t start_ms;
+
+// times of the state changes of PSU1, from the start
+static volatile uint64_t quiet_ms = 0;
+static volatile uint64_t dead_ms = 0;
+static volatile uint64_t back_ms = 0;
+static volatile uint32_t false_alarms = 0;
+
+static void answer_thread(psu* self)
+{
+    uint8_t cmd_array[1] = {CMD_IS_ALIVE};
+    uint8_t buffer[255];
+
+    while(1)
+    {
+        self->rs->read(cmd_array, 1, buffer);
+        if(!self->muted)
+        {
+            self->rs->write(self->rs->getBoardAdress(), CMD_IS_ALIVE, 0, NULL);
+        }
+    }
+}
+
+static void telemetry_thread(psu* self)
+{
+    uint8_t payload[46] = {0};
+
+    while(1)
+    {
+        if(!self->muted)
+        {
+            self->rs->write(self->rs->getBoardAdress(), CMD_POWER_WINDOW, sizeof(payload), payload);
+        }
+        ThisThread::sleep_for(SIM_TELEMETRY_MS);
+    }
+}
+
+static void other_master_thread(RS485* rs)
+{
+    while(1)
+    {
+        for(uint8_t i = 0; i < SIM_NB_PSU; ++i)
+        {
+            rs->write(SLAVE_PSU0 + i, CMD_IS_ALIVE, 0, NULL);
+            ThisThread::sleep_for(5);
+        }
+        ThisThread::sleep_for(SIM_OTHER_PING_MS);
+    }
+}
+
+static void on_change(uint8_t slave, uint8_t state)
+{
+    uint64_t time = Kernel::get_ms_count() - start_ms;
+
+    if(slave != SLAVE_PSU0 + SIM_MUTED)
+    {
+        false_alarms += state != RS485_LIVENESS_ALIVE;
+        return;
+    }
+    if(time < SIM_MUTE_MS)
+    {
+        false_alarms += state != RS485_LIVENESS_ALIVE;
+    }
+    else if(state == RS485_LIVENESS_QUIET && !quiet_ms)
+    {
+        quiet_ms = time;
+    }
+    else if(state == RS485_LIVENESS_DEAD && !dead_ms)
+    {
+        dead_ms = time;
+    }
+    else if(state == RS485_LIVENESS_ALIVE && time >= SIM_UNMUTE_MS && !back_ms)
+    {
+        back_ms = time;
+    }
+}
+
+static void run(const char* name, bool tracker, uint8_t nb_telemetry, bool other_master)
+{
+    RS485 master_rs(SLAVE_STATE_SCREEN);
+    Thread threads[2*SIM_NB_PSU];
+    Thread other_thread;
+
+    // the serial bus of the host doesn't give the frames back to their sender
+    master_rs.setEcho(false);
+
+    for(uint8_t i = 0; i < SIM_NB_PSU; ++i)
+    {
+        psus[i] = {new RS485(SLAVE_PSU0 + i), i < nb_telemetry, false};
+        threads[2*i].start(callback(answer_thread, &psus[i]));
+        if(psus[i].telemetry)
+        {
+            threads[2*i + 1].start(callback(telemetry_thread, &psus[i]));
+        }
+    }
+
+    if(other_master)
+    {
+        other_thread.start(callback(other_master_thread, new RS485(SLAVE_STATE_SCREEN)));
+    }
+
+    start_ms = Kernel::get_ms_count();
+    RS485Liveness* liveness = NULL;
+    if(tracker)
+    {
+        liveness = new RS485Liveness(&master_rs, SLAVE_MASK_PSU);
+        liveness->onChange(callback(on_change));
+    }
+
+    while(Kernel::get_ms_count() - start_ms < SIM_END_MS)
+    {
+        uint64_t time = Kernel::get_ms_count() - start_ms;
+        if(time < SIM_MUTE_MS && liveness)
+        {
+            pings = liveness->getStats().pings;
+        }
+        psus[SIM_MUTED].muted = time >= SIM_MUTE_MS && time < SIM_UNMUTE_MS;
+
+        if(!tracker)
+        {
+            for(uint8_t i = 0; i < SIM_NB_PSU; ++i)
+            {
+                master_rs.write(SLAVE_PSU0 + i, CMD_IS_ALIVE, 0, NULL);
+            }
+            if(time < SIM_MUTE_MS)
+            {
+                pings += SIM_NB_PSU;
+            }
+            ThisThread::sleep_for(RS485_LIVENESS_PING_MS);
+        }
+        else
+        {
+            ThisThread::sleep_for(10);
+        }
+    }
+
+    double_t rate = pings*1000.0/SIM_MUTE_MS;
+    if(tracker)
+    {
+        printf("%-24s %8.1f %8.0f %8lu %8lu %8lu %6lu\n", name, rate, rate*SIM_PING_BYTES,
+               (unsigned long)(quiet_ms ? quiet_ms - SIM_MUTE_MS : 0), (unsigned long)(dead_ms ? dead_ms - SIM_MUTE_MS : 0),
+               (unsigned long)(back_ms ? back_ms - SIM_UNMUTE_MS : 0), (unsigned long)false_alarms);
+    }
+    else
+    {
+        printf("%-24s %8.1f %8.0f %8s %8s %8s %6s\n", name, rate, rate*SIM_PING_BYTES, "-", "-", "-", "-");
+    }
+    fflush(stdout);
+
+    // the threads of the boards are never stopped
+    _exit(0);
+}
+
+int main()
+{
+    printf("%d PSUs, telemetry every %d ms, stale %d ms, dead %d ms, PSU1 silent from %d to %d ms\n", SIM_NB_PSU, SIM_TELEMETRY_MS,
+           RS485_LIVENESS_STALE_MS, RS485_LIVENESS_DEAD_MS, SIM_MUTE_MS, SIM_UNMUTE_MS);
+    printf("%-24s %8s %8s %8s %8s %8s %6s\n", "case", "pings/s", "B/s", "quiet ms", "dead ms", "back ms", "false");
+    fflush(stdout);
+
+    const struct
+    {
+        const char* name;
+        bool tracker;
+        uint8_t nb_telemetry;
+        bool other_master;
+    } cases[] = {
+        {"ping all", false, SIM_NB_PSU, false},
+        {"tracker, 4 telemetry", true, SIM_NB_PSU, false},
+        {"tracker, 2 telemetry", true, 2, false},
+        {"other master", true, 2, true},
+    };
+
+    for(const auto& test : cases)
+    {
+        pid_t pid = fork();
+        if(pid == 0)
+        {
+            run(test.name, test.tracker, test.nb_telemetry, test.other_master);
+        }
+        waitpid(pid, NULL, 0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,198 @@
+/**
+ * @file motor_sim.cpp
+ * @brief Simulation of the motor setpoints sent to the ESC board, one frame per motor or RS485MotorSet
+ *
+ * The master runs a control loop every SIM_PERIOD_MS and sends the setpoints of 8 motors:
+ * - per motor: one CMD_PWM frame per motor, [motor][setpoint][update] (16 bits each), the update ends with the last motor
+ *   (RS485::read() gives one frame of a command per batch received, the ESC misses some of the other motors)
+ * - key frames: RS485MotorSet without delta
+ * - delta: RS485MotorSet against the last set acknowledged by the ESC
+ * The latency goes from the start of the update on the master to the end of the update on the ESC,
+ * the motors read count the setpoints the ESC got.
+ * Four motors follow a slow sine, the others hold their setpoint.
+ * Each case runs in its own process, so the boards of a case never see the next one.
+ *
+ *  g++ -std=gnu++14 -O2 -IHost -I. -IRS485 Host/sim/motor_sim.cpp RS485/RS485.cpp RS485/RS485_frame.cpp RS485/RS485Subscriber.cpp RS485/RS485MotorSet.cpp RS485/RS485Serializer.cpp
+ *      Utility/Timebase.cpp Utility/MemoryAlloc.cpp Host/mbed_host.cpp -lpthread -o motor_sim
+ *
+ */
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "RS485/RS485_definition.h"
+#include "RS485/RS485.h"
+#include "RS485/RS485MotorSet.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <vector>
+
+#define SIM_NB_MOTOR 8
+#define SIM_NB_UPDATE 300
+#define SIM_PERIOD_MS 10
+#define SIM_PWM_SIZE 5
+
+#define SIM_MODE_PER_MOTOR 0
+#define SIM_MODE_KEY_FRAME 1
+#define SIM_MODE_DELTA 2
+
+static const char* mode_name[] = {"per motor", "key frames", "delta"};
+static const double_t error_rate[] = {0.0, 1e-3};
+
+static RS485* esc_rs;
+static RS485MotorSet* esc_set;
+static uint64_t start_us[SIM_NB_UPDATE];
+static std::vector<uint32_t> latency;
+static Mutex latency_mutex;
+static volatile uint32_t motor_read = 0;
+
+static void setpoints_of(uint16_t update, int16_t* setpoints)
+{
+    // the update in motor 0 gives the set back on the ESC
+    setpoints[0] = (int16_t)update;
+    for(uint8_t i = 1; i < SIM_NB_MOTOR; ++i)
+    {
+        setpoints[i] = i < SIM_NB_MOTOR/2 ? (int16_t)(1500 + 300*sin(update*0.05 + i)) : (int16_t)(1500 + 10*i);
+    }
+}
+
+static void complete(uint16_t update)
+{
+    if(update >= SIM_NB_UPDATE)
+    {
+        return;
+    }
+    latency_mutex.lock();
+    latency.push_back((uint32_t)(host_time_us() - start_us[update]));
+    latency_mutex.unlock();
+}
+
+static void pwm_thread()
+{
+    uint8_t cmd_array[1] = {CMD_PWM};
+    uint8_t buffer[255];
+
+    while(1)
+    {
+        uint8_t nb_byte = esc_rs->read(cmd_array, 1, buffer);
+        if(nb_byte != SIM_PWM_SIZE || buffer[0] >= SIM_NB_MOTOR)
+        {
+            continue;
+        }
+
+        motor_read++;
+        if(buffer[0] == SIM_NB_MOTOR - 1)
+        {
+            complete(buffer[3] | (buffer[4] << 8));
+        }
+    }
+}
+
+static void motor_set_thread()
+{
+    int16_t setpoints[RS485_MOTOR_MAX];
+
+    while(1)
+    {
+        esc_set->read(setpoints);
+        motor_read += SIM_NB_MOTOR;
+        complete((uint16_t)setpoints[0]);
+    }
+}
+
+static void run(uint8_t mode, double_t rate)
+{
+    RS485 master_rs(SLAVE_STATE_SCREEN);
+    RS485 slave_rs(SLAVE_ESC);
+    esc_rs = &slave_rs;
+
+    RS485MotorSet* master_set = NULL;
+    Thread esc_reader;
+    if(mode == SIM_MODE_PER_MOTOR)
+    {
+        esc_reader.start(callback(pwm_thread));
+    }
+    else
+    {
+        master_set = new RS485MotorSet(&master_rs, true, SIM_NB_MOTOR, mode == SIM_MODE_DELTA);
+        esc_set = new RS485MotorSet(&slave_rs, false, SIM_NB_MOTOR);
+        esc_reader.start(callback(motor_set_thread));
+    }
+    ThisThread::sleep_for(50);
+
+    host_serial_error_rate(rate);
+    master_rs.resetStats();
+
+    int16_t setpoints[SIM_NB_MOTOR];
+    for(uint16_t update = 0; update < SIM_NB_UPDATE; ++update)
+    {
+        setpoints_of(update, setpoints);
+        start_us[update] = host_time_us();
+
+        if(mode == SIM_MODE_PER_MOTOR)
+        {
+            for(uint8_t i = 0; i < SIM_NB_MOTOR; ++i)
+            {
+                uint8_t pwm[SIM_PWM_SIZE] = {i, (uint8_t)(setpoints[i] & 0xFF), (uint8_t)(setpoints[i] >> 8),
+                                             (uint8_t)(update & 0xFF), (uint8_t)(update >> 8)};
+                master_rs.write(SLAVE_ESC, CMD_PWM, SIM_PWM_SIZE, pwm);
+            }
+        }
+        else
+        {
+            master_set->set(setpoints);
+        }
+        ThisThread::sleep_for(SIM_PERIOD_MS);
+    }
+    ThisThread::sleep_for(50);
+
+    RS485_stats bus = master_rs.getStats();
+    latency_mutex.lock();
+    std::sort(latency.begin(), latency.end());
+    uint64_t total = 0;
+    for(uint32_t value : latency)
+    {
+        total += value;
+    }
+
+    printf("%-11s %7.0e %9.1f %9.0f %8u %8u %7.1f%% %10.1f%%", mode_name[mode], rate, (double_t)bus.tx_bytes/SIM_NB_UPDATE,
+           latency.empty() ? 0.0 : (double_t)total/latency.size(), latency.empty() ? 0 : latency[latency.size()*99/100],
+           latency.empty() ? 0 : latency.back(), 100.0*latency.size()/SIM_NB_UPDATE, 100.0*motor_read/SIM_NB_UPDATE/SIM_NB_MOTOR);
+    if(master_set)
+    {
+        RS485_motor_stats stats = master_set->getStats();
+        printf(" %6lu %6lu", (unsigned long)stats.key_frames, (unsigned long)stats.resync);
+    }
+    printf("\n");
+    fflush(stdout);
+    latency_mutex.unlock();
+
+    // the threads of the boards are never stopped
+    _exit(0);
+}
+
+int main()
+{
+    printf("%d motors every %d ms at %d baud\n", SIM_NB_MOTOR, SIM_PERIOD_MS, RS485_BAUDRATE);
+    printf("%-11s %7s %9s %9s %8s %8s %8s %11s %6s %6s\n", "mode", "ber", "B/update", "mean us", "p99 us", "max us", "updates", "motors read", "keys", "resync");
+    fflush(stdout);
+
+    for(double_t rate : error_rate)
+    {
+        for(uint8_t mode = SIM_MODE_PER_MOTOR; mode <= SIM_MODE_DELTA; ++mode)
+        {
+            pid_t pid = fork();
+            if(pid == 0)
+            {
+                run(mode, rate);
+            }
+            waitpid(pid, NULL, 0);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,269 @@
+/**
+ * @file reliable_sim.cpp
+ * @brief Simulation of RS485Reliable against the resend of the application on a noisy bus
+ *
+ * The master sends CMD_IO_TORPEDO_ACTION to the IO board and waits for its response.
+ * Without RS485Reliable, a lost request or response is only recovered when the master
+ * gives up after SIM_APP_TIMEOUT_MS and sends again. With RS485Reliable the frame is sent
+ * again after RS485Reliable::getTimeout(). The latency is measured from the first request
+ * to the response, for several bit error rates of the simulated bus.
+ * The last case is scripted: the master sends sequence 0 twice, as after a lost ack, then the next
+ * sequences and a new sequence 0 once the window moved on, as after a reset of the master.
+ * The copy must be dropped and the restart delivered.
+ * Each case runs in its own process, so the boards of a case never see the next one.
+ *
+ *  g++ -std=gnu++14 -O2 -IHost -I. -IRS485 Host/sim/reliable_sim.cpp RS485/RS485.cpp RS485/RS485_frame.cpp RS485/RS485Subscriber.cpp RS485/RS485Reliable.cpp
+ *      Utility/Timebase.cpp Utility/MemoryAlloc.cpp Host/mbed_host.cpp -lpthread -o reliable_sim
+ *
+ */
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "RS485/RS485_definition.h"
+#include "RS485/RS485.h"
+#include "RS485/RS485Reliable.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <vector>
+
+#define SIM_NB_COMMAND 60
+#define SIM_APP_TIMEOUT_MS 500
+#define SIM_SCRIPT_PERIOD_MS 5
+
+static const double_t error_rate[] = {0.0, 1e-4, 5e-4, 1e-3, 2e-3};
+
+/**
+ * @brief one side of the exchange, through RS485 or RS485Reliable
+ *
+ */
+class SimLink
+{
+    public:
+        SimLink(RS485* rs, RS485Reliable* reliable) : rs(rs), reliable(reliable) {}
+
+        void write(uint8_t slave, uint8_t value)
+        {
+            if(reliable)
+            {
+                reliable->write(slave, CMD_IO_TORPEDO_ACTION, 1, &value);
+            }
+            else
+            {
+                rs->write(slave, CMD_IO_TORPEDO_ACTION, 1, &value);
+            }
+        }
+
+        uint8_t read()
+        {
+            uint8_t cmd_array[1] = {CMD_IO_TORPEDO_ACTION};
+            uint8_t buffer[RS485_MAX_PAYLOAD];
+            uint8_t slave;
+            uint8_t cmd;
+
+            if(reliable)
+            {
+                reliable->read(cmd_array, 1, slave, cmd, buffer);
+            }
+            else
+            {
+                rs->read(cmd_array, 1, slave, buffer);
+            }
+            return buffer[0];
+        }
+
+    private:
+        RS485* rs;
+        RS485Reliable* reliable;
+};
+
+static SimLink* master_link;
+static SimLink* slave_link;
+static volatile uint8_t expected;
+static Semaphore response(0);
+
+static void slave_thread()
+{
+    while(1)
+    {
+        uint8_t value = slave_link->read();
+        slave_link->write(SLAVE_IO, value);
+    }
+}
+
+static void response_thread()
+{
+    while(1)
+    {
+        if(master_link->read() == expected)
+        {
+            response.release();
+        }
+    }
+}
+
+static void run(bool use_reliable, double_t rate)
+{
+    RS485 master_rs(SLAVE_STATE_SCREEN);
+    RS485 slave_rs(SLAVE_IO);
+    uint8_t reliable_cmd[1] = {CMD_IO_TORPEDO_ACTION};
+    RS485Reliable* master_reliable = use_reliable ? new RS485Reliable(&master_rs, true, reliable_cmd, 1) : NULL;
+    RS485Reliable* slave_reliable = use_reliable ? new RS485Reliable(&slave_rs, false, reliable_cmd, 1) : NULL;
+    SimLink master(&master_rs, master_reliable);
+    SimLink slave(&slave_rs, slave_reliable);
+    master_link = &master;
+    slave_link = &slave;
+
+    if(use_reliable && rate == 0.0)
+    {
+        printf("timeout of the reliable delivery: %lu ms at %lu baud, of the application: %d ms\n", (unsigned long)master_reliable->getTimeout(1),
+               (unsigned long)master_rs.getBaud(), SIM_APP_TIMEOUT_MS);
+    }
+
+    Thread slave_reader;
+    Thread master_reader;
+    slave_reader.start(callback(slave_thread));
+    master_reader.start(callback(response_thread));
+    ThisThread::sleep_for(50);
+
+    host_serial_error_rate(rate);
+
+    std::vector<uint32_t> latency;
+    uint32_t app_resend = 0;
+    Timer timer;
+    timer.start();
+
+    for(uint16_t i = 0; i < SIM_NB_COMMAND; ++i)
+    {
+        expected = (uint8_t)(i + 1);
+        uint64_t start = timer.read_high_resolution_us();
+
+        while(1)
+        {
+            master.write(SLAVE_IO, expected);
+            if(response.wait(SIM_APP_TIMEOUT_MS) > 0)
+            {
+                break;
+            }
+            app_resend++;
+        }
+        latency.push_back((uint32_t)((timer.read_high_resolution_us() - start)/1000));
+    }
+
+    std::sort(latency.begin(), latency.end());
+    uint64_t total = 0;
+    for(uint32_t value : latency)
+    {
+        total += value;
+    }
+
+    printf("%-9s %8.0e %9.1f %8u %8u %10u", use_reliable ? "reliable" : "plain", rate, (double_t)total/latency.size(),
+           latency[latency.size()*99/100], latency.back(), app_resend);
+    if(use_reliable)
+    {
+        RS485_reliable_stats a = master_reliable->getStats();
+        RS485_reliable_stats b = slave_reliable->getStats();
+        printf(" %10lu %10lu %10lu", (unsigned long)(a.retransmitted + b.retransmitted), (unsigned long)(a.piggybacked + b.piggybacked),
+               (unsigned long)(a.duplicates + b.duplicates));
+    }
+    printf("\n");
+    fflush(stdout);
+
+    // the threads of the boards are never stopped
+    _exit(0);
+}
+
+static volatile uint32_t delivered = 0;
+
+static void count_thread(RS485Reliable* reliable)
+{
+    uint8_t cmd_array[1] = {CMD_IO_TORPEDO_ACTION};
+    uint8_t buffer[RS485_RELIABLE_MAX_DATA];
+    uint8_t slave;
+    uint8_t cmd;
+
+    while(1)
+    {
+        reliable->read(cmd_array, 1, slave, cmd, buffer);
+        delivered++;
+    }
+}
+
+static void scriptedSend(RS485* rs, uint8_t seq)
+{
+    // [direction | sequence][no ack][value], what RS485Reliable of the master would send
+    uint8_t frame[RS485_RELIABLE_HEADER + 1] = {(uint8_t)(RS485_RELIABLE_FROM_MASTER | seq), 0, seq};
+
+    rs->write(SLAVE_IO, CMD_IO_TORPEDO_ACTION, sizeof(frame), frame);
+    ThisThread::sleep_for(SIM_SCRIPT_PERIOD_MS);
+}
+
+static void lostAckOnRestart()
+{
+    RS485 master_rs(SLAVE_STATE_SCREEN);
+    RS485 slave_rs(SLAVE_IO);
+    uint8_t reliable_cmd[1] = {CMD_IO_TORPEDO_ACTION};
+    RS485Reliable slave_reliable(&slave_rs, false, reliable_cmd, 1);
+
+    Thread counter;
+    counter.start(callback(count_thread, &slave_reliable));
+    ThisThread::sleep_for(50);
+
+    uint32_t sent = 0;
+
+    // the ack of sequence 0 is lost, the master sends it again
+    scriptedSend(&master_rs, 0);
+    scriptedSend(&master_rs, 0);
+    sent++;
+
+    for(uint8_t seq = 1; seq <= RS485_RELIABLE_WINDOW + 8; ++seq)
+    {
+        scriptedSend(&master_rs, seq);
+        sent++;
+    }
+
+    // the master was reset
+    scriptedSend(&master_rs, 0);
+    scriptedSend(&master_rs, 1);
+    sent += 2;
+    ThisThread::sleep_for(50);
+
+    RS485_reliable_stats stats = slave_reliable.getStats();
+    printf("lost ack on sequence 0: %lu delivered of %lu, %lu copy dropped: %s\n", (unsigned long)delivered, (unsigned long)sent,
+           (unsigned long)stats.duplicates, delivered == sent && stats.duplicates == 1 ? "ok" : "FAIL");
+    fflush(stdout);
+
+    // the threads of the boards are never stopped
+    _exit(0);
+}
+
+int main()
+{
+    printf("%-9s %8s %9s %8s %8s %10s %10s %10s %10s\n", "mode", "ber", "mean ms", "p99 ms", "max ms", "app resend", "retransmit", "piggyback", "duplicate");
+    fflush(stdout);
+
+    for(double_t rate : error_rate)
+    {
+        for(uint8_t use_reliable = 0; use_reliable < 2; ++use_reliable)
+        {
+            pid_t pid = fork();
+            if(pid == 0)
+            {
+                run(use_reliable, rate);
+            }
+            waitpid(pid, NULL, 0);
+        }
+    }
+
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+        lostAckOnRestart();
+    }
+    waitpid(pid, NULL, 0);
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file serializer_sim.cpp
+ * @brief Checks of RS485Serializer on a stream of power windows, and the bytes of a frame
+ *
+ * The PSU encodes SIM_NB_FRAME power windows with a slow random walk of the values, the master
+ * decodes them. The cases:
+ * - round trip: every frame decodes to the values encoded
+ * - lost delta frame: the delta frames after the gap are rejected until the next key frame
+ * - lost key frame: the same, the decoder was synchronized on the frames before
+ * - truncated frame: rejected, the frames after it wait for the next key frame
+ * The bytes per frame of the serializer are compared with the floats the firmware sends.
+ * The program returns 1 if a check fails.
+ *
+ *  g++ -std=gnu++14 -O2 -IHost -I. -IRS485 Host/sim/serializer_sim.cpp RS485/RS485Serializer.cpp
+ *      Utility/MemoryAlloc.cpp Host/mbed_host.cpp -lpthread -o serializer_sim
+ *
+ */
+
+#include "mbed.h"
+
+#include "RS485/RS485_definition.h"
+#include "RS485/RS485Serializer.h"
+#include "RS485/RS485_frame.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_NB_FRAME 1000
+#define SIM_KEY_FRAME_INTERVAL 10
+#define SIM_NB_FIELD 9
+#define SIM_FLOAT_SIZE 46 // response of CMD_POWER_WINDOW in the registry, floats of the firmware
+
+static uint32_t failures = 0;
+
+static void check(bool condition, const char* what, uint32_t frame)
+{
+    if(!condition)
+    {
+        printf("FAIL %s, frame %lu\n", what, (unsigned long)frame);
+        failures++;
+    }
+}
+
+static void nextWindow(int32_t* values, uint32_t frame)
+{
+    values[0] = 100;
+    for(uint8_t i = 1; i < SIM_NB_FIELD; ++i)
+    {
+        // around 2 A and 16 V, a few mA or mV per window
+        values[i] = (i < 5 ? 2000 : 16000) + (int32_t)(frame % 50) - (rand() % 7);
+    }
+}
+
+/**
+ * @brief run the stream, the frame lost is not given to the decoder, the frame cut loses its last byte
+ *
+ * @return double_t the mean payload size
+ */
+static double_t run(const char* name, uint32_t lost, uint32_t cut)
+{
+    RS485Serializer encoder(SCHEMA_PSU_POWER_WINDOW, SIM_KEY_FRAME_INTERVAL);
+    RS485Serializer decoder(SCHEMA_PSU_POWER_WINDOW, SIM_KEY_FRAME_INTERVAL);
+    int32_t values[SIM_NB_FIELD];
+    int32_t decoded[SIM_NB_FIELD];
+    uint8_t payload[schemaMaxSize(SCHEMA_PSU_POWER_WINDOW)];
+    uint32_t bytes = 0;
+    uint32_t rejected = 0;
+    uint32_t failures_before = failures;
+
+    // the first key frame after the gap, the frames are numbered from 0
+    uint32_t gap = lost < cut ? lost : cut;
+    uint32_t resync = (gap/SIM_KEY_FRAME_INTERVAL + 1)*SIM_KEY_FRAME_INTERVAL;
+
+    srand(1);
+    for(uint32_t frame = 0; frame < SIM_NB_FRAME; ++frame)
+    {
+        nextWindow(values, frame);
+        uint8_t size = encoder.encode(values, payload);
+        bytes += size;
+
+        if(frame == lost)
+        {
+            continue;
+        }
+
+        bool ok = decoder.decode(payload, frame == cut ? size - 1 : size, decoded);
+        bool expected = frame < gap || frame >= resync;
+        check(ok == expected, expected ? "frame rejected" : "frame accepted after a gap", frame);
+        if(ok)
+        {
+            check(memcmp(values, decoded, sizeof(values)) == 0, "wrong values", frame);
+        }
+        rejected += !ok;
+    }
+
+    printf("%-24s %8lu %8s\n", name, (unsigned long)rejected, failures == failures_before ? "ok" : "FAIL");
+    return (double_t)bytes/SIM_NB_FRAME;
+}
+
+int main()
+{
+    printf("%d power windows, a key frame every %d frames\n", SIM_NB_FRAME, SIM_KEY_FRAME_INTERVAL);
+    printf("%-24s %8s %8s\n", "case", "rejected", "result");
+
+    double_t mean_size = run("round trip", SIM_NB_FRAME, SIM_NB_FRAME);
+    run("lost delta frame", 503, SIM_NB_FRAME);
+    run("lost key frame", 500, SIM_NB_FRAME);
+    run("truncated frame", SIM_NB_FRAME, 507);
+
+    uint32_t frame_serializer = (uint32_t)(mean_size + 0.5) + RS485_FRAME_OVERHEAD;
+    uint32_t frame_float = SIM_FLOAT_SIZE + RS485_FRAME_OVERHEAD;
+    printf("\n%-24s %8s %8s\n", "bytes per frame", "payload", "frame");
+    printf("%-24s %8d %8lu\n", "floats of the firmware", SIM_FLOAT_SIZE, (unsigned long)frame_float);
+    printf("%-24s %8lu %8s\n", "serializer max", (unsigned long)schemaMaxSize(SCHEMA_PSU_POWER_WINDOW), "-");
+    printf("%-24s %8.1f %8lu\n", "serializer mean", mean_size, (unsigned long)frame_serializer);
+    check(frame_serializer < frame_float, "serializer frame not smaller", 0);
+
+    return failures ? 1 : 0;
+}
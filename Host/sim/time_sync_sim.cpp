@@ -0,0 +1,105 @@
+/**
+ * @file time_sync_sim.cpp
+ * @brief Simulation of RS485TimeSync with boards whose clocks drift
+ *
+ * One master and three slaves share the simulated RS485 bus, each slave clock has its own
+ * offset and drift. The shared time of every slave is compared with the time of the master
+ * at the same instant, after the convergence.
+ *
+ *  g++ -std=gnu++14 -O2 -IHost -I. -IRS485 Host/sim/time_sync_sim.cpp RS485/RS485.cpp RS485/RS485_frame.cpp RS485/RS485Subscriber.cpp RS485/RS485TimeSync.cpp
+ *      Utility/Timebase.cpp Utility/MemoryAlloc.cpp Host/mbed_host.cpp -lpthread -o time_sync_sim
+ *
+ */
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "RS485/RS485_definition.h"
+#include "RS485/RS485.h"
+#include "RS485/RS485TimeSync.h"
+#include "Utility/Timebase.h"
+
+#include <stdio.h>
+
+#define SIM_PERIOD_MS 250
+#define SIM_DURATION_MS 20000
+#define SIM_SETTLE_MS 8000
+#define SIM_NB_SLAVE 3
+
+/**
+ * @brief clock of a simulated board, the host clock with an offset and a drift
+ *
+ */
+class DriftingClock
+{
+    public:
+        DriftingClock(int64_t offset_us, int32_t drift_ppm) : offset_us(offset_us), drift_ppm(drift_ppm) {}
+
+        int32_t getDrift() { return drift_ppm; }
+
+        uint64_t now()
+        {
+            int64_t host = (int64_t)host_time_us();
+            return (uint64_t)(host + offset_us + host*drift_ppm/1000000);
+        }
+
+    private:
+        int64_t offset_us;
+        int32_t drift_ppm;
+};
+
+int main()
+{
+    const uint8_t address[SIM_NB_SLAVE] = {SLAVE_PSU0, SLAVE_PSU1, SLAVE_IO};
+    DriftingClock clock[SIM_NB_SLAVE] = {DriftingClock(3000000, 50), DriftingClock(-1200000, -80), DriftingClock(450000, 20)};
+
+    Timebase master_timebase;
+    RS485 master_rs(SLAVE_STATE_SCREEN);
+    RS485TimeSync master(&master_rs, &master_timebase, true, SIM_PERIOD_MS);
+
+    Timebase* timebase[SIM_NB_SLAVE];
+    RS485* rs[SIM_NB_SLAVE];
+    RS485TimeSync* sync[SIM_NB_SLAVE];
+
+    for(uint8_t i = 0; i < SIM_NB_SLAVE; ++i)
+    {
+        timebase[i] = new Timebase(callback(&clock[i], &DriftingClock::now));
+        rs[i] = new RS485(address[i]);
+        sync[i] = new RS485TimeSync(rs[i], timebase[i], false, SIM_PERIOD_MS);
+    }
+
+    double_t sum_square[SIM_NB_SLAVE] = {0};
+    int64_t max_error[SIM_NB_SLAVE] = {0};
+    uint32_t nb_measure = 0;
+
+    for(uint32_t elapsed = 0; elapsed < SIM_DURATION_MS; elapsed += 50)
+    {
+        ThisThread::sleep_for(50);
+
+        if(elapsed < SIM_SETTLE_MS)
+        {
+            continue;
+        }
+
+        for(uint8_t i = 0; i < SIM_NB_SLAVE; ++i)
+        {
+            int64_t error = (int64_t)(timebase[i]->getTime() - master_timebase.getTime());
+            sum_square[i] += (double_t)error*error;
+            if(error > max_error[i] || -error > max_error[i])
+            {
+                max_error[i] = error < 0 ? -error : error;
+            }
+        }
+        nb_measure++;
+    }
+
+    printf("sync period %d ms, %d broadcasts, measured over the last %d s\n", SIM_PERIOD_MS, master.getSyncCount(), (SIM_DURATION_MS - SIM_SETTLE_MS)/1000);
+    for(uint8_t i = 0; i < SIM_NB_SLAVE; ++i)
+    {
+        printf("slave %d: drift %+4d ppm (estimated %+6.1f), path delay %4u us, %u outliers, error rms %6.1f us, max %5lld us\n",
+               address[i], clock[i].getDrift(), -timebase[i]->getDrift()/1000.0, sync[i]->getPathDelay(),
+               sync[i]->getOutlierCount(), sqrt(sum_square[i]/nb_measure), (long long)max_error[i]);
+    }
+
+    return 0;
+}
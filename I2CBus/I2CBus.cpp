@@ -0,0 +1,228 @@
+/**
+ * @file I2CBus.cpp
+ * @brief I2CBus class source file
+ *
+ */
+
+#include "I2CBus.h"
+
+#include "Trace/Trace.h"
+
+I2CBus::I2CBus(I2C* i2c, osPriority thread_priority, uint32_t stack_size)
+    : busThread(thread_priority, stack_size, NULL, "i2c_bus")
+{
+    this->i2c = i2c;
+
+    busThread.start(callback(this, &I2CBus::bus_thread));
+}
+
+bool I2CBus::claim(I2C_transaction* transaction)
+{
+    queue_mutex.lock();
+    bool claimed = !transaction->pending;
+    transaction->pending = true;
+    queue_mutex.unlock();
+
+    return claimed;
+}
+
+void I2CBus::release(I2C_transaction* transaction)
+{
+    queue_mutex.lock();
+    transaction->pending = false;
+    queue_mutex.unlock();
+}
+
+bool I2CBus::submit(I2C_transaction* transaction, bool claimed)
+{
+    transaction->waiter = NULL;
+    return enqueue(transaction, claimed);
+}
+
+bool I2CBus::enqueue(I2C_transaction* transaction, bool claimed)
+{
+    queue_mutex.lock();
+
+    if(transaction->pending && !claimed)
+    {
+        queue_mutex.unlock();
+        return false;
+    }
+
+    transaction->pending = true;
+    transaction->result = 0;
+    transaction->next = NULL;
+
+    // sorted by priority, in order of arrival for the same priority
+    I2C_transaction** position = &head;
+    while(*position != NULL && (*position)->priority <= transaction->priority)
+    {
+        position = &(*position)->next;
+    }
+    transaction->next = *position;
+    *position = transaction;
+
+    queue_mutex.unlock();
+
+    queue_semaphore.release();
+    return true;
+}
+
+int I2CBus::transact(char address, const char* tx, uint8_t tx_length, char* rx, uint8_t rx_length, uint8_t priority)
+{
+    I2C_transaction transaction;
+    Semaphore waiter(0);
+
+    if(tx_length > I2C_TRANSACTION_MAX_TX)
+    {
+        return -1;
+    }
+
+    transaction.address = address;
+    if(tx_length)
+    {
+        memcpy(transaction.tx, tx, tx_length);
+    }
+    transaction.tx_length = tx_length;
+    transaction.rx = rx;
+    transaction.rx_length = rx_length;
+    transaction.priority = priority;
+    transaction.pending = false;
+    transaction.waiter = &waiter;
+
+    enqueue(&transaction, false);
+    waiter.wait();
+
+    return transaction.result;
+}
+
+I2C* I2CBus::getI2C()
+{
+    return i2c;
+}
+
+uint32_t I2CBus::getMergedCount()
+{
+    return merged_count;
+}
+
+int I2CBus::execute(I2C_transaction* transaction)
+{
+#if DEVICE_I2C_ASYNCH
+    transfer_event.clear(I2C_BUS_TRANSFER_FLAG);
+    if(i2c->transfer(transaction->address, transaction->tx, transaction->tx_length, transaction->rx, transaction->rx_length,
+                     event_callback_t(this, &I2CBus::transfer_callback), I2C_EVENT_ALL) != 0)
+    {
+        return -1;
+    }
+    transfer_event.wait_any(I2C_BUS_TRANSFER_FLAG);
+    return transfer_result;
+#else
+    int result = 0;
+
+    i2c->lock();
+    if(transaction->tx_length)
+    {
+        result = i2c->write(transaction->address, transaction->tx, transaction->tx_length, transaction->rx_length > 0);
+    }
+    if(result == 0 && transaction->rx_length)
+    {
+        result = i2c->read(transaction->address + 1, transaction->rx, transaction->rx_length);
+    }
+    i2c->unlock();
+
+    return result;
+#endif
+}
+
+void I2CBus::complete(I2C_transaction* transaction, int result)
+{
+    Semaphore* waiter = transaction->waiter;
+
+    transaction->result = result;
+
+    // still pending during the callback: a new request can't overwrite the result or the callback of the driver
+    if(transaction->done)
+    {
+        transaction->done(result);
+    }
+
+    // the transaction may be reused as soon as it is not pending, nothing is read from it after
+    queue_mutex.lock();
+    transaction->pending = false;
+    queue_mutex.unlock();
+
+    if(waiter)
+    {
+        waiter->release();
+    }
+}
+
+void I2CBus::transfer_callback(int event)
+{
+    transfer_result = (event & I2C_EVENT_TRANSFER_COMPLETE) ? 0 : -1;
+    transfer_event.set(I2C_BUS_TRANSFER_FLAG);
+}
+
+void I2CBus::bus_thread()
+{
+    I2C_transaction* merged[I2C_BUS_MAX_MERGE];
+
+    while(1)
+    {
+        queue_semaphore.wait();
+
+        queue_mutex.lock();
+        I2C_transaction* transaction = head;
+        if(transaction == NULL)
+        {
+            queue_mutex.unlock();
+            continue;
+        }
+        head = transaction->next;
+
+        // take out the identical reads that follow, until another access to the same device
+        uint8_t nb_merged = 0;
+        if(transaction->rx_length)
+        {
+            I2C_transaction** position = &head;
+            while(*position != NULL && nb_merged < I2C_BUS_MAX_MERGE)
+            {
+                I2C_transaction* other = *position;
+                if(other->address != transaction->address)
+                {
+                    position = &other->next;
+                }
+                else if(other->rx_length == transaction->rx_length && other->tx_length == transaction->tx_length &&
+                        memcmp(other->tx, transaction->tx, transaction->tx_length) == 0)
+                {
+                    *position = other->next;
+                    merged[nb_merged++] = other;
+                }
+                else
+                {
+                    break;
+                }
+            }
+        }
+        queue_mutex.unlock();
+
+        TRACE_BEGIN(TRACE_EVENT_I2C, ((uint8_t)transaction->address << 8) | transaction->rx_length);
+        int result = execute(transaction);
+        TRACE_END(TRACE_EVENT_I2C, ((uint8_t)transaction->address << 8) | transaction->rx_length);
+
+        for(uint8_t i = 0; i < nb_merged; ++i)
+        {
+            memcpy(merged[i]->rx, transaction->rx, transaction->rx_length);
+            merged_count++;
+
+            // one release of the semaphore was done for each merged transaction
+            queue_semaphore.wait(0);
+        }
+        for(uint8_t i = 0; i < nb_merged; ++i)
+        {
+            complete(merged[i], result);
+        }
+        complete(transaction, result);
+    }
+}
@@ -0,0 +1,180 @@
+/**
+ * @file I2CBus.h
+ * @brief Shared I2C bus manager
+ *
+ * All the drivers on one bus (INA228, TC74A5, PCA9531) give their transactions to the I2CBus
+ * instead of using the I2C object directly. The bus thread executes them one at a time,
+ * highest priority first, with the interrupt driven I2C::transfer() when the target supports it.
+ * The thread that submitted a transaction is free while it runs and is notified by a callback.
+ *
+ * Identical reads (same device, same register pointer, same length) that follow each other
+ * in the queue for a device are merged: the bus is used once and every transaction gets the result.
+ *
+ * @warning never call I2CBus::transact() from a completion callback, it runs in the bus thread.
+ *
+ */
+
+#ifndef I2CBUS_H
+#define I2CBUS_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+#define I2C_TRANSACTION_MAX_TX 8
+
+#define I2C_PRIORITY_HIGH 0
+#define I2C_PRIORITY_NORMAL 1
+#define I2C_PRIORITY_LOW 2
+
+#define I2C_BUS_TRANSFER_FLAG 0x1
+#define I2C_BUS_MAX_MERGE 8
+
+/**
+ * @brief one transaction of the bus: a write of tx followed by a read of rx with a repeated start
+ *
+ * The structure belongs to the caller and must stay valid until the transaction is completed.
+ * pending must be false before the first submit.
+ */
+typedef struct I2C_transaction_struct
+{
+    char address;
+    char tx[I2C_TRANSACTION_MAX_TX];
+    uint8_t tx_length;
+    char* rx;
+    uint8_t rx_length;
+    uint8_t priority;
+    Callback<void(int)> done; // called from the bus thread with 0 on success
+
+    // used by the bus
+    int result;
+    volatile bool pending;
+    Semaphore* waiter;
+    struct I2C_transaction_struct* next;
+} I2C_transaction;
+
+/**
+ * @brief asynchronous transaction scheduler of one I2C bus
+ *
+ */
+class I2CBus
+{
+    public:
+
+        /**
+         * @brief I2CBus constructor
+         *
+         * @param i2c pointer to the I2C peripheral of the bus
+         * @param thread_priority priority of the bus thread
+         * @param stack_size stack size of the bus thread
+         */
+        I2CBus(I2C* i2c, osPriority thread_priority = osPriorityAboveNormal, uint32_t stack_size = OS_STACK_SIZE);
+
+        /**
+         * @brief Reserve a transaction before filling it, so two threads never fill the same one
+         *
+         * The transaction is pending from now on, it is given to submit() with claimed = true
+         * or given back with release().
+         *
+         * @param transaction the transaction
+         * @return false if the transaction is already claimed or in the queue
+         */
+        bool claim(I2C_transaction* transaction);
+
+        /**
+         * @brief Give back a claimed transaction that is not submitted
+         *
+         * @param transaction the transaction
+         */
+        void release(I2C_transaction* transaction);
+
+        /**
+         * @brief Add a transaction to the queue, the call returns right away
+         *
+         * The transaction stays pending until its done callback returns.
+         *
+         * @param transaction the transaction, address, tx, rx, priority and done must be filled
+         * @param claimed true if the transaction was reserved with claim()
+         * @return false if the transaction is already in the queue
+         */
+        bool submit(I2C_transaction* transaction, bool claimed = false);
+
+        /**
+         * @brief Execute a transaction through the queue and wait for the result
+         *
+         * @param address 8 bits address of the device
+         * @param tx the bytes to write (register pointer and data)
+         * @param tx_length the number of bytes to write (max I2C_TRANSACTION_MAX_TX)
+         * @param rx the buffer for the bytes to read
+         * @param rx_length the number of bytes to read
+         * @param priority priority of the transaction
+         * @return int 0 on success
+         */
+        int transact(char address, const char* tx, uint8_t tx_length, char* rx, uint8_t rx_length, uint8_t priority = I2C_PRIORITY_NORMAL);
+
+        /**
+         * @brief Get the I2C peripheral of the bus
+         *
+         * @return I2C* the I2C peripheral
+         */
+        I2C* getI2C();
+
+        /**
+         * @brief Get the number of transactions completed without using the bus
+         *
+         * @return uint32_t the number of merged transactions
+         */
+        uint32_t getMergedCount();
+
+    private:
+
+        I2C* i2c;
+
+        Thread busThread;
+        Mutex queue_mutex;
+        Semaphore queue_semaphore;
+        EventFlags transfer_event;
+
+        I2C_transaction* head = NULL;
+        volatile int transfer_result = 0;
+        uint32_t merged_count = 0;
+
+        /**
+         * @brief insert a transaction in the queue by priority
+         *
+         * @param transaction the transaction
+         * @param claimed true if the transaction was reserved with claim()
+         * @return false if the transaction is already in the queue
+         */
+        bool enqueue(I2C_transaction* transaction, bool claimed);
+
+        /**
+         * @brief execute one transaction on the bus
+         *
+         * @param transaction the transaction
+         * @return int 0 on success
+         */
+        int execute(I2C_transaction* transaction);
+
+        /**
+         * @brief complete a transaction, call its callback and wake up its waiter
+         *
+         * @param transaction the transaction
+         * @param result the result
+         */
+        void complete(I2C_transaction* transaction, int result);
+
+        /**
+         * @brief end of transfer interrupt of I2C::transfer()
+         *
+         * @param event the I2C events
+         */
+        void transfer_callback(int event);
+
+        /**
+         * @brief the bus thread
+         *
+         */
+        void bus_thread();
+};
+
+#endif
@@ -27,17 +27,35 @@
 #include "mbed.h"
 #include "INA228.h"
 
+// conversion times and averaging counts indexed by their code in ADC_CONFIG
+static const uint16_t conversion_time_us[8] = {50, 84, 150, 280, 540, 1052, 2074, 4120};
+static const uint16_t averaging_count[8] = {1, 4, 16, 64, 128, 256, 512, 1024};
+
 INA228::INA228 (I2C* i2c, char addr)
 {
     _i2c = i2c;
+    _bus = NULL;
     _addr = addr;
 
     _ShuntR = 0;
     _CURR_LSB = 0;
+    _POWER_LSB = 0;
+    _ENERGY_LSB = 0;
+    _CHARGE_LSB = 0;
+    _ADC_RANGE = 0;
+}
+
+INA228::INA228 (I2CBus* bus, char addr) : INA228(bus->getI2C(), addr)
+{
+    _bus = bus;
+
+    _current_transaction.pending = false;
+    _bus_volt_transaction.pending = false;
 }
 
 void INA228::setConfig (uint16_t reg)
 {
+    _ADC_RANGE = (reg & CONF_ADCRANGE) ? 1 : 0;
     writeINA228(CONF, reg);
 }    
 
@@ -88,14 +106,14 @@ float_t INA228::getShuntVolt() // To be reviewed for negation
 {
     uint32_t value;
     readINA228(VSHUNT, &value);
-    return (float_t)(value >> 4)*SHUNT_LSB;
+    return (float_t)(value >> 4)*(_ADC_RANGE ? SHUNT_LSB : SHUNT_LSB*4.0);
 }
 
 float_t INA228::getBusVolt() // To be reviewed for negation
 {
     uint32_t value;
     readINA228(VBUS, &value);
-    return (float_t)(value >> 4)*BUS_LSB;
+    return busVoltFromRegister(value);
 }
 
 float_t INA228::getDieTemp()
@@ -109,12 +127,45 @@ float_t INA228::getCurrent() // To be reviewed for negation
 {
     uint32_t value;
     readINA228(CURRENT, &value);
-    
-    uint8_t sign = (value >> 23) & 0x1;
-    value = (value >> 4) & 0x7FFFF;
-    
-    if(sign) return (float_t)(~value & 0x7FFFF)*_CURR_LSB*-1.0;
-    else return (float_t)value*_CURR_LSB;
+    return currentFromRegister(value);
+}
+
+bool INA228::getCurrentAsync(Callback<void(float_t)> done)
+{
+    if(_bus == NULL || !_bus->claim(&_current_transaction))
+    {
+        return false;
+    }
+
+    _current_done = done;
+    _current_transaction.address = _addr;
+    _current_transaction.tx[0] = CURRENT;
+    _current_transaction.tx_length = 1;
+    _current_transaction.rx = _current_rx;
+    _current_transaction.rx_length = 3;
+    _current_transaction.priority = I2C_PRIORITY_NORMAL;
+    _current_transaction.done = callback(this, &INA228::currentDone);
+
+    return _bus->submit(&_current_transaction, true);
+}
+
+bool INA228::getBusVoltAsync(Callback<void(float_t)> done)
+{
+    if(_bus == NULL || !_bus->claim(&_bus_volt_transaction))
+    {
+        return false;
+    }
+
+    _bus_volt_done = done;
+    _bus_volt_transaction.address = _addr;
+    _bus_volt_transaction.tx[0] = VBUS;
+    _bus_volt_transaction.tx_length = 1;
+    _bus_volt_transaction.rx = _bus_volt_rx;
+    _bus_volt_transaction.rx_length = 3;
+    _bus_volt_transaction.priority = I2C_PRIORITY_NORMAL;
+    _bus_volt_transaction.done = callback(this, &INA228::busVoltDone);
+
+    return _bus->submit(&_bus_volt_transaction, true);
 }
 
 float_t INA228::getPower()
@@ -128,7 +179,7 @@ float_t INA228::getEnergy()
 {
     uint64_t value;
     readINA228(ENERGY, &value);
-    return (float_t)value*_ENERGY_LSB;
+    return energyFromRegister(value);
 }
 
 float_t INA228::getCharge() // To be reviewed for negation
@@ -138,6 +189,25 @@ float_t INA228::getCharge() // To be reviewed for negation
     return (float_t)value*_CHARGE_LSB;
 }
 
+uint64_t INA228::getEnergyRaw()
+{
+    uint64_t value;
+    readINA228(ENERGY, &value);
+    return value & ACCUMULATOR_MASK;
+}
+
+uint64_t INA228::getChargeRaw()
+{
+    uint64_t value;
+    readINA228(CHARGE, &value);
+    return value & ACCUMULATOR_MASK;
+}
+
+void INA228::resetAccumulators()
+{
+    writeINA228(CONF, (uint16_t)(getConfig() | CONF_RSTACC));
+}
+
 void INA228::setAlertFlags(uint16_t reg)
 {
     writeINA228(DIAG_ALRT, reg);
@@ -159,7 +229,7 @@ float_t INA228::getSOVL() // Conversion factor
 {
     uint16_t value;
     readINA228(SOVL, &value);
-    return (float_t)value*SHUNT_OVER_UNDER_VOLTAGE_LSB;
+    return (float_t)value*(_ADC_RANGE ? SHUNT_OVER_UNDER_VOLTAGE_LSB : SHUNT_OVER_UNDER_VOLTAGE_LSB_RANGE0);
 }
 
 void INA228::setSUVL(uint16_t reg)
@@ -171,7 +241,7 @@ float_t INA228::getSUVL() // Conversion factor
 {
     uint16_t value;
     readINA228(SUVL, &value);
-    return (float_t)value*SHUNT_OVER_UNDER_VOLTAGE_LSB;
+    return (float_t)value*(_ADC_RANGE ? SHUNT_OVER_UNDER_VOLTAGE_LSB : SHUNT_OVER_UNDER_VOLTAGE_LSB_RANGE0);
 }
 
 void INA228::setBOVL(uint16_t reg)
@@ -222,6 +292,38 @@ float_t INA228::getOverPowerLimit() // Conversion factor
     return value;
 }
 
+void INA228::setOverCurrentLimit(float_t current)
+{
+    float_t lsb = _ADC_RANGE ? SHUNT_OVER_UNDER_VOLTAGE_LSB : SHUNT_OVER_UNDER_VOLTAGE_LSB_RANGE0;
+    writeINA228(SOVL, toLimitRegister(current*_ShuntR, lsb, -32768, 32767));
+}
+
+void INA228::setUnderCurrentLimit(float_t current)
+{
+    float_t lsb = _ADC_RANGE ? SHUNT_OVER_UNDER_VOLTAGE_LSB : SHUNT_OVER_UNDER_VOLTAGE_LSB_RANGE0;
+    writeINA228(SUVL, toLimitRegister(current*_ShuntR, lsb, -32768, 32767));
+}
+
+void INA228::setBusOverVoltageLimit(float_t voltage)
+{
+    writeINA228(BOVL, toLimitRegister(voltage, BUS_OVER_UNDER_VOLTAGE_LSB, 0, 32767));
+}
+
+void INA228::setBusUnderVoltageLimit(float_t voltage)
+{
+    writeINA228(BUVL, toLimitRegister(voltage, BUS_OVER_UNDER_VOLTAGE_LSB, 0, 32767));
+}
+
+void INA228::setOverTempLimitCelsius(float_t temperature)
+{
+    writeINA228(TEMP_LIMIT, toLimitRegister(temperature, TEMP_LIMIT_LSB, -32768, 32767));
+}
+
+void INA228::setOverPowerLimitWatts(float_t power)
+{
+    writeINA228(PWR_LIMIT, toLimitRegister(power, _POWER_LSB*POWER_LIMIT_FACTOR, 0, 65535));
+}
+
 uint16_t INA228::getManufacturer()
 {
     uint16_t value;
@@ -260,21 +362,203 @@ float_t INA228::getCurrentLSB()
     return _CURR_LSB;
 }
 
+float_t INA228::getEnergyLSB()
+{
+    return _ENERGY_LSB;
+}
+
+float_t INA228::getChargeLSB()
+{
+    return _CHARGE_LSB;
+}
+
+INA228_plan INA228::planCalibration(float_t shunt_r, float_t max_current, float_t target_period_us, bool measure_temperature)
+{
+    INA228_plan plan;
+
+    plan.shunt_r = shunt_r;
+    plan.adc_range = (max_current*shunt_r <= SHUNT_FULL_SCALE_RANGE1) ? 1 : 0;
+    plan.shunt_lsb = plan.adc_range ? SHUNT_LSB : SHUNT_LSB*4.0;
+
+    // SHUNT_CAL is 4 times bigger with ADCRANGE = 1 and only has 15 bits
+    float_t cal_factor = SHUNT_CAL_FACTOR*shunt_r*(plan.adc_range ? 4.0 : 1.0);
+    plan.current_lsb = max_current/CURRENT_RESOLUTION;
+    if(plan.current_lsb*cal_factor > SHUNT_CAL_MAX)
+    {
+        plan.current_lsb = SHUNT_CAL_MAX/cal_factor;
+    }
+    plan.shunt_cal = (uint16_t)lroundf(plan.current_lsb*cal_factor);
+
+    // the smallest of the ADC full scale and the CURRENT register range
+    float_t full_scale = plan.adc_range ? SHUNT_FULL_SCALE_RANGE1 : SHUNT_FULL_SCALE_RANGE0;
+    plan.max_current = shunt_r > 0 ? full_scale/shunt_r : 0;
+    if(plan.current_lsb*CURRENT_RESOLUTION < plan.max_current)
+    {
+        plan.max_current = plan.current_lsb*CURRENT_RESOLUTION;
+    }
+    plan.valid = shunt_r > 0 && plan.max_current >= max_current*0.99999f;
+
+    // keep the most integration time on the shunt, then the most on the bus
+    uint8_t best_bus = 0;
+    uint8_t best_shunt = 0;
+    uint8_t best_avg = 0;
+    uint32_t best_shunt_time = 0;
+    uint32_t best_bus_time = 0;
+    const uint8_t temp_code = 0; // the die temperature only needs the fastest conversion
+
+    for(uint8_t avg = 0; avg < 8; ++avg)
+    {
+        for(uint8_t shunt = 0; shunt < 8; ++shunt)
+        {
+            for(uint8_t bus = 0; bus < 8; ++bus)
+            {
+                uint32_t conversion = conversion_time_us[bus] + conversion_time_us[shunt];
+                if(measure_temperature)
+                {
+                    conversion += conversion_time_us[temp_code];
+                }
+
+                if((float_t)(conversion*averaging_count[avg]) > target_period_us)
+                {
+                    continue;
+                }
+
+                uint32_t shunt_time = (uint32_t)conversion_time_us[shunt]*averaging_count[avg];
+                uint32_t bus_time = (uint32_t)conversion_time_us[bus]*averaging_count[avg];
+                if(shunt_time > best_shunt_time || (shunt_time == best_shunt_time && bus_time > best_bus_time))
+                {
+                    best_shunt_time = shunt_time;
+                    best_bus_time = bus_time;
+                    best_bus = bus;
+                    best_shunt = shunt;
+                    best_avg = avg;
+                }
+            }
+        }
+    }
+
+    plan.adc_config = (measure_temperature ? ADC_CONFIG_MODE_CONT_ALL : ADC_CONFIG_MODE_CONT_SHUNT_BUS) |
+                      (best_bus << 9) | (best_shunt << 6) | (temp_code << 3) | best_avg;
+    plan.vbus_conversion_us = conversion_time_us[best_bus];
+    plan.vshunt_conversion_us = conversion_time_us[best_shunt];
+    plan.vtemp_conversion_us = measure_temperature ? conversion_time_us[temp_code] : 0;
+    plan.averaging = averaging_count[best_avg];
+    plan.sample_period_us = (float_t)(plan.vbus_conversion_us + plan.vshunt_conversion_us + plan.vtemp_conversion_us)*plan.averaging;
+
+    return plan;
+}
+
+bool INA228::applyPlan(const INA228_plan& plan)
+{
+    if(!plan.valid)
+    {
+        return false;
+    }
+
+    uint16_t config = getConfig() & ~CONF_ADCRANGE;
+    if(plan.adc_range)
+    {
+        config |= CONF_ADCRANGE;
+    }
+
+    setConfig(config);
+    setShuntRValue(plan.shunt_r);
+    setCurrentLSB(plan.current_lsb);
+    setShuntCal(plan.shunt_cal);
+    setConfigADC(plan.adc_config);
+
+    return true;
+}
+
+uint16_t INA228::toLimitRegister(float_t value, float_t lsb, int32_t min, int32_t max)
+{
+    if(lsb <= 0)
+    {
+        return (uint16_t)max;
+    }
+
+    float_t scaled = value/lsb;
+    int32_t reg;
+
+    if(scaled >= (float_t)max) reg = max;
+    else if(scaled <= (float_t)min) reg = min;
+    else reg = (int32_t)lroundf(scaled);
+
+    // two's complement on 16 bits for the signed limits
+    return (uint16_t)(reg & 0xFFFF);
+}
+
+float_t INA228::currentFromRegister(uint32_t value)
+{
+    uint8_t sign = (value >> 23) & 0x1;
+    value = (value >> 4) & 0x7FFFF;
+    
+    if(sign) return (float_t)(~value & 0x7FFFF)*_CURR_LSB*-1.0;
+    else return (float_t)value*_CURR_LSB;
+}
+
+float_t INA228::busVoltFromRegister(uint32_t value)
+{
+    return (float_t)(value >> 4)*BUS_LSB;
+}
+
+float_t INA228::energyFromRegister(uint64_t value)
+{
+    return (float_t)value*_ENERGY_LSB;
+}
+
+void INA228::currentDone(int result)
+{
+    uint32_t value = ((uint32_t)(uint8_t)_current_rx[0] << 16) | ((uint8_t)_current_rx[1] << 8) | (uint8_t)_current_rx[2];
+    if(result == 0 && _current_done)
+    {
+        _current_done(currentFromRegister(value));
+    }
+}
+
+void INA228::busVoltDone(int result)
+{
+    uint32_t value = ((uint32_t)(uint8_t)_bus_volt_rx[0] << 16) | ((uint8_t)_bus_volt_rx[1] << 8) | (uint8_t)_bus_volt_rx[2];
+    if(result == 0 && _bus_volt_done)
+    {
+        _bus_volt_done(busVoltFromRegister(value));
+    }
+}
+
 void INA228::writeINA228(char cmd, uint16_t reg)
 {
     char buffer[3];
     buffer[0] = cmd;
     buffer[1] = (char) ((reg & 0xFF00) >> 8);
     buffer[2] = (char) (reg & 0x00FF);
+    if(_bus)
+    {
+        _bus->transact(_addr, buffer, 3, NULL, 0);
+        return;
+    }
     _i2c->write(_addr,buffer,3);
 }
 
+void INA228::readRegister(char cmd, char *buff, uint8_t length)
+{
+    if(_bus)
+    {
+        _bus->transact(_addr, &cmd, 1, buff, length);
+        return;
+    }
+
+    // keep the register pointer and the read together if another thread uses the bus
+    _i2c->lock();
+    _i2c->write(_addr,&cmd,1,true);
+    _i2c->read(_addr+1,buff,length);
+    _i2c->unlock();
+}
+
 void INA228::readINA228(char cmd, uint16_t *value)
 {
     char buff[2];
-    _i2c->write(_addr,&cmd,1,true);
-    _i2c->read(_addr+1,buff,2);
-    *value = (buff[0] << 8) | buff[1];
+    readRegister(cmd, buff, 2);
+    *value = ((uint8_t)buff[0] << 8) | (uint8_t)buff[1];
 }
 
 void INA228::writeINA228(char cmd, uint32_t reg)
@@ -285,9 +569,8 @@ void INA228::writeINA228(char cmd, uint32_t reg)
 void INA228::readINA228(char cmd, uint32_t *value)
 {
     char buff[3];
-    _i2c->write(_addr,&cmd,1,true);
-    _i2c->read(_addr+1,buff,3);
-    *value = (buff[0] << 16) | (buff[1] << 8) | buff[2];
+    readRegister(cmd, buff, 3);
+    *value = ((uint32_t)(uint8_t)buff[0] << 16) | ((uint8_t)buff[1] << 8) | (uint8_t)buff[2];
 }
 
 void INA228::writeINA228(char cmd, uint64_t reg)
@@ -298,7 +581,6 @@ void INA228::writeINA228(char cmd, uint64_t reg)
 void INA228::readINA228(char cmd, uint64_t *value)
 {
     char buff[5];
-    _i2c->write(_addr,&cmd,1,true);
-    _i2c->read(_addr+1,buff,5);
-    *value = (buff[0] << 32) | (buff[1] << 24) | (buff[2] << 16) | (buff[4] << 8) | buff[5];
+    readRegister(cmd, buff, 5);
+    *value = ((uint64_t)(uint8_t)buff[0] << 32) | ((uint64_t)(uint8_t)buff[1] << 24) | ((uint64_t)(uint8_t)buff[2] << 16) | ((uint64_t)(uint8_t)buff[3] << 8) | (uint64_t)(uint8_t)buff[4];
 }
\ No newline at end of file
@@ -29,6 +29,8 @@
 
 #include "mbed.h"
 
+#include "I2CBus/I2CBus.h"
+
 #define CONF 0x00
 #define ADC_CONFIG 0x01
 #define SHUNT_CAL 0x02
@@ -56,6 +58,63 @@
 #define SHUNT_OVER_UNDER_VOLTAGE_LSB 0.00000125 // ADCRANGE = 1
 #define BUS_OVER_UNDER_VOLTAGE_LSB 0.003125
 
+#define SHUNT_OVER_UNDER_VOLTAGE_LSB_RANGE0 0.000005 // ADCRANGE = 0
+#define TEMP_LIMIT_LSB 0.0078125
+#define POWER_LIMIT_FACTOR 256.0 // PWR_LIMIT LSB = 256 * power LSB
+
+#define CONF_RSTACC 0x4000 // Reset the ENERGY and CHARGE accumulators
+#define CONF_ADCRANGE 0x0010 // Shunt full scale range, 0 = 163.84 mV, 1 = 40.96 mV
+#define ACCUMULATOR_MASK 0xFFFFFFFFFFULL // ENERGY and CHARGE are 40 bits wide
+
+// DIAG_ALRT bits
+#define DIAG_ALRT_ALATCH 0x8000 // Latch the alert until DIAG_ALRT is read
+#define DIAG_ALRT_CNVR 0x4000 // Alert on conversion ready
+#define DIAG_ALRT_SLOWALERT 0x2000 // Compare the limits on the averaged value
+#define DIAG_ALRT_APOL 0x1000 // Alert pin active high
+#define DIAG_ALRT_ENERGYOF 0x0800 // ENERGY overflow
+#define DIAG_ALRT_CHARGEOF 0x0400 // CHARGE overflow
+#define DIAG_ALRT_MATHOF 0x0200 // Arithmetic overflow
+#define DIAG_ALRT_TMPOL 0x0080 // Temperature over-limit
+#define DIAG_ALRT_SHNTOL 0x0040 // Shunt over-limit
+#define DIAG_ALRT_SHNTUL 0x0020 // Shunt under-limit
+#define DIAG_ALRT_BUSOL 0x0010 // Bus over-limit
+#define DIAG_ALRT_BUSUL 0x0008 // Bus under-limit
+#define DIAG_ALRT_POL 0x0004 // Power over-limit
+#define DIAG_ALRT_CNVRF 0x0002 // Conversion completed
+#define DIAG_ALRT_MEMSTAT 0x0001 // Cleared on a checksum error in the device trim memory
+#define DIAG_ALRT_CAUSE_MASK 0x0EFC // Bits that can trigger the alert pin
+#define DIAG_ALRT_CONFIG_MASK 0xF000 // Bits written by setAlertFlags(), the others are read only
+
+#define SHUNT_CAL_FACTOR 13107200000.0 // SHUNT_CAL = factor * current LSB * shunt resistor
+#define SHUNT_CAL_MAX 0x7FFF
+#define CURRENT_RESOLUTION 524288.0 // 2^19, resolution of CURRENT
+#define SHUNT_FULL_SCALE_RANGE1 0.04096 // Shunt full scale in Volts with ADCRANGE = 1
+#define SHUNT_FULL_SCALE_RANGE0 0.16384 // Shunt full scale in Volts with ADCRANGE = 0
+
+#define ADC_CONFIG_MODE_CONT_ALL 0xF000 // Continuous bus, shunt and temperature
+#define ADC_CONFIG_MODE_CONT_SHUNT_BUS 0xB000 // Continuous bus and shunt
+
+/**
+ * @brief Calibration and ADC timing computed by INA228::planCalibration()
+ * 
+ */
+typedef struct INA228_plan_struct
+{
+    float_t shunt_r;
+    float_t current_lsb;
+    uint16_t shunt_cal;
+    uint8_t adc_range;
+    uint16_t adc_config;
+    uint16_t vbus_conversion_us;
+    uint16_t vshunt_conversion_us;
+    uint16_t vtemp_conversion_us;
+    uint16_t averaging;
+    float_t sample_period_us; // Time between two new results of CURRENT
+    float_t shunt_lsb; // Resolution of the shunt voltage in Volts
+    float_t max_current; // Largest current measured without saturation, in Amperes
+    bool valid; // false if max_current is below the requested one, applyPlan() refuses the plan
+} INA228_plan;
+
 /** INA228 class 
  */
 class INA228 {
@@ -68,6 +127,16 @@ public:
      */
     INA228 (I2C* i2c, char addr); 
 
+    /**
+     * @brief Constructor of the object INA228 on a shared bus
+     * 
+     * Every access goes through the I2CBus and the asynchronous getters are available.
+     * 
+     * @param bus pointer to the shared I2C bus
+     * @param addr sensor I2C address
+     */
+    INA228 (I2CBus* bus, char addr);
+
     /**
      * @brief Set the configuration
      * 
@@ -152,6 +221,26 @@ public:
      */
     float_t getCurrent();
     
+    /**
+     * @brief Start the read of the current on the shared bus
+     * 
+     * Only available with the I2CBus constructor, one read at a time.
+     * 
+     * @param done Function called from the bus thread with the current in Amperes
+     * @return true if the read is queued
+     */
+    bool getCurrentAsync(Callback<void(float_t)> done);
+
+    /**
+     * @brief Start the read of the bus voltage on the shared bus
+     * 
+     * Only available with the I2CBus constructor, one read at a time.
+     * 
+     * @param done Function called from the bus thread with the bus voltage in Volts
+     * @return true if the read is queued
+     */
+    bool getBusVoltAsync(Callback<void(float_t)> done);
+    
     /**
      * @brief Get the calculated power
      * 
@@ -173,6 +262,26 @@ public:
      */
     float_t getCharge();
 
+    /**
+     * @brief Get the raw value of the energy accumulator
+     * 
+     * @return uint64_t Unsigned 40 bits value of the ENERGY register
+     */
+    uint64_t getEnergyRaw();
+
+    /**
+     * @brief Get the raw value of the charge accumulator
+     * 
+     * @return uint64_t Two's complement 40 bits value of the CHARGE register
+     */
+    uint64_t getChargeRaw();
+
+    /**
+     * @brief Reset the energy and charge accumulators of the device
+     * 
+     */
+    void resetAccumulators();
+
     /**
      * @brief Set the diagnostic flags and alert
      * 
@@ -271,6 +380,54 @@ public:
      */
     float_t getOverPowerLimit();
 
+    /**
+     * @brief Set the over-current threshold with the shunt overvoltage limit
+     * 
+     * The shunt resistor value must be set with setShuntRValue().
+     * 
+     * @param current Over-current threshold in Amperes
+     */
+    void setOverCurrentLimit(float_t current);
+
+    /**
+     * @brief Set the under-current threshold with the shunt undervoltage limit
+     * 
+     * The shunt resistor value must be set with setShuntRValue().
+     * 
+     * @param current Under-current threshold in Amperes (negative for a reverse current)
+     */
+    void setUnderCurrentLimit(float_t current);
+
+    /**
+     * @brief Set the bus overvoltage threshold
+     * 
+     * @param voltage Bus overvoltage threshold in Volts
+     */
+    void setBusOverVoltageLimit(float_t voltage);
+
+    /**
+     * @brief Set the bus undervoltage threshold
+     * 
+     * @param voltage Bus undervoltage threshold in Volts
+     */
+    void setBusUnderVoltageLimit(float_t voltage);
+
+    /**
+     * @brief Set the temperature over-limit threshold
+     * 
+     * @param temperature Temperature over-limit threshold in °C
+     */
+    void setOverTempLimitCelsius(float_t temperature);
+
+    /**
+     * @brief Set the power over-limit threshold
+     * 
+     * The current LSB must be set with setCurrentLSB().
+     * 
+     * @param power Power over-limit threshold in Watts
+     */
+    void setOverPowerLimitWatts(float_t power);
+
     /**
      * @brief Get the Manufacturer ID
      * 
@@ -312,17 +469,125 @@ public:
      * @return float_t Current LSB
      */
     float_t getCurrentLSB();
+
+    /**
+     * @brief Get the Energy LSB
+     * 
+     * @return float_t Energy LSB in Joules
+     */
+    float_t getEnergyLSB();
+
+    /**
+     * @brief Get the Charge LSB
+     * 
+     * @return float_t Charge LSB in Coulombs
+     */
+    float_t getChargeLSB();
+
+    /**
+     * @brief Compute the calibration and the ADC timing for a shunt and a sample period
+     * 
+     * The smallest current LSB that covers max_current is used and the most
+     * integration time (conversion time times averaging) on the shunt that fits
+     * in target_period_us is selected. If nothing fits, the fastest timing is selected.
+     * The plan is not valid when the shunt voltage at max_current is above the 163.84 mV
+     * of the wider range, or when SHUNT_CAL can't cover max_current: the current would saturate.
+     * 
+     * @param shunt_r Value of the shunt resistor in Ohms
+     * @param max_current Maximum expected current in Amperes
+     * @param target_period_us Maximum time between two results in us (1e6 / sample rate)
+     * @param measure_temperature Convert the die temperature for the temperature compensation
+     * @return INA228_plan The computed plan
+     */
+    static INA228_plan planCalibration(float_t shunt_r, float_t max_current, float_t target_period_us, bool measure_temperature = true);
+
+    /**
+     * @brief Apply a calibration plan to the device in one call
+     * 
+     * @param plan Plan computed by planCalibration()
+     * @return true if the plan was applied, false if it is not valid
+     */
+    bool applyPlan(const INA228_plan& plan);
+
+    /**
+     * @brief Convert the CURRENT register in Amperes
+     * 
+     * For a register read by other means than the getters, with the current LSB of this device.
+     * 
+     * @param value Value of the register
+     * @return float_t Current in Amperes
+     */
+    float_t currentFromRegister(uint32_t value);
+
+    /**
+     * @brief Convert the VBUS register in Volts
+     * 
+     * @param value Value of the register
+     * @return float_t Bus voltage in Volts
+     */
+    float_t busVoltFromRegister(uint32_t value);
+
+    /**
+     * @brief Convert the ENERGY register in Joules
+     * 
+     * @param value Value of the register
+     * @return float_t Energy in Joules
+     */
+    float_t energyFromRegister(uint64_t value);
     
 protected:
 
 private:
     char _addr;
     I2C *_i2c;
+    I2CBus *_bus;
     float_t _ShuntR;
     float_t _CURR_LSB;
     float_t _POWER_LSB;
     float_t _ENERGY_LSB;
     float_t _CHARGE_LSB;
+    uint8_t _ADC_RANGE;
+
+    I2C_transaction _current_transaction;
+    char _current_rx[3];
+    Callback<void(float_t)> _current_done;
+    I2C_transaction _bus_volt_transaction;
+    char _bus_volt_rx[3];
+    Callback<void(float_t)> _bus_volt_done;
+
+    /**
+     * @brief Completion of getCurrentAsync()
+     * 
+     * @param result Result of the transaction
+     */
+    void currentDone(int result);
+
+    /**
+     * @brief Completion of getBusVoltAsync()
+     * 
+     * @param result Result of the transaction
+     */
+    void busVoltDone(int result);
+
+    /**
+     * @brief Read the bytes of a register with I2C or the shared bus
+     * 
+     * @param cmd Command
+     * @param buff Buffer for the bytes of the register
+     * @param length Number of bytes of the register
+     */
+    void readRegister(char cmd, char *buff, uint8_t length);
+
+    /**
+     * @brief Convert a value to a register value and saturate it
+     * 
+     * @param value Value in engineering units
+     * @param lsb LSB of the register
+     * @param min Minimum value of the register
+     * @param max Maximum value of the register
+     * @return uint16_t Value for the register
+     */
+    uint16_t toLimitRegister(float_t value, float_t lsb, int32_t min, int32_t max);
     
     /**
      * @brief Write uint16_t to the INA228 with I2C
@@ -0,0 +1,180 @@
+/**
+ * @file INA228Accumulator.cpp
+ * @brief INA228Accumulator class source file
+ *
+ */
+
+#include "INA228Accumulator.h"
+
+INA228Accumulator::INA228Accumulator(INA228* ina228)
+{
+    this->ina228 = ina228;
+}
+
+void INA228Accumulator::update()
+{
+    uint64_t energy_raw = ina228->getEnergyRaw();
+    uint64_t charge_raw = ina228->getChargeRaw();
+
+    accumulator_mutex.lock();
+    if(primed)
+    {
+        // the modulo 2^40 difference is the increment whatever the number of wrap (max one)
+        energy += (energy_raw - last_energy_raw) & ACCUMULATOR_MASK;
+
+        // CHARGE is signed, sign extend the 40 bits difference
+        uint64_t delta = (charge_raw - last_charge_raw) & ACCUMULATOR_MASK;
+        if(delta & 0x8000000000ULL)
+        {
+            delta |= ~ACCUMULATOR_MASK;
+        }
+        charge += (int64_t)delta;
+    }
+    last_energy_raw = energy_raw;
+    last_charge_raw = charge_raw;
+    primed = true;
+    accumulator_mutex.unlock();
+}
+
+void INA228Accumulator::reset()
+{
+    ina228->resetAccumulators();
+
+    accumulator_mutex.lock();
+    primed = false;
+    energy = 0;
+    charge = 0;
+    window_energy = 0;
+    window_charge = 0;
+    mission_running = false;
+    mission_energy_start = 0;
+    mission_energy_stop = 0;
+    mission_charge_start = 0;
+    mission_charge_stop = 0;
+    battery_charge_start = 0;
+    accumulator_mutex.unlock();
+
+    update();
+}
+
+uint32_t INA228Accumulator::getMaxUpdatePeriod(float_t max_power, float_t max_current)
+{
+    // half of the register range must never be crossed between two samples of CHARGE
+    float_t energy_period = (float_t)ACCUMULATOR_MASK*ina228->getEnergyLSB()/max_power;
+    float_t charge_period = (float_t)(ACCUMULATOR_MASK >> 1)*ina228->getChargeLSB()/max_current;
+
+    float_t period = energy_period < charge_period ? energy_period : charge_period;
+
+    // keep a 50% margin for the scheduling jitter of the caller
+    period = period*500.0f;
+    if(period > (float_t)0xFFFFFFFF)
+    {
+        return 0xFFFFFFFF;
+    }
+    return (uint32_t)period;
+}
+
+double_t INA228Accumulator::getEnergy()
+{
+    accumulator_mutex.lock();
+    uint64_t value = energy;
+    accumulator_mutex.unlock();
+
+    return (double_t)value*ina228->getEnergyLSB();
+}
+
+double_t INA228Accumulator::getCharge()
+{
+    accumulator_mutex.lock();
+    int64_t value = charge;
+    accumulator_mutex.unlock();
+
+    return (double_t)value*ina228->getChargeLSB();
+}
+
+double_t INA228Accumulator::readWindowEnergy()
+{
+    accumulator_mutex.lock();
+    uint64_t value = energy - window_energy;
+    window_energy = energy;
+    accumulator_mutex.unlock();
+
+    return (double_t)value*ina228->getEnergyLSB();
+}
+
+double_t INA228Accumulator::readWindowCharge()
+{
+    accumulator_mutex.lock();
+    int64_t value = charge - window_charge;
+    window_charge = charge;
+    accumulator_mutex.unlock();
+
+    return (double_t)value*ina228->getChargeLSB();
+}
+
+void INA228Accumulator::startMission()
+{
+    accumulator_mutex.lock();
+    mission_running = true;
+    mission_energy_start = energy;
+    mission_charge_start = charge;
+    accumulator_mutex.unlock();
+}
+
+void INA228Accumulator::stopMission()
+{
+    accumulator_mutex.lock();
+    if(mission_running)
+    {
+        mission_running = false;
+        mission_energy_stop = energy;
+        mission_charge_stop = charge;
+    }
+    accumulator_mutex.unlock();
+}
+
+double_t INA228Accumulator::getMissionEnergy()
+{
+    accumulator_mutex.lock();
+    uint64_t value = (mission_running ? energy : mission_energy_stop) - mission_energy_start;
+    accumulator_mutex.unlock();
+
+    return (double_t)value*ina228->getEnergyLSB();
+}
+
+double_t INA228Accumulator::getMissionCharge()
+{
+    accumulator_mutex.lock();
+    int64_t value = (mission_running ? charge : mission_charge_stop) - mission_charge_start;
+    accumulator_mutex.unlock();
+
+    return (double_t)value*ina228->getChargeLSB();
+}
+
+void INA228Accumulator::setBattery(double_t capacity, float_t level)
+{
+    accumulator_mutex.lock();
+    battery_capacity = capacity;
+    battery_level_start = level;
+    battery_charge_start = charge;
+    accumulator_mutex.unlock();
+}
+
+float_t INA228Accumulator::getBatteryLevel()
+{
+    accumulator_mutex.lock();
+    int64_t used = charge - battery_charge_start;
+    double_t capacity = battery_capacity;
+    float_t level_start = battery_level_start;
+    accumulator_mutex.unlock();
+
+    if(capacity <= 0)
+    {
+        return 0;
+    }
+
+    float_t level = level_start - (float_t)((double_t)used*ina228->getChargeLSB()/capacity);
+    if(level < 0) return 0;
+    if(level > 1.0f) return 1.0f;
+    return level;
+}
@@ -0,0 +1,155 @@
+/**
+ * @file INA228Accumulator.h
+ * @brief Overflow-extended energy and charge accumulation on top of the INA228
+ *
+ * The ENERGY and CHARGE registers of the INA228 are 40 bits wide and wrap around.
+ * INA228Accumulator::update() must be called at least once every getMaxUpdatePeriod() ms
+ * so that every wrap of the device accumulators is detected and extended in 64 bits counters.
+ * All the getters work on the cached counters and never access the I2C bus.
+ *
+ */
+
+#ifndef INA228_ACCUMULATOR_H
+#define INA228_ACCUMULATOR_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "INA228.h"
+
+/**
+ * @brief 64 bits energy and charge accumulator for the INA228
+ *
+ */
+class INA228Accumulator
+{
+    public:
+
+        /**
+         * @brief INA228Accumulator constructor
+         *
+         * @param ina228 pointer to the configured INA228 (current LSB already set)
+         */
+        INA228Accumulator(INA228* ina228);
+
+        /**
+         * @brief Sample the device accumulators and extend them
+         *
+         * The first call only takes the reference of the device accumulators.
+         */
+        void update();
+
+        /**
+         * @brief Reset the device accumulators, all the extended counters and the mission
+         *
+         */
+        void reset();
+
+        /**
+         * @brief Get the maximum period between two update() before a wrap can be missed
+         *
+         * @param max_power maximum expected power in Watts
+         * @param max_current maximum expected current (absolute value) in Amperes
+         * @return uint32_t period in ms
+         */
+        uint32_t getMaxUpdatePeriod(float_t max_power, float_t max_current);
+
+        /**
+         * @brief Get the energy accumulated since the last reset
+         *
+         * @return double_t energy in Joules
+         */
+        double_t getEnergy();
+
+        /**
+         * @brief Get the charge accumulated since the last reset
+         *
+         * @return double_t charge in Coulombs
+         */
+        double_t getCharge();
+
+        /**
+         * @brief Get the energy accumulated since the last call and start a new window
+         *
+         * @return double_t energy of the window in Joules
+         */
+        double_t readWindowEnergy();
+
+        /**
+         * @brief Get the charge accumulated since the last call and start a new window
+         *
+         * @return double_t charge of the window in Coulombs
+         */
+        double_t readWindowCharge();
+
+        /**
+         * @brief Start the totals of a new mission
+         *
+         */
+        void startMission();
+
+        /**
+         * @brief Freeze the totals of the current mission
+         *
+         */
+        void stopMission();
+
+        /**
+         * @brief Get the energy used during the current (or last) mission
+         *
+         * @return double_t energy in Joules
+         */
+        double_t getMissionEnergy();
+
+        /**
+         * @brief Get the charge used during the current (or last) mission
+         *
+         * @return double_t charge in Coulombs
+         */
+        double_t getMissionCharge();
+
+        /**
+         * @brief Set the battery used for the battery level integration
+         *
+         * @param capacity capacity of the battery in Coulombs (Ah * 3600)
+         * @param level battery level at the time of the call (0.0 to 1.0)
+         */
+        void setBattery(double_t capacity, float_t level = 1.0);
+
+        /**
+         * @brief Get the battery level
+         *
+         * A positive charge through the shunt is considered as a discharge of the battery.
+         *
+         * @return float_t battery level (0.0 to 1.0)
+         */
+        float_t getBatteryLevel();
+
+    private:
+
+        INA228* ina228;
+
+        Mutex accumulator_mutex;
+
+        bool primed = false;
+        uint64_t last_energy_raw = 0;
+        uint64_t last_charge_raw = 0;
+
+        uint64_t energy = 0;
+        int64_t charge = 0;
+
+        uint64_t window_energy = 0;
+        int64_t window_charge = 0;
+
+        bool mission_running = false;
+        uint64_t mission_energy_start = 0;
+        uint64_t mission_energy_stop = 0;
+        int64_t mission_charge_start = 0;
+        int64_t mission_charge_stop = 0;
+
+        double_t battery_capacity = 0;
+        int64_t battery_charge_start = 0;
+        float_t battery_level_start = 1.0;
+};
+
+#endif
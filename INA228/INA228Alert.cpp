@@ -0,0 +1,95 @@
+/**
+ * @file INA228Alert.cpp
+ * @brief INA228Alert class source file
+ *
+ */
+
+#include "INA228Alert.h"
+
+#include "Utility/MemoryAlloc.h"
+
+INA228Alert::INA228Alert(INA228* ina228, PinName alert_pin, Callback<void(uint16_t)> alert_callback, osPriority thread_priority)
+    : alertThread(thread_priority, OS_STACK_SIZE, NULL, "ina228_alert")
+{
+    this->ina228 = ina228;
+    this->alert_callback = alert_callback;
+
+    // latched, the flags are cleared by the read of DIAG_ALRT, the other settings of the user are kept
+    uint16_t config = ina228->getAlertFlags() & DIAG_ALRT_CONFIG_MASK;
+    ina228->setAlertFlags(config | DIAG_ALRT_ALATCH);
+    ina228->getAlertFlags();
+    active_high = config & DIAG_ALRT_APOL;
+
+    alert = new InterruptIn(alert_pin);
+    memoryAccount(MEMORY_MODULE_INA228, sizeof(InterruptIn));
+
+    alertThread.start(callback(this, &INA228Alert::alert_thread));
+    if(active_high)
+    {
+        alert->mode(PullDown);
+        alert->rise(callback(this, &INA228Alert::alert_irq));
+    }
+    else
+    {
+        alert->mode(PullUp);
+        alert->fall(callback(this, &INA228Alert::alert_irq));
+    }
+}
+
+INA228Alert::~INA228Alert()
+{
+    // no interrupt and no thread may use the pin once it is deleted
+    if(active_high)
+    {
+        alert->rise(Callback<void()>());
+    }
+    else
+    {
+        alert->fall(Callback<void()>());
+    }
+    event.set(INA228_ALERT_STOP_FLAG);
+    alertThread.join();
+
+    delete alert;
+    memoryAccount(MEMORY_MODULE_INA228, -(int32_t)sizeof(InterruptIn));
+}
+
+uint16_t INA228Alert::getLastCause()
+{
+    return last_cause;
+}
+
+uint32_t INA228Alert::getAlertCount()
+{
+    return alert_count;
+}
+
+void INA228Alert::alert_irq()
+{
+    event.set(INA228_ALERT_FLAG);
+}
+
+void INA228Alert::alert_thread()
+{
+    while(1)
+    {
+        uint32_t flags = event.wait_any(INA228_ALERT_FLAG | INA228_ALERT_STOP_FLAG);
+        if(flags & INA228_ALERT_STOP_FLAG)
+        {
+            return;
+        }
+
+        uint16_t cause = ina228->getAlertFlags() & DIAG_ALRT_CAUSE_MASK;
+
+        if(cause)
+        {
+            last_cause = cause;
+            alert_count++;
+
+            if(alert_callback)
+            {
+                alert_callback(cause);
+            }
+        }
+    }
+}
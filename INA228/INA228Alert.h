@@ -0,0 +1,92 @@
+/**
+ * @file INA228Alert.h
+ * @brief Alert pin handling of the INA228
+ *
+ * The limits are programmed on the INA228 (see INA228::setOverCurrentLimit() and the others)
+ * and the device pulls its ALERT pin as soon as a conversion crosses one of them.
+ * The interrupt wakes the alert thread which reads DIAG_ALRT and calls the user callback
+ * with the cause of the alert (DIAG_ALRT_* bits of DIAG_ALRT_CAUSE_MASK).
+ *
+ * @warning the callback is called from the alert thread, it must not block for long.
+ *
+ */
+
+#ifndef INA228_ALERT_H
+#define INA228_ALERT_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "INA228.h"
+
+#define INA228_ALERT_FLAG 0x1
+#define INA228_ALERT_STOP_FLAG 0x2
+
+/**
+ * @brief ALERT pin interrupt of the INA228
+ *
+ */
+class INA228Alert
+{
+    public:
+
+        /**
+         * @brief INA228Alert constructor
+         *
+         * Latch the alert of the INA228 and start the alert thread. The other settings of DIAG_ALRT
+         * (CNVR, SLOWALERT, APOL) are kept, the edge of the pin follows APOL.
+         *
+         * @param ina228 pointer to the configured INA228
+         * @param alert_pin pin connected to the ALERT output of the INA228
+         * @param alert_callback function called with the cause of the alert
+         * @param thread_priority priority of the alert thread
+         */
+        INA228Alert(INA228* ina228, PinName alert_pin, Callback<void(uint16_t)> alert_callback, osPriority thread_priority = osPriorityHigh);
+
+        /**
+         * @brief Destroy the INA228Alert object, the alert thread is stopped and joined first
+         *
+         */
+        ~INA228Alert();
+
+        /**
+         * @brief Get the cause of the last alert
+         *
+         * @return uint16_t DIAG_ALRT_* bits of the last alert
+         */
+        uint16_t getLastCause();
+
+        /**
+         * @brief Get the number of alerts since the start
+         *
+         * @return uint32_t number of alerts
+         */
+        uint32_t getAlertCount();
+
+    private:
+
+        INA228* ina228;
+        InterruptIn* alert;
+        bool active_high;
+        Callback<void(uint16_t)> alert_callback;
+
+        Thread alertThread;
+        EventFlags event;
+
+        volatile uint16_t last_cause = 0;
+        volatile uint32_t alert_count = 0;
+
+        /**
+         * @brief interrupt of the ALERT pin, wake up the alert thread
+         *
+         */
+        void alert_irq();
+
+        /**
+         * @brief the alert thread, read DIAG_ALRT and call the user callback
+         *
+         */
+        void alert_thread();
+};
+
+#endif
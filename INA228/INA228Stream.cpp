@@ -0,0 +1,190 @@
+/**
+ * @file INA228Stream.cpp
+ * @brief INA228Stream class source file
+ *
+ */
+
+#include "INA228Stream.h"
+
+#include "Utility/MemoryAlloc.h"
+
+INA228Stream::INA228Stream(INA228* ina228, RS485* rs, const uint16_t window_size, const uint16_t ring_size)
+{
+    this->ina228 = ina228;
+    this->rs = rs;
+    // the ring index is taken modulo its size, never empty
+    this->window_size = window_size ? window_size : 1;
+    this->ring_size = ring_size ? ring_size : 1;
+
+    ring = (INA228_sample*)memoryAlloc(MEMORY_MODULE_INA228, sizeof(INA228_sample)*this->ring_size);
+
+    resetRunning(current_running);
+    resetRunning(voltage_running);
+}
+
+INA228Stream::~INA228Stream()
+{
+    memoryFree(ring);
+    ring = NULL;
+}
+
+void INA228Stream::sample()
+{
+    float_t current = ina228->getCurrent();
+    float_t voltage = ina228->getBusVolt();
+
+    addSample(current, voltage);
+}
+
+void INA228Stream::setTimebase(Timebase* timebase)
+{
+    this->timebase = timebase;
+}
+
+void INA228Stream::addSample(const float_t current, const float_t voltage)
+{
+    uint64_t now = timebase ? timebase->getTime() : Kernel::get_ms_count()*1000;
+
+    stream_mutex.lock();
+
+    if(!ring_frozen)
+    {
+        ring[ring_head].current = current;
+        ring[ring_head].voltage = voltage;
+        ring_head = (ring_head + 1) % ring_size;
+        if(ring_count < ring_size)
+        {
+            ring_count++;
+        }
+    }
+
+    if(window_count == 0)
+    {
+        window_start_us = now;
+    }
+
+    addRunning(current_running, current);
+    addRunning(voltage_running, voltage);
+    window_count++;
+
+    if(window_count >= window_size)
+    {
+        last_window.nb_sample = window_count;
+        last_window.current_min = current_running.min;
+        last_window.current_max = current_running.max;
+        last_window.current_mean = current_running.sum/window_count;
+        last_window.current_rms = sqrtf(current_running.sum_square/window_count);
+        last_window.voltage_min = voltage_running.min;
+        last_window.voltage_max = voltage_running.max;
+        last_window.voltage_mean = voltage_running.sum/window_count;
+        last_window.voltage_rms = sqrtf(voltage_running.sum_square/window_count);
+        last_window.start_us = window_start_us;
+        last_window.end_us = now;
+        window_ready = true;
+
+        window_count = 0;
+        resetRunning(current_running);
+        resetRunning(voltage_running);
+    }
+
+    stream_mutex.unlock();
+}
+
+bool INA228Stream::getWindow(INA228_window& window)
+{
+    stream_mutex.lock();
+    bool ready = window_ready;
+    window = last_window;
+    window_ready = false;
+    stream_mutex.unlock();
+
+    return ready;
+}
+
+bool INA228Stream::publish()
+{
+    INA228_window window;
+    uint8_t buffer[INA228_WINDOW_PAYLOAD_SIZE];
+
+    if(!getWindow(window))
+    {
+        return false;
+    }
+
+    putWindowInArray(buffer, window);
+    rs->write(rs->getBoardAdress(), CMD_POWER_WINDOW, INA228_WINDOW_PAYLOAD_SIZE, buffer);
+    return true;
+}
+
+void INA228Stream::dumpRing()
+{
+    uint8_t buffer[2 + INA228_RAW_SAMPLE_PER_FRAME*8];
+
+    stream_mutex.lock();
+    ring_frozen = true;
+    uint16_t count = ring_count;
+    uint16_t oldest = (ring_head + ring_size - ring_count) % ring_size;
+    stream_mutex.unlock();
+
+    // the frame index is on one byte
+    if(count > 255*INA228_RAW_SAMPLE_PER_FRAME)
+    {
+        oldest = (oldest + count - 255*INA228_RAW_SAMPLE_PER_FRAME) % ring_size;
+        count = 255*INA228_RAW_SAMPLE_PER_FRAME;
+    }
+
+    uint8_t nb_frame = (count + INA228_RAW_SAMPLE_PER_FRAME - 1) / INA228_RAW_SAMPLE_PER_FRAME;
+
+    for(uint8_t frame = 0; frame < nb_frame; ++frame)
+    {
+        uint8_t nb_sample = 0;
+
+        buffer[0] = frame;
+        buffer[1] = nb_frame;
+
+        // the ring is frozen, no need to hold the mutex while reading it
+        while(nb_sample < INA228_RAW_SAMPLE_PER_FRAME && frame*INA228_RAW_SAMPLE_PER_FRAME + nb_sample < count)
+        {
+            uint16_t index = (oldest + frame*INA228_RAW_SAMPLE_PER_FRAME + nb_sample) % ring_size;
+            putFloatInArray(buffer, ring[index].current, 2 + nb_sample*8);
+            putFloatInArray(buffer, ring[index].voltage, 6 + nb_sample*8);
+            nb_sample++;
+        }
+
+        rs->write(rs->getBoardAdress(), CMD_POWER_RAW, 2 + nb_sample*8, buffer);
+    }
+
+    stream_mutex.lock();
+    ring_frozen = false;
+    stream_mutex.unlock();
+}
+
+void INA228Stream::putWindowInArray(uint8_t* array, const INA228_window& window)
+{
+    array[0] = (uint8_t)(window.nb_sample >> 8);
+    array[1] = (uint8_t)(window.nb_sample & 0xFF);
+    putFloatInArray(array, window.current_min, 2);
+    putFloatInArray(array, window.current_max, 6);
+    putFloatInArray(array, window.current_mean, 10);
+    putFloatInArray(array, window.current_rms, 14);
+    putFloatInArray(array, window.voltage_min, 18);
+    putFloatInArray(array, window.voltage_max, 22);
+    putFloatInArray(array, window.voltage_mean, 26);
+    putFloatInArray(array, window.voltage_rms, 30);
+}
+
+void INA228Stream::resetRunning(INA228_running& running)
+{
+    running.min = INFINITY;
+    running.max = -INFINITY;
+    running.sum = 0;
+    running.sum_square = 0;
+}
+
+void INA228Stream::addRunning(INA228_running& running, const float_t value)
+{
+    if(value < running.min) running.min = value;
+    if(value > running.max) running.max = value;
+    running.sum += value;
+    running.sum_square += value*value;
+}
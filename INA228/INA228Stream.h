@@ -0,0 +1,177 @@
+/**
+ * @file INA228Stream.h
+ * @brief Windowed telemetry of the INA228 with min/max/mean/RMS decimation
+ *
+ * INA228Stream::sample() is called at the ADC rate and keeps the raw samples in a ring buffer.
+ * Every window_size samples a summary (min, max, mean and RMS of the current and bus voltage) is computed.
+ * INA228Stream::publish() is called at the telemetry rate and sends the last summary with CMD_POWER_WINDOW.
+ * INA228Stream::dumpRing() sends the raw ring with CMD_POWER_RAW when the master asks for it.
+ *
+ */
+
+#ifndef INA228_STREAM_H
+#define INA228_STREAM_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "INA228.h"
+#include "Utility/utility.h"
+#include "Utility/Timebase.h"
+
+#define INA228_WINDOW_PAYLOAD_SIZE 34
+#define INA228_RAW_SAMPLE_PER_FRAME 31
+
+/**
+ * @brief summary of one window of samples
+ *
+ */
+typedef struct INA228_window_struct
+{
+    uint16_t nb_sample;
+    float_t current_min;
+    float_t current_max;
+    float_t current_mean;
+    float_t current_rms;
+    float_t voltage_min;
+    float_t voltage_max;
+    float_t voltage_mean;
+    float_t voltage_rms;
+    uint64_t start_us; // time of the first sample, shared time when a timebase is set
+    uint64_t end_us;   // time of the last sample
+} INA228_window;
+
+/**
+ * @brief decimation stage between the INA228 and the RS485 telemetry
+ *
+ */
+class INA228Stream
+{
+    public:
+
+        /**
+         * @brief INA228Stream constructor
+         *
+         * @param ina228 pointer to the configured INA228
+         * @param rs pointer to the RS485 used for the telemetry
+         * @param window_size number of samples in one window, at least 1
+         * @param ring_size number of raw samples kept for the burst dump, at least 1
+         */
+        INA228Stream(INA228* ina228, RS485* rs, const uint16_t window_size = 100, const uint16_t ring_size = 256);
+
+        /**
+         * @brief Destroy the INA228Stream object
+         *
+         */
+        ~INA228Stream();
+
+        /**
+         * @brief Read the current and the bus voltage on the INA228 and add them to the stream
+         *
+         */
+        void sample();
+
+        /**
+         * @brief Add a sample that was already read
+         *
+         * @param current current in Amperes
+         * @param voltage bus voltage in Volts
+         */
+        void addSample(const float_t current, const float_t voltage);
+
+        /**
+         * @brief Set the timebase used to stamp the windows
+         *
+         * Without timebase the windows are stamped with the kernel time.
+         *
+         * @param timebase the timebase of the board
+         */
+        void setTimebase(Timebase* timebase);
+
+        /**
+         * @brief Get the last completed window
+         *
+         * @param window the structure where the summary gonna be written
+         * @return true if a window was completed since the last call
+         */
+        bool getWindow(INA228_window& window);
+
+        /**
+         * @brief Send the last completed window with CMD_POWER_WINDOW
+         *
+         * Nothing is sent if no window was completed since the last call.
+         *
+         * @return true if a frame was sent
+         */
+        bool publish();
+
+        /**
+         * @brief Send all the raw samples of the ring with CMD_POWER_RAW
+         *
+         * Each frame contains the frame index, the number of frames and up to
+         * INA228_RAW_SAMPLE_PER_FRAME pairs of current and voltage, oldest first.
+         * The ring is frozen during the dump but the windows keep being computed.
+         */
+        void dumpRing();
+
+        /**
+         * @brief Encode a window summary in a payload of INA228_WINDOW_PAYLOAD_SIZE bytes
+         *
+         * @param array the payload buffer
+         * @param window the summary to encode
+         */
+        static void putWindowInArray(uint8_t* array, const INA228_window& window);
+
+    private:
+
+        typedef struct INA228_sample_struct
+        {
+            float_t current;
+            float_t voltage;
+        } INA228_sample;
+
+        typedef struct INA228_running_struct
+        {
+            float_t min;
+            float_t max;
+            float_t sum;
+            float_t sum_square;
+        } INA228_running;
+
+        INA228* ina228;
+        RS485* rs;
+        Timebase* timebase = NULL;
+
+        Mutex stream_mutex;
+
+        uint16_t window_size;
+        uint16_t window_count = 0;
+        INA228_running current_running;
+        INA228_running voltage_running;
+        INA228_window last_window;
+        bool window_ready = false;
+        uint64_t window_start_us = 0;
+
+        INA228_sample* ring = NULL;
+        uint16_t ring_size;
+        uint16_t ring_head = 0;
+        uint16_t ring_count = 0;
+        bool ring_frozen = false;
+
+        /**
+         * @brief restart the running statistics of a window
+         *
+         * @param running the running statistics
+         */
+        static void resetRunning(INA228_running& running);
+
+        /**
+         * @brief add a value to the running statistics
+         *
+         * @param running the running statistics
+         * @param value the value to add
+         */
+        static void addRunning(INA228_running& running, const float_t value);
+};
+
+#endif
@@ -0,0 +1,164 @@
+/**
+ * @file RS485EmulatedSlave.cpp
+ * @brief RS485EmulatedSlave class source file
+ *
+ */
+
+#include "RS485EmulatedSlave.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+RS485EmulatedSlave::RS485EmulatedSlave(uint8_t address, RS485_slave_handler handler)
+{
+    this->address = address;
+    this->handler = handler;
+}
+
+RS485EmulatedSlave::~RS485EmulatedSlave()
+{
+    stop();
+}
+
+int RS485EmulatedSlave::start(int fd)
+{
+    stop();
+
+    int flags = fcntl(fd, F_GETFL);
+    if(flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        return -errno;
+    }
+
+    stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if(stop_fd < 0)
+    {
+        return -errno;
+    }
+
+    this->fd = fd;
+    thread = std::thread(&RS485EmulatedSlave::loop, this);
+
+    return 0;
+}
+
+void RS485EmulatedSlave::stop()
+{
+    if(stop_fd < 0)
+    {
+        return;
+    }
+
+    uint64_t value = 1;
+    if(write(stop_fd, &value, sizeof(value)) == sizeof(value))
+    {
+        thread.join();
+    }
+    else
+    {
+        thread.detach();
+    }
+
+    close(stop_fd);
+    stop_fd = -1;
+    fd = -1;
+}
+
+uint32_t RS485EmulatedSlave::getHandled()
+{
+    return handled;
+}
+
+//###################################################
+//
+// PRIVATE FUNCTION
+//
+//###################################################
+
+void RS485EmulatedSlave::loop()
+{
+    RS485_frame_parser parser;
+    uint8_t data[RS485_MAX_PAYLOAD];
+    uint8_t reply[RS485_MAX_PAYLOAD];
+    uint8_t frame[RS485_FRAME_MAX_SIZE];
+    uint8_t buffer[4096];
+
+    RS485_frameParserInit(&parser, data);
+
+    struct pollfd fds[2] = {{fd, POLLIN, 0}, {stop_fd, POLLIN, 0}};
+
+    while(1)
+    {
+        if(::poll(fds, 2, -1) < 0 && errno != EINTR)
+        {
+            return;
+        }
+        if(fds[1].revents)
+        {
+            return;
+        }
+        if(!(fds[0].revents & POLLIN))
+        {
+            continue;
+        }
+
+        ssize_t size = read(fd, buffer, sizeof(buffer));
+        if(size <= 0)
+        {
+            continue;
+        }
+
+        size_t position = 0;
+        while(position < (size_t)size)
+        {
+            RS485_parse_status status;
+            position += RS485_frameParseChunk(&parser, buffer + position, size - position, status);
+            if(status != RS485_PARSE_FRAME || !RS485_frameAccept(address, &parser))
+            {
+                continue;
+            }
+
+            int nb_byte = handler(parser.cmd, parser.data, parser.nb_byte, reply);
+            handled++;
+
+            // the broadcasts are never answered
+            if(nb_byte < 0 || parser.slave != address)
+            {
+                continue;
+            }
+
+            uint16_t frame_size = RS485_frameEncode(address, parser.cmd, (uint8_t)nb_byte, reply, frame);
+            if(writeAll(frame, frame_size) < 0)
+            {
+                return;
+            }
+        }
+    }
+}
+
+int RS485EmulatedSlave::writeAll(const uint8_t* data, size_t size)
+{
+    while(size > 0)
+    {
+        ssize_t written = write(fd, data, size);
+        if(written < 0)
+        {
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                return -errno;
+            }
+
+            struct pollfd out = {fd, POLLOUT, 0};
+            ::poll(&out, 1, -1);
+            continue;
+        }
+
+        data += written;
+        size -= written;
+    }
+
+    return 0;
+}
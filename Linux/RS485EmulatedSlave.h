@@ -0,0 +1,83 @@
+/**
+ * @file RS485EmulatedSlave.h
+ * @brief A board answering on a file descriptor, to run the Linux master without the bus
+ *
+ * The slave parses the bytes with the same framing as the boards, keeps the frames of its
+ * address (RS485_frameAccept) and gives each one to a handler that writes the reply.
+ * It runs in its own thread until stop().
+ *
+ */
+
+#ifndef RS485_EMULATED_SLAVE_H
+#define RS485_EMULATED_SLAVE_H
+
+#include <stdint.h>
+#include <functional>
+#include <thread>
+
+#include "RS485/RS485_frame.h"
+
+/**
+ * @brief handler of a frame: cmd, data, nb_byte, reply buffer, returns the size of the reply or -1 without reply
+ *
+ */
+typedef std::function<int(uint8_t, const uint8_t*, uint8_t, uint8_t*)> RS485_slave_handler;
+
+/**
+ * @brief Emulation of one board
+ *
+ */
+class RS485EmulatedSlave
+{
+    public:
+
+        /**
+         * @brief RS485EmulatedSlave constructor
+         *
+         * @param address the address of the board
+         * @param handler the handler of the frames
+         */
+        RS485EmulatedSlave(uint8_t address, RS485_slave_handler handler);
+
+        /**
+         * @brief Destroy the RS485EmulatedSlave object, the thread is stopped
+         *
+         */
+        ~RS485EmulatedSlave();
+
+        /**
+         * @brief start the thread on a file descriptor, the caller keeps it open until stop()
+         *
+         * @param fd the file descriptor
+         * @return int 0 or -errno
+         */
+        int start(int fd);
+
+        /**
+         * @brief stop the thread
+         *
+         */
+        void stop();
+
+        /**
+         * @brief Get the number of frames handled
+         *
+         * @return uint32_t the number of frames
+         */
+        uint32_t getHandled();
+
+    private:
+
+        uint8_t address;
+        RS485_slave_handler handler;
+
+        int fd = -1;
+        int stop_fd = -1;
+        std::thread thread;
+        volatile uint32_t handled = 0;
+
+        void loop();
+        int writeAll(const uint8_t* data, size_t size);
+};
+
+#endif
@@ -0,0 +1,598 @@
+/**
+ * @file RS485LinuxMaster.cpp
+ * @brief RS485LinuxMaster class source file
+ *
+ */
+
+#include "RS485LinuxMaster.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "RS485/RS485_definition.h"
+
+// the rates of RS485Baud, the boards start at the first one
+static const uint32_t rates[RS485_BAUD_NB_RATE] = RS485_BAUD_RATES;
+static const uint32_t base_rate = rates[0];
+
+/**
+ * @brief the termios constant of a baudrate
+ *
+ */
+static speed_t linuxSpeed(uint32_t baud)
+{
+    switch(baud)
+    {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        case 1000000: return B1000000;
+        case 2000000: return B2000000;
+        default: return B0;
+    }
+}
+
+RS485LinuxMaster::RS485LinuxMaster(uint8_t window, uint32_t timeout_ms)
+{
+    this->window = window ? window : 1;
+    this->timeout_ms = timeout_ms;
+
+    RS485_frameParserInit(&parser, parser_data);
+}
+
+RS485LinuxMaster::~RS485LinuxMaster()
+{
+    close();
+}
+
+int RS485LinuxMaster::open(const char* path, uint32_t baud)
+{
+    speed_t speed = linuxSpeed(baud);
+    if(speed == B0)
+    {
+        return -EINVAL;
+    }
+
+    int port = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if(port < 0)
+    {
+        return -errno;
+    }
+
+    // raw 8N1, no flow control, read() returns what is there
+    struct termios tty;
+    if(tcgetattr(port, &tty) < 0)
+    {
+        int error = -errno;
+        ::close(port);
+        return error;
+    }
+    cfmakeraw(&tty);
+    tty.c_cflag |= CLOCAL | CREAD;
+    tty.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 0;
+    cfsetispeed(&tty, speed);
+    cfsetospeed(&tty, speed);
+
+    if(tcsetattr(port, TCSANOW, &tty) < 0)
+    {
+        int error = -errno;
+        ::close(port);
+        return error;
+    }
+    tcflush(port, TCIOFLUSH);
+
+    int result = attach(port);
+    if(result == 0)
+    {
+        this->baud = baud;
+    }
+    return result;
+}
+
+int RS485LinuxMaster::attach(int fd)
+{
+    close();
+
+    // the master owns the descriptor, even when it can't use it
+    int flags = fcntl(fd, F_GETFL);
+    if(flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        int error = -errno;
+        ::close(fd);
+        return error;
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if(epoll_fd < 0)
+    {
+        int error = -errno;
+        ::close(fd);
+        return error;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+        int error = -errno;
+        ::close(epoll_fd);
+        epoll_fd = -1;
+        ::close(fd);
+        return error;
+    }
+
+    this->fd = fd;
+    want_write = false;
+    baud = 0;
+    switch_rate = 0;
+    RS485_frameParserInit(&parser, parser_data);
+
+    return 0;
+}
+
+void RS485LinuxMaster::close()
+{
+    RS485_linux_reply reply = {-ECANCELED, 0, 0, 0, NULL, 0};
+
+    while(!in_flight.empty() || !queued.empty())
+    {
+        std::deque<pending_request>& list = in_flight.empty() ? queued : in_flight;
+        pending_request canceled = list.front();
+        list.pop_front();
+
+        if(canceled.reply)
+        {
+            reply.slave = canceled.slave;
+            reply.cmd = canceled.cmd;
+            canceled.callback(reply);
+        }
+    }
+    write_offset = 0;
+    echoes.clear();
+
+    if(epoll_fd >= 0)
+    {
+        ::close(epoll_fd);
+        epoll_fd = -1;
+    }
+    if(fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+int RS485LinuxMaster::setBaud(uint32_t baud)
+{
+    if(fd < 0)
+    {
+        return -EBADF;
+    }
+
+    speed_t speed = linuxSpeed(baud);
+    if(speed == B0)
+    {
+        return -EINVAL;
+    }
+
+    struct termios tty;
+    if(tcgetattr(fd, &tty) < 0)
+    {
+        return -errno;
+    }
+    cfsetispeed(&tty, speed);
+    cfsetospeed(&tty, speed);
+
+    if(tcsetattr(fd, TCSADRAIN, &tty) < 0)
+    {
+        return -errno;
+    }
+
+    this->baud = baud;
+    return 0;
+}
+
+uint32_t RS485LinuxMaster::getBaud()
+{
+    return baud;
+}
+
+void RS485LinuxMaster::followBaud(bool follow)
+{
+    follow_baud = follow;
+    switch_rate = 0;
+    baud_request_ns = now();
+}
+
+void RS485LinuxMaster::setEcho(bool echo)
+{
+    this->echo = echo;
+}
+
+int RS485LinuxMaster::send(uint8_t slave, uint8_t cmd, uint8_t nb_byte, const uint8_t* data)
+{
+    return enqueue(slave, cmd, nb_byte, data, false, RS485_linux_callback());
+}
+
+int RS485LinuxMaster::request(uint8_t slave, uint8_t cmd, uint8_t nb_byte, const uint8_t* data, RS485_linux_callback callback)
+{
+    return enqueue(slave, cmd, nb_byte, data, true, callback);
+}
+
+void RS485LinuxMaster::onFrame(RS485_linux_callback callback)
+{
+    frame_callback = callback;
+}
+
+int RS485LinuxMaster::poll(int timeout_ms)
+{
+    if(fd < 0)
+    {
+        return -EBADF;
+    }
+
+    int result = flush();
+    if(result < 0)
+    {
+        return result;
+    }
+
+    // wake up for the timeout of the oldest request, the switch and the fallback of the rate
+    uint64_t deadline = UINT64_MAX;
+    if(!in_flight.empty())
+    {
+        deadline = in_flight.front().sent_ns + (uint64_t)this->timeout_ms*1000000;
+    }
+    if(switch_rate && switch_ns < deadline)
+    {
+        deadline = switch_ns;
+    }
+    if(follow_baud && baud && baud != base_rate && baud_request_ns + (uint64_t)RS485_BAUD_SILENCE_MS*1000000 < deadline)
+    {
+        deadline = baud_request_ns + (uint64_t)RS485_BAUD_SILENCE_MS*1000000;
+    }
+    if(deadline != UINT64_MAX)
+    {
+        uint64_t time = now();
+        int wait_ms = deadline > time ? (int)((deadline - time + 999999)/1000000) : 0;
+        if(timeout_ms < 0 || wait_ms < timeout_ms)
+        {
+            timeout_ms = wait_ms;
+        }
+    }
+
+    result = updateEvents();
+    if(result < 0)
+    {
+        return result;
+    }
+
+    struct epoll_event event;
+    int nb_event = epoll_wait(epoll_fd, &event, 1, timeout_ms);
+    if(nb_event < 0)
+    {
+        return errno == EINTR ? 0 : -errno;
+    }
+
+    int handled = 0;
+    if(nb_event > 0 && (event.events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+    {
+        result = receive();
+        if(result < 0)
+        {
+            return result;
+        }
+        handled += result;
+    }
+
+    handled += expire();
+
+    // the replies opened the window
+    result = flush();
+    if(result < 0)
+    {
+        return result;
+    }
+
+    return handled;
+}
+
+size_t RS485LinuxMaster::getPending()
+{
+    return queued.size() + in_flight.size();
+}
+
+uint32_t RS485LinuxMaster::getErrors()
+{
+    return errors;
+}
+
+//###################################################
+//
+// PRIVATE FUNCTION
+//
+//###################################################
+
+int RS485LinuxMaster::enqueue(uint8_t slave, uint8_t cmd, uint8_t nb_byte, const uint8_t* data, bool reply, RS485_linux_callback callback)
+{
+    if(fd < 0)
+    {
+        return -EBADF;
+    }
+    if(reply && !callback)
+    {
+        return -EINVAL;
+    }
+
+    pending_request added;
+    added.slave = slave;
+    added.cmd = cmd;
+    added.reply = reply;
+    added.sent_ns = 0;
+    added.callback = callback;
+    added.frame.resize(nb_byte + RS485_FRAME_OVERHEAD);
+    RS485_frameEncode(slave, cmd, nb_byte, data, added.frame.data());
+
+    queued.push_back(added);
+
+    return 0;
+}
+
+int RS485LinuxMaster::flush()
+{
+    want_write = false;
+
+    // a frame waits while the window is full, the line is not free
+    while(!queued.empty() && in_flight.size() < window)
+    {
+        pending_request& first = queued.front();
+
+        ssize_t size = write(fd, first.frame.data() + write_offset, first.frame.size() - write_offset);
+        if(size < 0)
+        {
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                want_write = true;
+                return 0;
+            }
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return -errno;
+        }
+
+        write_offset += size;
+        if(write_offset < first.frame.size())
+        {
+            continue;
+        }
+        write_offset = 0;
+
+        uint64_t sent_ns = now();
+        if(echo)
+        {
+            size_t end = first.frame.size();
+            echo_frame sent = {first.slave, first.cmd, first.frame[3], (uint16_t)((first.frame[end - 3] << 8) | first.frame[end - 2]), sent_ns};
+            echoes.push_back(sent);
+        }
+
+        if(first.reply)
+        {
+            first.sent_ns = sent_ns;
+            in_flight.push_back(first);
+        }
+        queued.pop_front();
+    }
+
+    return 0;
+}
+
+int RS485LinuxMaster::receive()
+{
+    int handled = 0;
+
+    while(1)
+    {
+        ssize_t size = read(fd, read_buffer, sizeof(read_buffer));
+        if(size < 0)
+        {
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return -errno;
+        }
+        if(size == 0)
+        {
+            break;
+        }
+
+        size_t position = 0;
+        while(position < (size_t)size)
+        {
+            RS485_parse_status status;
+            position += RS485_frameParseChunk(&parser, read_buffer + position, size - position, status);
+            if(status != RS485_PARSE_MORE)
+            {
+                handled += handleFrame(status);
+            }
+        }
+    }
+
+    return handled;
+}
+
+int RS485LinuxMaster::expire()
+{
+    uint64_t time = now();
+    int handled = 0;
+
+    // an echo lost on the line would hide the next ones
+    while(!echoes.empty() && time - echoes.front().sent_ns >= (uint64_t)timeout_ms*1000000)
+    {
+        echoes.pop_front();
+    }
+
+    // a port that is not a tty keeps its rate, it is not tried again
+    if(switch_rate && time >= switch_ns)
+    {
+        setBaud(switch_rate);
+        switch_rate = 0;
+    }
+    else if(follow_baud && baud && baud != base_rate && time - baud_request_ns >= (uint64_t)RS485_BAUD_SILENCE_MS*1000000)
+    {
+        setBaud(base_rate);
+        baud_request_ns = time;
+    }
+
+    // the requests are written in order, the oldest one expires first
+    while(!in_flight.empty() && time - in_flight.front().sent_ns >= (uint64_t)timeout_ms*1000000)
+    {
+        pending_request expired = in_flight.front();
+        in_flight.pop_front();
+
+        RS485_linux_reply reply = {-ETIMEDOUT, expired.slave, expired.cmd, 0, NULL, time - expired.sent_ns};
+        expired.callback(reply);
+        handled++;
+    }
+
+    return handled;
+}
+
+int RS485LinuxMaster::handleFrame(RS485_parse_status status)
+{
+    uint64_t time = now();
+
+    if(status == RS485_PARSE_ERROR)
+    {
+        errors++;
+
+        // the damaged echo of a request has its slave and command too
+        if(skipEcho(true))
+        {
+            return 0;
+        }
+
+        // only the request of the same slave and command fails now, the others keep their timeout
+        for(std::deque<pending_request>::iterator it = in_flight.begin(); it != in_flight.end(); ++it)
+        {
+            if(it->slave == parser.slave && it->cmd == parser.cmd)
+            {
+                pending_request failed = *it;
+                in_flight.erase(it);
+
+                RS485_linux_reply reply = {-EIO, failed.slave, failed.cmd, 0, NULL, time - failed.sent_ns};
+                failed.callback(reply);
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    if(skipEcho(false))
+    {
+        return 0;
+    }
+
+    if(!RS485_isValidFrame(RS485_frameDispatch(), parser.slave, parser.cmd, parser.nb_byte))
+    {
+        return 0;
+    }
+
+    if(follow_baud && parser.cmd == CMD_BAUD && parser.nb_byte == RS485_BAUD_REQUEST_SIZE)
+    {
+        baudRequest();
+    }
+
+    RS485_linux_reply reply = {0, parser.slave, parser.cmd, parser.nb_byte, parser.data, 0};
+
+    for(std::deque<pending_request>::iterator it = in_flight.begin(); it != in_flight.end(); ++it)
+    {
+        if(it->slave == parser.slave && it->cmd == parser.cmd)
+        {
+            pending_request answered = *it;
+            in_flight.erase(it);
+
+            reply.latency_ns = time - answered.sent_ns;
+            answered.callback(reply);
+            return 1;
+        }
+    }
+
+    if(frame_callback)
+    {
+        frame_callback(reply);
+    }
+
+    return 0;
+}
+
+bool RS485LinuxMaster::skipEcho(bool damaged)
+{
+    if(!echo || echoes.empty())
+    {
+        return false;
+    }
+
+    // the checksum of a damaged frame is not the one sent
+    const echo_frame& first = echoes.front();
+    if(first.slave != parser.slave || first.cmd != parser.cmd || first.nb_byte != parser.nb_byte ||
+       (!damaged && first.checksum != parser.received))
+    {
+        return false;
+    }
+
+    echoes.pop_front();
+    return true;
+}
+
+void RS485LinuxMaster::baudRequest()
+{
+    uint64_t time = now();
+    uint8_t index = parser.data[1];
+
+    // any request proves the master of the boards is still there, at this rate
+    baud_request_ns = time;
+
+    if(parser.slave == SLAVE_BROADCAST && parser.data[0] == RS485_BAUD_OP_SWITCH && index < RS485_BAUD_NB_RATE)
+    {
+        switch_rate = rates[index];
+        switch_ns = time + (uint64_t)(parser.data[2] | (parser.data[3] << 8))*1000000;
+    }
+}
+
+int RS485LinuxMaster::updateEvents()
+{
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | (want_write ? (uint32_t)EPOLLOUT : 0);
+    event.data.fd = fd;
+
+    return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event) < 0 ? -errno : 0;
+}
+
+uint64_t RS485LinuxMaster::now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec*1000000000 + time.tv_nsec;
+}
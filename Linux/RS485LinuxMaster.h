@@ -0,0 +1,313 @@
+/**
+ * @file RS485LinuxMaster.h
+ * @brief Master of the bus on the Linux mission computer
+ *
+ * The master uses the framing of RS485_frame.h, so the boards and the computer can't disagree
+ * on a frame. The port is in raw 8N1 and non-blocking, one epoll waits on it: the bytes are
+ * read by chunks of RS485_LINUX_READ_SIZE and parsed with RS485_frameParseChunk(), the frames
+ * to send wait in a queue until the port can take them.
+ *
+ * A request waits for the reply of its slave and command. Up to window requests are on the
+ * bus at the same time and the replies are matched in order. The bus is half duplex, a slave
+ * only answers when the line is free, so a window above 1 is only useful on a full duplex
+ * link (RS422, or a gateway that queues the requests).
+ *
+ * A frame with a bad checksum or end fails the request of the same slave and command with -EIO,
+ * the other requests wait for their reply or their timeout.
+ *
+ * The adapter must not send back the frames of the master, or setEcho() must be enabled
+ * so they are skipped: the frames sent back must have the slave, command, size and checksum
+ * of the oldest frame written, an echo not back within the timeout is forgotten.
+ *
+ * The boards may move the bus to another rate with RS485Baud, followBaud() makes the port
+ * follow the switches of their master and its fallback to the base rate.
+ *
+ * The functions return 0 or -errno, nothing is thrown.
+ *
+ */
+
+#ifndef RS485_LINUX_MASTER_H
+#define RS485_LINUX_MASTER_H
+
+#include <stdint.h>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "RS485/RS485_frame.h"
+
+#define RS485_LINUX_READ_SIZE 4096
+#define RS485_LINUX_TIMEOUT_MS 50
+#define RS485_LINUX_WINDOW 1
+
+/**
+ * @brief what the master got for a request
+ *
+ */
+typedef struct RS485_linux_reply_struct
+{
+    int status;          // 0, -ETIMEDOUT without reply, -EIO after a bad frame of the slave and command
+    uint8_t slave;
+    uint8_t cmd;
+    uint8_t nb_byte;
+    const uint8_t* data; // valid during the callback only
+    uint64_t latency_ns; // from the write of the request to the end of the reply
+} RS485_linux_reply;
+
+typedef std::function<void(const RS485_linux_reply&)> RS485_linux_callback;
+
+/**
+ * @brief Master of the bus over a tty
+ *
+ */
+class RS485LinuxMaster
+{
+    public:
+
+        /**
+         * @brief RS485LinuxMaster constructor, the port is opened by open() or attach()
+         *
+         * @param window the number of requests on the bus at the same time
+         * @param timeout_ms the time to wait for a reply
+         */
+        RS485LinuxMaster(uint8_t window = RS485_LINUX_WINDOW, uint32_t timeout_ms = RS485_LINUX_TIMEOUT_MS);
+
+        /**
+         * @brief Destroy the RS485LinuxMaster object, the port is closed
+         *
+         */
+        ~RS485LinuxMaster();
+
+        /**
+         * @brief open a serial port in raw 8N1
+         *
+         * @param path the tty, ex: /dev/ttyUSB0
+         * @param baud the baudrate, one of the termios rates
+         * @return int 0 or -errno
+         */
+        int open(const char* path, uint32_t baud);
+
+        /**
+         * @brief use a file descriptor already configured, ex: a pseudo terminal
+         *
+         * @param fd the file descriptor, the master closes it, also when it fails
+         * @return int 0 or -errno
+         */
+        int attach(int fd);
+
+        /**
+         * @brief close the port, the requests waiting get -ECANCELED
+         *
+         */
+        void close();
+
+        /**
+         * @brief change the rate of the port, the bytes already written leave at the old rate
+         *
+         * @param baud the baudrate, one of the termios rates
+         * @return int 0 or -errno, -ENOTTY when the port is not a tty
+         */
+        int setBaud(uint32_t baud);
+
+        /**
+         * @brief Get the rate of the port
+         *
+         * @return uint32_t the baudrate, 0 when the port was attached and its rate never set
+         */
+        uint32_t getBaud();
+
+        /**
+         * @brief follow the rate of the bus set by the RS485Baud master of the boards
+         *
+         * A CMD_BAUD switch broadcast changes the rate of the port after its delay. Away from the
+         * base rate, the port goes back to it without a CMD_BAUD request for RS485_BAUD_SILENCE_MS,
+         * as the slaves do. The master of the boards broadcasts a keep request more often than that.
+         *
+         * @param follow true to follow the switches
+         */
+        void followBaud(bool follow);
+
+        /**
+         * @brief skip the frames sent back by the adapter
+         *
+         * @param echo true if the adapter receives its own frames
+         */
+        void setEcho(bool echo);
+
+        /**
+         * @brief queue a frame without reply, ex: a broadcast
+         *
+         * @param slave the slave
+         * @param cmd the command
+         * @param nb_byte the size of the data
+         * @param data the data
+         * @return int 0 or -errno
+         */
+        int send(uint8_t slave, uint8_t cmd, uint8_t nb_byte, const uint8_t* data);
+
+        /**
+         * @brief queue a request, the callback gets the reply of the same slave and command
+         *
+         * @param slave the slave
+         * @param cmd the command
+         * @param nb_byte the size of the data
+         * @param data the data
+         * @param callback called by poll() with the reply or the error
+         * @return int 0 or -errno
+         */
+        int request(uint8_t slave, uint8_t cmd, uint8_t nb_byte, const uint8_t* data, RS485_linux_callback callback);
+
+        /**
+         * @brief called by poll() with the frames that are not a reply, ex: the telemetry
+         *
+         * @param callback the callback, status is 0
+         */
+        void onFrame(RS485_linux_callback callback);
+
+        /**
+         * @brief wait for the port and handle everything ready: writes, reads, replies and timeouts
+         *
+         * @param timeout_ms the time to wait, -1 forever
+         * @return int the number of replies handled or -errno
+         */
+        int poll(int timeout_ms);
+
+        /**
+         * @brief Get the number of requests queued or on the bus
+         *
+         * @return size_t the number of requests
+         */
+        size_t getPending();
+
+        /**
+         * @brief Get the number of frames with a bad checksum or end
+         *
+         * @return uint32_t the number of frames
+         */
+        uint32_t getErrors();
+
+    private:
+
+        /**
+         * @brief a frame queued, or written and waiting for its reply
+         *
+         */
+        typedef struct pending_request_struct
+        {
+            uint8_t slave;
+            uint8_t cmd;
+            bool reply;
+            uint64_t sent_ns;
+            RS485_linux_callback callback;
+            std::vector<uint8_t> frame;
+        } pending_request;
+
+        /**
+         * @brief a frame written, to skip when the adapter sends it back
+         *
+         */
+        typedef struct echo_frame_struct
+        {
+            uint8_t slave;
+            uint8_t cmd;
+            uint8_t nb_byte;
+            uint16_t checksum;
+            uint64_t sent_ns;
+        } echo_frame;
+
+        int fd = -1;
+        int epoll_fd = -1;
+        uint8_t window;
+        uint32_t timeout_ms;
+        bool echo = false;
+        bool want_write = false;
+
+        uint32_t baud = 0;
+        bool follow_baud = false;
+        uint32_t switch_rate = 0;     // switch broadcast by the boards, 0 without one
+        uint64_t switch_ns = 0;
+        uint64_t baud_request_ns = 0; // last CMD_BAUD request of the master of the boards
+
+        std::deque<pending_request> queued;    // not written yet
+        std::deque<pending_request> in_flight; // written, waiting for the reply
+        size_t write_offset = 0;               // bytes of the first queued frame already written
+        std::deque<echo_frame> echoes;         // frames written, to skip when the adapter sends them back
+
+        RS485_frame_parser parser;
+        uint8_t parser_data[RS485_MAX_PAYLOAD];
+        uint8_t read_buffer[RS485_LINUX_READ_SIZE];
+        RS485_linux_callback frame_callback;
+        uint32_t errors = 0;
+
+        /**
+         * @brief encode a frame and add it to the queue
+         *
+         * @param slave the slave
+         * @param cmd the command
+         * @param nb_byte the size of the data
+         * @param data the data
+         * @param reply true if the frame waits for a reply
+         * @param callback called with the reply, when reply is true
+         * @return int 0 or -errno
+         */
+        int enqueue(uint8_t slave, uint8_t cmd, uint8_t nb_byte, const uint8_t* data, bool reply, RS485_linux_callback callback);
+
+        /**
+         * @brief write the queued frames while the window has room and the port takes them
+         *
+         * @return int 0 or -errno, want_write is set when the port is full
+         */
+        int flush();
+
+        /**
+         * @brief read everything the port has and parse it
+         *
+         * @return int the number of replies handled or -errno
+         */
+        int receive();
+
+        /**
+         * @brief forget the old echoes, fail the requests past their timeout, apply the rate of the boards
+         *
+         * @return int the number of requests failed
+         */
+        int expire();
+
+        /**
+         * @brief match a parsed frame with its request, or give it to the frame callback
+         *
+         * @param status RS485_PARSE_FRAME or RS485_PARSE_ERROR
+         * @return int 1 if a request got its reply or its error, 0 otherwise
+         */
+        int handleFrame(RS485_parse_status status);
+
+        /**
+         * @brief check if the parsed frame is the echo of the oldest frame written, and drop it
+         *
+         * @param damaged true if the frame has a bad checksum or end, its checksum is not compared
+         * @return true if the frame is an echo
+         */
+        bool skipEcho(bool damaged);
+
+        /**
+         * @brief note a CMD_BAUD request of the master of the boards, and its switch
+         *
+         */
+        void baudRequest();
+
+        /**
+         * @brief wait for the port to be writable only while a frame is waiting for it
+         *
+         * @return int 0 or -errno
+         */
+        int updateEvents();
+
+        /**
+         * @brief the monotonic time
+         *
+         * @return uint64_t the time in ns
+         */
+        static uint64_t now();
+};
+
+#endif
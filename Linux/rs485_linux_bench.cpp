@@ -0,0 +1,156 @@
+/**
+ * @file rs485_linux_bench.cpp
+ * @brief Throughput and latency of the Linux master against an emulated PSU on a pseudo terminal
+ *
+ * The master opens the slave side of a pty like a tty, the emulated PSU0 answers CMD_POWER_WINDOW
+ * with 46 bytes on the other side. Each window is run for BENCH_NB_REQUEST requests, with
+ * enough requests queued that the master never waits for the bench.
+ * A pty has no line time, the results are the cost of the software: at 115200 baud the bus adds
+ * the time of the bytes, printed on the first line.
+ *
+ *  g++ -std=gnu++14 -O2 -I. -IRS485 Linux/rs485_linux_bench.cpp Linux/RS485LinuxMaster.cpp
+ *      Linux/RS485EmulatedSlave.cpp RS485/RS485_frame.cpp -lpthread -o rs485_linux_bench
+ *
+ */
+
+#include "Linux/RS485LinuxMaster.h"
+#include "Linux/RS485EmulatedSlave.h"
+#include "RS485/RS485_definition.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#define BENCH_NB_REQUEST 20000
+#define BENCH_REPLY_SIZE 46
+#define BENCH_BAUDRATE 115200
+
+static uint64_t benchNow()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec*1000000000 + time.tv_nsec;
+}
+
+static double_t percentile(std::vector<uint64_t>& values, double_t rank)
+{
+    if(values.empty())
+    {
+        return 0.0;
+    }
+    size_t index = std::min(values.size() - 1, (size_t)(rank*values.size()));
+    return values[index]/1000.0;
+}
+
+static int powerWindow(uint8_t cmd, const uint8_t*, uint8_t, uint8_t* reply)
+{
+    if(cmd != CMD_POWER_WINDOW)
+    {
+        return -1;
+    }
+    for(uint8_t i = 0; i < BENCH_REPLY_SIZE; ++i)
+    {
+        reply[i] = (uint8_t)(i*31 + 7);
+    }
+    return BENCH_REPLY_SIZE;
+}
+
+static int run(uint8_t window)
+{
+    int pty = posix_openpt(O_RDWR | O_NOCTTY);
+    if(pty < 0 || grantpt(pty) < 0 || unlockpt(pty) < 0)
+    {
+        return -errno;
+    }
+
+    RS485LinuxMaster master(window);
+    int result = master.open(ptsname(pty), BENCH_BAUDRATE);
+    if(result < 0)
+    {
+        close(pty);
+        return result;
+    }
+
+    RS485EmulatedSlave psu(SLAVE_PSU0, powerWindow);
+    result = psu.start(pty);
+    if(result < 0)
+    {
+        close(pty);
+        return result;
+    }
+
+    std::vector<uint64_t> latency;
+    latency.reserve(BENCH_NB_REQUEST);
+    uint32_t issued = 0;
+    uint32_t failed = 0;
+
+    RS485_linux_callback done = [&](const RS485_linux_reply& reply) {
+        if(reply.status == 0 && reply.nb_byte == BENCH_REPLY_SIZE)
+        {
+            latency.push_back(reply.latency_ns);
+        }
+        else
+        {
+            failed++;
+        }
+    };
+
+    uint64_t start = benchNow();
+    while(latency.size() + failed < BENCH_NB_REQUEST)
+    {
+        while(issued < BENCH_NB_REQUEST && master.getPending() < 2*(size_t)window)
+        {
+            master.request(SLAVE_PSU0, CMD_POWER_WINDOW, 0, NULL, done);
+            issued++;
+        }
+
+        result = master.poll(100);
+        if(result < 0)
+        {
+            break;
+        }
+    }
+    double_t elapsed_s = (benchNow() - start)/1e9;
+
+    std::sort(latency.begin(), latency.end());
+    printf("%6u %12.0f %9.1f %9.1f %9.1f %8lu %7lu\n", window, latency.size()/elapsed_s,
+           percentile(latency, 0.5), percentile(latency, 0.99), percentile(latency, 0.999),
+           (unsigned long)failed, (unsigned long)master.getErrors());
+    fflush(stdout);
+
+    psu.stop();
+    master.close();
+    close(pty);
+
+    return result < 0 ? result : 0;
+}
+
+int main()
+{
+    // request and reply on the wire, 10 bits per byte
+    uint32_t line_us = (uint32_t)((2*RS485_FRAME_OVERHEAD + BENCH_REPLY_SIZE)*10*1000000ULL/BENCH_BAUDRATE);
+    printf("%d requests of CMD_POWER_WINDOW to an emulated PSU over a pty, %d B replies\n", BENCH_NB_REQUEST, BENCH_REPLY_SIZE);
+    printf("line time of a request and its reply at %d baud: %lu us\n", BENCH_BAUDRATE, (unsigned long)line_us);
+    printf("%6s %12s %9s %9s %9s %8s %7s\n", "window", "frames/s", "p50 us", "p99 us", "p999 us", "failed", "errors");
+    fflush(stdout);
+
+    const uint8_t windows[] = {1, 4};
+    for(uint8_t window : windows)
+    {
+        int result = run(window);
+        if(result < 0)
+        {
+            printf("window %u: %s\n", window, strerror(-result));
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,405 @@
+/**
+ * @file rs485_linux_test.cpp
+ * @brief Checks of the Linux master against an emulated board and a scripted line
+ *
+ * The cases:
+ * - round trip: an emulated PSU on a pseudo terminal answers CMD_POWER_WINDOW, window 1 and 4
+ * - timeout: a request to a slave that is not there gets -ETIMEDOUT
+ * - bad reply: a reply with a bad checksum fails its request with -EIO right away
+ * - bad frame of another slave: the request is not failed and gets its reply
+ * - echo: the frames sent back by the adapter are skipped, a frame of another slave and command
+ *   with the same checksum is not taken for the echo
+ * - bad descriptor: attach() of a file epoll can't wait on fails and closes it
+ * - baud switch: the port follows a CMD_BAUD switch broadcast, stays at the rate while the keep
+ *   requests come and goes back to the base rate after RS485_BAUD_SILENCE_MS without one
+ * The scripted cases write the line with a socket pair, the master only sees a file descriptor.
+ * The program returns 1 if a check fails.
+ *
+ *  g++ -std=gnu++14 -O2 -Wall -Wextra -I. -IRS485 Linux/rs485_linux_test.cpp Linux/RS485LinuxMaster.cpp
+ *      Linux/RS485EmulatedSlave.cpp RS485/RS485_frame.cpp -lpthread -o rs485_linux_test
+ *
+ */
+
+#include "Linux/RS485LinuxMaster.h"
+#include "Linux/RS485EmulatedSlave.h"
+#include "RS485/RS485_definition.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <vector>
+
+#define TEST_NB_REQUEST 200
+#define TEST_REPLY_SIZE 46
+#define TEST_BAUDRATE 115200
+#define TEST_TIMEOUT_MS 20
+#define TEST_POLL_MS 10
+#define TEST_MAX_POLL 10000 // polls of a case before it gives up
+
+static uint32_t failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    if(!condition)
+    {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+static void report(const char* name, uint32_t failures_before)
+{
+    printf("%-32s %s\n", name, failures == failures_before ? "ok" : "FAIL");
+    fflush(stdout);
+}
+
+static void fillReply(uint8_t* reply, uint8_t seed)
+{
+    for(uint8_t i = 0; i < TEST_REPLY_SIZE; ++i)
+    {
+        reply[i] = (uint8_t)(i*31 + seed);
+    }
+}
+
+static int powerWindow(uint8_t cmd, const uint8_t* data, uint8_t nb_byte, uint8_t* reply)
+{
+    if(cmd != CMD_POWER_WINDOW)
+    {
+        return -1;
+    }
+
+    // the seed of the request comes back, the reply is tied to its request
+    fillReply(reply, nb_byte ? data[0] : 0);
+    return TEST_REPLY_SIZE;
+}
+
+/**
+ * @brief the replies of a case
+ *
+ */
+typedef struct test_result_struct
+{
+    std::vector<int> status;
+    uint32_t wrong_data = 0;
+    uint32_t frames = 0;  // given to onFrame()
+    uint8_t frame_slave = 0;
+    uint8_t frame_cmd = 0;
+} test_result;
+
+static RS485_linux_callback collect(test_result& result, uint8_t seed)
+{
+    return [&result, seed](const RS485_linux_reply& reply) {
+        result.status.push_back(reply.status);
+
+        if(reply.status == 0)
+        {
+            uint8_t expected[TEST_REPLY_SIZE];
+            fillReply(expected, seed);
+            result.wrong_data += reply.nb_byte != TEST_REPLY_SIZE || memcmp(expected, reply.data, TEST_REPLY_SIZE) != 0;
+        }
+    };
+}
+
+static void pollUntil(RS485LinuxMaster& master, size_t pending)
+{
+    for(uint32_t i = 0; i < TEST_MAX_POLL && master.getPending() > pending; ++i)
+    {
+        master.poll(TEST_POLL_MS);
+    }
+}
+
+static void roundTrip(uint8_t window)
+{
+    uint32_t failures_before = failures;
+
+    int pty = posix_openpt(O_RDWR | O_NOCTTY);
+    check(pty >= 0 && grantpt(pty) == 0 && unlockpt(pty) == 0, "pseudo terminal");
+    if(pty < 0)
+    {
+        return;
+    }
+
+    RS485LinuxMaster master(window, TEST_TIMEOUT_MS*10);
+    check(master.open(ptsname(pty), TEST_BAUDRATE) == 0, "open");
+    RS485EmulatedSlave psu(SLAVE_PSU0, powerWindow);
+    check(psu.start(pty) == 0, "start of the slave");
+
+    test_result result;
+    for(uint16_t i = 0; i < TEST_NB_REQUEST; ++i)
+    {
+        uint8_t seed = (uint8_t)i;
+        check(master.request(SLAVE_PSU0, CMD_POWER_WINDOW, 1, &seed, collect(result, seed)) == 0, "request");
+    }
+    pollUntil(master, 0);
+
+    uint32_t answered = 0;
+    for(int status : result.status)
+    {
+        answered += status == 0;
+    }
+    check(result.status.size() == TEST_NB_REQUEST, "every request completed");
+    check(answered == TEST_NB_REQUEST, "every request answered");
+    check(result.wrong_data == 0, "reply data");
+    check(master.getErrors() == 0, "no bad frame");
+    check(psu.getHandled() == TEST_NB_REQUEST, "requests handled by the slave");
+
+    psu.stop();
+    master.close();
+    close(pty);
+
+    char name[32];
+    snprintf(name, sizeof(name), "round trip, window %u", window);
+    report(name, failures_before);
+}
+
+static void timeout()
+{
+    uint32_t failures_before = failures;
+
+    int pty = posix_openpt(O_RDWR | O_NOCTTY);
+    check(pty >= 0 && grantpt(pty) == 0 && unlockpt(pty) == 0, "pseudo terminal");
+    if(pty < 0)
+    {
+        return;
+    }
+
+    RS485LinuxMaster master(1, TEST_TIMEOUT_MS);
+    check(master.open(ptsname(pty), TEST_BAUDRATE) == 0, "open");
+    RS485EmulatedSlave psu(SLAVE_PSU0, powerWindow);
+    check(psu.start(pty) == 0, "start of the slave");
+
+    test_result result;
+    master.request(SLAVE_PSU1, CMD_POWER_WINDOW, 0, NULL, collect(result, 0));
+    pollUntil(master, 0);
+
+    check(result.status.size() == 1 && result.status[0] == -ETIMEDOUT, "request without slave timed out");
+
+    psu.stop();
+    master.close();
+    close(pty);
+
+    report("timeout", failures_before);
+}
+
+/**
+ * @brief both ends of a scripted line, the test writes what the boards would send
+ *
+ */
+class ScriptedLine
+{
+    public:
+        RS485LinuxMaster master;
+        int line = -1;
+
+        ScriptedLine() : master(1, TEST_TIMEOUT_MS*10)
+        {
+            int fds[2];
+            check(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0, "socket pair");
+            check(master.attach(fds[0]) == 0, "attach");
+            line = fds[1];
+        }
+
+        ~ScriptedLine()
+        {
+            master.close();
+            close(line);
+        }
+
+        // what the master wrote, after a poll
+        std::vector<uint8_t> written()
+        {
+            std::vector<uint8_t> bytes(RS485_FRAME_MAX_SIZE);
+            master.poll(0);
+            ssize_t size = recv(line, bytes.data(), bytes.size(), MSG_DONTWAIT);
+            bytes.resize(size > 0 ? size : 0);
+            return bytes;
+        }
+
+        void send(const uint8_t* bytes, size_t size)
+        {
+            check(write(line, bytes, size) == (ssize_t)size, "write of the line");
+        }
+
+        void sendFrame(uint8_t slave, uint8_t cmd, uint8_t nb_byte, const uint8_t* data, bool damaged)
+        {
+            uint8_t frame[RS485_FRAME_MAX_SIZE];
+            uint16_t size = RS485_frameEncode(slave, cmd, nb_byte, data, frame);
+            if(damaged)
+            {
+                frame[size - 2] ^= 0x01;
+            }
+            send(frame, size);
+        }
+};
+
+static void badReply()
+{
+    uint32_t failures_before = failures;
+    ScriptedLine bus;
+    uint8_t reply[TEST_REPLY_SIZE];
+    test_result result;
+
+    bus.master.request(SLAVE_PSU0, CMD_POWER_WINDOW, 0, NULL, collect(result, 0));
+    check(!bus.written().empty(), "request written");
+
+    fillReply(reply, 0);
+    bus.sendFrame(SLAVE_PSU0, CMD_POWER_WINDOW, TEST_REPLY_SIZE, reply, true);
+    for(uint8_t i = 0; i < 5 && result.status.empty(); ++i)
+    {
+        bus.master.poll(TEST_POLL_MS);
+    }
+
+    check(result.status.size() == 1 && result.status[0] == -EIO, "request failed by its bad reply");
+    check(bus.master.getErrors() == 1, "bad frame counted");
+
+    report("bad reply", failures_before);
+}
+
+static void badFrameOfAnotherSlave()
+{
+    uint32_t failures_before = failures;
+    ScriptedLine bus;
+    uint8_t reply[TEST_REPLY_SIZE];
+    uint8_t current[6] = {0};
+    test_result result;
+
+    bus.master.request(SLAVE_PSU0, CMD_POWER_WINDOW, 0, NULL, collect(result, 0));
+    check(!bus.written().empty(), "request written");
+
+    bus.sendFrame(SLAVE_PSU1, CMD_CURRENT, sizeof(current), current, true);
+    for(uint8_t i = 0; i < 5; ++i)
+    {
+        bus.master.poll(1);
+    }
+    check(result.status.empty(), "request still waiting after the bad frame");
+
+    fillReply(reply, 0);
+    bus.sendFrame(SLAVE_PSU0, CMD_POWER_WINDOW, TEST_REPLY_SIZE, reply, false);
+    pollUntil(bus.master, 0);
+
+    check(result.status.size() == 1 && result.status[0] == 0, "request answered");
+    check(result.wrong_data == 0, "reply data");
+    check(bus.master.getErrors() == 1, "bad frame counted");
+
+    report("bad frame of another slave", failures_before);
+}
+
+static void echo()
+{
+    uint32_t failures_before = failures;
+    ScriptedLine bus;
+    uint8_t reply[TEST_REPLY_SIZE];
+    test_result result;
+
+    bus.master.setEcho(true);
+    bus.master.onFrame([&result](const RS485_linux_reply& frame) {
+        result.frames++;
+        result.frame_slave = frame.slave;
+        result.frame_cmd = frame.cmd;
+    });
+
+    // PSU3 CMD_VOLTAGE has the checksum of PSU0 CMD_POWER_WINDOW, both without data
+    bus.master.request(SLAVE_PSU0, CMD_POWER_WINDOW, 0, NULL, collect(result, 0));
+    std::vector<uint8_t> request = bus.written();
+    check(request.size() == RS485_FRAME_OVERHEAD, "request written");
+
+    bus.sendFrame(SLAVE_PSU3, CMD_VOLTAGE, 0, NULL, false);
+    bus.send(request.data(), request.size());
+    fillReply(reply, 0);
+    bus.sendFrame(SLAVE_PSU0, CMD_POWER_WINDOW, TEST_REPLY_SIZE, reply, false);
+    pollUntil(bus.master, 0);
+
+    check(result.frames == 1 && result.frame_slave == SLAVE_PSU3 && result.frame_cmd == CMD_VOLTAGE, "frame of the other slave given");
+    check(result.status.size() == 1 && result.status[0] == 0, "request answered");
+    check(result.wrong_data == 0, "reply data, not the echo");
+
+    report("echo", failures_before);
+}
+
+static void badDescriptor()
+{
+    uint32_t failures_before = failures;
+
+    char path[] = "/tmp/rs485_linux_test_XXXXXX";
+    int file = mkstemp(path);
+    check(file >= 0, "temporary file");
+    if(file < 0)
+    {
+        return;
+    }
+    unlink(path);
+
+    RS485LinuxMaster master;
+    check(master.attach(file) == -EPERM, "attach of a regular file");
+    check(fcntl(file, F_GETFD) < 0 && errno == EBADF, "descriptor closed");
+
+    report("bad descriptor", failures_before);
+}
+
+static void pollFor(RS485LinuxMaster& master, uint32_t duration_ms)
+{
+    for(uint32_t elapsed = 0; elapsed < duration_ms; elapsed += TEST_POLL_MS)
+    {
+        master.poll(TEST_POLL_MS);
+    }
+}
+
+static void baudSwitch()
+{
+    uint32_t failures_before = failures;
+
+    int pty = posix_openpt(O_RDWR | O_NOCTTY);
+    check(pty >= 0 && grantpt(pty) == 0 && unlockpt(pty) == 0, "pseudo terminal");
+    if(pty < 0)
+    {
+        return;
+    }
+
+    RS485LinuxMaster master;
+    check(master.open(ptsname(pty), TEST_BAUDRATE) == 0, "open");
+    master.followBaud(true);
+
+    // the RS485Baud master of the boards moves the bus to 460800 in 10 ms
+    uint8_t frame[RS485_FRAME_MAX_SIZE];
+    uint8_t request[RS485_BAUD_REQUEST_SIZE] = {RS485_BAUD_OP_SWITCH, 2, 10, 0};
+    uint16_t size = RS485_frameEncode(SLAVE_BROADCAST, CMD_BAUD, RS485_BAUD_REQUEST_SIZE, request, frame);
+    check(write(pty, frame, size) == size, "write of the switch");
+    pollFor(master, 5*TEST_POLL_MS);
+    check(master.getBaud() == 460800, "rate of the switch");
+
+    // a keep request before the silence, the rate stays
+    pollFor(master, RS485_BAUD_SILENCE_MS*2/3);
+    uint8_t keep[RS485_BAUD_REQUEST_SIZE] = {RS485_BAUD_OP_KEEP, 0, 0, 0};
+    size = RS485_frameEncode(SLAVE_BROADCAST, CMD_BAUD, RS485_BAUD_REQUEST_SIZE, keep, frame);
+    check(write(pty, frame, size) == size, "write of the keep request");
+    pollFor(master, RS485_BAUD_SILENCE_MS/2);
+    check(master.getBaud() == 460800, "rate kept by the keep request");
+
+    pollFor(master, RS485_BAUD_SILENCE_MS);
+    check(master.getBaud() == TEST_BAUDRATE, "base rate after the silence");
+
+    master.close();
+    close(pty);
+
+    report("baud switch", failures_before);
+}
+
+int main()
+{
+    printf("%-32s %s\n", "case", "result");
+
+    roundTrip(1);
+    roundTrip(4);
+    timeout();
+    badReply();
+    badFrameOfAnotherSlave();
+    echo();
+    badDescriptor();
+    baudSwitch();
+
+    return failures ? 1 : 0;
+}
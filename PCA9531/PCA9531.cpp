@@ -8,7 +8,19 @@
 PCA9531::PCA9531(I2C *i2c, char address)
 {
     _i2c = i2c;
+    _bus = NULL;
     addr = address;
+
+    // power-on values, only written by setLEDsAsync() over a register never set
+    memset(shadow, 0, sizeof(shadow));
+    shadow[PWM0_REG] = PWM_DEFAULT;
+    shadow[PWM1_REG] = PWM_DEFAULT;
+}
+
+PCA9531::PCA9531(I2CBus *bus, char address) : PCA9531(bus->getI2C(), address)
+{
+    _bus = bus;
+    leds_transaction.pending = false;
 }
 
 PCA9531::~PCA9531()
@@ -17,52 +29,210 @@ PCA9531::~PCA9531()
 
 void PCA9531::setLEDs(uint16_t state)
 {
-    setSelectorLEDs(state, LS0_REG);
-    setSelectorLEDs((state >> 8), LS1_REG);
+    shadow_mutex.lock();
+    stage(LS0_REG, state & 0xFF);
+    stage(LS1_REG, state >> 8);
+    flush();
+    shadow_mutex.unlock();
 }
 
-void PCA9531::setSelectorLEDs(uint8_t state, uint8_t selector)
+bool PCA9531::setLEDsAsync(uint16_t state)
 {
-    char temp[2];
+    if(_bus == NULL || !_bus->claim(&leds_transaction))
+    {
+        return false;
+    }
 
-    temp[0] = selector;
-    temp[1] = state;
+    shadow_mutex.lock();
+    stage(LS0_REG, state & 0xFF);
+    stage(LS1_REG, state >> 8);
 
-    _i2c->write(addr, temp, 2);
+    uint8_t length = holding ? 0 : buildWrite(leds_transaction.tx, true);
+    async_length = length;
+    async_done = false;
+    shadow_mutex.unlock();
+
+    if(length == 0)
+    {
+        _bus->release(&leds_transaction);
+        return true;
+    }
+
+    leds_transaction.address = addr;
+    leds_transaction.tx_length = length;
+    leds_transaction.rx = NULL;
+    leds_transaction.rx_length = 0;
+    leds_transaction.priority = I2C_PRIORITY_NORMAL;
+    leds_transaction.done = callback(this, &PCA9531::ledsDone);
+
+    return _bus->submit(&leds_transaction, true);
+}
+
+void PCA9531::setSelectorLEDs(uint8_t state, uint8_t selector)
+{
+    shadow_mutex.lock();
+    stage(selector == LS1_REG ? LS1_REG : LS0_REG, state);
+    flush();
+    shadow_mutex.unlock();
 }
 
 void PCA9531::setPrescaler(uint8_t prescaler, uint8_t pwm_register)
 {
-    char temp[2];
+    shadow_mutex.lock();
+    stage(pwm_register == 1 ? PSC1_REG : PSC0_REG, prescaler);
+    flush();
+    shadow_mutex.unlock();
+}
+
+void PCA9531::setDutyCycle(uint8_t duty_cycle, uint8_t pwm_register)
+{
+    shadow_mutex.lock();
+    stage(pwm_register == 1 ? PWM1_REG : PWM0_REG, duty_cycle);
+    flush();
+    shadow_mutex.unlock();
+}
 
-    if(pwm_register == 1)
+void PCA9531::beginUpdate()
+{
+    shadow_mutex.lock();
+    holding = true;
+    shadow_mutex.unlock();
+}
+
+void PCA9531::apply()
+{
+    shadow_mutex.lock();
+    holding = false;
+    flush();
+    shadow_mutex.unlock();
+}
+
+void PCA9531::invalidate()
+{
+    shadow_mutex.lock();
+    valid_mask = 0;
+    shadow_mutex.unlock();
+}
+
+void PCA9531::stage(uint8_t reg, uint8_t value)
+{
+    uint8_t bit = 1 << reg;
+
+    collectAsync();
+
+    if((valid_mask & bit) && shadow[reg] == value)
     {
-        temp[0] = PSC1_REG;
+        return;
     }
-    else
+
+    shadow[reg] = value;
+    dirty_mask |= bit;
+}
+
+uint8_t PCA9531::buildWrite(char *data, bool whole)
+{
+    uint8_t first = PSC0_REG;
+    uint8_t last;
+
+    if(dirty_mask == 0)
     {
-        temp[0] = PSC0_REG;
+        return 0;
     }
 
-    temp[1] = prescaler;
+    while(!(dirty_mask & (1 << first)))
+    {
+        first++;
+    }
+
+    // extend over the clean registers only if their value is known, they are written again with the same value
+    last = first;
+    for(uint8_t reg = first + 1; reg <= LS1_REG; ++reg)
+    {
+        uint8_t bit = 1 << reg;
+        if(!whole && !(dirty_mask & bit) && !(valid_mask & bit))
+        {
+            break;
+        }
+        if(dirty_mask & bit)
+        {
+            last = reg;
+        }
+    }
 
-    _i2c->write(addr, temp, 2);
+    data[0] = first | AUTO_INCREMENT;
+    for(uint8_t reg = first; reg <= last; ++reg)
+    {
+        data[1 + reg - first] = shadow[reg];
+        dirty_mask &= ~(1 << reg);
+    }
+
+    return 2 + last - first;
 }
 
-void PCA9531::setDutyCycle(uint8_t duty_cycle, uint8_t pwm_register)
+void PCA9531::commitWrite(const char *data, uint8_t length, int result)
 {
-    char temp[2];
+    uint8_t first = data[0] & ~AUTO_INCREMENT;
 
-    if(pwm_register == 1)
+    for(uint8_t reg = first; reg < first + length - 1; ++reg)
     {
-        temp[0] = PWM1_REG;
+        uint8_t bit = 1 << reg;
+        if(result != 0)
+        {
+            valid_mask &= ~bit;
+            dirty_mask |= bit;
+        }
+        else if(shadow[reg] == (uint8_t)data[1 + reg - first])
+        {
+            valid_mask |= bit;
+        }
+        // else changed during the write, still dirty
     }
-    else
+}
+
+void PCA9531::collectAsync()
+{
+    if(async_length && async_done)
     {
-        temp[0] = PWM0_REG;
+        commitWrite(leds_transaction.tx, async_length, leds_transaction.result);
+        async_length = 0;
     }
+}
 
-    temp[1] = duty_cycle;
+void PCA9531::ledsDone(int)
+{
+    async_done = true;
+}
+
+void PCA9531::flush()
+{
+    char data[NB_REGISTER];
+
+    if(holding)
+    {
+        return;
+    }
+
+    collectAsync();
+
+    uint8_t length = buildWrite(data, false);
+    while(length)
+    {
+        int result = writePCA9531(data, length);
+        commitWrite(data, length, result);
+        if(result != 0)
+        {
+            return;
+        }
+        length = buildWrite(data, false);
+    }
+}
+
+int PCA9531::writePCA9531(const char *data, uint8_t length)
+{
+    if(_bus)
+    {
+        return _bus->transact(addr, data, length, NULL, 0);
+    }
 
-    _i2c->write(addr, temp, 2);    
+    return _i2c->write(addr, data, length);
 }
\ No newline at end of file
@@ -8,6 +8,8 @@
 
 #include "mbed.h"
 
+#include "I2CBus/I2CBus.h"
+
 #define INPUT_REG 0x00 // Input register
 #define PSC0_REG 0x01 // Frequency prescaler 0
 #define PWM0_REG 0x02 // PWM register 0
@@ -15,10 +17,22 @@
 #define PWM1_REG 0x04 // PWM register 1
 #define LS0_REG 0x05 // LED0 to LED3
 #define LS1_REG 0x06 // LED4 to LED7
+#define AUTO_INCREMENT 0x10 // Auto-increment flag of the control register
+#define NB_REGISTER 7
+#define PWM_DEFAULT 0x80 // PWM0 and PWM1 at the power-on
 
 /**
  * @brief PCA9531 I2C class
  *  LED Driver 
+ * 
+ * The driver keeps a copy of the registers it wrote. A setter that doesn't change
+ * a register doesn't use the bus, and the changed registers are written in one
+ * auto-increment transaction from the lowest changed register to the highest
+ * (split only around registers that were never written).
+ * Between beginUpdate() and apply() the setters only change the copy, apply() writes
+ * the prescalers, PWMs and selectors together.
+ * A register is known only once its write succeeded, after a failed write it is
+ * written again by the next setter.
  */
 
 class PCA9531
@@ -33,6 +47,15 @@ public:
  */
 
     PCA9531(I2C *i2c, char address);
+
+/**
+ * @brief PCA9531 Constructor on a shared bus
+ * 
+ * @param bus pointer of the shared I2C bus
+ * @param address of the PCA9531
+ */
+
+    PCA9531(I2CBus *bus, char address);
     
 /**
  * @brief Destroy the PCA9531 object
@@ -49,6 +72,20 @@ public:
 
     void setLEDs(uint16_t state);
 
+/**
+ * @brief Set LEDs of the driver without waiting for the bus
+ * 
+ * Both selectors are written in one auto-increment transaction, with the registers
+ * left from a failed write: the range goes over the registers never written, they
+ * get the value of the copy (the power-on values if never set).
+ * Only available with the I2CBus constructor, one write at a time.
+ * 
+ * @param state array of the state of the leds to set
+ * @return true if the write is queued
+ */
+
+    bool setLEDsAsync(uint16_t state);
+
 /**
  * @brief Set LEDs of one selector register
  * 
@@ -75,10 +112,110 @@ public:
  */
 
     void setDutyCycle(uint8_t duty_cycle, uint8_t pwm_register);
+
+/**
+ * @brief Hold the writes of the setters until apply()
+ * 
+ */
+
+    void beginUpdate();
+
+/**
+ * @brief Write all the changed registers in one transaction
+ * 
+ * Also ends a beginUpdate().
+ */
+
+    void apply();
+
+/**
+ * @brief Forget the copy of the registers, the next write sends them again
+ * 
+ * Call it if the PCA9531 was reset.
+ */
+
+    void invalidate();
     
 private:
     char addr;
     I2C *_i2c;
+    I2CBus *_bus;
+
+    I2C_transaction leds_transaction;
+    uint8_t async_length = 0;  // write of setLEDsAsync() not given to commitWrite() yet
+    volatile bool async_done = false;
+
+    Mutex shadow_mutex;
+    uint8_t shadow[NB_REGISTER];
+    uint8_t dirty_mask = 0;
+    uint8_t valid_mask = 0;
+    bool holding = false;
+
+/**
+ * @brief Change a register in the copy
+ * 
+ * @param reg address of the register
+ * @param value value of the register
+ */
+
+    void stage(uint8_t reg, uint8_t value);
+
+/**
+ * @brief Build the next auto-increment write of the changed registers
+ * 
+ * The registers of the write are not changed anymore, they are known after commitWrite().
+ * 
+ * @param data buffer of NB_REGISTER bytes for the control register and the data
+ * @param whole true to write up to the last changed register, over the registers never written
+ * @return uint8_t number of bytes to write, 0 if nothing is left to write
+ */
+
+    uint8_t buildWrite(char *data, bool whole);
+
+/**
+ * @brief Update the copy with the result of a write of buildWrite()
+ * 
+ * @param data the data of the write
+ * @param length number of bytes of the write
+ * @param result result of the write, the registers are changed again if it failed
+ */
+
+    void commitWrite(const char *data, uint8_t length, int result);
+
+/**
+ * @brief Commit the write of setLEDsAsync() once the bus is done with it
+ * 
+ */
+
+    void collectAsync();
+
+/**
+ * @brief Completion of setLEDsAsync(), called from the bus thread
+ * 
+ * The copy is updated by the next setter: a setter can hold shadow_mutex while it waits for the bus.
+ * 
+ * @param result result of the transaction
+ */
+
+    void ledsDone(int result);
+
+/**
+ * @brief Write the changed registers if the writes are not held
+ * 
+ * Stops at the first failed write, the registers left are written by the next flush.
+ */
+
+    void flush();
+
+/**
+ * @brief Write bytes to the PCA9531 with I2C or the shared bus
+ * 
+ * @param data control register followed by the data
+ * @param length number of bytes
+ * @return int 0 on success
+ */
+
+    int writePCA9531(const char *data, uint8_t length);
 };
 
 #endif
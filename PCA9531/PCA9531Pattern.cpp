@@ -0,0 +1,233 @@
+/**
+ * @file PCA9531Pattern.cpp
+ * @brief PCA9531Pattern class source file
+*/
+
+#include "PCA9531Pattern.h"
+
+PCA9531Pattern::PCA9531Pattern(PCA9531 *driver)
+{
+    this->driver = driver;
+
+    for(uint8_t i = 0; i < PCA9531_NB_LED; ++i)
+    {
+        pattern[i].mode = PATTERN_OFF;
+        pattern[i].period_ms = 0;
+        pattern[i].duty_cycle = 0;
+        selector[i] = LED_SELECT_OFF;
+    }
+}
+
+void PCA9531Pattern::setPattern(uint8_t led, PCA9531_pattern_mode mode, uint16_t period_ms, uint8_t duty_cycle)
+{
+    if(led >= PCA9531_NB_LED)
+    {
+        return;
+    }
+
+    pattern_mutex.lock();
+    if(pattern[led].mode != mode || pattern[led].period_ms != period_ms || pattern[led].duty_cycle != duty_cycle)
+    {
+        pattern[led].mode = mode;
+        pattern[led].period_ms = period_ms;
+        pattern[led].duty_cycle = duty_cycle;
+        changed = true;
+    }
+    pattern_mutex.unlock();
+}
+
+bool PCA9531Pattern::commit()
+{
+    uint8_t blink_prescaler[PCA9531_NB_LED];
+    uint8_t blink_pwm[PCA9531_NB_LED];
+    uint8_t blink_count[PCA9531_NB_LED];
+    uint8_t blink_of_led[PCA9531_NB_LED];
+    uint8_t nb_blink = 0;
+
+    pattern_mutex.lock();
+
+    if(!changed)
+    {
+        bool fit = software_mask == 0;
+        pattern_mutex.unlock();
+        return fit;
+    }
+    changed = false;
+
+    // group the LEDs by quantized blink
+    for(uint8_t led = 0; led < PCA9531_NB_LED; ++led)
+    {
+        if(pattern[led].mode != PATTERN_BLINK)
+        {
+            continue;
+        }
+
+        uint8_t prescaler = toPrescaler(pattern[led].period_ms);
+        uint8_t pwm = pattern[led].duty_cycle;
+        uint8_t blink = 0;
+
+        while(blink < nb_blink && (blink_prescaler[blink] != prescaler || blink_pwm[blink] != pwm))
+        {
+            blink++;
+        }
+        if(blink == nb_blink)
+        {
+            blink_prescaler[blink] = prescaler;
+            blink_pwm[blink] = pwm;
+            blink_count[blink] = 0;
+            nb_blink++;
+        }
+        blink_count[blink]++;
+        blink_of_led[led] = blink;
+    }
+
+    // the blinks used by the most LEDs get the hardware channels, then the fastest
+    uint8_t channel_blink[PCA9531_NB_CHANNEL];
+    uint8_t nb_channel = 0;
+    bool used[PCA9531_NB_LED] = {false};
+
+    while(nb_channel < PCA9531_NB_CHANNEL && nb_channel < nb_blink)
+    {
+        uint8_t best = 0xFF;
+        for(uint8_t blink = 0; blink < nb_blink; ++blink)
+        {
+            if(used[blink])
+            {
+                continue;
+            }
+            if(best == 0xFF || blink_count[blink] > blink_count[best] ||
+               (blink_count[blink] == blink_count[best] && blink_prescaler[blink] < blink_prescaler[best]))
+            {
+                best = blink;
+            }
+        }
+        used[best] = true;
+        channel_blink[nb_channel++] = best;
+    }
+
+    software_mask = 0;
+    for(uint8_t led = 0; led < PCA9531_NB_LED; ++led)
+    {
+        switch(pattern[led].mode)
+        {
+            case PATTERN_ON:
+                selector[led] = LED_SELECT_ON;
+                break;
+
+            case PATTERN_BLINK:
+                if(nb_channel > 0 && blink_of_led[led] == channel_blink[0])
+                {
+                    selector[led] = LED_SELECT_PWM0;
+                }
+                else if(nb_channel > 1 && blink_of_led[led] == channel_blink[1])
+                {
+                    selector[led] = LED_SELECT_PWM1;
+                }
+                else
+                {
+                    selector[led] = LED_SELECT_OFF;
+                    software_mask |= 1 << led;
+                }
+                break;
+
+            default:
+                selector[led] = LED_SELECT_OFF;
+                break;
+        }
+    }
+
+    // the PCA9531 skips the registers that didn't change
+    driver->beginUpdate();
+    for(uint8_t channel = 0; channel < nb_channel; ++channel)
+    {
+        driver->setPrescaler(blink_prescaler[channel_blink[channel]], channel);
+        driver->setDutyCycle(blink_pwm[channel_blink[channel]], channel);
+    }
+    driver->setLEDs(buildSelectors());
+    driver->apply();
+
+    bool fit = software_mask == 0;
+    pattern_mutex.unlock();
+
+    if(!fit)
+    {
+        update();
+    }
+    return fit;
+}
+
+uint8_t PCA9531Pattern::getSoftwareMask()
+{
+    return software_mask;
+}
+
+uint32_t PCA9531Pattern::update()
+{
+    uint32_t next_toggle = osWaitForever;
+
+    pattern_mutex.lock();
+
+    if(software_mask == 0)
+    {
+        pattern_mutex.unlock();
+        return next_toggle;
+    }
+
+    uint64_t now = Kernel::get_ms_count();
+
+    for(uint8_t led = 0; led < PCA9531_NB_LED; ++led)
+    {
+        if(!(software_mask & (1 << led)))
+        {
+            continue;
+        }
+
+        // same quantization as the hardware channels
+        uint32_t period = ((uint32_t)toPrescaler(pattern[led].period_ms) + 1)*1000/PCA9531_OSCILLATOR_HZ;
+        uint32_t on_time = period*pattern[led].duty_cycle/256;
+        uint32_t phase = (uint32_t)(now % period);
+        uint32_t wait;
+
+        if(phase < on_time)
+        {
+            selector[led] = LED_SELECT_ON;
+            wait = on_time - phase;
+        }
+        else
+        {
+            selector[led] = LED_SELECT_OFF;
+            wait = period - phase;
+        }
+
+        if(wait < next_toggle)
+        {
+            next_toggle = wait;
+        }
+    }
+
+    driver->setLEDs(buildSelectors());
+
+    pattern_mutex.unlock();
+    return next_toggle;
+}
+
+uint8_t PCA9531Pattern::toPrescaler(uint16_t period_ms)
+{
+    uint32_t prescaler = ((uint32_t)period_ms*PCA9531_OSCILLATOR_HZ + 500)/1000;
+
+    if(prescaler < 1) return 0;
+    if(prescaler > 256) return 255;
+    return (uint8_t)(prescaler - 1);
+}
+
+uint16_t PCA9531Pattern::buildSelectors()
+{
+    uint16_t state = 0;
+
+    for(uint8_t led = 0; led < PCA9531_NB_LED; ++led)
+    {
+        state |= (uint16_t)selector[led] << (2*led);
+    }
+
+    return state;
+}
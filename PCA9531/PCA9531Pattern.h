@@ -0,0 +1,131 @@
+/**
+ * @file PCA9531Pattern.h
+ * @brief LED pattern engine on the PCA9531
+ */
+
+#ifndef PCA9531_PATTERN_H
+#define PCA9531_PATTERN_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "PCA9531.h"
+
+#define PCA9531_NB_LED 8
+#define PCA9531_NB_CHANNEL 2
+#define PCA9531_OSCILLATOR_HZ 152 // the blink period is (PSC + 1) / 152 s
+
+#define LED_SELECT_OFF 0x0
+#define LED_SELECT_ON 0x1
+#define LED_SELECT_PWM0 0x2
+#define LED_SELECT_PWM1 0x3
+
+/**
+ * @brief mode of the pattern of one LED
+ * 
+ */
+typedef enum
+{
+    PATTERN_OFF = 0,
+    PATTERN_ON,
+    PATTERN_BLINK
+} PCA9531_pattern_mode;
+
+/**
+ * @brief pattern of one LED
+ * 
+ * A blink with a period under 20 ms is seen as a dimmed LED.
+ */
+typedef struct PCA9531_pattern_struct
+{
+    PCA9531_pattern_mode mode;
+    uint16_t period_ms;
+    uint8_t duty_cycle; // on 256, like PCA9531::setDutyCycle()
+} PCA9531_pattern;
+
+/**
+ * @brief Compile the LED patterns into the two blink channels of the PCA9531
+ * 
+ * The patterns are set with setPattern() and sent with commit(). The bus is only used
+ * when the compiled registers change. The blinks are quantized to the prescaler and PWM
+ * registers, the LEDs with the same quantized blink share a channel.
+ * When more than two different blinks are requested, the two used by the most LEDs get the
+ * hardware channels and the others blink in software: update() toggles them and returns
+ * the time until the next toggle.
+ */
+class PCA9531Pattern
+{
+
+public:
+/**
+ * @brief PCA9531Pattern Constructor, all the LEDs are off
+ * 
+ * @param driver pointer of the PCA9531
+ */
+
+    PCA9531Pattern(PCA9531 *driver);
+
+/**
+ * @brief Set the pattern of one LED, nothing is sent before commit()
+ * 
+ * @param led index of the LED (0 to 7)
+ * @param mode mode of the pattern
+ * @param period_ms period of the blink in ms (6 to 1684)
+ * @param duty_cycle on time of the blink on 256
+ */
+
+    void setPattern(uint8_t led, PCA9531_pattern_mode mode, uint16_t period_ms = 0, uint8_t duty_cycle = 128);
+
+/**
+ * @brief Compile the patterns and send the result if it changed
+ * 
+ * @return true if all the patterns fit in the hardware channels
+ */
+
+    bool commit();
+
+/**
+ * @brief Get the LEDs that blink in software
+ * 
+ * @return uint8_t one bit per LED
+ */
+
+    uint8_t getSoftwareMask();
+
+/**
+ * @brief Toggle the LEDs that blink in software
+ * 
+ * @return uint32_t time until the next toggle in ms, osWaitForever if no LED blinks in software
+ */
+
+    uint32_t update();
+
+private:
+    PCA9531 *driver;
+    Mutex pattern_mutex;
+
+    PCA9531_pattern pattern[PCA9531_NB_LED];
+    bool changed = true;
+
+    uint8_t selector[PCA9531_NB_LED];
+    uint8_t software_mask = 0;
+
+/**
+ * @brief Convert a period to the prescaler register
+ * 
+ * @param period_ms period in ms
+ * @return uint8_t value of the prescaler
+ */
+
+    static uint8_t toPrescaler(uint16_t period_ms);
+
+/**
+ * @brief Build the selector registers from the selectors of the LEDs
+ * 
+ * @return uint16_t LS0 in the low byte and LS1 in the high byte
+ */
+
+    uint16_t buildSelectors();
+};
+
+#endif
@@ -9,7 +9,10 @@
 
 #include "RS485_definition.h"
 #include "RS485.h"
+#include "RS485Subscriber.h"
 #include "pinDef.h"
+#include "Trace/Trace.h"
+#include "Utility/MemoryAlloc.h"
 
 //###################################################
 //
@@ -17,22 +20,25 @@
 //
 //###################################################
 
-RS485::RS485(const uint8_t board_address, const uint32_t prefered_sleep_time, const uint8_t packet_array_size, const uint8_t te_value)
+RS485::RS485(const uint8_t board_address, const uint32_t prefered_sleep_time, const uint8_t packet_array_size, const uint8_t te_value,
+             const uint32_t stack_size)
+    : readThread(osPriorityBelowNormal, stack_size, NULL, "rs485")
 {
-    rs485 = new RawSerial(RS485_TX_PIN, RS485_RX_PIN, 115200);
+    rs485 = new RawSerial(RS485_TX_PIN, RS485_RX_PIN, RS485_BAUDRATE);
     re = new DigitalOut(RS485_RE_PIN, 0);
     te = new DigitalOut(RS485_TE_PIN, te_value);
     de = new DigitalOut(RS485_DE_PIN, 0);
+    memoryAccount(MEMORY_MODULE_RS485, sizeof(RawSerial) + 3*sizeof(DigitalOut));
 
     rs485->set_flow_control(mbed::SerialBase::Disabled, NC, NC);
     this->board_adress = board_address;
     this->prefered_sleep_time = prefered_sleep_time;
     this->packet_array_size = packet_array_size;
 
-    packet_array = (RS485_reader_message*)malloc(sizeof(RS485_reader_message)*packet_array_size);
+    packet_array = (RS485_reader_message*)memoryAlloc(MEMORY_MODULE_RS485, sizeof(RS485_reader_message)*packet_array_size);
+    stats_start_ms = Kernel::get_ms_count();
 
     readThread.start(callback(this, &RS485::read_thread));
-    readThread.set_priority(osPriorityBelowNormal);
 }
 
 RS485::~RS485()
@@ -41,9 +47,15 @@ RS485::~RS485()
     delete re;
     delete te;
     delete de;
+    memoryAccount(MEMORY_MODULE_RS485, -(int32_t)(sizeof(RawSerial) + 3*sizeof(DigitalOut)));
 
-    free(packet_array);
+    memoryFree(packet_array);
     packet_array = NULL;
+    for(uint8_t i = 0; i < nb_block; ++i)
+    {
+        memoryFree(pool_blocks[i]);
+    }
+    nb_block = 0;
 }
 
 uint8_t RS485::read(const uint8_t* cmd_array, const uint8_t nb_command, uint8_t* data_buffer)
@@ -73,15 +85,33 @@ uint8_t RS485::read(const uint8_t* cmd_array, const uint8_t nb_command, uint8_t*
                         data_buffer[x] = packet_array[i].data[x];
                     }
 
+                    TRACE(TRACE_EVENT_RS485_READ, packet_array[i].cmd);
                     event.clear(cmd_flag);
                     return packet_array[i].nb_byte;
                 }
             }
         }
+
+        // the packet was given while no reader was waiting, it is already gone
+        event.clear(cmd_flag);
     }
 }
 
 uint8_t RS485::read(const uint8_t* cmd_array, const uint8_t nb_command, uint8_t& returned_slave, uint8_t* data_buffer)
+{
+    uint8_t returned_cmd;
+
+    return read(cmd_array, nb_command, returned_slave, returned_cmd, data_buffer);
+}
+
+uint8_t RS485::read(const uint8_t* cmd_array, const uint8_t nb_command, uint8_t& returned_slave, uint8_t& returned_cmd, uint8_t* data_buffer)
+{
+    uint64_t timestamp_us;
+
+    return read(cmd_array, nb_command, returned_slave, returned_cmd, timestamp_us, data_buffer);
+}
+
+uint8_t RS485::read(const uint8_t* cmd_array, const uint8_t nb_command, uint8_t& returned_slave, uint8_t& returned_cmd, uint64_t& timestamp_us, uint8_t* data_buffer)
 {
     uint32_t cmd_flag = 0;
 
@@ -108,35 +138,34 @@ uint8_t RS485::read(const uint8_t* cmd_array, const uint8_t nb_command, uint8_t&
                         data_buffer[x] = packet_array[i].data[x];
                     }
                     returned_slave = packet_array[i].slave;
+                    returned_cmd = packet_array[i].cmd;
+                    timestamp_us = packet_array[i].timestamp_us;
 
+                    TRACE(TRACE_EVENT_RS485_READ, packet_array[i].cmd);
                     event.clear(cmd_flag);
                     return packet_array[i].nb_byte;
                 }
             }
         }
+
+        // the packet was given while no reader was waiting, it is already gone
+        event.clear(cmd_flag);
     }
 }
 
 void RS485::write(const uint8_t slave, const uint8_t cmd, const uint8_t nb_byte, const uint8_t* data_buffer)
 {
-    uint16_t checksum = calculateCheckSum(slave, cmd, nb_byte, data_buffer);
+    transmit(slave, cmd, nb_byte, data_buffer, RS485_NO_STAMP);
+}
 
-    writer_mutex.lock();
-    de->write(1);
-    serial_write(0x3A);
-    serial_write(slave);
-    serial_write(cmd);
-    serial_write(nb_byte);
-    for(uint8_t i = 0; i < nb_byte; ++i)
-    {
-        serial_write(data_buffer[i]);
-    }
-    serial_write((uint8_t)(checksum >> 8));
-    serial_write((uint8_t)(checksum & 0xFF));
-    serial_write(0x0D);
-    ThisThread::sleep_for(20);
-    de->write(0);
-    writer_mutex.unlock();
+void RS485::writeStamped(const uint8_t slave, const uint8_t cmd, const uint8_t nb_byte, const uint8_t* data_buffer, const uint8_t stamp_offset)
+{
+    transmit(slave, cmd, nb_byte, data_buffer, stamp_offset);
+}
+
+void RS485::setTimebase(Timebase* timebase)
+{
+    this->timebase = timebase;
 }
 
 uint8_t RS485::getBoardAdress()
@@ -144,21 +173,300 @@ uint8_t RS485::getBoardAdress()
     return board_adress;
 }
 
+void RS485::setBaud(const uint32_t baudrate)
+{
+    writer_mutex.lock();
+    rs485->baud(baudrate);
+    this->baudrate = baudrate;
+    byte_time_ns = RS485_BITS_PER_BYTE*1000000000ULL/baudrate;
+    writer_mutex.unlock();
+}
+
+uint32_t RS485::getBaud()
+{
+    return baudrate;
+}
+
+uint32_t RS485::getLineTime(const uint16_t nb_byte)
+{
+    return (uint32_t)((uint64_t)nb_byte*RS485_BITS_PER_BYTE*1000000/baudrate);
+}
+
+uint32_t RS485::getDeHoldTime()
+{
+    return getLineTime(RS485_DE_HOLD_BYTES);
+}
+
+bool RS485::subscribe(RS485Subscriber* subscriber)
+{
+    uint16_t needed = subscriber->getQueueSize() + 1;
+
+    subscriber_mutex.lock();
+
+    if(nb_subscriber >= RS485_MAX_SUBSCRIBER)
+    {
+        subscriber_mutex.unlock();
+        return false;
+    }
+
+    // the packets left by the subscribers gone are used first
+    pool_mutex.lock();
+    if(pool_reserved + needed > pool_size)
+    {
+        uint16_t nb_packet = pool_reserved + needed - pool_size;
+        RS485_packet* block = (RS485_packet*)memoryAlloc(MEMORY_MODULE_RS485, sizeof(RS485_packet)*nb_packet);
+        if(block == NULL)
+        {
+            pool_mutex.unlock();
+            subscriber_mutex.unlock();
+            return false;
+        }
+
+        pool_blocks[nb_block++] = block;
+        for(uint16_t i = 0; i < nb_packet; ++i)
+        {
+            free_packets[nb_free++] = &block[i];
+        }
+        pool_size += nb_packet;
+    }
+    pool_reserved += needed;
+    pool_mutex.unlock();
+
+    subscribers[nb_subscriber++] = subscriber;
+    subscribed_flag |= subscriber->getCommandFlag();
+
+    subscriber_mutex.unlock();
+    return true;
+}
+
+void RS485::unsubscribe(RS485Subscriber* subscriber)
+{
+    subscriber_mutex.lock();
+
+    uint32_t flag = 0;
+    for(uint8_t i = 0; i < nb_subscriber;)
+    {
+        if(subscribers[i] == subscriber)
+        {
+            subscribers[i] = subscribers[--nb_subscriber];
+
+            pool_mutex.lock();
+            pool_reserved -= subscriber->getQueueSize() + 1;
+            pool_mutex.unlock();
+        }
+        else
+        {
+            flag |= subscribers[i++]->getCommandFlag();
+        }
+    }
+    subscribed_flag = flag;
+
+    subscriber_mutex.unlock();
+}
+
+void RS485::releasePacket(const RS485_packet* packet)
+{
+    // the packets of the subscribers are read only, the pool owns them
+    RS485_packet* shared = const_cast<RS485_packet*>(packet);
+
+    pool_mutex.lock();
+    if(--shared->refcount == 0)
+    {
+        free_packets[nb_free++] = shared;
+    }
+    pool_mutex.unlock();
+}
+
+uint32_t RS485::getPoolEmptyCount()
+{
+    return pool_empty;
+}
+
+void RS485::setFrameObserver(Callback<void(uint8_t, uint8_t, uint8_t)> observer)
+{
+    observer_mutex.lock();
+    frame_observer = observer;
+    observer_mutex.unlock();
+}
+
+void RS485::setEcho(bool echo)
+{
+    echo_mutex.lock();
+    this->echo = echo;
+    echo_count = 0;
+    echo_mutex.unlock();
+}
+
+RS485_stats RS485::getStats()
+{
+    stats_mutex.lock();
+    RS485_stats current = stats;
+    current.rx_time_us = rx_time_ns/1000;
+    current.elapsed_ms = Kernel::get_ms_count() - stats_start_ms;
+    stats_mutex.unlock();
+
+    return current;
+}
+
+float_t RS485::getBusOccupancy()
+{
+    RS485_stats current = getStats();
+
+    if(current.elapsed_ms == 0)
+    {
+        return 0;
+    }
+
+    // the bytes of the other boards at the rate they were received, this board holds the bus for de_time_us
+    float_t busy_ms = (current.de_time_us + current.rx_time_us)/1000.0f;
+
+    return busy_ms < current.elapsed_ms ? busy_ms/current.elapsed_ms : 1.0f;
+}
+
+void RS485::resetStats()
+{
+    stats_mutex.lock();
+    stats.tx_frames = 0;
+    stats.tx_bytes = 0;
+    stats.rx_bytes = 0;
+    stats.rx_frames = 0;
+    stats.rx_errors = 0;
+    stats.rx_rejected = 0;
+    stats.de_time_us = 0;
+    rx_time_ns = 0;
+    stats_start_ms = Kernel::get_ms_count();
+    stats_mutex.unlock();
+}
+
 //###################################################
 //
 // PRIVATE FUNCTION
 //
 //###################################################
 
+const RS485_dispatch& RS485::getDispatch()
+{
+    return RS485_frameDispatch();
+}
+
 uint16_t RS485::calculateCheckSum(const uint8_t slave, const uint8_t cmd, const uint8_t nbByte, const uint8_t* data)
 {
-    uint16_t check = (uint16_t)(0x3A+slave+cmd+nbByte+0x0D);
-    for(uint8_t i = 0; i < nbByte; ++i)
+    return RS485_frameChecksum(slave, cmd, nbByte, data);
+}
+
+void RS485::transmit(const uint8_t slave, const uint8_t cmd, const uint8_t nb_byte, const uint8_t* data_buffer, const uint8_t stamp_offset)
+{
+    uint8_t frame[RS485_FRAME_MAX_SIZE];
+
+    writer_mutex.lock();
+    TRACE_BEGIN(TRACE_EVENT_RS485_TX, (slave << 8) | cmd);
+
+    uint16_t size = RS485_frameEncode(slave, cmd, nb_byte, data_buffer, frame);
+
+    if(stamp_offset != RS485_NO_STAMP)
+    {
+        uint64_t stamp = localTime();
+        uint8_t* data = frame + RS485_FRAME_HEADER;
+
+        for(uint8_t i = 0; i < 8 && stamp_offset + i < nb_byte; ++i)
+        {
+            data[stamp_offset + i] = (uint8_t)(stamp >> (8*i));
+        }
+
+        uint16_t checksum = RS485_frameChecksum(slave, cmd, nb_byte, data);
+        frame[size - 3] = (uint8_t)(checksum >> 8);
+        frame[size - 2] = (uint8_t)(checksum & 0xFF);
+    }
+
+    // the echo is read while the frame is sent, it is known before
+    if(echo)
+    {
+        echo_mutex.lock();
+        if(echo_count == RS485_ECHO_QUEUE)
+        {
+            echo_first = (echo_first + 1) % RS485_ECHO_QUEUE;
+            echo_count--;
+        }
+        RS485_echo_frame* sent = &echo_frames[(echo_first + echo_count++) % RS485_ECHO_QUEUE];
+        sent->slave = slave;
+        sent->cmd = cmd;
+        sent->nb_byte = nb_byte;
+        sent->checksum = (uint16_t)((frame[size - 3] << 8) | frame[size - 2]);
+        sent->sent_ms = (uint32_t)Kernel::get_ms_count();
+        echo_mutex.unlock();
+    }
+
+    de->write(1);
+    for(uint16_t i = 0; i < size; ++i)
     {
-        check += data[i];
+        serial_write(frame[i]);
+    }
+    uint32_t hold_us = getDeHoldTime();
+    wait_us(hold_us);
+    de->write(0);
+
+    stats_mutex.lock();
+    stats.tx_frames++;
+    stats.tx_bytes += size;
+    stats.de_time_us += getLineTime(size) + hold_us;
+    stats_mutex.unlock();
+    TRACE_END(TRACE_EVENT_RS485_TX, (slave << 8) | cmd);
+    writer_mutex.unlock();
+}
+
+uint64_t RS485::localTime()
+{
+    if(timebase)
+    {
+        return timebase->getLocalTime();
+    }
+    return Kernel::get_ms_count()*1000;
+}
+
+void RS485::publish(const RS485_reader_message* message)
+{
+    RS485_packet* packet = NULL;
+
+    subscriber_mutex.lock();
+
+    for(uint8_t i = 0; i < nb_subscriber; ++i)
+    {
+        if(!(subscribers[i]->getCommandFlag() & (1UL << message->cmd)))
+        {
+            continue;
+        }
+
+        pool_mutex.lock();
+        if(packet == NULL)
+        {
+            if(nb_free == 0)
+            {
+                pool_empty++;
+                pool_mutex.unlock();
+                break;
+            }
+
+            // one copy for all the subscribers, our reference keeps it until the last push
+            packet = free_packets[--nb_free];
+            packet->slave = message->slave;
+            packet->cmd = message->cmd;
+            packet->nb_byte = message->nb_byte;
+            memcpy(packet->data, message->data, message->nb_byte);
+            packet->timestamp_us = message->timestamp_us;
+            packet->refcount = 1;
+        }
+        packet->refcount++;
+        pool_mutex.unlock();
+
+        subscribers[i]->push(packet);
     }
 
-    return check;
+    subscriber_mutex.unlock();
+
+    if(packet)
+    {
+        releasePacket(packet);
+    }
 }
 
 void RS485::send_packet()
@@ -169,12 +477,63 @@ void RS485::send_packet()
     packet_count = 0;
 }
 
+void RS485::count_rx(uint32_t* counter)
+{
+    stats_mutex.lock();
+    stats.rx_bytes += rx_bytes_pending;
+    rx_time_ns += rx_time_pending_ns;
+    if(counter)
+    {
+        (*counter)++;
+    }
+    stats_mutex.unlock();
+
+    rx_bytes_pending = 0;
+    rx_time_pending_ns = 0;
+}
+
+bool RS485::skip_echo(const RS485_frame_parser* parser, bool damaged)
+{
+    bool own = false;
+    uint32_t now = (uint32_t)Kernel::get_ms_count();
+
+    echo_mutex.lock();
+
+    // an echo lost on the line would hide the next ones
+    while(echo_count && now - echo_frames[echo_first].sent_ms >= RS485_ECHO_TIMEOUT_MS)
+    {
+        echo_first = (echo_first + 1) % RS485_ECHO_QUEUE;
+        echo_count--;
+    }
+
+    // the checksum of a damaged frame is not the one sent
+    const RS485_echo_frame* first = &echo_frames[echo_first];
+    if(echo_count && first->slave == parser->slave && first->cmd == parser->cmd && first->nb_byte == parser->nb_byte &&
+       (damaged || first->checksum == parser->received))
+    {
+        echo_first = (echo_first + 1) % RS485_ECHO_QUEUE;
+        echo_count--;
+        own = true;
+    }
+
+    echo_mutex.unlock();
+
+    return own;
+}
+
 uint8_t RS485::serial_read()
 {
     while(1)
     {
         if(rs485->readable())
         {
+            // the echo of our own frames is already counted in de_time_us
+            own_byte = de->read();
+            if(!own_byte)
+            {
+                rx_bytes_pending++;
+                rx_time_pending_ns += byte_time_ns;
+            }
             return rs485->getc();
             break;
         }
@@ -184,6 +543,11 @@ uint8_t RS485::serial_read()
             {
                 send_packet();
             }
+            // the bytes of a frame are counted at its end, or when the line is idle
+            if(rx_bytes_pending)
+            {
+                count_rx(NULL);
+            }
         }
     }
 }
@@ -204,36 +568,74 @@ void RS485::serial_write(const uint8_t data)
 
 void RS485::read_thread()
 {
-    uint16_t local_checksum;
+    RS485_frame_parser parser;
+    RS485_frameParserInit(&parser, packet_array[packet_count].data);
 
     while(1)
     {
-        // search for the start byte
-        while(serial_read() != 0x3A);
+        RS485_reader_message* message = &packet_array[packet_count];
+        parser.data = message->data;
+
+        RS485_parse_status status = RS485_frameParse(&parser, serial_read());
+        if(status == RS485_PARSE_START)
+        {
+            TRACE_BEGIN(TRACE_EVENT_RS485_RX, 0);
+        }
+        if(status != RS485_PARSE_FRAME && status != RS485_PARSE_ERROR)
+        {
+            continue;
+        }
 
-        // collect all the information
-        packet_array[packet_count].slave = serial_read();
-        packet_array[packet_count].cmd = serial_read();
-        packet_array[packet_count].nb_byte = serial_read();
+        message->slave = parser.slave;
+        message->cmd = parser.cmd;
+        message->nb_byte = parser.nb_byte;
 
-        for(uint8_t i = 0; i < packet_array[packet_count].nb_byte; ++i)
+        // the time of the first byte, from the time of the last one
+        uint32_t frame_us = getLineTime(message->nb_byte + RS485_FRAME_OVERHEAD);
+        message->timestamp_us = localTime() - frame_us;
+        TRACE_END(TRACE_EVENT_RS485_RX, (message->slave << 8) | message->cmd);
+
+        // DE may be low when the end of our echo is read, the frame is compared with the ones sent
+        bool own_frame = skip_echo(&parser, status == RS485_PARSE_ERROR);
+
+        // validate the frame, the errors tell if the bus is reliable at this rate
+        if(status == RS485_PARSE_ERROR)
         {
-            packet_array[packet_count].data[i] = serial_read();
+            count_rx(&stats.rx_errors);
+            continue;
         }
+        count_rx(&stats.rx_frames);
 
-        local_checksum = (uint16_t)(serial_read()<<8);
-        local_checksum += serial_read();
+        // a frame that doesn't match the registry is dropped, counted for every board to find the firmware that sends it
+        bool registered = RS485_isValidFrame(getDispatch(), parser.slave, parser.cmd, parser.nb_byte);
+        if(!registered)
+        {
+            count_rx(&stats.rx_rejected);
+        }
+
+        if(!own_frame && registered)
+        {
+            observer_mutex.lock();
+            if(frame_observer)
+            {
+                frame_observer(parser.slave, parser.cmd, parser.nb_byte);
+            }
+            observer_mutex.unlock();
+        }
 
         // validate the data
-        if(serial_read() != 0x0D || 
-            (packet_array[packet_count].slave != board_adress && board_adress != SLAVE_STATE_SCREEN) || 
-            calculateCheckSum(packet_array[packet_count].slave, packet_array[packet_count].cmd, packet_array[packet_count].nb_byte, packet_array[packet_count].data) != local_checksum)
+        if(!RS485_frameAccept(board_adress, &parser))
         {
             continue;
         }
 
+        if(subscribed_flag & (1UL << message->cmd))
+        {
+            publish(message);
+        }
+
         // if the packet is good, add the command to the event_flag
-        event_flag = event_flag | (1 << packet_array[packet_count].cmd);
+        event_flag = event_flag | (1 << message->cmd);
 
         packet_count++;
 
@@ -242,4 +644,4 @@ void RS485::read_thread()
             send_packet();
         }
     }
-}
\ No newline at end of file
+}
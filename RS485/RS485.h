@@ -4,6 +4,7 @@
  * 
  * To start the RS485 thread call the RS485::init() before initializing other thread in the main function.
  * To read bytes, use the RS485::read() function the priority of your thread must be higher than osPriorityBelowNormal.
+ * A frame is given to one reader only, to give the frames of a command to several threads use RS485Subscriber.
  * To write bytes, use the RS485::write() function.
  * 
  * @warning never call write and read function inside an interrupt.
@@ -16,6 +17,54 @@
 #include "mbed.h"
 #include "rtos.h"
 
+#include "RS485_registry.h"
+#include "RS485_frame.h"
+#include "Utility/Timebase.h"
+
+#define RS485_BAUDRATE 115200 // rate at power up, see setBaud()
+#define RS485_BITS_PER_BYTE 10 // start, 8 data, stop
+#define RS485_DE_HOLD_BYTES 3  // DE held after the end byte: the data and shift registers of the UART, and one byte of margin
+#define RS485_NO_STAMP 0xFF
+#define RS485_STACK_SIZE OS_STACK_SIZE
+#define RS485_MAX_SUBSCRIBER 8
+#define RS485_SUBSCRIBER_MAX_QUEUE 8
+#define RS485_PACKET_POOL (RS485_MAX_SUBSCRIBER*(RS485_SUBSCRIBER_MAX_QUEUE + 1) + 1) // most packets of the pool, see subscribe()
+#define RS485_ECHO_QUEUE 4        // frames sent whose echo is not read yet, the oldest is forgotten
+#define RS485_ECHO_TIMEOUT_MS 100 // an echo lost on the line is forgotten after it
+
+class RS485Subscriber;
+
+/**
+ * @brief usage of the bus seen by one board
+ * 
+ */
+typedef struct RS485_stats_struct
+{
+    uint32_t tx_frames;
+    uint32_t tx_bytes;
+    uint32_t rx_bytes;   // bytes sent by the other boards, for this board or not
+    uint32_t rx_frames;  // frames with a valid end and checksum, for this board or not
+    uint32_t rx_errors;  // frames with a bad end or checksum
+    uint32_t rx_rejected; // frames with a slave and command missing from the registry or a payload too big
+    uint64_t de_time_us; // time the bus was held by this board
+    uint64_t rx_time_us; // time of the bytes of the other boards on the line
+    uint64_t elapsed_ms;
+} RS485_stats;
+
+/**
+ * @brief one received frame shared by the subscribers, see RS485Subscriber
+ * 
+ */
+typedef struct RS485_packet_struct
+{
+    uint8_t slave;
+    uint8_t cmd;
+    uint8_t nb_byte;
+    uint8_t data[255];
+    uint64_t timestamp_us;
+    uint8_t refcount; // one per queue holding the packet
+} RS485_packet;
+
 /**
  * @brief the main class for RS485
  * 
@@ -32,8 +81,10 @@ class RS485
          * @param prefered_sleep_time the time(in ms) that the writer and reader thread should wait if there's no data to process.
          * @param packet_array_size the number of packet RS485 can process at the same time.
          * @param te_value define if the terminal resistor need to be enabled on this board.
+         * @param stack_size stack size of the reader thread, see memoryReportThread() for the used size
          */
-        RS485(const uint8_t board_adress, const uint32_t prefered_sleep_time = 20, const uint8_t packet_array_size = 5, const uint8_t te_value = 1);
+        RS485(const uint8_t board_adress, const uint32_t prefered_sleep_time = 20, const uint8_t packet_array_size = 5, const uint8_t te_value = 1,
+              const uint32_t stack_size = RS485_STACK_SIZE);
 
         /**
          * @brief Destroy the RS485::RS485 object
@@ -63,6 +114,31 @@ class RS485
          */
         uint8_t read(const uint8_t* cmd_array, const uint8_t nb_command, uint8_t& returned_slave, uint8_t* data_buffer);
 
+        /**
+         * @brief the user function to read on RS485 that also return the slave and the command
+         * 
+         * @param cmd_array an array that contains the command the thread need to receive to wakeup.
+         * @param nb_command the number of command.
+         * @param returned_slave the slave that been returned by the command.
+         * @param returned_cmd the command that been received.
+         * @param data_buffer the buffer where the byte gonna be written. The buffer should be of size 255.
+         * @return uint8_t the number of byte received.
+         */
+        uint8_t read(const uint8_t* cmd_array, const uint8_t nb_command, uint8_t& returned_slave, uint8_t& returned_cmd, uint8_t* data_buffer);
+
+        /**
+         * @brief the user function to read on RS485 that also return the slave, the command and the time of the frame
+         * 
+         * @param cmd_array an array that contains the command the thread need to receive to wakeup.
+         * @param nb_command the number of command.
+         * @param returned_slave the slave that been returned by the command.
+         * @param returned_cmd the command that been received.
+         * @param timestamp_us the local time of the start of the frame on the bus, see setTimebase().
+         * @param data_buffer the buffer where the byte gonna be written. The buffer should be of size 255.
+         * @return uint8_t the number of byte received.
+         */
+        uint8_t read(const uint8_t* cmd_array, const uint8_t nb_command, uint8_t& returned_slave, uint8_t& returned_cmd, uint64_t& timestamp_us, uint8_t* data_buffer);
+
         /**
          * @brief the user function to write on RS485
          * 
@@ -73,12 +149,165 @@ class RS485
          */
         void write(const uint8_t slave, const uint8_t cmd, const uint8_t nb_byte, const uint8_t* data_buffer);
 
+        /**
+         * @brief write on RS485 with the local time of the start of the frame in the payload
+         * 
+         * The time is taken once the bus is acquired, right before the first byte,
+         * and written as 8 bytes little-endian at stamp_offset.
+         * 
+         * @param slave the slave address the message should be send to
+         * @param cmd the cmd to send to the message
+         * @param nb_byte the number of byte to be send
+         * @param data_buffer the buffer of the data to be send, stamp_offset + 8 bytes at least
+         * @param stamp_offset the position of the time in the payload
+         */
+        void writeStamped(const uint8_t slave, const uint8_t cmd, const uint8_t nb_byte, const uint8_t* data_buffer, const uint8_t stamp_offset);
+
+        /**
+         * @brief set the timebase used to stamp the frames
+         * 
+         * Without timebase the frames are stamped with the kernel time.
+         * 
+         * @param timebase the timebase of the board
+         */
+        void setTimebase(Timebase* timebase);
+
         /**
          * @brief getter to have the slave id of the current board
          * 
          * @return the slave id
          */
         uint8_t getBoardAdress();
+
+        /**
+         * @brief change the baud rate of the port
+         * 
+         * Waits for the frame being sent, the frames received during the change are lost.
+         * The DE hold and the times of the frames follow the new rate.
+         * 
+         * @param baudrate the new baud rate
+         */
+        void setBaud(const uint32_t baudrate);
+
+        /**
+         * @brief get the baud rate of the port
+         * 
+         * @return uint32_t the baud rate
+         */
+        uint32_t getBaud();
+
+        /**
+         * @brief get the time of bytes on the line at the current baud rate
+         * 
+         * @param nb_byte the number of bytes, with the RS485_FRAME_OVERHEAD of a frame
+         * @return uint32_t the time in us
+         */
+        uint32_t getLineTime(const uint16_t nb_byte);
+
+        /**
+         * @brief get the time DE is held after the end of a frame, RS485_DE_HOLD_BYTES at the current rate
+         *
+         * RawSerial has no transmission complete flag: the last byte is written when the data register
+         * is free, two bytes may still be in the UART. The third byte is the margin.
+         *
+         * @return uint32_t the time in us
+         */
+        uint32_t getDeHoldTime();
+
+        /**
+         * @brief Get the usage of the bus since the last reset of the statistics
+         * 
+         * @return RS485_stats the statistics
+         */
+        RS485_stats getStats();
+
+        /**
+         * @brief Get the part of the time the bus was busy, sent by this board or received
+         * 
+         * @return float_t the occupancy (0.0 to 1.0)
+         */
+        float_t getBusOccupancy();
+
+        /**
+         * @brief Reset the statistics of the bus
+         * 
+         */
+        void resetStats();
+
+        /**
+         * @brief add a subscriber, it gets its own reference of every packet of its commands
+         * 
+         * Called by RS485Subscriber. The pool grows to the depth of every queue, plus the packet
+         * each subscriber is reading and the new copy of the reader thread: a slow subscriber only
+         * holds its own share and can't starve the others, and a full queue of drop-oldest always
+         * gets the newest frame. The packets stay in the pool after unsubscribe() for the next subscribers.
+         * 
+         * @param subscriber the subscriber
+         * @return true if the subscriber was added, false if there are RS485_MAX_SUBSCRIBER already or the packets can't be allocated
+         */
+        bool subscribe(RS485Subscriber* subscriber);
+
+        /**
+         * @brief remove a subscriber, called by RS485Subscriber
+         * 
+         * @param subscriber the subscriber
+         */
+        void unsubscribe(RS485Subscriber* subscriber);
+
+        /**
+         * @brief give back one reference of a packet, the last one returns it to the pool
+         * 
+         * @param packet the packet
+         */
+        void releasePacket(const RS485_packet* packet);
+
+        /**
+         * @brief Get the number of packets not given to the subscribers because the pool was empty
+         * 
+         * @return uint32_t the number of packets
+         */
+        uint32_t getPoolEmptyCount();
+
+        /**
+         * @brief set the observer of the frames of the other boards
+         * 
+         * Called by the reader thread with every valid frame sent by another board, for this board
+         * or not, before the frame is dispatched. A frame read that matches the oldest frame sent
+         * is our echo, it is not given, see setEcho().
+         * It holds the reader thread, it must be short and must not write on the bus.
+         * The previous observer is not called anymore once this returns.
+         * 
+         * @param observer called with the slave, the command and the size of the frame
+         */
+        void setFrameObserver(Callback<void(uint8_t, uint8_t, uint8_t)> observer);
+
+        /**
+         * @brief tell if the transceiver gives back the frames of this board
+         * 
+         * The receiver of the board is always enabled (RE low), the default is true.
+         * Without echo a response identical to its request (ex: CMD_IS_ALIVE) would be taken for the echo.
+         * 
+         * @param echo true if the frames sent are read back
+         */
+        void setEcho(bool echo);
+
+        /**
+         * @brief calculate the checksum of a frame
+         * 
+         * @param slave the address of the frame
+         * @param cmd the command of the frame
+         * @param nbByte the number of data bytes
+         * @param data the data
+         * @return uint16_t the checksum
+         */
+        static uint16_t calculateCheckSum(const uint8_t slave, const uint8_t cmd, const uint8_t nbByte, const uint8_t* data);
+
+        /**
+         * @brief Get the dispatch table built at compile time from RS485_COMMANDS
+         * 
+         * @return const RS485_dispatch& the dispatch table
+         */
+        static const RS485_dispatch& getDispatch();
     
     private:
 
@@ -92,6 +321,7 @@ class RS485
             uint8_t cmd;
             uint8_t nb_byte;
             uint8_t data[255];
+            uint64_t timestamp_us;
         } RS485_reader_message;
 
         uint8_t packet_array_size;
@@ -109,21 +339,83 @@ class RS485
         uint32_t event_flag = 0;
         uint8_t board_adress;
         uint32_t sleep_time;
+        volatile uint32_t baudrate = RS485_BAUDRATE;
+        volatile uint32_t byte_time_ns = RS485_BITS_PER_BYTE*1000000000ULL/RS485_BAUDRATE;
 
         Mutex writer_mutex;
 
+        Timebase* timebase = NULL;
+
+        // every counter of stats and rx_time_ns is changed and read under stats_mutex, never held during a transfer
+        Mutex stats_mutex;
+        RS485_stats stats = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+        uint64_t stats_start_ms = 0;
+        uint64_t rx_time_ns = 0;
+        uint32_t rx_bytes_pending = 0;   // bytes not counted in stats yet, reader thread only
+        uint64_t rx_time_pending_ns = 0; // time of these bytes
+
         RS485_reader_message* packet_array = NULL;
 
+        RS485Subscriber* subscribers[RS485_MAX_SUBSCRIBER];
+        uint8_t nb_subscriber = 0;
+        volatile uint32_t subscribed_flag = 0; // commands of all the subscribers
+        Mutex subscriber_mutex;
+        Mutex pool_mutex;
+        RS485_packet* pool_blocks[RS485_PACKET_POOL]; // one allocation per growth of the pool, one packet at least
+        uint8_t nb_block = 0;
+        uint16_t pool_size = 0;     // packets allocated
+        uint16_t pool_reserved = 1; // packets needed by the subscribers, and the copy of the reader thread
+        RS485_packet* free_packets[RS485_PACKET_POOL];
+        uint16_t nb_free = 0;
+        uint32_t pool_empty = 0;
+
+        /**
+         * @brief a frame sent, to recognize its echo
+         * 
+         */
+        typedef struct RS485_echo_frame_struct
+        {
+            uint8_t slave;
+            uint8_t cmd;
+            uint8_t nb_byte;
+            uint16_t checksum;
+            uint32_t sent_ms;
+        } RS485_echo_frame;
+
+        Callback<void(uint8_t, uint8_t, uint8_t)> frame_observer;
+        Mutex observer_mutex; // held by the reader thread during the call of the observer
+        bool own_byte = false; // DE was high when the last byte was read, for the statistics only
+
+        volatile bool echo = true;
+        Mutex echo_mutex;
+        RS485_echo_frame echo_frames[RS485_ECHO_QUEUE]; // ring of the frames sent, oldest first
+        uint8_t echo_first = 0;
+        uint8_t echo_count = 0;
+
+        /**
+         * @brief send one frame
+         * 
+         * @param slave the slave address
+         * @param cmd the command
+         * @param nb_byte the number of byte of the payload
+         * @param data_buffer the payload
+         * @param stamp_offset the position of the local time in the payload, RS485_NO_STAMP for none
+         */
+        void transmit(const uint8_t slave, const uint8_t cmd, const uint8_t nb_byte, const uint8_t* data_buffer, const uint8_t stamp_offset);
+
+        /**
+         * @brief get the local time used to stamp the frames
+         * 
+         * @return uint64_t the time in us
+         */
+        uint64_t localTime();
+
         /**
-         * @brief calculate the checksum 
+         * @brief give a received frame to its subscribers, one packet for all of them
          * 
-         * @param slave 
-         * @param cmd 
-         * @param nbByte 
-         * @param data 
-         * @return uint16_t 
+         * @param message the frame
          */
-        uint16_t calculateCheckSum(const uint8_t slave, const uint8_t cmd, const uint8_t nbByte, const uint8_t* data);
+        void publish(const RS485_reader_message* message);
 
         /**
          * @brief function that wakeup the thread waiting for a packet
@@ -131,6 +423,22 @@ class RS485
          */
         void send_packet();
 
+        /**
+         * @brief add the bytes received since the last call to the statistics, from the reader thread
+         * 
+         * @param counter a counter of stats to increment with them, NULL for none
+         */
+        void count_rx(uint32_t* counter);
+
+        /**
+         * @brief check if a parsed frame is the echo of the oldest frame sent, and forget it
+         * 
+         * @param parser the parser with the frame
+         * @param damaged true if the frame has a bad end or checksum, its checksum is not compared
+         * @return true if the frame is our echo
+         */
+        bool skip_echo(const RS485_frame_parser* parser, bool damaged);
+
         /**
          * @brief a blocking call that wait for a byte to be read
          * 
@@ -0,0 +1,363 @@
+/**
+ * @file RS485Baud.cpp
+ * @brief RS485Baud class source file
+ *
+ */
+
+#include "RS485Baud.h"
+
+#include "RS485_definition.h"
+
+const uint32_t RS485Baud::rates[RS485_BAUD_NB_RATE] = RS485_BAUD_RATES;
+
+RS485Baud::RS485Baud(RS485* rs, bool master, uint8_t supported_mask, osPriority thread_priority)
+    : readerThread(thread_priority, OS_STACK_SIZE, NULL, "baud"), monitorThread(thread_priority, OS_STACK_SIZE, NULL, "baud_mon")
+{
+    this->rs = rs;
+    this->master = master;
+    this->supported_mask = supported_mask | RS485_BAUD_MASK_BASE;
+
+    memset(reply_mask, RS485_BAUD_MASK_BASE, sizeof(reply_mask));
+
+    uint8_t cmd_array[1] = {CMD_BAUD};
+    subscriber = new RS485Subscriber(rs, cmd_array, 1);
+
+    if(master)
+    {
+        readerThread.start(callback(this, &RS485Baud::master_thread));
+    }
+    else
+    {
+        readerThread.start(callback(this, &RS485Baud::slave_thread));
+    }
+    monitorThread.start(callback(this, &RS485Baud::monitor_thread));
+}
+
+RS485Baud::~RS485Baud()
+{
+    // not cleared by the waits, both threads see it
+    subscriber->cancel();
+    stop_event.set(RS485_BAUD_STOP_FLAG);
+    readerThread.join();
+    monitorThread.join();
+    delete subscriber;
+
+    if(confirm_pending)
+    {
+        setRate(confirm_previous);
+    }
+}
+
+bool RS485Baud::negotiate(const uint8_t* slaves, uint8_t nb_slave)
+{
+    baud_mutex.lock();
+
+    this->nb_slave = nb_slave < RS485_MAX_SLAVE ? nb_slave : RS485_MAX_SLAVE;
+    memcpy(this->slaves, slaves, this->nb_slave);
+
+    uint8_t mask;
+    bool found = true;
+    for(uint8_t i = 0; i < this->nb_slave; ++i)
+    {
+        found = query(this->slaves[i], mask) && found;
+    }
+
+    // a slave restarted or gave up on the bus, it listens at the base rate
+    if(!found && current != 0)
+    {
+        sendSwitch(current, 0);
+        found = true;
+        for(uint8_t i = 0; i < this->nb_slave; ++i)
+        {
+            found = query(this->slaves[i], mask) && found;
+        }
+    }
+
+    // a slave missing at the base rate would not hear the switch
+    if(!found)
+    {
+        baud_mutex.unlock();
+        return false;
+    }
+
+    uint8_t target = highest(commonMask());
+    bool success = target == current || switchTo(target);
+
+    baud_mutex.unlock();
+    return success;
+}
+
+bool RS485Baud::query(uint8_t slave, uint8_t& supported_mask)
+{
+    uint8_t request[RS485_BAUD_REQUEST_SIZE] = {RS485_BAUD_OP_QUERY, 0, 0, 0};
+    uint32_t flag = 1UL << slave;
+
+    for(uint8_t i = 0; i < RS485_BAUD_RETRY; ++i)
+    {
+        reply_event.clear(flag);
+        rs->write(slave, CMD_BAUD, RS485_BAUD_REQUEST_SIZE, request);
+
+        if(!(reply_event.wait_any(flag, RS485_BAUD_REPLY_MS) & osFlagsError))
+        {
+            supported_mask = reply_mask[slave];
+            return true;
+        }
+    }
+    return false;
+}
+
+RS485_baud_stats RS485Baud::getStats()
+{
+    baud_mutex.lock();
+    RS485_baud_stats copy = stats;
+    baud_mutex.unlock();
+
+    return copy;
+}
+
+void RS485Baud::setRate(uint8_t index)
+{
+    rs->setBaud(rates[index]);
+    current = index;
+    stats.switches++;
+}
+
+void RS485Baud::sendSwitch(uint8_t from, uint8_t to)
+{
+    uint8_t request[RS485_BAUD_REQUEST_SIZE] = {RS485_BAUD_OP_SWITCH, to, RS485_BAUD_SWITCH_DELAY_MS & 0xFF, RS485_BAUD_SWITCH_DELAY_MS >> 8};
+
+    if(current != from)
+    {
+        setRate(from);
+    }
+    rs->write(SLAVE_BROADCAST, CMD_BAUD, RS485_BAUD_REQUEST_SIZE, request);
+
+    // the slaves wait the same delay from the end of the frame
+    ThisThread::sleep_for(RS485_BAUD_SWITCH_DELAY_MS);
+    setRate(to);
+    ThisThread::sleep_for(RS485_BAUD_SETTLE_MS);
+}
+
+bool RS485Baud::switchTo(uint8_t index)
+{
+    uint8_t previous = current;
+    uint8_t mask;
+
+    sendSwitch(current, index);
+
+    for(uint8_t i = 0; i < nb_slave; ++i)
+    {
+        if(!query(slaves[i], mask))
+        {
+            stats.failed++;
+            excluded_mask |= (uint8_t)(0xFF << index);
+            excluded_ms = Kernel::get_ms_count();
+
+            // back to the base rate, from the new rate and from the previous one for the slaves that missed the switch
+            sendSwitch(index, 0);
+            if(previous != 0)
+            {
+                sendSwitch(previous, 0);
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+uint8_t RS485Baud::commonMask()
+{
+    uint8_t mask = supported_mask & ~excluded_mask;
+
+    for(uint8_t i = 0; i < nb_slave; ++i)
+    {
+        mask &= reply_mask[slaves[i]];
+    }
+    return mask | RS485_BAUD_MASK_BASE;
+}
+
+uint8_t RS485Baud::highest(uint8_t mask)
+{
+    uint8_t index = 0;
+
+    for(uint8_t i = 0; i < RS485_BAUD_NB_RATE; ++i)
+    {
+        if(mask & (1 << i))
+        {
+            index = i;
+        }
+    }
+    return index;
+}
+
+void RS485Baud::master_thread()
+{
+    while(1)
+    {
+        // NULL once canceled by the destructor, or never subscribed
+        const RS485_packet* packet = subscriber->read();
+        if(packet == NULL)
+        {
+            return;
+        }
+
+        // the requests of the master come back on its own port
+        uint8_t slave = packet->slave;
+        if(packet->nb_byte == RS485_BAUD_REPLY_SIZE && packet->data[0] == RS485_BAUD_OP_QUERY && slave < RS485_MAX_SLAVE)
+        {
+            reply_mask[slave] = packet->data[1] | RS485_BAUD_MASK_BASE;
+            reply_event.set(1UL << slave);
+        }
+
+        subscriber->release(packet);
+    }
+}
+
+void RS485Baud::slave_thread()
+{
+    uint8_t buffer[RS485_BAUD_REQUEST_SIZE];
+    uint8_t reply[RS485_BAUD_REPLY_SIZE];
+
+    while(1)
+    {
+        const RS485_packet* packet = subscriber->read();
+        if(packet == NULL)
+        {
+            return;
+        }
+
+        uint8_t slave = packet->slave;
+        uint8_t nb_byte = packet->nb_byte;
+        memcpy(buffer, packet->data, nb_byte < RS485_BAUD_REQUEST_SIZE ? nb_byte : RS485_BAUD_REQUEST_SIZE);
+        subscriber->release(packet);
+
+        if(nb_byte != RS485_BAUD_REQUEST_SIZE)
+        {
+            continue;
+        }
+
+        // any request proves the master hears this board at its rate
+        baud_mutex.lock();
+        request_ms = Kernel::get_ms_count();
+        confirm_pending = false;
+        baud_mutex.unlock();
+
+        if(buffer[0] == RS485_BAUD_OP_QUERY && slave == rs->getBoardAdress())
+        {
+            reply[0] = RS485_BAUD_OP_QUERY;
+            reply[1] = supported_mask;
+            reply[2] = current;
+            rs->write(rs->getBoardAdress(), CMD_BAUD, RS485_BAUD_REPLY_SIZE, reply);
+        }
+        else if(buffer[0] == RS485_BAUD_OP_SWITCH && slave == SLAVE_BROADCAST)
+        {
+            uint8_t index = buffer[1];
+            if(index >= RS485_BAUD_NB_RATE || !(supported_mask & (1 << index)) || index == current)
+            {
+                continue;
+            }
+
+            // the switch is not done when the object goes away during its delay
+            uint32_t flags = stop_event.wait_any(RS485_BAUD_STOP_FLAG, buffer[2] | (buffer[3] << 8), false);
+            if(!(flags & osFlagsError) && (flags & RS485_BAUD_STOP_FLAG))
+            {
+                return;
+            }
+
+            baud_mutex.lock();
+            uint8_t previous = current;
+            setRate(index);
+
+            // the base rate is always kept, the others wait for a request
+            confirm_pending = index != 0;
+            confirm_previous = previous;
+            confirm_ms = Kernel::get_ms_count();
+            baud_mutex.unlock();
+        }
+    }
+}
+
+void RS485Baud::monitor_thread()
+{
+    uint8_t keep[RS485_BAUD_REQUEST_SIZE] = {RS485_BAUD_OP_KEEP, 0, 0, 0};
+    RS485_stats last = rs->getStats();
+    request_ms = Kernel::get_ms_count();
+
+    while(1)
+    {
+        uint32_t flags = stop_event.wait_any(RS485_BAUD_STOP_FLAG, master ? RS485_BAUD_CHECK_MS : RS485_BAUD_POLL_MS, false);
+        if(!(flags & osFlagsError) && (flags & RS485_BAUD_STOP_FLAG))
+        {
+            return;
+        }
+
+        uint64_t now = Kernel::get_ms_count();
+
+        baud_mutex.lock();
+
+        if(master)
+        {
+            RS485_stats now_stats = rs->getStats();
+
+            // the statistics were reset
+            if(now_stats.rx_frames < last.rx_frames || now_stats.rx_errors < last.rx_errors)
+            {
+                last = now_stats;
+            }
+            uint32_t frames = now_stats.rx_frames - last.rx_frames;
+            uint32_t errors = now_stats.rx_errors - last.rx_errors;
+            last = now_stats;
+
+            if(excluded_mask && now - excluded_ms >= RS485_BAUD_EXCLUDE_MS)
+            {
+                excluded_mask = 0;
+                step_up = true;
+            }
+
+            if(current != 0 && frames + errors >= RS485_BAUD_MIN_FRAMES && errors*100 > (frames + errors)*RS485_BAUD_MAX_ERROR_PERCENT)
+            {
+                stats.step_downs++;
+                excluded_mask |= (uint8_t)(0xFF << current);
+                excluded_ms = now;
+                switchTo(highest(commonMask() & ((1 << current) - 1)));
+
+                // the errors of the switch are not the ones of the new rate
+                last = rs->getStats();
+            }
+            else if(step_up)
+            {
+                // a failed switch excludes the rate again, it is tried at the end of the next exclusion
+                step_up = false;
+                uint8_t target = highest(commonMask());
+                if(nb_slave && target > current)
+                {
+                    stats.step_ups++;
+                    switchTo(target);
+                    last = rs->getStats();
+                }
+            }
+            else if(current != 0)
+            {
+                rs->write(SLAVE_BROADCAST, CMD_BAUD, RS485_BAUD_REQUEST_SIZE, keep);
+            }
+        }
+        else
+        {
+            if(confirm_pending && now - confirm_ms >= RS485_BAUD_CONFIRM_MS)
+            {
+                stats.failed++;
+                confirm_pending = false;
+                setRate(confirm_previous);
+                request_ms = now;
+            }
+            else if(current != 0 && now - request_ms >= RS485_BAUD_SILENCE_MS)
+            {
+                stats.silences++;
+                setRate(0);
+                request_ms = now;
+            }
+        }
+
+        baud_mutex.unlock();
+    }
+}
@@ -0,0 +1,214 @@
+/**
+ * @file RS485Baud.h
+ * @brief Negotiation of the baud rate of the bus by the master
+ *
+ * Every board starts at RS485_BAUDRATE. The master asks each slave the rates it supports
+ * (a mask of the rates of RS485Baud::rates), picks the highest rate common to all of them
+ * and broadcasts the switch with a delay, so every board changes its port at the same time.
+ * The master then asks each slave again at the new rate: a slave that does not answer sends
+ * the whole bus back to RS485_BAUDRATE.
+ *
+ * The fallbacks:
+ * - master: when the frames received with a bad end or checksum go over RS485_BAUD_MAX_ERROR_PERCENT
+ *   the bus steps down to the next lower common rate, the failed rate is not used again for
+ *   RS485_BAUD_EXCLUDE_MS. When the exclusion ends the master tries the highest common rate again,
+ *   the same way a failed switch is retried, so the bus goes back up once the noise is gone.
+ * - slave: a switch not followed by a request of the master within RS485_BAUD_CONFIRM_MS is undone,
+ *   and a slave that hears no request for RS485_BAUD_SILENCE_MS goes back to RS485_BAUDRATE,
+ *   where the master finds it at its next negotiate(). Away from the base rate the master broadcasts
+ *   a keep request every RS485_BAUD_CHECK_MS, the frames of the other slaves do not count:
+ *   slaves that missed a switch together still hear each other.
+ *
+ * The DE hold and the timeouts of RS485 and RS485Reliable follow the current rate.
+ * A master of the Linux computer on the same bus (RS485LinuxMaster) is not a slave of the negotiation,
+ * it follows the switches and the fallback to the base rate with followBaud(). Its adapter is not
+ * asked, it must support the rates common to the slaves.
+ *
+ * @warning frames sent by the other threads while the bus switches are lost.
+ *
+ */
+
+#ifndef RS485_BAUD_H
+#define RS485_BAUD_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "RS485.h"
+#include "RS485Subscriber.h"
+#include "RS485_definition.h"
+
+#define RS485_BAUD_MASK_BASE 0x01       // RS485_BAUDRATE, supported by every board
+#define RS485_BAUD_SWITCH_DELAY_MS 10   // from the end of the switch broadcast to the change of rate
+#define RS485_BAUD_SETTLE_MS 2
+#define RS485_BAUD_REPLY_MS 50
+#define RS485_BAUD_RETRY 3
+#define RS485_BAUD_CHECK_MS 500         // master, period of the error rate
+#define RS485_BAUD_POLL_MS 100          // slave, period of the confirmation and silence checks
+#define RS485_BAUD_MIN_FRAMES 10        // frames of a check period before the error rate counts
+#define RS485_BAUD_MAX_ERROR_PERCENT 10
+#define RS485_BAUD_EXCLUDE_MS 60000
+#define RS485_BAUD_CONFIRM_MS 500
+#define RS485_BAUD_STOP_FLAG 0x1
+
+/**
+ * @brief counters of the negotiation
+ *
+ */
+typedef struct RS485_baud_stats_struct
+{
+    uint32_t switches;   // changes of rate of this board
+    uint32_t step_downs; // master: error rate over the limit
+    uint32_t step_ups;   // master: higher rate tried again at the end of an exclusion
+    uint32_t failed;     // master: a slave lost after a switch, slave: a switch not confirmed
+    uint32_t silences;   // slave: back to RS485_BAUDRATE after RS485_BAUD_SILENCE_MS
+} RS485_baud_stats;
+
+/**
+ * @brief baud rate negotiation over RS485, master or slave
+ *
+ */
+class RS485Baud
+{
+    public:
+
+        /**
+         * @brief the rates of the masks, from the lowest
+         *
+         */
+        static const uint32_t rates[RS485_BAUD_NB_RATE];
+
+        /**
+         * @brief RS485Baud constructor, the threads start right away
+         *
+         * @param rs the RS485 of the board
+         * @param master true on the bus master
+         * @param supported_mask the rates the transceiver and the UART of this board support, bit i for rates[i]
+         * @param thread_priority priority of the threads, higher than osPriorityBelowNormal
+         */
+        RS485Baud(RS485* rs, bool master, uint8_t supported_mask = RS485_BAUD_MASK_BASE, osPriority thread_priority = osPriorityAboveNormal);
+
+        /**
+         * @brief Destroy the RS485Baud object, the threads are joined
+         *
+         * A switch in progress ends first. On a slave a switch not confirmed yet is undone,
+         * nothing would undo it later.
+         *
+         */
+        ~RS485Baud();
+
+        /**
+         * @brief Move the bus to the highest rate supported by the master and all the slaves, master only
+         *
+         * A slave that does not answer at the current rate is searched at RS485_BAUDRATE.
+         * The slaves are checked by the step downs after errors.
+         *
+         * @param slaves the addresses of the slaves on the bus
+         * @param nb_slave the number of slaves
+         * @return true if every slave answered at the rate of the bus
+         */
+        bool negotiate(const uint8_t* slaves, uint8_t nb_slave);
+
+        /**
+         * @brief Ask a slave the rates it supports, master only
+         *
+         * @param slave the address of the slave
+         * @param supported_mask the rates of the slave
+         * @return true if the slave answered
+         */
+        bool query(uint8_t slave, uint8_t& supported_mask);
+
+        /**
+         * @brief Get the counters of the negotiation
+         *
+         * @return RS485_baud_stats the counters
+         */
+        RS485_baud_stats getStats();
+
+    private:
+
+        RS485* rs;
+        bool master;
+        uint8_t supported_mask;
+        uint8_t current = 0;
+
+        RS485Subscriber* subscriber;
+        Thread readerThread;
+        Thread monitorThread;
+        Mutex baud_mutex;
+        EventFlags reply_event;
+        EventFlags stop_event;
+
+        uint8_t reply_mask[RS485_MAX_SLAVE];
+        uint8_t slaves[RS485_MAX_SLAVE];
+        uint8_t nb_slave = 0;
+        uint8_t excluded_mask = 0;
+        uint64_t excluded_ms = 0;
+        bool step_up = false; // the exclusion ended, the rates above the current one are tried again
+
+        // slave: switch waiting for a request of the master at the new rate
+        bool confirm_pending = false;
+        uint8_t confirm_previous = 0;
+        uint64_t confirm_ms = 0;
+        uint64_t request_ms = 0;
+
+        RS485_baud_stats stats = {0, 0, 0, 0, 0};
+
+        /**
+         * @brief change the rate of this board
+         *
+         * @param index the rate, in rates
+         */
+        void setRate(uint8_t index);
+
+        /**
+         * @brief broadcast a switch and change the rate of the master with the slaves
+         *
+         * @param from the rate the broadcast is sent at
+         * @param to the new rate
+         */
+        void sendSwitch(uint8_t from, uint8_t to);
+
+        /**
+         * @brief switch the bus and check the slaves at the new rate, back to RS485_BAUDRATE if one is lost
+         *
+         * @param index the new rate
+         * @return true if every slave answered at the new rate
+         */
+        bool switchTo(uint8_t index);
+
+        /**
+         * @brief the rates the bus can use, the masks of the slaves and the exclusions
+         *
+         * @return uint8_t the mask of the rates
+         */
+        uint8_t commonMask();
+
+        /**
+         * @brief the highest rate of a mask
+         *
+         * @param mask the mask of the rates
+         * @return uint8_t the rate, in rates
+         */
+        static uint8_t highest(uint8_t mask);
+
+        /**
+         * @brief thread of the master, collects the answers of the slaves
+         *
+         */
+        void master_thread();
+
+        /**
+         * @brief thread of the slave, answers the queries and switches
+         *
+         */
+        void slave_thread();
+
+        /**
+         * @brief thread of the fallbacks, error rate on the master, confirmation and silence on a slave
+         *
+         */
+        void monitor_thread();
+};
+
+#endif
@@ -0,0 +1,212 @@
+/**
+ * @file RS485Liveness.cpp
+ * @brief RS485Liveness class source file
+ *
+ */
+
+#include "RS485Liveness.h"
+
+#include "RS485_definition.h"
+
+RS485Liveness::RS485Liveness(RS485* rs, uint16_t slaves_mask, uint32_t stale_ms, uint32_t dead_ms, osPriority thread_priority)
+    : monitorThread(thread_priority, OS_STACK_SIZE, NULL, "liveness")
+{
+    this->rs = rs;
+    this->slaves_mask = slaves_mask;
+
+    // the slaves get half their stale time before the first ping
+    uint32_t now = (uint32_t)Kernel::get_ms_count();
+    for(uint8_t i = 0; i < RS485_MAX_SLAVE; ++i)
+    {
+        last_seen_ms[i] = now;
+        this->stale_ms[i] = stale_ms;
+        this->dead_ms[i] = dead_ms;
+        ping_ms[i] = now;
+        state[i] = RS485_LIVENESS_UNKNOWN;
+        request_cmd[i] = RS485_LIVENESS_NO_REQUEST;
+        request_ms[i] = now;
+        foreign_ms[i] = now - RS485_LIVENESS_PING_MS;
+    }
+
+    rs->setFrameObserver(callback(this, &RS485Liveness::observe));
+    monitorThread.start(callback(this, &RS485Liveness::monitor_thread));
+}
+
+RS485Liveness::~RS485Liveness()
+{
+    rs->setFrameObserver(Callback<void(uint8_t, uint8_t, uint8_t)>());
+    wake_event.set(RS485_LIVENESS_STOP_FLAG);
+    monitorThread.join();
+}
+
+void RS485Liveness::setThreshold(uint8_t slave, uint32_t stale_ms, uint32_t dead_ms)
+{
+    if(slave >= RS485_MAX_SLAVE)
+    {
+        return;
+    }
+
+    liveness_mutex.lock();
+    this->stale_ms[slave] = stale_ms;
+    this->dead_ms[slave] = dead_ms;
+    liveness_mutex.unlock();
+}
+
+void RS485Liveness::onChange(Callback<void(uint8_t, uint8_t)> callback)
+{
+    liveness_mutex.lock();
+    change_callback = callback;
+    liveness_mutex.unlock();
+}
+
+uint8_t RS485Liveness::getState(uint8_t slave)
+{
+    return slave < RS485_MAX_SLAVE ? state[slave] : RS485_LIVENESS_UNKNOWN;
+}
+
+uint32_t RS485Liveness::getAge(uint8_t slave)
+{
+    if(slave >= RS485_MAX_SLAVE || !(seen_mask & SLAVE_MASK(slave)))
+    {
+        return UINT32_MAX;
+    }
+
+    return (uint32_t)Kernel::get_ms_count() - last_seen_ms[slave];
+}
+
+RS485_liveness_stats RS485Liveness::getStats()
+{
+    liveness_mutex.lock();
+    RS485_liveness_stats current = stats;
+    current.heartbeats = heartbeats;
+    liveness_mutex.unlock();
+
+    return current;
+}
+
+//###################################################
+//
+// PRIVATE FUNCTION
+//
+//###################################################
+
+void RS485Liveness::observe(uint8_t slave, uint8_t cmd, uint8_t nb_byte)
+{
+    if(slave >= RS485_MAX_SLAVE || !(slaves_mask & SLAVE_MASK(slave)))
+    {
+        return;
+    }
+
+    uint32_t now = (uint32_t)Kernel::get_ms_count();
+
+    // a frame that fits the request may be sent to the slave: it is the response of the request before it, or a request
+    if(RS485_fitsRequest(RS485::getDispatch(), slave, cmd, nb_byte))
+    {
+        liveness_mutex.lock();
+        bool response = request_cmd[slave] == cmd && now - request_ms[slave] < RS485_LIVENESS_REPLY_MS;
+        request_cmd[slave] = response ? RS485_LIVENESS_NO_REQUEST : cmd;
+        request_ms[slave] = now;
+        if(!response)
+        {
+            foreign_ms[slave] = now;
+        }
+        liveness_mutex.unlock();
+
+        if(!response)
+        {
+            return;
+        }
+    }
+
+    last_seen_ms[slave] = now;
+    seen_mask |= SLAVE_MASK(slave);
+    heartbeats++;
+
+    if(state[slave] != RS485_LIVENESS_ALIVE)
+    {
+        wake_event.set(RS485_LIVENESS_FLAG);
+    }
+}
+
+void RS485Liveness::monitor_thread()
+{
+    uint8_t changed[RS485_MAX_SLAVE];
+    uint8_t changed_state[RS485_MAX_SLAVE];
+
+    while(1)
+    {
+        uint32_t flags = wake_event.wait_any(RS485_LIVENESS_FLAG | RS485_LIVENESS_STOP_FLAG, RS485_LIVENESS_CHECK_MS);
+        if(!(flags & osFlagsError) && (flags & RS485_LIVENESS_STOP_FLAG))
+        {
+            return;
+        }
+
+        uint16_t ping_mask = 0;
+        uint8_t nb_changed = 0;
+
+        liveness_mutex.lock();
+        uint32_t now = (uint32_t)Kernel::get_ms_count();
+
+        for(uint8_t i = 0; i < RS485_MAX_SLAVE; ++i)
+        {
+            if(!(slaves_mask & SLAVE_MASK(i)))
+            {
+                continue;
+            }
+
+            // wraps with the time, the ages are short
+            uint32_t age = now - last_seen_ms[i];
+            uint8_t next;
+            if(age < stale_ms[i])
+            {
+                next = seen_mask & SLAVE_MASK(i) ? RS485_LIVENESS_ALIVE : RS485_LIVENESS_UNKNOWN;
+            }
+            else if(age < dead_ms[i])
+            {
+                next = RS485_LIVENESS_QUIET;
+            }
+            else
+            {
+                next = RS485_LIVENESS_DEAD;
+            }
+
+            // only the quiet slaves are pinged, from half their stale time: a slave that answers is never stale.
+            // a slave polled by another master is not: its answer is a heartbeat, and a request seen just after
+            // our ping would be taken for the answer
+            if(age >= stale_ms[i]/2 && now - ping_ms[i] >= (next == RS485_LIVENESS_DEAD ? RS485_LIVENESS_DEAD_PING_MS : RS485_LIVENESS_PING_MS) &&
+               now - foreign_ms[i] >= RS485_LIVENESS_PING_MS)
+            {
+                ping_mask |= SLAVE_MASK(i);
+                ping_ms[i] = now;
+                // the echo of the ping is not observed, its answer is expected from now
+                request_cmd[i] = CMD_IS_ALIVE;
+                request_ms[i] = now;
+                stats.pings++;
+            }
+
+            if(next != state[i])
+            {
+                state[i] = next;
+                stats.changes++;
+                changed[nb_changed] = i;
+                changed_state[nb_changed++] = next;
+            }
+        }
+
+        Callback<void(uint8_t, uint8_t)> on_change = change_callback;
+        liveness_mutex.unlock();
+
+        // the writes wait for the bus and the callback may call back in, nothing is locked
+        for(uint8_t i = 0; i < RS485_MAX_SLAVE; ++i)
+        {
+            if(ping_mask & SLAVE_MASK(i))
+            {
+                rs->write(i, CMD_IS_ALIVE, 0, NULL);
+            }
+        }
+        for(uint8_t i = 0; i < nb_changed && on_change; ++i)
+        {
+            on_change(changed[i], changed_state[i]);
+        }
+    }
+}
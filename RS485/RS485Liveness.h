@@ -0,0 +1,168 @@
+/**
+ * @file RS485Liveness.h
+ * @brief Liveness of the slaves seen by the master, from the frames they already send
+ *
+ * Every valid frame sent by a slave is a heartbeat: the frame observer of RS485 writes the time
+ * in a table indexed by the address, nothing else is done in the reader thread.
+ * A frame bigger than the request of its command comes from the slave (telemetry or response).
+ * A smaller one may be a request of another master (ex: the Linux master): it is a heartbeat only
+ * when it follows a request of the same command within RS485_LIVENESS_REPLY_MS, or one of our pings.
+ * A slave polled by another master is not pinged.
+ * The monitor thread checks the table every RS485_LIVENESS_CHECK_MS. A slave without frame for
+ * half its stale time is pinged with CMD_IS_ALIVE (answered by isAliveThread()) every
+ * RS485_LIVENESS_PING_MS, so a slave without telemetry that answers never goes quiet.
+ * After its dead time it is pinged every RS485_LIVENESS_DEAD_PING_MS only, so it is found
+ * when it comes back. A slave that sends telemetry more often is never pinged.
+ *
+ * The state changes are given to the callback by the monitor thread, a frame of a quiet
+ * or dead slave wakes it up right away.
+ *
+ * The observer sees the frames for every board, the echo of our own frames is not given to it.
+ *
+ */
+
+#ifndef RS485_LIVENESS_H
+#define RS485_LIVENESS_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "RS485.h"
+
+#define RS485_LIVENESS_UNKNOWN 0 // no frame yet
+#define RS485_LIVENESS_ALIVE 1
+#define RS485_LIVENESS_QUIET 2   // no frame for the stale time, the pings are not answered
+#define RS485_LIVENESS_DEAD 3    // no frame for the dead time
+
+#define RS485_LIVENESS_STALE_MS 500
+#define RS485_LIVENESS_DEAD_MS 1500
+#define RS485_LIVENESS_CHECK_MS 50
+#define RS485_LIVENESS_PING_MS 250
+#define RS485_LIVENESS_DEAD_PING_MS 1000
+#define RS485_LIVENESS_REPLY_MS 20 // a response comes within it after its request
+#define RS485_LIVENESS_FLAG 0x1
+#define RS485_LIVENESS_STOP_FLAG 0x2
+#define RS485_LIVENESS_NO_REQUEST 0xFF
+
+/**
+ * @brief counters of the tracker
+ *
+ */
+typedef struct RS485_liveness_stats_struct
+{
+    uint32_t heartbeats; // frames sent by the tracked slaves
+    uint32_t pings;      // CMD_IS_ALIVE sent to the quiet slaves
+    uint32_t changes;    // state changes given to the callback
+} RS485_liveness_stats;
+
+/**
+ * @brief liveness tracker of the slaves, on the master
+ *
+ */
+class RS485Liveness
+{
+    public:
+
+        /**
+         * @brief RS485Liveness constructor, the thread starts right away
+         *
+         * @param rs the RS485 of the master, its frame observer is set
+         * @param slaves_mask SLAVE_MASK() of the slaves to track
+         * @param stale_ms the time without frame before a slave is quiet, pinged from half of it, for every slave
+         * @param dead_ms the time without frame before a slave is dead, for every slave
+         * @param thread_priority priority of the thread, higher than osPriorityBelowNormal
+         */
+        RS485Liveness(RS485* rs, uint16_t slaves_mask, uint32_t stale_ms = RS485_LIVENESS_STALE_MS, uint32_t dead_ms = RS485_LIVENESS_DEAD_MS,
+                      osPriority thread_priority = osPriorityAboveNormal);
+
+        /**
+         * @brief Destroy the RS485Liveness object, the frame observer is removed and the thread is joined
+         *
+         */
+        ~RS485Liveness();
+
+        /**
+         * @brief change the thresholds of one slave, ex: a board that sends telemetry slowly
+         *
+         * @param slave the address of the slave
+         * @param stale_ms the time without frame before the slave is quiet, pinged from half of it
+         * @param dead_ms the time without frame before the slave is dead
+         */
+        void setThreshold(uint8_t slave, uint32_t stale_ms, uint32_t dead_ms);
+
+        /**
+         * @brief set the callback of the state changes, called by the monitor thread
+         *
+         * @param callback called with the slave and its new RS485_LIVENESS_ state
+         */
+        void onChange(Callback<void(uint8_t, uint8_t)> callback);
+
+        /**
+         * @brief Get the state of a slave
+         *
+         * @param slave the address of the slave
+         * @return uint8_t RS485_LIVENESS_ state, as of the last check
+         */
+        uint8_t getState(uint8_t slave);
+
+        /**
+         * @brief Get the time since the last frame of a slave
+         *
+         * @param slave the address of the slave
+         * @return uint32_t the time in ms, UINT32_MAX without frame
+         */
+        uint32_t getAge(uint8_t slave);
+
+        /**
+         * @brief Get the counters of the tracker
+         *
+         * @return RS485_liveness_stats the counters
+         */
+        RS485_liveness_stats getStats();
+
+    private:
+
+        RS485* rs;
+        uint16_t slaves_mask;
+
+        Thread monitorThread;
+        Mutex liveness_mutex;
+        EventFlags wake_event;
+        Callback<void(uint8_t, uint8_t)> change_callback;
+
+        // written by the reader thread only
+        volatile uint32_t last_seen_ms[RS485_MAX_SLAVE];
+        volatile uint16_t seen_mask = 0;
+        volatile uint32_t heartbeats = 0;
+
+        // the last request of each slave not answered yet, under liveness_mutex
+        uint8_t request_cmd[RS485_MAX_SLAVE];
+        uint32_t request_ms[RS485_MAX_SLAVE];
+        uint32_t foreign_ms[RS485_MAX_SLAVE]; // last request of another master
+
+        uint32_t stale_ms[RS485_MAX_SLAVE];
+        uint32_t dead_ms[RS485_MAX_SLAVE];
+        uint32_t ping_ms[RS485_MAX_SLAVE];
+        volatile uint8_t state[RS485_MAX_SLAVE];
+
+        RS485_liveness_stats stats = {0, 0, 0};
+
+        /**
+         * @brief frame observer of RS485, one heartbeat for a frame sent by the slave
+         *
+         * @param slave the slave of the frame
+         * @param cmd the command of the frame
+         * @param nb_byte the size of the frame, tells a request from a response
+         */
+        void observe(uint8_t slave, uint8_t cmd, uint8_t nb_byte);
+
+        /**
+         * @brief thread of the checks, the pings and the callbacks
+         *
+         * The states are changed under liveness_mutex, the pings and the callbacks are done after it is released.
+         *
+         */
+        void monitor_thread();
+};
+
+#endif
@@ -0,0 +1,267 @@
+/**
+ * @file RS485MotorSet.cpp
+ * @brief RS485MotorSet class source file
+ *
+ */
+
+#include "RS485MotorSet.h"
+
+#include "RS485_definition.h"
+#include "RS485Serializer.h"
+
+RS485MotorSet::RS485MotorSet(RS485* rs, bool master, uint8_t nb_motor, bool use_delta, osPriority thread_priority)
+    : motorThread(thread_priority, OS_STACK_SIZE, NULL, "motor_set")
+{
+    this->rs = rs;
+    this->master = master;
+    this->nb_motor = nb_motor < RS485_MOTOR_MAX ? nb_motor : RS485_MOTOR_MAX;
+    this->use_delta = use_delta;
+
+    memset(history, 0, sizeof(history));
+    memset(&base, 0, sizeof(base));
+
+    uint8_t cmd_array[1] = {CMD_MOTOR_SET};
+    subscriber = new RS485Subscriber(rs, cmd_array, 1);
+
+    if(master)
+    {
+        motorThread.start(callback(this, &RS485MotorSet::master_thread));
+    }
+    else
+    {
+        motorThread.start(callback(this, &RS485MotorSet::esc_thread));
+    }
+}
+
+RS485MotorSet::~RS485MotorSet()
+{
+    // the thread may be in a write, in the motor mutex, it ends its frame first
+    subscriber->cancel();
+    motorThread.join();
+    delete subscriber;
+}
+
+uint8_t RS485MotorSet::set(const int16_t* setpoints)
+{
+    uint8_t request[RS485_MOTOR_MAX_REQUEST];
+    uint8_t size = RS485_MOTOR_HEADER_SIZE;
+    uint8_t mask = 0;
+
+    motor_mutex.lock();
+
+    if(++seq == RS485_MOTOR_NO_SEQ)
+    {
+        seq++;
+    }
+    store(seq, setpoints);
+
+    bool key_frame = !use_delta || base.seq == RS485_MOTOR_NO_SEQ;
+
+    for(uint8_t i = 0; i < nb_motor; ++i)
+    {
+        if(key_frame)
+        {
+            size += RS485Serializer::putVarint(setpoints[i], request + size);
+            mask |= 1 << i;
+        }
+        else if(setpoints[i] != base.setpoints[i])
+        {
+            size += RS485Serializer::putVarint((int32_t)setpoints[i] - base.setpoints[i], request + size);
+            mask |= 1 << i;
+        }
+    }
+
+    request[0] = key_frame ? RS485_MOTOR_KEY_FRAME : 0;
+    request[1] = seq;
+    request[2] = key_frame ? RS485_MOTOR_NO_SEQ : base.seq;
+    request[3] = mask;
+
+    stats.sets++;
+    stats.key_frames += key_frame;
+    stats.bytes += size;
+
+    // in the mutex, the frames leave in the order of their sequence
+    rs->write(SLAVE_ESC, CMD_MOTOR_SET, size, request);
+    uint8_t sent = seq;
+
+    motor_mutex.unlock();
+
+    return sent;
+}
+
+uint8_t RS485MotorSet::read(int16_t* setpoints)
+{
+    set_event.wait_any(RS485_MOTOR_SET_FLAG);
+    return get(setpoints);
+}
+
+uint8_t RS485MotorSet::get(int16_t* setpoints)
+{
+    motor_mutex.lock();
+    memcpy(setpoints, base.setpoints, nb_motor*sizeof(int16_t));
+    uint8_t applied = base.seq;
+    motor_mutex.unlock();
+
+    return applied;
+}
+
+RS485_motor_stats RS485MotorSet::getStats()
+{
+    motor_mutex.lock();
+    RS485_motor_stats copy = stats;
+    motor_mutex.unlock();
+
+    return copy;
+}
+
+RS485MotorSet::motor_set* RS485MotorSet::find(uint8_t seq)
+{
+    if(seq == RS485_MOTOR_NO_SEQ)
+    {
+        return NULL;
+    }
+
+    for(uint8_t i = 0; i < RS485_MOTOR_HISTORY; ++i)
+    {
+        if(history[i].seq == seq)
+        {
+            return &history[i];
+        }
+    }
+    return NULL;
+}
+
+void RS485MotorSet::store(uint8_t seq, const int16_t* setpoints)
+{
+    motor_set* slot = &history[seq % RS485_MOTOR_HISTORY];
+
+    slot->seq = seq;
+    memcpy(slot->setpoints, setpoints, nb_motor*sizeof(int16_t));
+}
+
+uint8_t RS485MotorSet::apply(const uint8_t* request, uint8_t nb_byte)
+{
+    int16_t setpoints[RS485_MOTOR_MAX];
+    uint8_t position = RS485_MOTOR_HEADER_SIZE;
+    bool key_frame = request[0] & RS485_MOTOR_KEY_FRAME;
+    uint8_t mask = request[3];
+
+    motor_mutex.lock();
+
+    if(key_frame)
+    {
+        memset(setpoints, 0, sizeof(setpoints));
+    }
+    else
+    {
+        motor_set* delta_base = find(request[2]);
+        if(delta_base == NULL)
+        {
+            stats.resync++;
+            motor_mutex.unlock();
+            return RS485_MOTOR_STATUS_RESYNC;
+        }
+        memcpy(setpoints, delta_base->setpoints, sizeof(setpoints));
+    }
+
+    for(uint8_t i = 0; i < nb_motor; ++i)
+    {
+        if(!(mask & (1 << i)))
+        {
+            continue;
+        }
+
+        int32_t value;
+        uint8_t size = RS485Serializer::getVarint(request + position, nb_byte - position, value);
+        if(size == 0)
+        {
+            motor_mutex.unlock();
+            return RS485_MOTOR_STATUS_RESYNC;
+        }
+        position += size;
+
+        setpoints[i] = key_frame ? (int16_t)value : (int16_t)(setpoints[i] + value);
+    }
+
+    // all the motors change together
+    base.seq = request[1];
+    memcpy(base.setpoints, setpoints, sizeof(setpoints));
+    store(base.seq, setpoints);
+
+    stats.sets++;
+    stats.key_frames += key_frame;
+    stats.bytes += nb_byte;
+
+    set_event.set(RS485_MOTOR_SET_FLAG);
+    motor_mutex.unlock();
+
+    return RS485_MOTOR_STATUS_OK;
+}
+
+void RS485MotorSet::master_thread()
+{
+    while(1)
+    {
+        // NULL once canceled by the destructor, or never subscribed
+        const RS485_packet* packet = subscriber->read();
+        if(packet == NULL)
+        {
+            return;
+        }
+
+        // the requests of the master come back on its own port
+        if(packet->nb_byte != RS485_MOTOR_RESPONSE_SIZE)
+        {
+            subscriber->release(packet);
+            continue;
+        }
+
+        motor_mutex.lock();
+
+        if(packet->data[1] == RS485_MOTOR_STATUS_RESYNC)
+        {
+            stats.resync++;
+            base.seq = RS485_MOTOR_NO_SEQ;
+        }
+        else
+        {
+            // a late response must not move the base back
+            motor_set* acked = find(packet->data[0]);
+            if(acked != NULL && (base.seq == RS485_MOTOR_NO_SEQ || (int8_t)(acked->seq - base.seq) > 0))
+            {
+                base = *acked;
+            }
+            stats.acked++;
+        }
+
+        motor_mutex.unlock();
+        subscriber->release(packet);
+    }
+}
+
+void RS485MotorSet::esc_thread()
+{
+    uint8_t response[RS485_MOTOR_RESPONSE_SIZE];
+
+    while(1)
+    {
+        const RS485_packet* packet = subscriber->read();
+        if(packet == NULL)
+        {
+            return;
+        }
+
+        // the responses of the ESC come back on its own port
+        if(packet->nb_byte < RS485_MOTOR_HEADER_SIZE)
+        {
+            subscriber->release(packet);
+            continue;
+        }
+
+        response[0] = packet->data[1];
+        response[1] = apply(packet->data, packet->nb_byte);
+        subscriber->release(packet);
+
+        rs->write(SLAVE_ESC, CMD_MOTOR_SET, RS485_MOTOR_RESPONSE_SIZE, response);
+    }
+}
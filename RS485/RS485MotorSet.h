@@ -0,0 +1,176 @@
+/**
+ * @file RS485MotorSet.h
+ * @brief All the motor setpoints of the ESC board in one CMD_MOTOR_SET frame
+ *
+ * Request, master to SLAVE_ESC: [header][sequence][base sequence][motor mask][one varint per motor of the mask].
+ * A key frame has the absolute setpoints of all the motors. A delta frame has the changes against
+ * the base, the last set acknowledged by the ESC, only for the motors that changed.
+ * Every delta is relative to an acknowledged set: a lost frame does not break the next ones.
+ *
+ * Response, SLAVE_ESC to master: [sequence][status]. The ESC keeps its last RS485_MOTOR_HISTORY sets,
+ * a delta on a base it does not have is answered RS485_MOTOR_STATUS_RESYNC and the next frame is a key frame.
+ *
+ * The ESC applies the whole set at once: read() and get() always give the motors of the same frame.
+ *
+ */
+
+#ifndef RS485_MOTOR_SET_H
+#define RS485_MOTOR_SET_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "RS485.h"
+#include "RS485Subscriber.h"
+
+#define RS485_MOTOR_MAX 8
+#define RS485_MOTOR_HEADER_SIZE 4       // header, sequence, base sequence, motor mask
+#define RS485_MOTOR_VALUE_MAX_SIZE 3    // zig-zag varint of an int16_t or of the difference of two
+#define RS485_MOTOR_MAX_REQUEST (RS485_MOTOR_HEADER_SIZE + RS485_MOTOR_MAX*RS485_MOTOR_VALUE_MAX_SIZE)
+#define RS485_MOTOR_RESPONSE_SIZE 2     // sequence, status
+#define RS485_MOTOR_HISTORY 4           // sets kept as delta bases
+#define RS485_MOTOR_KEY_FRAME 0x01
+#define RS485_MOTOR_NO_SEQ 0            // never used by a set, no base
+#define RS485_MOTOR_STATUS_OK 0
+#define RS485_MOTOR_STATUS_RESYNC 1
+
+#define RS485_MOTOR_SET_FLAG 0x1
+
+/**
+ * @brief counters of the motor sets
+ *
+ */
+typedef struct RS485_motor_stats_struct
+{
+    uint32_t sets;       // master: sent, ESC: applied
+    uint32_t key_frames;
+    uint32_t bytes;      // payload bytes sent or received
+    uint32_t acked;      // master only
+    uint32_t resync;     // deltas on a base the ESC did not have
+} RS485_motor_stats;
+
+/**
+ * @brief coalesced motor setpoints over RS485, master or ESC
+ *
+ */
+class RS485MotorSet
+{
+    public:
+
+        /**
+         * @brief RS485MotorSet constructor, the thread starts right away
+         *
+         * @param rs the RS485 of the board
+         * @param master true on the bus master, false on the ESC board
+         * @param nb_motor the number of motors, the same on both sides (max RS485_MOTOR_MAX)
+         * @param use_delta false to send only key frames
+         * @param thread_priority priority of the thread, higher than osPriorityBelowNormal
+         */
+        RS485MotorSet(RS485* rs, bool master, uint8_t nb_motor = RS485_MOTOR_MAX, bool use_delta = true, osPriority thread_priority = osPriorityAboveNormal);
+
+        /**
+         * @brief Destroy the RS485MotorSet object, the thread is joined
+         *
+         */
+        ~RS485MotorSet();
+
+        /**
+         * @brief Send the setpoints of all the motors in one frame, master only
+         *
+         * Does not wait for the response of the ESC.
+         *
+         * @param setpoints one setpoint per motor
+         * @return uint8_t the sequence of the set
+         */
+        uint8_t set(const int16_t* setpoints);
+
+        /**
+         * @brief Wait for the next set applied, ESC only
+         *
+         * @param setpoints one setpoint per motor
+         * @return uint8_t the sequence of the set
+         */
+        uint8_t read(int16_t* setpoints);
+
+        /**
+         * @brief Get the last set applied without waiting, ESC only
+         *
+         * @param setpoints one setpoint per motor, 0 before the first set
+         * @return uint8_t the sequence of the set, RS485_MOTOR_NO_SEQ before the first set
+         */
+        uint8_t get(int16_t* setpoints);
+
+        /**
+         * @brief Get the counters of the motor sets
+         *
+         * @return RS485_motor_stats the counters
+         */
+        RS485_motor_stats getStats();
+
+    private:
+
+        /**
+         * @brief one set of the history
+         *
+         */
+        typedef struct motor_set_struct
+        {
+            uint8_t seq;
+            int16_t setpoints[RS485_MOTOR_MAX];
+        } motor_set;
+
+        RS485* rs;
+        bool master;
+        uint8_t nb_motor;
+        bool use_delta;
+
+        RS485Subscriber* subscriber;
+        Thread motorThread;
+        Mutex motor_mutex;
+        EventFlags set_event;
+
+        motor_set history[RS485_MOTOR_HISTORY];
+        uint8_t seq = RS485_MOTOR_NO_SEQ;
+        motor_set base;   // master: last set acknowledged, ESC: last set applied
+
+        RS485_motor_stats stats = {0, 0, 0, 0, 0};
+
+        /**
+         * @brief find a set of the history
+         *
+         * @param seq the sequence of the set
+         * @return motor_set* the set, NULL if it is not in the history anymore
+         */
+        motor_set* find(uint8_t seq);
+
+        /**
+         * @brief add a set to the history, over the oldest one
+         *
+         * @param seq the sequence of the set
+         * @param setpoints one setpoint per motor
+         */
+        void store(uint8_t seq, const int16_t* setpoints);
+
+        /**
+         * @brief decode a request and apply the set, ESC only
+         *
+         * @param request the payload
+         * @param nb_byte the size of the payload
+         * @return uint8_t the status of the response
+         */
+        uint8_t apply(const uint8_t* request, uint8_t nb_byte);
+
+        /**
+         * @brief thread of the master, reads the responses
+         *
+         */
+        void master_thread();
+
+        /**
+         * @brief thread of the ESC, reads the requests
+         *
+         */
+        void esc_thread();
+};
+
+#endif
@@ -0,0 +1,159 @@
+/**
+ * @file RS485Publisher.cpp
+ * @brief RS485Publisher class source file
+ *
+ */
+
+#include "RS485Publisher.h"
+
+#include "Utility/utility.h"
+
+RS485Publisher::RS485Publisher(RS485* rs)
+{
+    this->rs = rs;
+}
+
+int8_t RS485Publisher::addChannel(uint8_t cmd, float_t deadband, uint32_t heartbeat_ms)
+{
+    publisher_mutex.lock();
+
+    if(nb_channel >= RS485_PUBLISHER_MAX_CHANNEL)
+    {
+        publisher_mutex.unlock();
+        return -1;
+    }
+
+    publisher_channel* channel = &channels[nb_channel];
+    memset(channel, 0, sizeof(publisher_channel));
+    channel->cmd = cmd;
+    channel->deadband = deadband;
+    channel->heartbeat_ms = heartbeat_ms;
+
+    int8_t index = nb_channel++;
+    publisher_mutex.unlock();
+
+    return index;
+}
+
+bool RS485Publisher::publish(uint8_t channel, float_t value)
+{
+    uint8_t payload[4];
+
+    if(channel >= nb_channel)
+    {
+        return false;
+    }
+
+    publisher_mutex.lock();
+
+    publisher_channel* current = &channels[channel];
+    uint64_t now = Kernel::get_ms_count();
+    float_t change = value - current->last_value;
+    // a NaN compares false with the deadband: going to or from NaN is a change, NaN to NaN is not
+    bool changed = !current->sent || change > current->deadband || change < -current->deadband ||
+                   isnan(value) != isnan(current->last_value);
+
+    putFloatInArray(payload, value);
+    bool sent = send(current, payload, 4, changed || heartbeatExpired(current, now), now);
+    if(sent)
+    {
+        current->last_value = value;
+    }
+
+    publisher_mutex.unlock();
+    return sent;
+}
+
+bool RS485Publisher::publish(uint8_t channel, const uint8_t* payload, uint8_t nb_byte)
+{
+    if(channel >= nb_channel || nb_byte > RS485_PUBLISHER_MAX_PAYLOAD)
+    {
+        return false;
+    }
+
+    publisher_mutex.lock();
+
+    publisher_channel* current = &channels[channel];
+    uint64_t now = Kernel::get_ms_count();
+    bool changed = !current->sent || nb_byte != current->last_nb_byte || memcmp(payload, current->last_payload, nb_byte) != 0;
+
+    bool sent = send(current, payload, nb_byte, changed || heartbeatExpired(current, now), now);
+
+    publisher_mutex.unlock();
+    return sent;
+}
+
+void RS485Publisher::force(uint8_t channel)
+{
+    if(channel >= nb_channel)
+    {
+        return;
+    }
+
+    publisher_mutex.lock();
+    channels[channel].sent = false;
+    publisher_mutex.unlock();
+}
+
+uint32_t RS485Publisher::getSentCount()
+{
+    uint32_t count = 0;
+
+    publisher_mutex.lock();
+    for(uint8_t i = 0; i < nb_channel; ++i)
+    {
+        count += channels[i].sent_count;
+    }
+    publisher_mutex.unlock();
+
+    return count;
+}
+
+uint32_t RS485Publisher::getSuppressedCount()
+{
+    uint32_t count = 0;
+
+    publisher_mutex.lock();
+    for(uint8_t i = 0; i < nb_channel; ++i)
+    {
+        count += channels[i].suppressed_count;
+    }
+    publisher_mutex.unlock();
+
+    return count;
+}
+
+uint32_t RS485Publisher::getSavedBusTime()
+{
+    publisher_mutex.lock();
+    uint32_t saved_ms = (uint32_t)(saved_us/1000);
+    publisher_mutex.unlock();
+
+    return saved_ms;
+}
+
+bool RS485Publisher::heartbeatExpired(publisher_channel* channel, uint64_t now)
+{
+    return now - channel->last_sent_ms >= channel->heartbeat_ms;
+}
+
+bool RS485Publisher::send(publisher_channel* channel, const uint8_t* payload, uint8_t nb_byte, bool send, uint64_t now)
+{
+    if(!send)
+    {
+        channel->suppressed_count++;
+        // at the rate of the bus when the frame was suppressed
+        saved_us += rs->getLineTime(nb_byte + RS485_FRAME_OVERHEAD) + rs->getDeHoldTime();
+        return false;
+    }
+
+    rs->write(rs->getBoardAdress(), channel->cmd, nb_byte, payload);
+
+    memcpy(channel->last_payload, payload, nb_byte);
+    channel->last_nb_byte = nb_byte;
+    channel->last_sent_ms = now;
+    channel->sent = true;
+    channel->sent_count++;
+
+    return true;
+}
@@ -0,0 +1,146 @@
+/**
+ * @file RS485Publisher.h
+ * @brief On change publisher of the telemetry of a board
+ *
+ * The board calls publish() every cycle as before, the value is only sent when it moved
+ * more than the deadband of its channel since the last sent value, or when the channel
+ * was silent for its heartbeat period. The receivers keep the last value (RS485ValueCache).
+ * A NaN (a sensor fault) is sent right away, and the first value after it too.
+ *
+ */
+
+#ifndef RS485_PUBLISHER_H
+#define RS485_PUBLISHER_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "RS485.h"
+
+#define RS485_PUBLISHER_MAX_CHANNEL 8
+#define RS485_PUBLISHER_MAX_PAYLOAD 16
+
+/**
+ * @brief one published command
+ *
+ */
+typedef struct publisher_channel_struct
+{
+    uint8_t cmd;
+    float_t deadband;
+    uint32_t heartbeat_ms;
+
+    float_t last_value;
+    uint8_t last_payload[RS485_PUBLISHER_MAX_PAYLOAD];
+    uint8_t last_nb_byte;
+    uint64_t last_sent_ms;
+    bool sent;
+
+    uint32_t sent_count;
+    uint32_t suppressed_count;
+} publisher_channel;
+
+/**
+ * @brief deadband and heartbeat publisher over RS485::write()
+ *
+ */
+class RS485Publisher
+{
+    public:
+
+        /**
+         * @brief RS485Publisher constructor
+         *
+         * @param rs the RS485 of the board, the frames are sent with the board address
+         */
+        RS485Publisher(RS485* rs);
+
+        /**
+         * @brief Add a published command
+         *
+         * @param cmd the command
+         * @param deadband the change of the value that is sent right away, 0 to send every change
+         * @param heartbeat_ms the maximum time without sending the value
+         * @return int8_t index of the channel, -1 if there is no channel left
+         */
+        int8_t addChannel(uint8_t cmd, float_t deadband, uint32_t heartbeat_ms);
+
+        /**
+         * @brief Publish a float, sent like putFloatInArray()
+         *
+         * @param channel index of the channel
+         * @param value the value
+         * @return true if the value was sent
+         */
+        bool publish(uint8_t channel, float_t value);
+
+        /**
+         * @brief Publish a raw payload, sent when a byte changes or on the heartbeat
+         *
+         * @param channel index of the channel
+         * @param payload the payload
+         * @param nb_byte the size of the payload (max RS485_PUBLISHER_MAX_PAYLOAD)
+         * @return true if the payload was sent
+         */
+        bool publish(uint8_t channel, const uint8_t* payload, uint8_t nb_byte);
+
+        /**
+         * @brief Send the value of a channel with the next publish
+         *
+         * @param channel index of the channel
+         */
+        void force(uint8_t channel);
+
+        /**
+         * @brief Get the number of frames sent
+         *
+         * @return uint32_t the number of frames of all the channels
+         */
+        uint32_t getSentCount();
+
+        /**
+         * @brief Get the number of frames not sent
+         *
+         * @return uint32_t the number of frames of all the channels
+         */
+        uint32_t getSuppressedCount();
+
+        /**
+         * @brief Get the bus time saved by the deadband and the heartbeat
+         *
+         * @return uint32_t the time in ms, frame bytes and DE hold of the frames not sent
+         */
+        uint32_t getSavedBusTime();
+
+    private:
+
+        RS485* rs;
+        Mutex publisher_mutex;
+
+        publisher_channel channels[RS485_PUBLISHER_MAX_CHANNEL];
+        uint8_t nb_channel = 0;
+        uint64_t saved_us = 0;
+
+        /**
+         * @brief check the heartbeat of a channel
+         *
+         * @param channel the channel
+         * @param now the time in ms
+         * @return true if the heartbeat expired
+         */
+        bool heartbeatExpired(publisher_channel* channel, uint64_t now);
+
+        /**
+         * @brief send a payload of a channel or count it as suppressed
+         *
+         * @param channel the channel
+         * @param payload the payload
+         * @param nb_byte the size of the payload
+         * @param send true to send it
+         * @param now the time in ms
+         * @return the value of send
+         */
+        bool send(publisher_channel* channel, const uint8_t* payload, uint8_t nb_byte, bool send, uint64_t now);
+};
+
+#endif
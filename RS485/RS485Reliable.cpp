@@ -0,0 +1,506 @@
+/**
+ * @file RS485Reliable.cpp
+ * @brief RS485Reliable class source file
+ *
+ */
+
+#include "RS485Reliable.h"
+
+#include "RS485_definition.h"
+#include "Utility/MemoryAlloc.h"
+
+#define RELIABLE_STATE_WAIT 0
+#define RELIABLE_STATE_ACKED 1
+#define RELIABLE_STATE_FAILED 2
+
+#define RELIABLE_NO_DEADLINE UINT64_MAX
+
+// sequence 0 is only used by the first frame of a link, it restarts the window of the receiver
+// after a reset of the sender, the other frames use 1 to RELIABLE_SEQ_COUNT.
+// Within RS485_RELIABLE_WINDOW frames of a restart a sequence 0 is a copy, not a new restart.
+#define RELIABLE_SEQ_COUNT 127
+
+RS485Reliable::RS485Reliable(RS485* rs, bool master, const uint8_t* cmd_array, uint8_t nb_command, osPriority thread_priority)
+    : readerThread(thread_priority, OS_STACK_SIZE, NULL, "reliable_rx"), serviceThread(thread_priority, OS_STACK_SIZE, NULL, "reliable_tx")
+{
+    this->rs = rs;
+    this->master = master;
+    direction = master ? RS485_RELIABLE_FROM_MASTER : 0;
+
+    memset(link, 0, sizeof(link));
+
+    pending = (reliable_pending*)memoryAlloc(MEMORY_MODULE_RS485, sizeof(reliable_pending)*RS485_RELIABLE_MAX_PENDING);
+    queue = (reliable_message*)memoryAlloc(MEMORY_MODULE_RS485, sizeof(reliable_message)*RS485_RELIABLE_QUEUE_SIZE);
+    for(uint8_t i = 0; i < RS485_RELIABLE_MAX_PENDING; ++i)
+    {
+        pending[i].in_use = false;
+    }
+
+    // the enabled commands the registry allows, for any slave on the master, for the board on a slave
+    uint16_t board_mask = master ? SLAVE_MASK_ALL : SLAVE_MASK(rs->getBoardAdress());
+    for(uint8_t i = 0; i < nb_command; ++i)
+    {
+        for(uint8_t slave = 0; slave < RS485_MAX_SLAVE; ++slave)
+        {
+            if((board_mask & SLAVE_MASK(slave)) && RS485_isReliable(RS485::getDispatch(), slave, cmd_array[i]))
+            {
+                reliable_flag |= 1UL << cmd_array[i];
+            }
+        }
+    }
+
+    // the acks of the other side, and our own copy of the frames: the plain readers keep theirs
+    uint8_t subscribed[RS485_NB_CMD + 1];
+    uint8_t nb_subscribed = 0;
+    for(uint8_t cmd = 0; cmd < RS485_NB_CMD; ++cmd)
+    {
+        if(reliable_flag & (1UL << cmd))
+        {
+            subscribed[nb_subscribed++] = cmd;
+        }
+    }
+    subscribed[nb_subscribed++] = CMD_ACK;
+    subscriber = new RS485Subscriber(rs, subscribed, nb_subscribed, RS485_RELIABLE_QUEUE_SIZE);
+
+    readerThread.start(callback(this, &RS485Reliable::reader_thread));
+    serviceThread.start(callback(this, &RS485Reliable::service_thread));
+}
+
+RS485Reliable::~RS485Reliable()
+{
+    // the reader wakes up with the cancel, the service thread with the stop flag
+    subscriber->cancel();
+    service_event.set(RS485_RELIABLE_STOP_FLAG);
+    readerThread.join();
+    serviceThread.join();
+    delete subscriber;
+
+    memoryFree(pending);
+    memoryFree(queue);
+    pending = NULL;
+    queue = NULL;
+}
+
+bool RS485Reliable::write(const uint8_t slave, const uint8_t cmd, const uint8_t nb_byte, const uint8_t* data)
+{
+    if(slave == SLAVE_BROADCAST || nb_byte > RS485_RELIABLE_MAX_DATA || !isReliable(slave, cmd))
+    {
+        return false;
+    }
+
+    reliable_mutex.lock();
+    uint8_t index = RS485_RELIABLE_MAX_PENDING;
+    for(uint8_t i = 0; i < RS485_RELIABLE_MAX_PENDING; ++i)
+    {
+        if(!pending[i].in_use)
+        {
+            index = i;
+            break;
+        }
+    }
+    if(index == RS485_RELIABLE_MAX_PENDING)
+    {
+        reliable_mutex.unlock();
+        return false;
+    }
+
+    reliable_pending* frame = &pending[index];
+    frame->in_use = true;
+    frame->state = RELIABLE_STATE_WAIT;
+    frame->slave = slave;
+    frame->cmd = cmd;
+    frame->nb_byte = nb_byte;
+    frame->retries = 0;
+    frame->deadline_ms = RELIABLE_NO_DEADLINE;
+    memcpy(frame->data, data, nb_byte);
+
+    frame->seq = link[slave].tx_seq;
+    link[slave].tx_seq = link[slave].tx_seq % RELIABLE_SEQ_COUNT + 1;
+    stats.sent++;
+    reliable_mutex.unlock();
+
+    send(frame);
+    service_event.set(RS485_RELIABLE_SERVICE_FLAG);
+
+    pending_done[index].wait();
+
+    reliable_mutex.lock();
+    bool acked = frame->state == RELIABLE_STATE_ACKED;
+    frame->in_use = false;
+    reliable_mutex.unlock();
+
+    return acked;
+}
+
+uint8_t RS485Reliable::read(const uint8_t* cmd_array, const uint8_t nb_command, uint8_t& returned_slave, uint8_t& returned_cmd, uint8_t* data_buffer)
+{
+    uint32_t cmd_flag = 0;
+
+    for(uint8_t i = 0; i < nb_command; ++i)
+    {
+        cmd_flag |= 1UL << cmd_array[i];
+    }
+
+    while(1)
+    {
+        // oldest first
+        reliable_mutex.lock();
+        for(uint8_t i = 0; i < queue_count; ++i)
+        {
+            if(cmd_flag & (1UL << queue[i].cmd))
+            {
+                uint8_t nb_byte = queue[i].nb_byte;
+                returned_slave = queue[i].slave;
+                returned_cmd = queue[i].cmd;
+                memcpy(data_buffer, queue[i].data, nb_byte);
+
+                for(uint8_t j = i + 1; j < queue_count; ++j)
+                {
+                    queue[j - 1] = queue[j];
+                }
+                queue_count--;
+                reliable_mutex.unlock();
+
+                return nb_byte;
+            }
+        }
+        reliable_mutex.unlock();
+
+        message_event.wait_any(cmd_flag);
+    }
+}
+
+uint32_t RS485Reliable::getTimeout(uint8_t nb_byte)
+{
+    // the frame, the longest frame of the receiver and the largest CMD_ACK
+    uint16_t nb_line = (uint16_t)nb_byte + RS485_RELIABLE_HEADER + RS485_FRAME_OVERHEAD + RS485_MAX_PAYLOAD + RS485_FRAME_OVERHEAD +
+                       1 + RS485_RELIABLE_MAX_ACK + RS485_FRAME_OVERHEAD;
+
+    // our DE hold, and the one of the receiver if it just sent something, rounded up
+    uint32_t line_us = rs->getLineTime(nb_line) + 2*rs->getDeHoldTime();
+    return (line_us + 999)/1000 + RS485_RELIABLE_ACK_DELAY_MS + 1;
+}
+
+RS485_reliable_stats RS485Reliable::getStats()
+{
+    reliable_mutex.lock();
+    RS485_reliable_stats copy = stats;
+    reliable_mutex.unlock();
+
+    return copy;
+}
+
+bool RS485Reliable::isReliable(uint8_t slave, uint8_t cmd)
+{
+    return RS485_isReliable(RS485::getDispatch(), slave, cmd) && (reliable_flag & (1UL << cmd));
+}
+
+void RS485Reliable::send(reliable_pending* frame)
+{
+    uint8_t buffer[RS485_MAX_PAYLOAD];
+
+    reliable_mutex.lock();
+    uint8_t slave = frame->slave;
+    uint8_t cmd = frame->cmd;
+    uint8_t seq = frame->seq;
+    uint8_t nb_byte = frame->nb_byte;
+
+    // the newest ack of the link rides in the frame
+    reliable_link* tx = &link[slave];
+    buffer[0] = direction | seq;
+    buffer[1] = 0;
+    if(tx->nb_ack)
+    {
+        buffer[1] = RS485_RELIABLE_ACK_VALID | tx->ack[--tx->nb_ack];
+        stats.piggybacked++;
+    }
+    memcpy(&buffer[RS485_RELIABLE_HEADER], frame->data, nb_byte);
+    reliable_mutex.unlock();
+
+    uint64_t start_ms = Kernel::get_ms_count();
+    rs->write(slave, cmd, nb_byte + RS485_RELIABLE_HEADER, buffer);
+
+    // the ack may already be there, or the entry reused by another write
+    reliable_mutex.lock();
+    if(frame->in_use && frame->state == RELIABLE_STATE_WAIT && frame->seq == seq && frame->slave == slave)
+    {
+        frame->deadline_ms = start_ms + getTimeout(nb_byte);
+    }
+    reliable_mutex.unlock();
+}
+
+void RS485Reliable::sendAck(uint8_t slave)
+{
+    uint8_t buffer[1 + RS485_RELIABLE_MAX_ACK];
+
+    reliable_mutex.lock();
+    reliable_link* tx = &link[slave];
+    uint8_t nb_ack = tx->nb_ack;
+    buffer[0] = direction;
+    memcpy(&buffer[1], tx->ack, nb_ack);
+    tx->nb_ack = 0;
+    if(nb_ack)
+    {
+        stats.ack_frames++;
+    }
+    reliable_mutex.unlock();
+
+    if(nb_ack)
+    {
+        rs->write(slave, CMD_ACK, 1 + nb_ack, buffer);
+    }
+}
+
+void RS485Reliable::acknowledge(uint8_t slave, uint8_t seq)
+{
+    reliable_mutex.lock();
+    for(uint8_t i = 0; i < RS485_RELIABLE_MAX_PENDING; ++i)
+    {
+        reliable_pending* frame = &pending[i];
+        if(frame->in_use && frame->state == RELIABLE_STATE_WAIT && frame->slave == slave && frame->seq == seq)
+        {
+            frame->state = RELIABLE_STATE_ACKED;
+            stats.acked++;
+            pending_done[i].release();
+            break;
+        }
+    }
+    reliable_mutex.unlock();
+}
+
+bool RS485Reliable::accept(reliable_link* rx, uint8_t seq)
+{
+    // a sequence 0 in the window of the last restart is a copy of it, its ack was lost
+    if(!rx->rx_valid || (seq == 0 && !rx->rx_zero))
+    {
+        rx->rx_valid = true;
+        rx->rx_zero = seq == 0;
+        rx->rx_last = seq;
+        rx->rx_window = 1;
+        return true;
+    }
+
+    uint8_t ahead = (uint8_t)((seq + RELIABLE_SEQ_COUNT - rx->rx_last) % RELIABLE_SEQ_COUNT);
+    if(rx->rx_last == 0)
+    {
+        // the sequence after 0 is 1
+        ahead = seq;
+    }
+
+    if(ahead == 0)
+    {
+        return false;
+    }
+    if(ahead < RELIABLE_SEQ_COUNT/2)
+    {
+        rx->rx_window = ahead < RS485_RELIABLE_WINDOW ? (rx->rx_window << ahead) | 1 : 1;
+        rx->rx_last = seq;
+        rx->rx_zero = rx->rx_zero && seq < RS485_RELIABLE_WINDOW;
+        return true;
+    }
+
+    uint8_t behind = RELIABLE_SEQ_COUNT - ahead;
+    if(behind < RS485_RELIABLE_WINDOW)
+    {
+        if(rx->rx_window & (1UL << behind))
+        {
+            return false;
+        }
+        rx->rx_window |= 1UL << behind;
+        return true;
+    }
+
+    // far outside of the window, the sender lost its state
+    rx->rx_last = seq;
+    rx->rx_window = 1;
+    rx->rx_zero = false;
+    return true;
+}
+
+void RS485Reliable::reader_thread()
+{
+    uint8_t buffer[RS485_MAX_PAYLOAD];
+    uint8_t slave;
+    uint8_t cmd;
+
+    // no frame would ever come, the writes fail after their retries
+    if(!subscriber->isSubscribed())
+    {
+        return;
+    }
+
+    while(1)
+    {
+        // NULL once canceled by the destructor
+        const RS485_packet* packet = subscriber->read();
+        if(packet == NULL)
+        {
+            return;
+        }
+
+        uint8_t nb_byte = packet->nb_byte;
+        slave = packet->slave;
+        cmd = packet->cmd;
+        memcpy(buffer, packet->data, nb_byte);
+        subscriber->release(packet);
+
+        // our own frames (echo) have our direction
+        if(slave >= RS485_MAX_SLAVE || nb_byte < 1 || (buffer[0] & RS485_RELIABLE_FROM_MASTER) == direction)
+        {
+            continue;
+        }
+
+        if(cmd == CMD_ACK)
+        {
+            for(uint8_t i = 1; i < nb_byte; ++i)
+            {
+                acknowledge(slave, buffer[i] & RS485_RELIABLE_SEQ_MASK);
+            }
+            continue;
+        }
+
+        // the same command number may be a plain command of another slave, that copy is ours only
+        if(!isReliable(slave, cmd) || nb_byte < RS485_RELIABLE_HEADER)
+        {
+            continue;
+        }
+
+        if(buffer[1] & RS485_RELIABLE_ACK_VALID)
+        {
+            acknowledge(slave, buffer[1] & RS485_RELIABLE_SEQ_MASK);
+        }
+
+        uint8_t seq = buffer[0] & RS485_RELIABLE_SEQ_MASK;
+
+        reliable_mutex.lock();
+        reliable_link* rx = &link[slave];
+        bool is_new = accept(rx, seq);
+
+        // a copy is acknowledged again, the first ack was lost
+        bool already = false;
+        for(uint8_t i = 0; i < rx->nb_ack; ++i)
+        {
+            already |= rx->ack[i] == seq;
+        }
+        if(!already && rx->nb_ack < RS485_RELIABLE_MAX_ACK)
+        {
+            if(rx->nb_ack == 0)
+            {
+                rx->ack_deadline_ms = Kernel::get_ms_count() + RS485_RELIABLE_ACK_DELAY_MS;
+            }
+            rx->ack[rx->nb_ack++] = seq;
+        }
+
+        if(is_new)
+        {
+            if(queue_count == RS485_RELIABLE_QUEUE_SIZE)
+            {
+                for(uint8_t j = 1; j < queue_count; ++j)
+                {
+                    queue[j - 1] = queue[j];
+                }
+                queue_count--;
+                stats.dropped++;
+            }
+
+            reliable_message* message = &queue[queue_count++];
+            message->slave = slave;
+            message->cmd = cmd;
+            message->nb_byte = nb_byte - RS485_RELIABLE_HEADER;
+            memcpy(message->data, &buffer[RS485_RELIABLE_HEADER], message->nb_byte);
+        }
+        else
+        {
+            stats.duplicates++;
+        }
+        reliable_mutex.unlock();
+
+        service_event.set(RS485_RELIABLE_SERVICE_FLAG);
+        if(is_new)
+        {
+            message_event.set(1UL << cmd);
+        }
+    }
+}
+
+void RS485Reliable::service_thread()
+{
+    while(1)
+    {
+        reliable_pending* resend = NULL;
+        int8_t ack_slave = -1;
+        uint32_t wait_ms = osWaitForever;
+
+        reliable_mutex.lock();
+        uint64_t now = Kernel::get_ms_count();
+
+        for(uint8_t i = 0; i < RS485_RELIABLE_MAX_PENDING; ++i)
+        {
+            reliable_pending* frame = &pending[i];
+            if(!frame->in_use || frame->state != RELIABLE_STATE_WAIT || frame->deadline_ms == RELIABLE_NO_DEADLINE)
+            {
+                continue;
+            }
+
+            if(now < frame->deadline_ms)
+            {
+                if(frame->deadline_ms - now < wait_ms)
+                {
+                    wait_ms = (uint32_t)(frame->deadline_ms - now);
+                }
+            }
+            else if(frame->retries >= RS485_RELIABLE_MAX_RETRY)
+            {
+                frame->state = RELIABLE_STATE_FAILED;
+                stats.failed++;
+                pending_done[i].release();
+            }
+            else if(resend == NULL)
+            {
+                // set again by send()
+                frame->deadline_ms = RELIABLE_NO_DEADLINE;
+                frame->retries++;
+                stats.retransmitted++;
+                resend = frame;
+            }
+        }
+
+        for(uint8_t slave = 0; slave < RS485_MAX_SLAVE; ++slave)
+        {
+            if(link[slave].nb_ack == 0)
+            {
+                continue;
+            }
+
+            if(now >= link[slave].ack_deadline_ms)
+            {
+                if(ack_slave < 0)
+                {
+                    ack_slave = slave;
+                }
+            }
+            else if(link[slave].ack_deadline_ms - now < wait_ms)
+            {
+                wait_ms = (uint32_t)(link[slave].ack_deadline_ms - now);
+            }
+        }
+        reliable_mutex.unlock();
+
+        if(resend)
+        {
+            send(resend);
+        }
+        if(ack_slave >= 0)
+        {
+            sendAck(ack_slave);
+        }
+        if(resend == NULL && ack_slave < 0)
+        {
+            uint32_t flags = service_event.wait_any(RS485_RELIABLE_SERVICE_FLAG | RS485_RELIABLE_STOP_FLAG, wait_ms);
+            if(!(flags & osFlagsError) && (flags & RS485_RELIABLE_STOP_FLAG))
+            {
+                return;
+            }
+        }
+    }
+}
@@ -0,0 +1,260 @@
+/**
+ * @file RS485Reliable.h
+ * @brief Acknowledged delivery of the commands flagged RS485_FLAG_RELIABLE in the registry
+ *
+ * The delivery is enabled at runtime: only the commands given to the constructor are sent
+ * and read with the header, the others stay plain frames. The flag of the registry only gives
+ * room for the header in the payload check. Both sides of a link must enable the same commands.
+ *
+ * A reliable frame starts with two bytes: [direction | sequence][ack valid | acknowledged sequence].
+ * Every frame is acknowledged by its receiver. The acknowledgement rides in the next reliable frame
+ * sent back to the same slave when there is one within RS485_RELIABLE_ACK_DELAY_MS (the response
+ * of the command most of the time), otherwise it is sent alone with CMD_ACK.
+ * A frame not acknowledged within a few frame times is sent again with the same sequence,
+ * the receiver drops the copies it already has and acknowledges them again.
+ *
+ * Each direction of each link (one slave and the master) has its own sequences.
+ * The direction bit also drops the echo of our own frames.
+ *
+ * The frames are received through a RS485Subscriber, the plain readers of the same command
+ * numbers (another slave, or a board without RS485Reliable) still get their frames.
+ *
+ * @warning once enabled, the reliable commands must be written and read with RS485Reliable
+ * on both sides, their payload on the bus has the header in front.
+ *
+ */
+
+#ifndef RS485_RELIABLE_H
+#define RS485_RELIABLE_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "RS485.h"
+#include "RS485Subscriber.h"
+
+#define RS485_RELIABLE_MAX_DATA (RS485_MAX_PAYLOAD - RS485_RELIABLE_HEADER)
+#define RS485_RELIABLE_MAX_PENDING 4 // writes waiting for their ack
+#define RS485_RELIABLE_QUEUE_SIZE 4  // frames received and not read yet
+#define RS485_RELIABLE_MAX_RETRY 5
+#define RS485_RELIABLE_ACK_DELAY_MS 2
+#define RS485_RELIABLE_MAX_ACK 8     // acknowledgements of one CMD_ACK
+#define RS485_RELIABLE_WINDOW 32     // sequences remembered to drop the copies
+
+#define RS485_RELIABLE_FROM_MASTER 0x80
+#define RS485_RELIABLE_ACK_VALID 0x80
+#define RS485_RELIABLE_SEQ_MASK 0x7F
+
+#define RS485_RELIABLE_SERVICE_FLAG 0x1
+#define RS485_RELIABLE_STOP_FLAG 0x2
+
+/**
+ * @brief counters of the reliable delivery
+ *
+ */
+typedef struct RS485_reliable_stats_struct
+{
+    uint32_t sent;          // first transmissions
+    uint32_t retransmitted;
+    uint32_t acked;
+    uint32_t failed;        // no ack after RS485_RELIABLE_MAX_RETRY retransmissions
+    uint32_t piggybacked;   // acks sent in a reliable frame
+    uint32_t ack_frames;    // CMD_ACK frames sent
+    uint32_t duplicates;    // copies received and dropped
+    uint32_t dropped;       // received frames lost because the queue was full
+} RS485_reliable_stats;
+
+/**
+ * @brief reliable delivery on top of RS485, master or slave
+ *
+ */
+class RS485Reliable
+{
+    public:
+
+        /**
+         * @brief RS485Reliable constructor, the threads start right away
+         *
+         * The commands not flagged RS485_FLAG_RELIABLE in the registry, or not implemented by
+         * the address of a slave board, are ignored.
+         *
+         * @param rs the RS485 of the board
+         * @param master true on the bus master
+         * @param cmd_array the commands to send and read with the reliable delivery
+         * @param nb_command the number of commands
+         * @param thread_priority priority of the threads, higher than osPriorityBelowNormal
+         */
+        RS485Reliable(RS485* rs, bool master, const uint8_t* cmd_array, uint8_t nb_command, osPriority thread_priority = osPriorityAboveNormal);
+
+        /**
+         * @brief Destroy the RS485Reliable object, the threads are joined
+         *
+         * No write() or read() may be waiting, they use the buffers freed here.
+         *
+         */
+        ~RS485Reliable();
+
+        /**
+         * @brief Send a reliable command and wait for its acknowledgement
+         *
+         * @param slave the slave of the frame (the address of this board on a slave)
+         * @param cmd the command, given to the constructor and flagged RS485_FLAG_RELIABLE for this slave
+         * @param nb_byte the size of the data (max RS485_RELIABLE_MAX_DATA)
+         * @param data the data
+         * @return true when the receiver acknowledged the frame, false after the last retry
+         */
+        bool write(const uint8_t slave, const uint8_t cmd, const uint8_t nb_byte, const uint8_t* data);
+
+        /**
+         * @brief Wait for a reliable command, each frame is given once
+         *
+         * @param cmd_array the commands to wait for
+         * @param nb_command the number of commands
+         * @param returned_slave the slave of the frame
+         * @param returned_cmd the command of the frame
+         * @param data_buffer the buffer of the data, RS485_RELIABLE_MAX_DATA bytes
+         * @return uint8_t the size of the data
+         */
+        uint8_t read(const uint8_t* cmd_array, const uint8_t nb_command, uint8_t& returned_slave, uint8_t& returned_cmd, uint8_t* data_buffer);
+
+        /**
+         * @brief Get the time without ack before a frame is sent again
+         *
+         * Derived from the current rate of the bus: the frame and the ack on the line, the longest
+         * frame the receiver may be sending when ours ends, the DE hold of both boards
+         * and the ack delay of the receiver.
+         *
+         * @param nb_byte the size of the data
+         * @return uint32_t the timeout in ms from the start of the transmission
+         */
+        uint32_t getTimeout(uint8_t nb_byte);
+
+        /**
+         * @brief Get the counters of the reliable delivery
+         *
+         * @return RS485_reliable_stats the counters
+         */
+        RS485_reliable_stats getStats();
+
+    private:
+
+        /**
+         * @brief state of one link (the master and one slave)
+         *
+         */
+        typedef struct reliable_link_struct
+        {
+            uint8_t tx_seq;
+            bool rx_valid;
+            uint8_t rx_last;
+            uint32_t rx_window;  // bit i: rx_last - i was received
+            bool rx_zero;        // the link restarted with sequence 0, still in the window
+            uint8_t ack[RS485_RELIABLE_MAX_ACK];
+            uint8_t nb_ack;
+            uint64_t ack_deadline_ms;
+        } reliable_link;
+
+        /**
+         * @brief one write waiting for its ack
+         *
+         */
+        typedef struct reliable_pending_struct
+        {
+            bool in_use;
+            uint8_t state;
+            uint8_t slave;
+            uint8_t cmd;
+            uint8_t seq;
+            uint8_t nb_byte;
+            uint8_t retries;
+            uint64_t deadline_ms;
+            uint8_t data[RS485_RELIABLE_MAX_DATA];
+        } reliable_pending;
+
+        /**
+         * @brief one frame received and not read yet
+         *
+         */
+        typedef struct reliable_message_struct
+        {
+            uint8_t slave;
+            uint8_t cmd;
+            uint8_t nb_byte;
+            uint8_t data[RS485_RELIABLE_MAX_DATA];
+        } reliable_message;
+
+        RS485* rs;
+        bool master;
+        uint8_t direction;
+
+        Thread readerThread;
+        Thread serviceThread;
+        Mutex reliable_mutex;
+        EventFlags service_event;
+        EventFlags message_event;
+
+        uint32_t reliable_flag = 0; // the commands enabled by the constructor
+        RS485Subscriber* subscriber;
+
+        reliable_link link[RS485_MAX_SLAVE];
+        reliable_pending* pending;
+        Semaphore pending_done[RS485_RELIABLE_MAX_PENDING];
+        reliable_message* queue;
+        uint8_t queue_count = 0;
+
+        RS485_reliable_stats stats = {0, 0, 0, 0, 0, 0, 0, 0};
+
+        /**
+         * @brief send a pending frame with the latest ack of its link
+         *
+         * @param frame the pending frame
+         */
+        void send(reliable_pending* frame);
+
+        /**
+         * @brief send the acks waiting on a link in one CMD_ACK
+         *
+         * @param slave the slave of the link
+         */
+        void sendAck(uint8_t slave);
+
+        /**
+         * @brief mark the pending frame of a sequence as acknowledged
+         *
+         * @param slave the slave of the link
+         * @param seq the sequence
+         */
+        void acknowledge(uint8_t slave, uint8_t seq);
+
+        /**
+         * @brief check a received sequence against the window of its link
+         *
+         * @param rx the link
+         * @param seq the sequence
+         * @return true if the frame is new, false if it is a copy
+         */
+        bool accept(reliable_link* rx, uint8_t seq);
+
+        /**
+         * @brief check if a frame uses the reliable delivery
+         *
+         * @param slave the slave of the frame
+         * @param cmd the command of the frame
+         * @return true if the command is enabled and flagged RS485_FLAG_RELIABLE for this slave
+         */
+        bool isReliable(uint8_t slave, uint8_t cmd);
+
+        /**
+         * @brief the reader thread, acks and reliable frames
+         *
+         */
+        void reader_thread();
+
+        /**
+         * @brief the service thread, retransmissions and delayed acks
+         *
+         */
+        void service_thread();
+};
+
+#endif
@@ -0,0 +1,211 @@
+/**
+ * @file RS485Serializer.cpp
+ * @brief RS485Serializer class source file
+ *
+ */
+
+#include "RS485Serializer.h"
+
+#include "Utility/MemoryAlloc.h"
+
+RS485Serializer::RS485Serializer(const RS485_schema& schema, uint8_t key_frame_interval)
+    : schema(schema)
+{
+    this->key_frame_interval = key_frame_interval ? key_frame_interval : 1;
+    has_delta = schemaHasDelta(schema);
+
+    previous = (int32_t*)memoryAlloc(MEMORY_MODULE_RS485, schema.nb_field*sizeof(int32_t));
+    if(previous)
+    {
+        memset(previous, 0, schema.nb_field*sizeof(int32_t));
+    }
+}
+
+RS485Serializer::~RS485Serializer()
+{
+    memoryFree(previous);
+}
+
+uint8_t RS485Serializer::encode(const int32_t* values, uint8_t* buffer)
+{
+    uint8_t size = 0;
+    bool key_frame = frame_count == 0;
+
+    if(previous == NULL)
+    {
+        return 0;
+    }
+
+    if(has_delta)
+    {
+        buffer[size++] = (sequence << SCHEMA_HEADER_SEQUENCE_SHIFT) | (key_frame ? SCHEMA_HEADER_KEY_FRAME : 0);
+        sequence = (sequence + 1) & SCHEMA_HEADER_SEQUENCE_MASK;
+        frame_count = (frame_count + 1) % key_frame_interval;
+    }
+
+    for(uint8_t i = 0; i < schema.nb_field; ++i)
+    {
+        uint32_t value = (uint32_t)values[i];
+
+        switch(schema.fields[i].encoding)
+        {
+            case FIELD_U32:
+            case FIELD_I32:
+                buffer[size + 3] = value >> 24;
+                buffer[size + 2] = value >> 16;
+                // fall through
+            case FIELD_U16:
+            case FIELD_I16:
+                buffer[size + 1] = value >> 8;
+                // fall through
+            case FIELD_U8:
+            case FIELD_I8:
+                buffer[size] = value;
+                size += schemaFieldMaxSize(schema.fields[i].encoding);
+                break;
+
+            case FIELD_VARINT:
+                size += putVarint(values[i], buffer + size);
+                break;
+
+            case FIELD_DELTA:
+                size += putVarint(key_frame ? values[i] : (int32_t)(value - (uint32_t)previous[i]), buffer + size);
+                previous[i] = values[i];
+                break;
+        }
+    }
+
+    return size;
+}
+
+bool RS485Serializer::decode(const uint8_t* buffer, uint8_t nb_byte, int32_t* values)
+{
+    uint8_t position = 0;
+    bool key_frame = false;
+    uint8_t frame_sequence = 0;
+
+    if(previous == NULL)
+    {
+        return false;
+    }
+
+    if(has_delta)
+    {
+        if(nb_byte < SCHEMA_HEADER_SIZE)
+        {
+            synchronized = false;
+            return false;
+        }
+        key_frame = buffer[position] & SCHEMA_HEADER_KEY_FRAME;
+        frame_sequence = buffer[position++] >> SCHEMA_HEADER_SEQUENCE_SHIFT;
+
+        // a delta after a gap would be added to the wrong previous values
+        if(!key_frame && (!synchronized || frame_sequence != sequence))
+        {
+            synchronized = false;
+            return false;
+        }
+    }
+
+    for(uint8_t i = 0; i < schema.nb_field; ++i)
+    {
+        schema_encoding encoding = schema.fields[i].encoding;
+        uint8_t size = schemaFieldMaxSize(encoding);
+        uint32_t value = 0;
+
+        if(encoding == FIELD_VARINT || encoding == FIELD_DELTA)
+        {
+            int32_t varint;
+            size = getVarint(buffer + position, nb_byte - position, varint);
+            if(size == 0)
+            {
+                synchronized = false;
+                return false;
+            }
+
+            if(encoding == FIELD_DELTA && !key_frame)
+            {
+                varint = (int32_t)((uint32_t)previous[i] + (uint32_t)varint);
+            }
+            values[i] = varint;
+        }
+        else
+        {
+            if(position + size > nb_byte)
+            {
+                synchronized = false;
+                return false;
+            }
+
+            for(uint8_t j = size; j > 0; --j)
+            {
+                value = (value << 8) | buffer[position + j - 1];
+            }
+
+            // sign extension of the signed fields
+            switch(encoding)
+            {
+                case FIELD_I8: values[i] = (int8_t)value; break;
+                case FIELD_I16: values[i] = (int16_t)value; break;
+                default: values[i] = (int32_t)value; break;
+            }
+        }
+
+        position += size;
+    }
+
+    // the delta fields are only committed once the whole frame is valid
+    for(uint8_t i = 0; i < schema.nb_field; ++i)
+    {
+        if(schema.fields[i].encoding == FIELD_DELTA)
+        {
+            previous[i] = values[i];
+        }
+    }
+    sequence = (frame_sequence + 1) & SCHEMA_HEADER_SEQUENCE_MASK;
+    synchronized = true;
+
+    return true;
+}
+
+float_t RS485Serializer::toFloat(const int32_t* values, uint8_t field) const
+{
+    return values[field]*schema.fields[field].scale;
+}
+
+void RS485Serializer::requestKeyFrame()
+{
+    frame_count = 0;
+}
+
+uint8_t RS485Serializer::putVarint(int32_t value, uint8_t* buffer)
+{
+    uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    uint8_t size = 0;
+
+    while(zigzag >= 0x80)
+    {
+        buffer[size++] = (zigzag & 0x7F) | 0x80;
+        zigzag >>= 7;
+    }
+    buffer[size++] = zigzag;
+
+    return size;
+}
+
+uint8_t RS485Serializer::getVarint(const uint8_t* buffer, uint8_t nb_byte, int32_t& value)
+{
+    uint32_t zigzag = 0;
+
+    for(uint8_t i = 0; i < nb_byte && i < SCHEMA_VARINT_MAX_SIZE; ++i)
+    {
+        zigzag |= (uint32_t)(buffer[i] & 0x7F) << (7*i);
+        if(!(buffer[i] & 0x80))
+        {
+            value = (int32_t)((zigzag >> 1) ^ (0U - (zigzag & 1)));
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
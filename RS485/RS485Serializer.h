@@ -0,0 +1,108 @@
+/**
+ * @file RS485Serializer.h
+ * @brief Compact encoder and decoder of the payloads described by a RS485_schema
+ *
+ * The encoding uses integer math only. One serializer encodes or decodes one stream
+ * (one command of one board): the delta fields are relative to the last frame of the stream.
+ * A key frame with the absolute values is sent every key_frame_interval frames.
+ * The header carries a rolling sequence number: a decoder that sees a gap (a frame lost
+ * or rejected) drops the delta frames until the next key frame. The number wraps at 128,
+ * a key frame is sent before that with any key_frame_interval below 128.
+ *
+ */
+
+#ifndef RS485_SERIALIZER_H
+#define RS485_SERIALIZER_H
+
+#include "mbed.h"
+
+#include "RS485_schema.h"
+
+/**
+ * @brief encoder and decoder of one stream of payloads
+ *
+ */
+class RS485Serializer
+{
+    public:
+
+        /**
+         * @brief RS485Serializer constructor
+         *
+         * @param schema the schema of the payload, it must stay valid as long as the serializer
+         * @param key_frame_interval the number of frames between two key frames
+         */
+        RS485Serializer(const RS485_schema& schema, uint8_t key_frame_interval = 10);
+
+        /**
+         * @brief Destroy the RS485Serializer object
+         *
+         */
+        ~RS485Serializer();
+
+        /**
+         * @brief Encode the values of one frame
+         *
+         * @param values one value per field of the schema
+         * @param buffer the buffer of the payload, schemaMaxSize() bytes
+         * @return uint8_t the size of the payload, 0 if the serializer got no memory
+         */
+        uint8_t encode(const int32_t* values, uint8_t* buffer);
+
+        /**
+         * @brief Decode the payload of one frame
+         *
+         * @param buffer the payload
+         * @param nb_byte the size of the payload
+         * @param values one value per field of the schema
+         * @return true if the payload is valid and no frame is missing since the last key frame
+         */
+        bool decode(const uint8_t* buffer, uint8_t nb_byte, int32_t* values);
+
+        /**
+         * @brief Get a decoded value in the usual unit of the field
+         *
+         * @param values the decoded values
+         * @param field the index of the field
+         * @return float_t the value multiplied by the scale of the field
+         */
+        float_t toFloat(const int32_t* values, uint8_t field) const;
+
+        /**
+         * @brief Send a key frame with the next encode
+         *
+         */
+        void requestKeyFrame();
+
+        /**
+         * @brief write a zig-zag varint
+         *
+         * @param value the value
+         * @param buffer the buffer
+         * @return uint8_t the number of bytes written
+         */
+        static uint8_t putVarint(int32_t value, uint8_t* buffer);
+
+        /**
+         * @brief read a zig-zag varint
+         *
+         * @param buffer the buffer
+         * @param nb_byte the number of bytes left in the buffer
+         * @param value the value
+         * @return uint8_t the number of bytes read, 0 if the varint is truncated
+         */
+        static uint8_t getVarint(const uint8_t* buffer, uint8_t nb_byte, int32_t& value);
+
+    private:
+
+        RS485_schema schema;
+        bool has_delta;
+        uint8_t key_frame_interval;
+        uint8_t frame_count = 0;
+        uint8_t sequence = 0; // next sequence number, sent by the encoder or expected by the decoder
+        bool synchronized = false;
+
+        int32_t* previous;
+};
+
+#endif
@@ -0,0 +1,165 @@
+/**
+ * @file RS485Subscriber.cpp
+ * @brief RS485Subscriber class source file
+ *
+ */
+
+#include "RS485Subscriber.h"
+
+#include "Utility/MemoryAlloc.h"
+
+RS485Subscriber::RS485Subscriber(RS485* rs, const uint8_t* cmd_array, uint8_t nb_command, uint8_t queue_size, uint8_t policy)
+{
+    this->rs = rs;
+    this->policy = policy;
+    this->queue_size = queue_size == 0 ? 1 : queue_size > RS485_SUBSCRIBER_MAX_QUEUE ? RS485_SUBSCRIBER_MAX_QUEUE : queue_size;
+
+    for(uint8_t i = 0; i < nb_command; ++i)
+    {
+        cmd_flag |= 1UL << cmd_array[i];
+    }
+
+    queue = (RS485_packet**)memoryAlloc(MEMORY_MODULE_RS485, sizeof(RS485_packet*)*this->queue_size);
+
+    subscribed = queue != NULL && rs->subscribe(this);
+}
+
+RS485Subscriber::~RS485Subscriber()
+{
+    if(subscribed)
+    {
+        rs->unsubscribe(this);
+    }
+
+    for(; count > 0; --count)
+    {
+        rs->releasePacket(queue[head]);
+        head = (head + 1) % queue_size;
+    }
+    memoryFree(queue);
+}
+
+const RS485_packet* RS485Subscriber::read(uint32_t timeout_ms)
+{
+    if(!subscribed)
+    {
+        return NULL;
+    }
+
+    while(1)
+    {
+        queue_mutex.lock();
+        if(canceled)
+        {
+            queue_mutex.unlock();
+            return NULL;
+        }
+        if(count > 0)
+        {
+            RS485_packet* packet = queue[head];
+            head = (head + 1) % queue_size;
+            count--;
+            queue_mutex.unlock();
+            return packet;
+        }
+
+        // a push after the clear sets the flag again
+        queue_event.clear(RS485_SUBSCRIBER_FLAG);
+        queue_mutex.unlock();
+
+        if(queue_event.wait_any(RS485_SUBSCRIBER_FLAG, timeout_ms) & osFlagsError)
+        {
+            return NULL;
+        }
+    }
+}
+
+uint8_t RS485Subscriber::read(uint8_t& returned_slave, uint8_t& returned_cmd, uint8_t* data_buffer)
+{
+    const RS485_packet* packet = read();
+    if(packet == NULL)
+    {
+        return 0;
+    }
+
+    uint8_t nb_byte = packet->nb_byte;
+
+    returned_slave = packet->slave;
+    returned_cmd = packet->cmd;
+    memcpy(data_buffer, packet->data, nb_byte);
+    release(packet);
+
+    return nb_byte;
+}
+
+void RS485Subscriber::release(const RS485_packet* packet)
+{
+    rs->releasePacket(packet);
+}
+
+void RS485Subscriber::cancel()
+{
+    queue_mutex.lock();
+    canceled = true;
+    queue_mutex.unlock();
+
+    queue_event.set(RS485_SUBSCRIBER_FLAG);
+}
+
+bool RS485Subscriber::isSubscribed()
+{
+    return subscribed;
+}
+
+uint8_t RS485Subscriber::getQueueSize()
+{
+    return queue_size;
+}
+
+uint32_t RS485Subscriber::getDropped()
+{
+    return dropped;
+}
+
+uint32_t RS485Subscriber::getCommandFlag()
+{
+    return cmd_flag;
+}
+
+void RS485Subscriber::push(RS485_packet* packet)
+{
+    RS485_packet* removed = NULL;
+
+    queue_mutex.lock();
+    if(count == queue_size)
+    {
+        dropped++;
+        if(policy == RS485_SUBSCRIBER_DROP_NEWEST)
+        {
+            removed = packet;
+            packet = NULL;
+        }
+        else
+        {
+            removed = queue[head];
+            head = (head + 1) % queue_size;
+            count--;
+        }
+    }
+
+    if(packet)
+    {
+        queue[(head + count) % queue_size] = packet;
+        count++;
+    }
+    queue_mutex.unlock();
+
+    if(removed)
+    {
+        rs->releasePacket(removed);
+    }
+    if(packet)
+    {
+        queue_event.set(RS485_SUBSCRIBER_FLAG);
+    }
+}
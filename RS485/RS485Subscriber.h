@@ -0,0 +1,144 @@
+/**
+ * @file RS485Subscriber.h
+ * @brief Delivery of the received frames to every thread interested in their command
+ *
+ * RS485::read() gives a frame to one reader only. A subscriber has its own bounded queue:
+ * the RS485 reader thread copies a frame once in a packet of the pool, and each subscriber
+ * of its command gets a reference to the same packet. The packet goes back to the pool
+ * when the last subscriber releases it. The pool has room for every queue, one packet
+ * being read per subscriber and the next copy of the reader thread.
+ *
+ * When a queue is full the policy of its subscriber drops the oldest packet of the queue
+ * or the new one, the other subscribers are not affected.
+ *
+ */
+
+#ifndef RS485_SUBSCRIBER_H
+#define RS485_SUBSCRIBER_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "RS485.h"
+
+#define RS485_SUBSCRIBER_DROP_OLDEST 0
+#define RS485_SUBSCRIBER_DROP_NEWEST 1
+#define RS485_SUBSCRIBER_QUEUE_SIZE 4
+
+#define RS485_SUBSCRIBER_FLAG 0x1
+
+/**
+ * @brief one consumer of the received frames
+ *
+ */
+class RS485Subscriber
+{
+    public:
+
+        /**
+         * @brief RS485Subscriber constructor, the packets are queued right away
+         *
+         * Check isSubscribed(): without room for one more subscriber nothing is ever queued.
+         *
+         * @param rs the RS485 of the board
+         * @param cmd_array the commands to receive
+         * @param nb_command the number of commands
+         * @param queue_size the number of packets waiting in the queue, at most RS485_SUBSCRIBER_MAX_QUEUE
+         * @param policy RS485_SUBSCRIBER_DROP_OLDEST or RS485_SUBSCRIBER_DROP_NEWEST when the queue is full
+         */
+        RS485Subscriber(RS485* rs, const uint8_t* cmd_array, uint8_t nb_command, uint8_t queue_size = RS485_SUBSCRIBER_QUEUE_SIZE,
+                        uint8_t policy = RS485_SUBSCRIBER_DROP_OLDEST);
+
+        /**
+         * @brief Destroy the RS485Subscriber object, the packets in the queue are released
+         *
+         */
+        ~RS485Subscriber();
+
+        /**
+         * @brief Wait for the next packet, without copy
+         *
+         * @param timeout_ms the time to wait
+         * @return const RS485_packet* the packet, to give back with release(), NULL after the timeout, when not subscribed or canceled
+         */
+        const RS485_packet* read(uint32_t timeout_ms = osWaitForever);
+
+        /**
+         * @brief Wait for the next packet and copy its data
+         *
+         * @param returned_slave the slave of the frame
+         * @param returned_cmd the command of the frame
+         * @param data_buffer the buffer of the data, 255 bytes
+         * @return uint8_t the size of the data, 0 when not subscribed or canceled
+         */
+        uint8_t read(uint8_t& returned_slave, uint8_t& returned_cmd, uint8_t* data_buffer);
+
+        /**
+         * @brief Give back a packet of read()
+         *
+         * @param packet the packet
+         */
+        void release(const RS485_packet* packet);
+
+        /**
+         * @brief Wake up the thread waiting in read(), every read() returns right away from now on
+         *
+         * Called before the owner joins its reader thread, the packets stay queued until the destructor.
+         *
+         */
+        void cancel();
+
+        /**
+         * @brief check if RS485 accepted the subscriber
+         *
+         * @return true if the packets are queued, false if RS485_MAX_SUBSCRIBER are there already or the pool can't grow
+         */
+        bool isSubscribed();
+
+        /**
+         * @brief Get the number of packets dropped because the queue was full
+         *
+         * @return uint32_t the number of packets
+         */
+        uint32_t getDropped();
+
+        /**
+         * @brief Get the size of the queue
+         *
+         * @return uint8_t the number of packets
+         */
+        uint8_t getQueueSize();
+
+        /**
+         * @brief Get the commands of the subscriber
+         *
+         * @return uint32_t one bit per command
+         */
+        uint32_t getCommandFlag();
+
+        /**
+         * @brief add a packet to the queue, called by the RS485 reader thread
+         *
+         * @param packet the packet, with one reference for this queue
+         */
+        void push(RS485_packet* packet);
+
+    private:
+
+        RS485* rs;
+        uint32_t cmd_flag = 0;
+        uint8_t policy;
+        bool subscribed = false;
+        volatile bool canceled = false;
+
+        Mutex queue_mutex;
+        EventFlags queue_event;
+
+        RS485_packet** queue;
+        uint8_t queue_size;
+        uint8_t head = 0;
+        uint8_t count = 0;
+        uint32_t dropped = 0;
+};
+
+#endif
@@ -0,0 +1,236 @@
+/**
+ * @file RS485TimeSync.cpp
+ * @brief RS485TimeSync class source file
+ *
+ */
+
+#include "RS485TimeSync.h"
+
+#include "RS485_definition.h"
+
+RS485TimeSync::RS485TimeSync(RS485* rs, Timebase* timebase, bool master, uint32_t period_ms, osPriority thread_priority)
+    : syncThread(thread_priority, OS_STACK_SIZE, NULL, "time_sync"), broadcastThread(thread_priority, OS_STACK_SIZE, NULL, "time_bcast")
+{
+    this->rs = rs;
+    this->timebase = timebase;
+    this->master = master;
+    this->period_ms = period_ms;
+
+    rs->setTimebase(timebase);
+
+    if(master)
+    {
+        uint8_t cmd_array[1] = {CMD_TIME_REQ};
+        subscriber = new RS485Subscriber(rs, cmd_array, 1);
+        syncThread.start(callback(this, &RS485TimeSync::master_thread));
+        broadcastThread.start(callback(this, &RS485TimeSync::broadcast_thread));
+    }
+    else
+    {
+        uint8_t cmd_array[2] = {CMD_TIME_SYNC, CMD_TIME_REQ};
+        subscriber = new RS485Subscriber(rs, cmd_array, 2);
+        syncThread.start(callback(this, &RS485TimeSync::slave_thread));
+    }
+}
+
+RS485TimeSync::~RS485TimeSync()
+{
+    subscriber->cancel();
+    stop_event.set(TIME_SYNC_STOP_FLAG);
+
+    syncThread.join();
+    if(master)
+    {
+        broadcastThread.join();
+    }
+    delete subscriber;
+}
+
+int32_t RS485TimeSync::getLastError()
+{
+    return last_error;
+}
+
+uint32_t RS485TimeSync::getPathDelay()
+{
+    return path_delay;
+}
+
+uint32_t RS485TimeSync::getSyncCount()
+{
+    return sync_count;
+}
+
+uint32_t RS485TimeSync::getOutlierCount()
+{
+    return outlier_count;
+}
+
+void RS485TimeSync::putTime(uint8_t* array, uint64_t time, uint8_t offset)
+{
+    for(uint8_t i = 0; i < 8; ++i)
+    {
+        array[offset + i] = (uint8_t)(time >> (8*i));
+    }
+}
+
+uint64_t RS485TimeSync::getTime(const uint8_t* array, uint8_t offset)
+{
+    uint64_t time = 0;
+
+    for(uint8_t i = 8; i > 0; --i)
+    {
+        time = (time << 8) | array[offset + i - 1];
+    }
+    return time;
+}
+
+void RS485TimeSync::synchronize(uint64_t master_us, uint64_t received_us)
+{
+    // offset of the master time measured by this frame
+    int64_t measured = (int64_t)(master_us + path_delay - received_us);
+
+    if(!timebase->isSynchronized())
+    {
+        timebase->adjust(received_us, measured, 0);
+        sync_count++;
+        return;
+    }
+
+    int64_t predicted = (int64_t)(timebase->toShared(received_us) - received_us);
+    int64_t error = measured - predicted;
+
+    if(error > TIME_SYNC_OUTLIER_US || error < -TIME_SYNC_OUTLIER_US)
+    {
+        outlier_count++;
+        if(++consecutive_outlier < TIME_SYNC_MAX_OUTLIER)
+        {
+            return;
+        }
+
+        // the time really moved, keep the drift and set the time again
+        timebase->adjust(received_us, measured, timebase->getDrift());
+        consecutive_outlier = 0;
+        last_error = (int32_t)error;
+        sync_count++;
+        return;
+    }
+    consecutive_outlier = 0;
+
+    // proportional correction of the offset, integral correction of the drift
+    int64_t drift = timebase->getDrift() + error*1000000LL/period_ms/TIME_SYNC_FREQUENCY_GAIN;
+    if(drift > INT32_MAX) drift = INT32_MAX;
+    if(drift < INT32_MIN) drift = INT32_MIN;
+
+    timebase->adjust(received_us, predicted + error/TIME_SYNC_PHASE_GAIN, (int32_t)drift);
+
+    last_error = (int32_t)error;
+    sync_count++;
+}
+
+void RS485TimeSync::roundTrip(const uint8_t* reply, uint64_t received_us)
+{
+    uint64_t t1 = getTime(reply, 0);
+    uint64_t t2 = getTime(reply, 8);
+    uint64_t t3 = getTime(reply, 16);
+    int64_t delay = (int64_t)(received_us - t1) - (int64_t)(t3 - t2);
+
+    if(delay > 2*TIME_SYNC_OUTLIER_US)
+    {
+        return;
+    }
+    if(delay < 0)
+    {
+        delay = 0;
+    }
+
+    if(!path_delay_valid)
+    {
+        path_delay = (uint32_t)(delay/2);
+        path_delay_valid = true;
+    }
+    else
+    {
+        path_delay = (uint32_t)((int64_t)path_delay + (delay/2 - (int64_t)path_delay)/TIME_SYNC_DELAY_FILTER);
+    }
+}
+
+void RS485TimeSync::slave_thread()
+{
+    uint8_t request[TIME_SYNC_REQUEST_SIZE] = {0};
+
+    while(1)
+    {
+        // NULL once canceled by the destructor, or never subscribed
+        const RS485_packet* packet = subscriber->read();
+        if(packet == NULL)
+        {
+            return;
+        }
+
+        if(packet->cmd == CMD_TIME_SYNC && packet->nb_byte == TIME_SYNC_BROADCAST_SIZE)
+        {
+            synchronize(getTime(packet->data, 0), packet->timestamp_us);
+
+            if(packet->data[8] == rs->getBoardAdress())
+            {
+                rs->writeStamped(rs->getBoardAdress(), CMD_TIME_REQ, TIME_SYNC_REQUEST_SIZE, request, 0);
+            }
+        }
+        else if(packet->cmd == CMD_TIME_REQ && packet->nb_byte == TIME_SYNC_REPLY_SIZE && packet->slave == rs->getBoardAdress())
+        {
+            roundTrip(packet->data, packet->timestamp_us);
+        }
+
+        subscriber->release(packet);
+    }
+}
+
+void RS485TimeSync::master_thread()
+{
+    uint8_t reply[TIME_SYNC_REPLY_SIZE];
+
+    while(1)
+    {
+        const RS485_packet* packet = subscriber->read();
+        if(packet == NULL)
+        {
+            return;
+        }
+
+        // the answers of the master come back on its own port
+        if(packet->nb_byte == TIME_SYNC_REQUEST_SIZE)
+        {
+            memcpy(reply, packet->data, TIME_SYNC_REQUEST_SIZE);
+            putTime(reply, packet->timestamp_us, 8);
+            rs->writeStamped(packet->slave, CMD_TIME_REQ, TIME_SYNC_REPLY_SIZE, reply, 16);
+        }
+
+        subscriber->release(packet);
+    }
+}
+
+void RS485TimeSync::broadcast_thread()
+{
+    uint8_t broadcast[TIME_SYNC_BROADCAST_SIZE] = {0};
+
+    while(1)
+    {
+        // one slave per period measures its path delay
+        do
+        {
+            slot = (slot + 1) % RS485_MAX_SLAVE;
+        }
+        while(!(SLAVE_MASK_ALL & SLAVE_MASK(slot)));
+
+        broadcast[8] = slot;
+        rs->writeStamped(SLAVE_BROADCAST, CMD_TIME_SYNC, TIME_SYNC_BROADCAST_SIZE, broadcast, 0);
+        sync_count++;
+
+        uint32_t flags = stop_event.wait_any(TIME_SYNC_STOP_FLAG, period_ms);
+        if(!(flags & osFlagsError) && (flags & TIME_SYNC_STOP_FLAG))
+        {
+            return;
+        }
+    }
+}
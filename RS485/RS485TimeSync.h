@@ -0,0 +1,166 @@
+/**
+ * @file RS485TimeSync.h
+ * @brief Synchronization of the Timebase of the boards on the time of the bus master
+ *
+ * The master broadcasts CMD_TIME_SYNC every period with the time of the start of the frame,
+ * written by RS485::writeStamped() once the bus is acquired. A slave compares it with the time
+ * it received the frame plus the path delay, and corrects the offset and the drift of its Timebase.
+ *
+ * The path delay (reception latency of the frame) is measured by a round trip: the broadcast gives
+ * a slot to one slave, that slave sends CMD_TIME_REQ with its time t1, the master answers with t1,
+ * its reception time t2 and its transmission time t3, the slave receives the answer at t4.
+ * Only one slave talks per period, the requests never collide.
+ * A frame delayed between its stamp and the bus (interrupt, preemption) gives one large error,
+ * it is ignored instead of pulling the drift.
+ *
+ * The master must receive all the frames (SLAVE_STATE_SCREEN), its time is its local time.
+ *
+ */
+
+#ifndef RS485_TIME_SYNC_H
+#define RS485_TIME_SYNC_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "RS485.h"
+#include "RS485Subscriber.h"
+#include "Utility/Timebase.h"
+
+#define TIME_SYNC_BROADCAST_SIZE 9 // master time, slot
+#define TIME_SYNC_REQUEST_SIZE 8   // t1
+#define TIME_SYNC_REPLY_SIZE 24    // t1, t2, t3
+#define TIME_SYNC_PHASE_GAIN 2     // the offset moves by 1/2 of the error
+#define TIME_SYNC_FREQUENCY_GAIN 8 // the drift moves by 1/8 of the error over a period
+#define TIME_SYNC_DELAY_FILTER 4
+#define TIME_SYNC_OUTLIER_US 1000  // a larger error is a late frame, ignored...
+#define TIME_SYNC_MAX_OUTLIER 3    // ...unless it repeats, then the time is set again
+#define TIME_SYNC_STOP_FLAG 0x1
+
+/**
+ * @brief time synchronization over RS485, master or slave
+ *
+ */
+class RS485TimeSync
+{
+    public:
+
+        /**
+         * @brief RS485TimeSync constructor, the threads start right away
+         *
+         * @param rs the RS485 of the board, its timebase is set to timebase
+         * @param timebase the timebase of the board, adjusted on a slave
+         * @param master true on the bus master
+         * @param period_ms the period of the broadcasts of the master
+         * @param thread_priority priority of the threads, higher than osPriorityBelowNormal
+         */
+        RS485TimeSync(RS485* rs, Timebase* timebase, bool master, uint32_t period_ms = 1000, osPriority thread_priority = osPriorityAboveNormal);
+
+        /**
+         * @brief Destroy the RS485TimeSync object, the threads are joined
+         *
+         */
+        ~RS485TimeSync();
+
+        /**
+         * @brief Get the error of the time at the last broadcast, before its correction
+         *
+         * @return int32_t the error in us, positive if the board was late
+         */
+        int32_t getLastError();
+
+        /**
+         * @brief Get the path delay measured by the round trips
+         *
+         * @return uint32_t the delay in us
+         */
+        uint32_t getPathDelay();
+
+        /**
+         * @brief Get the number of broadcasts sent or used
+         *
+         * @return uint32_t the number of broadcasts
+         */
+        uint32_t getSyncCount();
+
+        /**
+         * @brief Get the number of broadcasts ignored because of their error
+         *
+         * @return uint32_t the number of broadcasts
+         */
+        uint32_t getOutlierCount();
+
+    private:
+
+        RS485* rs;
+        Timebase* timebase;
+        bool master;
+        uint32_t period_ms;
+
+        RS485Subscriber* subscriber;
+        Thread syncThread;
+        Thread broadcastThread;
+        EventFlags stop_event;
+
+        int32_t last_error = 0;
+        uint32_t path_delay = 0;
+        bool path_delay_valid = false;
+        uint32_t sync_count = 0;
+        uint32_t outlier_count = 0;
+        uint8_t consecutive_outlier = 0;
+        uint8_t slot = 0;
+
+        /**
+         * @brief put a time in a payload, 8 bytes little-endian
+         *
+         * @param array the payload
+         * @param time the time
+         * @param offset the position in the payload
+         */
+        static void putTime(uint8_t* array, uint64_t time, uint8_t offset);
+
+        /**
+         * @brief get a time from a payload, 8 bytes little-endian
+         *
+         * @param array the payload
+         * @param offset the position in the payload
+         * @return uint64_t the time
+         */
+        static uint64_t getTime(const uint8_t* array, uint8_t offset);
+
+        /**
+         * @brief correct the timebase with a broadcast of the master
+         *
+         * @param master_us the time of the master at the start of the frame
+         * @param received_us the local time at the start of the frame
+         */
+        void synchronize(uint64_t master_us, uint64_t received_us);
+
+        /**
+         * @brief measure the path delay with the answer of the master
+         *
+         * @param reply the payload of the answer
+         * @param received_us the local time at the start of the answer
+         */
+        void roundTrip(const uint8_t* reply, uint64_t received_us);
+
+        /**
+         * @brief thread of the slave, reads the broadcasts and the answers
+         *
+         */
+        void slave_thread();
+
+        /**
+         * @brief thread of the master, answers the requests
+         *
+         */
+        void master_thread();
+
+        /**
+         * @brief thread of the master, sends the broadcasts
+         *
+         */
+        void broadcast_thread();
+};
+
+#endif
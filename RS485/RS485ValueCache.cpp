@@ -0,0 +1,133 @@
+/**
+ * @file RS485ValueCache.cpp
+ * @brief RS485ValueCache class source file
+ *
+ */
+
+#include "RS485ValueCache.h"
+
+#include "Utility/utility.h"
+#include "Utility/MemoryAlloc.h"
+
+RS485ValueCache::RS485ValueCache(RS485* rs, const uint8_t* cmd_array, uint8_t nb_command, osPriority thread_priority)
+    : cacheThread(thread_priority, OS_STACK_SIZE, NULL, "rs485_cache")
+{
+    entries = (cache_entry*)memoryAlloc(MEMORY_MODULE_RS485, sizeof(cache_entry)*RS485_CACHE_SIZE);
+    if(entries == NULL)
+    {
+        return;
+    }
+
+    // a copy of every frame, the other readers of these commands still get theirs
+    subscriber = new RS485Subscriber(rs, cmd_array, nb_command, RS485_SUBSCRIBER_MAX_QUEUE);
+
+    cacheThread.start(callback(this, &RS485ValueCache::cache_thread));
+}
+
+RS485ValueCache::~RS485ValueCache()
+{
+    if(subscriber)
+    {
+        subscriber->cancel();
+        cacheThread.join();
+        delete subscriber;
+    }
+
+    memoryFree(entries);
+    entries = NULL;
+}
+
+uint8_t RS485ValueCache::get(uint8_t slave, uint8_t cmd, uint8_t* payload)
+{
+    uint8_t nb_byte = 0;
+
+    cache_mutex.lock();
+    cache_entry* entry = find(slave, cmd);
+    if(entry)
+    {
+        nb_byte = entry->nb_byte;
+        memcpy(payload, entry->payload, nb_byte);
+    }
+    cache_mutex.unlock();
+
+    return nb_byte;
+}
+
+bool RS485ValueCache::getFloat(uint8_t slave, uint8_t cmd, float_t& value)
+{
+    uint8_t payload[RS485_CACHE_MAX_PAYLOAD];
+
+    if(get(slave, cmd, payload) < 4)
+    {
+        return false;
+    }
+
+    memcpy(&value, payload, 4);
+    return true;
+}
+
+uint32_t RS485ValueCache::getAge(uint8_t slave, uint8_t cmd)
+{
+    uint32_t age = osWaitForever;
+
+    cache_mutex.lock();
+    cache_entry* entry = find(slave, cmd);
+    if(entry)
+    {
+        age = (uint32_t)(Kernel::get_ms_count() - entry->received_ms);
+    }
+    cache_mutex.unlock();
+
+    return age;
+}
+
+cache_entry* RS485ValueCache::find(uint8_t slave, uint8_t cmd)
+{
+    for(uint8_t i = 0; i < nb_entry; ++i)
+    {
+        if(entries[i].slave == slave && entries[i].cmd == cmd)
+        {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+void RS485ValueCache::cache_thread()
+{
+    while(1)
+    {
+        // NULL once canceled by the destructor, or never subscribed
+        const RS485_packet* packet = subscriber->read();
+        if(packet == NULL)
+        {
+            return;
+        }
+
+        uint8_t nb_byte = packet->nb_byte;
+        if(nb_byte > RS485_CACHE_MAX_PAYLOAD)
+        {
+            nb_byte = RS485_CACHE_MAX_PAYLOAD;
+        }
+
+        cache_mutex.lock();
+
+        cache_entry* entry = find(packet->slave, packet->cmd);
+        if(entry == NULL && nb_entry < RS485_CACHE_SIZE)
+        {
+            entry = &entries[nb_entry++];
+            entry->slave = packet->slave;
+            entry->cmd = packet->cmd;
+        }
+        if(entry)
+        {
+            memcpy(entry->payload, packet->data, nb_byte);
+            entry->nb_byte = nb_byte;
+            entry->received_ms = Kernel::get_ms_count();
+        }
+
+        cache_mutex.unlock();
+
+        subscriber->release(packet);
+    }
+}
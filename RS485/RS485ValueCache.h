@@ -0,0 +1,117 @@
+/**
+ * @file RS485ValueCache.h
+ * @brief Last value of the telemetry received from the boards
+ *
+ * The boards that use RS485Publisher only send a value when it changes, the cache keeps
+ * the last payload of every (slave, command) so the value can be read at any time.
+ * The age of the entry tells if the board is still publishing, it should never be
+ * older than the heartbeat of the channel.
+ *
+ */
+
+#ifndef RS485_VALUE_CACHE_H
+#define RS485_VALUE_CACHE_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "RS485.h"
+#include "RS485Subscriber.h"
+
+#define RS485_CACHE_SIZE 32
+#define RS485_CACHE_MAX_PAYLOAD 16
+
+/**
+ * @brief last payload of one (slave, command)
+ *
+ */
+typedef struct cache_entry_struct
+{
+    uint8_t slave;
+    uint8_t cmd;
+    uint8_t nb_byte;
+    uint8_t payload[RS485_CACHE_MAX_PAYLOAD];
+    uint64_t received_ms;
+} cache_entry;
+
+/**
+ * @brief last value cache fed by a RS485 reader thread
+ *
+ */
+class RS485ValueCache
+{
+    public:
+
+        /**
+         * @brief RS485ValueCache constructor, the reader thread starts right away
+         *
+         * Without memory for the entries the thread is not started and nothing is ever cached.
+         *
+         * @param rs the RS485 of the board
+         * @param cmd_array the commands to cache
+         * @param nb_command the number of commands
+         * @param thread_priority priority of the reader thread, higher than osPriorityBelowNormal
+         */
+        RS485ValueCache(RS485* rs, const uint8_t* cmd_array, uint8_t nb_command, osPriority thread_priority = osPriorityNormal);
+
+        /**
+         * @brief Destroy the RS485ValueCache object, the reader thread is joined
+         *
+         */
+        ~RS485ValueCache();
+
+        /**
+         * @brief Get the last payload of a (slave, command)
+         *
+         * @param slave the slave
+         * @param cmd the command
+         * @param payload the buffer of the payload, RS485_CACHE_MAX_PAYLOAD bytes
+         * @return uint8_t the size of the payload, 0 if nothing was received
+         */
+        uint8_t get(uint8_t slave, uint8_t cmd, uint8_t* payload);
+
+        /**
+         * @brief Get the last float of a (slave, command) sent with putFloatInArray()
+         *
+         * @param slave the slave
+         * @param cmd the command
+         * @param value the value
+         * @return true if a value was received
+         */
+        bool getFloat(uint8_t slave, uint8_t cmd, float_t& value);
+
+        /**
+         * @brief Get the time since the last payload of a (slave, command)
+         *
+         * @param slave the slave
+         * @param cmd the command
+         * @return uint32_t the age in ms, osWaitForever if nothing was received
+         */
+        uint32_t getAge(uint8_t slave, uint8_t cmd);
+
+    private:
+
+        RS485Subscriber* subscriber = NULL;
+        Thread cacheThread;
+        Mutex cache_mutex;
+
+        cache_entry* entries;
+        uint8_t nb_entry = 0;
+
+        /**
+         * @brief find the entry of a (slave, command)
+         *
+         * @param slave the slave
+         * @param cmd the command
+         * @return cache_entry* the entry, NULL if there is none
+         */
+        cache_entry* find(uint8_t slave, uint8_t cmd);
+
+        /**
+         * @brief the reader thread
+         *
+         */
+        void cache_thread();
+};
+
+#endif
@@ -1,3 +1,9 @@
+#ifndef RS485_DEFINITION_H
+#define RS485_DEFINITION_H
+
+#include "RS485_schema.h"
+#include "RS485_registry.h"
+
 //###################################################
 //              SLAVE DEFINITION
 //###################################################
@@ -11,6 +17,10 @@
 #define SLAVE_IO 6
 #define SLAVE_STATE_SCREEN 7
 #define SLAVE_PWR_MANAGEMENT 8
+#define SLAVE_BROADCAST 15 // accepted by every board
+
+#define SLAVE_MASK_PSU (SLAVE_MASK(SLAVE_PSU0) | SLAVE_MASK(SLAVE_PSU1) | SLAVE_MASK(SLAVE_PSU2) | SLAVE_MASK(SLAVE_PSU3))
+#define SLAVE_MASK_ALL 0x01FF
 
 //###################################################
 //              CMD DEFINITION
@@ -24,11 +34,14 @@
 #define CMD_VOLTAGE 0
 #define CMD_CURRENT 1
 #define CMD_TEMPERATURE 2
+#define CMD_POWER_WINDOW 3
+#define CMD_POWER_RAW 4
 
 // define backplane/ESC
 #define CMD_READ_MOTOR 15
 #define CMD_ACT_MOTOR 16
 #define CMD_PWM 17
+#define CMD_MOTOR_SET 18 // all the motors in one frame, see RS485MotorSet
 
 // define IO CONTROL
 #define CMD_IO_TEMP  0
@@ -38,6 +51,12 @@
 #define CMD_IO_LEAK_SENSOR 4
 
 // COMMON DEFINITION
+#define CMD_ACK 24
+#define CMD_BAUD 25
+#define CMD_MEMORY 26
+#define CMD_TRACE 27
+#define CMD_TIME_REQ 28
+#define CMD_TIME_SYNC 29
 #define CMD_IS_ALIVE 30
 
 //###################################################
@@ -57,3 +76,96 @@
 
 #define DATA_IO_LEAK_SENSOR_DRY 0
 #define DATA_IO_LEAK_SENSOR_LEAK 1
+
+// define COMMON, CMD_BAUD of RS485Baud, also followed by RS485LinuxMaster
+
+#define RS485_BAUD_NB_RATE 6
+#define RS485_BAUD_RATES {115200, 230400, 460800, 921600, 1000000, 2000000} // bit i of a mask, the first one is RS485_BAUDRATE
+#define RS485_BAUD_REQUEST_SIZE 4       // operation, rate, delay
+#define RS485_BAUD_REPLY_SIZE 3         // operation, supported rates, current rate
+#define RS485_BAUD_OP_QUERY 0
+#define RS485_BAUD_OP_SWITCH 1
+#define RS485_BAUD_OP_KEEP 2            // master, away from the base rate, every RS485_BAUD_CHECK_MS
+#define RS485_BAUD_SILENCE_MS 3000      // without a request the boards go back to the base rate
+
+//###################################################
+//              SCHEMA DEFINITION
+//###################################################
+
+// define backplane/PSU, to use with RS485Serializer
+
+constexpr schema_field SCHEMA_FIELDS_PSU_VOLTAGE[] = {
+    {FIELD_DELTA, 0.001f}  // mV
+};
+constexpr schema_field SCHEMA_FIELDS_PSU_CURRENT[] = {
+    {FIELD_DELTA, 0.001f}  // mA
+};
+constexpr schema_field SCHEMA_FIELDS_PSU_TEMPERATURE[] = {
+    {FIELD_I16, 0.01f}     // 0.01 degC
+};
+constexpr schema_field SCHEMA_FIELDS_PSU_POWER_WINDOW[] = {
+    {FIELD_VARINT, 1.0f},  // number of samples
+    {FIELD_DELTA, 0.001f}, // min current mA
+    {FIELD_DELTA, 0.001f}, // max current mA
+    {FIELD_DELTA, 0.001f}, // mean current mA
+    {FIELD_DELTA, 0.001f}, // rms current mA
+    {FIELD_DELTA, 0.001f}, // min voltage mV
+    {FIELD_DELTA, 0.001f}, // max voltage mV
+    {FIELD_DELTA, 0.001f}, // mean voltage mV
+    {FIELD_DELTA, 0.001f}  // rms voltage mV
+};
+
+constexpr RS485_schema SCHEMA_PSU_VOLTAGE = SCHEMA(SCHEMA_FIELDS_PSU_VOLTAGE);
+constexpr RS485_schema SCHEMA_PSU_CURRENT = SCHEMA(SCHEMA_FIELDS_PSU_CURRENT);
+constexpr RS485_schema SCHEMA_PSU_TEMPERATURE = SCHEMA(SCHEMA_FIELDS_PSU_TEMPERATURE);
+constexpr RS485_schema SCHEMA_PSU_POWER_WINDOW = SCHEMA(SCHEMA_FIELDS_PSU_POWER_WINDOW);
+
+//###################################################
+//              COMMAND REGISTRY
+//###################################################
+
+// a payload size of RS485_MAX_PAYLOAD is not checked, the layout belongs to the board firmware:
+// the responses of the kill switch and the temperature of the IO board are not described in this library
+// the response sizes of the PSU fit the float payloads and the schemas
+// the commands flagged RS485_FLAG_RELIABLE may be sent and read with RS485Reliable, when both sides enable them
+
+constexpr RS485_command RS485_COMMANDS[] = {
+    // slaves                             cmd                    request  response            schema                    flags
+    {SLAVE_MASK(SLAVE_KILLMISSION),       CMD_MISSION,           0,       RS485_MAX_PAYLOAD,  nullptr,                  0},
+    {SLAVE_MASK(SLAVE_KILLMISSION),       CMD_KILL,              0,       RS485_MAX_PAYLOAD,  nullptr,                  RS485_FLAG_RELIABLE},
+
+    {SLAVE_MASK_PSU,                      CMD_VOLTAGE,           0,       6,                  &SCHEMA_PSU_VOLTAGE,      0},
+    {SLAVE_MASK_PSU,                      CMD_CURRENT,           0,       6,                  &SCHEMA_PSU_CURRENT,      0},
+    {SLAVE_MASK_PSU,                      CMD_TEMPERATURE,       0,       4,                  &SCHEMA_PSU_TEMPERATURE,  0},
+    {SLAVE_MASK_PSU,                      CMD_POWER_WINDOW,      0,       46,                 &SCHEMA_PSU_POWER_WINDOW, 0},
+    {SLAVE_MASK_PSU,                      CMD_POWER_RAW,         0,       250,                nullptr,                  0},
+
+    {SLAVE_MASK(SLAVE_ESC),               CMD_READ_MOTOR,        RS485_MAX_PAYLOAD, RS485_MAX_PAYLOAD, nullptr,                  0},
+    {SLAVE_MASK(SLAVE_ESC),               CMD_ACT_MOTOR,         RS485_MAX_PAYLOAD, RS485_MAX_PAYLOAD, nullptr,                  RS485_FLAG_RELIABLE},
+    {SLAVE_MASK(SLAVE_ESC),               CMD_PWM,               RS485_MAX_PAYLOAD, RS485_MAX_PAYLOAD, nullptr,                  0},
+    {SLAVE_MASK(SLAVE_ESC),               CMD_MOTOR_SET,         28,      2,                  nullptr,                  0},
+
+    {SLAVE_MASK(SLAVE_IO),                CMD_IO_TEMP,           0,       RS485_MAX_PAYLOAD,  nullptr,                  0},
+    {SLAVE_MASK(SLAVE_IO),                CMD_IO_DROPPER_ACTION, 1,       1,                  nullptr,                  0},
+    {SLAVE_MASK(SLAVE_IO),                CMD_IO_TORPEDO_ACTION, 1,       1,                  nullptr,                  RS485_FLAG_RELIABLE},
+    {SLAVE_MASK(SLAVE_IO),                CMD_IO_ARM_ACTION,     1,       1,                  nullptr,                  0},
+    {SLAVE_MASK(SLAVE_IO),                CMD_IO_LEAK_SENSOR,    0,       1,                  nullptr,                  0},
+
+    {SLAVE_MASK_ALL,                      CMD_ACK,               9,       9,                  nullptr,                  0},
+    {SLAVE_MASK_ALL | SLAVE_MASK(SLAVE_BROADCAST), CMD_BAUD,  4,       3,                  nullptr,                  0},
+    {SLAVE_MASK_ALL,                      CMD_MEMORY,            2,       243,                nullptr,                  0},
+    {SLAVE_MASK_ALL,                      CMD_TRACE,             0,       242,                nullptr,                  0},
+    {SLAVE_MASK_ALL,                      CMD_TIME_REQ,          24,      8,                  nullptr,                  0},
+    {SLAVE_MASK(SLAVE_BROADCAST),         CMD_TIME_SYNC,         9,       0,                  nullptr,                  0},
+    {SLAVE_MASK_ALL,                      CMD_IS_ALIVE,          0,       0,                  nullptr,                  0}
+};
+
+#define RS485_NB_COMMAND (sizeof(RS485_COMMANDS)/sizeof(RS485_COMMANDS[0]))
+
+static_assert(RS485_registryCheck(RS485_COMMANDS, RS485_NB_COMMAND) != RS485_REGISTRY_BAD_CMD, "a command doesn't fit in the event flags");
+static_assert(RS485_registryCheck(RS485_COMMANDS, RS485_NB_COMMAND) != RS485_REGISTRY_BAD_SLAVE, "a command has no slave");
+static_assert(RS485_registryCheck(RS485_COMMANDS, RS485_NB_COMMAND) != RS485_REGISTRY_BAD_PAYLOAD, "a payload doesn't fit in a frame");
+static_assert(RS485_registryCheck(RS485_COMMANDS, RS485_NB_COMMAND) != RS485_REGISTRY_OVERLAP, "a command is defined twice for the same slave");
+static_assert(RS485_registryCheck(RS485_COMMANDS, RS485_NB_COMMAND) == RS485_REGISTRY_OK, "invalid command registry");
+
+#endif
@@ -0,0 +1,178 @@
+/**
+ * @file RS485_frame.cpp
+ * @brief Portable framing source file
+ *
+ */
+
+#include "RS485_frame.h"
+
+#include <string.h>
+
+#include "RS485_definition.h"
+
+#define PARSER_START 0
+#define PARSER_SLAVE 1
+#define PARSER_CMD 2
+#define PARSER_NB_BYTE 3
+#define PARSER_DATA 4
+#define PARSER_CHECKSUM_HIGH 5
+#define PARSER_CHECKSUM_LOW 6
+#define PARSER_END 7
+
+// built at compile time from RS485_COMMANDS
+static constexpr RS485_dispatch dispatch = RS485_buildDispatch(RS485_COMMANDS, RS485_NB_COMMAND);
+
+uint16_t RS485_frameChecksum(uint8_t slave, uint8_t cmd, uint8_t nb_byte, const uint8_t* data)
+{
+    uint16_t check = (uint16_t)(RS485_FRAME_START + slave + cmd + nb_byte + RS485_FRAME_END);
+    for(uint8_t i = 0; i < nb_byte; ++i)
+    {
+        check += data[i];
+    }
+
+    return check;
+}
+
+uint16_t RS485_frameEncode(uint8_t slave, uint8_t cmd, uint8_t nb_byte, const uint8_t* data, uint8_t* frame)
+{
+    uint16_t checksum = RS485_frameChecksum(slave, cmd, nb_byte, data);
+    uint16_t size = 0;
+
+    frame[size++] = RS485_FRAME_START;
+    frame[size++] = slave;
+    frame[size++] = cmd;
+    frame[size++] = nb_byte;
+    memcpy(frame + size, data, nb_byte);
+    size += nb_byte;
+    frame[size++] = (uint8_t)(checksum >> 8);
+    frame[size++] = (uint8_t)(checksum & 0xFF);
+    frame[size++] = RS485_FRAME_END;
+
+    return size;
+}
+
+void RS485_frameParserInit(RS485_frame_parser* parser, uint8_t* data)
+{
+    memset(parser, 0, sizeof(RS485_frame_parser));
+    parser->state = PARSER_START;
+    parser->data = data;
+}
+
+RS485_parse_status RS485_frameParse(RS485_frame_parser* parser, uint8_t byte)
+{
+    switch(parser->state)
+    {
+        case PARSER_START:
+            if(byte != RS485_FRAME_START)
+            {
+                return RS485_PARSE_MORE;
+            }
+            parser->state = PARSER_SLAVE;
+            return RS485_PARSE_START;
+
+        case PARSER_SLAVE:
+            parser->slave = byte;
+            parser->state = PARSER_CMD;
+            break;
+
+        case PARSER_CMD:
+            parser->cmd = byte;
+            parser->state = PARSER_NB_BYTE;
+            break;
+
+        case PARSER_NB_BYTE:
+            parser->nb_byte = byte;
+            parser->index = 0;
+            parser->checksum = (uint16_t)(RS485_FRAME_START + parser->slave + parser->cmd + byte + RS485_FRAME_END);
+            parser->state = byte ? PARSER_DATA : PARSER_CHECKSUM_HIGH;
+            break;
+
+        case PARSER_DATA:
+            parser->data[parser->index++] = byte;
+            parser->checksum += byte;
+            if(parser->index == parser->nb_byte)
+            {
+                parser->state = PARSER_CHECKSUM_HIGH;
+            }
+            break;
+
+        case PARSER_CHECKSUM_HIGH:
+            parser->received = (uint16_t)(byte << 8);
+            parser->state = PARSER_CHECKSUM_LOW;
+            break;
+
+        case PARSER_CHECKSUM_LOW:
+            parser->received |= byte;
+            parser->state = PARSER_END;
+            break;
+
+        default:
+            parser->state = PARSER_START;
+            return byte == RS485_FRAME_END && parser->received == parser->checksum ? RS485_PARSE_FRAME : RS485_PARSE_ERROR;
+    }
+
+    return RS485_PARSE_MORE;
+}
+
+size_t RS485_frameParseChunk(RS485_frame_parser* parser, const uint8_t* bytes, size_t nb_byte, RS485_parse_status& status)
+{
+    size_t position = 0;
+
+    while(position < nb_byte)
+    {
+        if(parser->state == PARSER_START)
+        {
+            // skip to the next start byte
+            const uint8_t* start = (const uint8_t*)memchr(bytes + position, RS485_FRAME_START, nb_byte - position);
+            if(start == NULL)
+            {
+                break;
+            }
+            position = start - bytes;
+        }
+        else if(parser->state == PARSER_DATA)
+        {
+            // the data in one block
+            size_t size = parser->nb_byte - parser->index;
+            if(size > nb_byte - position)
+            {
+                size = nb_byte - position;
+            }
+
+            memcpy(parser->data + parser->index, bytes + position, size);
+            for(size_t i = 0; i < size; ++i)
+            {
+                parser->checksum += bytes[position + i];
+            }
+            parser->index += size;
+            position += size;
+
+            if(parser->index == parser->nb_byte)
+            {
+                parser->state = PARSER_CHECKSUM_HIGH;
+            }
+            continue;
+        }
+
+        RS485_parse_status result = RS485_frameParse(parser, bytes[position++]);
+        if(result == RS485_PARSE_FRAME || result == RS485_PARSE_ERROR)
+        {
+            status = result;
+            return position;
+        }
+    }
+
+    status = RS485_PARSE_MORE;
+    return nb_byte;
+}
+
+const RS485_dispatch& RS485_frameDispatch()
+{
+    return dispatch;
+}
+
+bool RS485_frameAccept(uint8_t board, const RS485_frame_parser* parser)
+{
+    return (parser->slave == board || parser->slave == SLAVE_BROADCAST || board == SLAVE_STATE_SCREEN) &&
+           RS485_isValidFrame(dispatch, parser->slave, parser->cmd, parser->nb_byte);
+}
@@ -0,0 +1,129 @@
+/**
+ * @file RS485_frame.h
+ * @brief Portable framing of the bus, shared by the boards and the Linux master
+ *
+ * A frame is [0x3A][slave][cmd][nb_byte][data][checksum high][checksum low][0x0D],
+ * the checksum is the 16 bits sum of all the other bytes.
+ *
+ * The parser is a state machine fed one byte (RS485 reader thread) or one chunk
+ * (a read() of the Linux master) at a time. It only needs stdint and string,
+ * the validation of the frames uses the dispatch table of the registry.
+ *
+ */
+
+#ifndef RS485_FRAME_H
+#define RS485_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "RS485_registry.h"
+
+#define RS485_FRAME_START 0x3A
+#define RS485_FRAME_END 0x0D
+#define RS485_FRAME_HEADER 4   // start, slave, cmd, nb_byte
+#define RS485_FRAME_OVERHEAD 7 // start, slave, cmd, nb_byte, checksum, end
+#define RS485_FRAME_MAX_SIZE (RS485_MAX_PAYLOAD + RS485_FRAME_OVERHEAD)
+
+/**
+ * @brief result of the parser after some bytes
+ *
+ */
+typedef enum
+{
+    RS485_PARSE_MORE = 0, // the frame is not complete
+    RS485_PARSE_START,    // the start byte of a frame
+    RS485_PARSE_FRAME,    // a frame with a valid end and checksum
+    RS485_PARSE_ERROR     // a frame with a bad end or checksum
+} RS485_parse_status;
+
+/**
+ * @brief state of the parser and the header of the last frame
+ *
+ * The data are written in the buffer given to RS485_frameParserInit(), it can be changed
+ * between two frames.
+ */
+typedef struct RS485_frame_parser_struct
+{
+    uint8_t state;
+    uint8_t slave;
+    uint8_t cmd;
+    uint8_t nb_byte;
+    uint8_t index;
+    uint16_t checksum; // the sum of the bytes received
+    uint16_t received; // the checksum of the frame
+    uint8_t* data;     // RS485_MAX_PAYLOAD bytes
+} RS485_frame_parser;
+
+/**
+ * @brief calculate the checksum of a frame
+ *
+ * @param slave the address of the frame
+ * @param cmd the command of the frame
+ * @param nb_byte the number of data bytes
+ * @param data the data
+ * @return uint16_t the checksum
+ */
+uint16_t RS485_frameChecksum(uint8_t slave, uint8_t cmd, uint8_t nb_byte, const uint8_t* data);
+
+/**
+ * @brief write a complete frame in a buffer
+ *
+ * @param slave the address of the frame
+ * @param cmd the command of the frame
+ * @param nb_byte the number of data bytes
+ * @param data the data
+ * @param frame the buffer, nb_byte + RS485_FRAME_OVERHEAD bytes
+ * @return uint16_t the size of the frame
+ */
+uint16_t RS485_frameEncode(uint8_t slave, uint8_t cmd, uint8_t nb_byte, const uint8_t* data, uint8_t* frame);
+
+/**
+ * @brief start a parser, it waits for a start byte
+ *
+ * @param parser the parser
+ * @param data the buffer of the data, RS485_MAX_PAYLOAD bytes
+ */
+void RS485_frameParserInit(RS485_frame_parser* parser, uint8_t* data);
+
+/**
+ * @brief give one byte to the parser
+ *
+ * @param parser the parser
+ * @param byte the byte
+ * @return RS485_parse_status RS485_PARSE_FRAME or RS485_PARSE_ERROR with the last byte of a frame
+ */
+RS485_parse_status RS485_frameParse(RS485_frame_parser* parser, uint8_t byte);
+
+/**
+ * @brief give a chunk of bytes to the parser, up to the end of the first frame
+ *
+ * The data of the frame are copied in one block.
+ *
+ * @param parser the parser
+ * @param bytes the bytes
+ * @param nb_byte the number of bytes
+ * @param status RS485_PARSE_FRAME or RS485_PARSE_ERROR if a frame ended, RS485_PARSE_MORE otherwise
+ * @return size_t the number of bytes used, call again with the rest
+ */
+size_t RS485_frameParseChunk(RS485_frame_parser* parser, const uint8_t* bytes, size_t nb_byte, RS485_parse_status& status);
+
+/**
+ * @brief Get the dispatch table built at compile time from RS485_COMMANDS
+ *
+ * @return const RS485_dispatch& the dispatch table
+ */
+const RS485_dispatch& RS485_frameDispatch();
+
+/**
+ * @brief check if a frame is for a board and matches the registry
+ *
+ * A board receives the frames of its address and the broadcasts, the state screen all of them.
+ *
+ * @param board the address of the board
+ * @param parser the parser, after RS485_PARSE_FRAME
+ * @return true if the board must handle the frame
+ */
+bool RS485_frameAccept(uint8_t board, const RS485_frame_parser* parser);
+
+#endif
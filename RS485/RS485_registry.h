@@ -0,0 +1,190 @@
+/**
+ * @file RS485_registry.h
+ * @brief Compile time registry of the commands of the bus
+ *
+ * The commands are described in RS485_definition.h by a constexpr array of RS485_command.
+ * The same command number is used by different boards for different things, so a command
+ * is always given with the set of slaves that implement it.
+ * RS485_registryCheck() rejects at compile time the commands that don't fit the event flags
+ * of RS485, the payloads that don't fit a frame and the overlaps. RS485_buildDispatch() builds
+ * the dense table used by RS485 to validate a frame with two array accesses.
+ *
+ * A command flagged RS485_FLAG_RELIABLE may carry the RS485_RELIABLE_HEADER bytes of RS485Reliable
+ * in front of its payload, the sizes of the registry are the sizes seen by the application.
+ * The flag doesn't change the frames on the bus: the header is only there when both sides
+ * enable the command in RS485Reliable.
+ *
+ */
+
+#ifndef RS485_REGISTRY_H
+#define RS485_REGISTRY_H
+
+#include <stdint.h>
+
+#include "RS485_schema.h"
+
+#define RS485_NB_CMD 31 // bit 31 of the event flags is reserved by the RTOS
+#define RS485_MAX_PAYLOAD 255
+#define RS485_MAX_SLAVE 16
+
+#define RS485_FLAG_RELIABLE 0x01 // may be sent with a sequence number and acknowledgement, see RS485Reliable
+#define RS485_RELIABLE_HEADER 2
+
+#define RS485_REGISTRY_OK 0
+#define RS485_REGISTRY_BAD_CMD 1
+#define RS485_REGISTRY_BAD_SLAVE 2
+#define RS485_REGISTRY_BAD_PAYLOAD 3
+#define RS485_REGISTRY_OVERLAP 4
+
+#define SLAVE_MASK(slave) (1U << (slave))
+
+/**
+ * @brief one command of the bus
+ *
+ */
+typedef struct RS485_command_struct
+{
+    uint16_t slaves;         // SLAVE_MASK() of the boards that implement the command
+    uint8_t cmd;
+    uint16_t request_size;   // maximum payload sent to the board
+    uint16_t response_size;  // maximum payload sent by the board
+    const RS485_schema* schema; // schema of the response, NULL if the payload is raw
+    uint8_t flags;           // RS485_FLAG_
+} RS485_command;
+
+/**
+ * @brief dispatch table of the bus, indexed by slave and command
+ *
+ */
+typedef struct RS485_dispatch_struct
+{
+    uint32_t valid[RS485_MAX_SLAVE]; // one bit per command
+    uint8_t max_payload[RS485_MAX_SLAVE][RS485_NB_CMD];
+    uint8_t max_request[RS485_MAX_SLAVE][RS485_NB_CMD];
+    uint32_t reliable[RS485_MAX_SLAVE]; // one bit per command
+} RS485_dispatch;
+
+/**
+ * @brief check a registry
+ *
+ * @param commands the commands
+ * @param nb_command the number of commands
+ * @return constexpr uint8_t RS485_REGISTRY_OK or the first error found
+ */
+constexpr uint8_t RS485_registryCheck(const RS485_command* commands, uint8_t nb_command)
+{
+    for(uint8_t i = 0; i < nb_command; ++i)
+    {
+        if(commands[i].cmd >= RS485_NB_CMD)
+        {
+            return RS485_REGISTRY_BAD_CMD;
+        }
+        if(commands[i].slaves == 0)
+        {
+            return RS485_REGISTRY_BAD_SLAVE;
+        }
+        uint16_t header = (commands[i].flags & RS485_FLAG_RELIABLE) ? RS485_RELIABLE_HEADER : 0;
+        if(commands[i].request_size > RS485_MAX_PAYLOAD || commands[i].response_size > RS485_MAX_PAYLOAD ||
+           (commands[i].request_size < RS485_MAX_PAYLOAD && commands[i].request_size + header > RS485_MAX_PAYLOAD) ||
+           (commands[i].response_size < RS485_MAX_PAYLOAD && commands[i].response_size + header > RS485_MAX_PAYLOAD) ||
+           (commands[i].schema != nullptr && schemaMaxSize(*commands[i].schema) > commands[i].response_size))
+        {
+            return RS485_REGISTRY_BAD_PAYLOAD;
+        }
+        for(uint8_t j = 0; j < i; ++j)
+        {
+            if(commands[j].cmd == commands[i].cmd && (commands[j].slaves & commands[i].slaves))
+            {
+                return RS485_REGISTRY_OVERLAP;
+            }
+        }
+    }
+    return RS485_REGISTRY_OK;
+}
+
+/**
+ * @brief build the dispatch table of a registry
+ *
+ * @param commands the commands, checked by RS485_registryCheck()
+ * @param nb_command the number of commands
+ * @return constexpr RS485_dispatch the dispatch table
+ */
+constexpr RS485_dispatch RS485_buildDispatch(const RS485_command* commands, uint8_t nb_command)
+{
+    RS485_dispatch dispatch{};
+
+    for(uint8_t i = 0; i < nb_command; ++i)
+    {
+        uint16_t payload = commands[i].request_size > commands[i].response_size ? commands[i].request_size : commands[i].response_size;
+        uint16_t request = commands[i].request_size;
+        if((commands[i].flags & RS485_FLAG_RELIABLE) && payload < RS485_MAX_PAYLOAD)
+        {
+            payload += RS485_RELIABLE_HEADER;
+        }
+        if((commands[i].flags & RS485_FLAG_RELIABLE) && request < RS485_MAX_PAYLOAD)
+        {
+            request += RS485_RELIABLE_HEADER;
+        }
+
+        for(uint8_t slave = 0; slave < RS485_MAX_SLAVE; ++slave)
+        {
+            if(commands[i].slaves & SLAVE_MASK(slave))
+            {
+                dispatch.valid[slave] |= 1UL << commands[i].cmd;
+                dispatch.max_payload[slave][commands[i].cmd] = (uint8_t)payload;
+                dispatch.max_request[slave][commands[i].cmd] = (uint8_t)request;
+                if(commands[i].flags & RS485_FLAG_RELIABLE)
+                {
+                    dispatch.reliable[slave] |= 1UL << commands[i].cmd;
+                }
+            }
+        }
+    }
+    return dispatch;
+}
+
+/**
+ * @brief check a frame against a dispatch table
+ *
+ * @param dispatch the dispatch table
+ * @param slave the slave of the frame
+ * @param cmd the command of the frame
+ * @param nb_byte the size of the payload
+ * @return true if the command exists for this slave and the payload fits
+ */
+constexpr bool RS485_isValidFrame(const RS485_dispatch& dispatch, uint8_t slave, uint8_t cmd, uint8_t nb_byte)
+{
+    return slave < RS485_MAX_SLAVE && cmd < RS485_NB_CMD && (dispatch.valid[slave] & (1UL << cmd)) &&
+           nb_byte <= dispatch.max_payload[slave][cmd];
+}
+
+/**
+ * @brief check if a frame may be a request sent to the slave, from its size
+ *
+ * A frame bigger than the request of its command can only be sent by the slave.
+ *
+ * @param dispatch the dispatch table
+ * @param slave the slave of the frame
+ * @param cmd the command of the frame
+ * @param nb_byte the size of the payload
+ * @return true if the payload fits the request of the command
+ */
+constexpr bool RS485_fitsRequest(const RS485_dispatch& dispatch, uint8_t slave, uint8_t cmd, uint8_t nb_byte)
+{
+    return slave < RS485_MAX_SLAVE && cmd < RS485_NB_CMD && nb_byte <= dispatch.max_request[slave][cmd];
+}
+
+/**
+ * @brief check if a command of a slave may use the reliable delivery
+ *
+ * @param dispatch the dispatch table
+ * @param slave the slave of the frame
+ * @param cmd the command of the frame
+ * @return true if the command is flagged RS485_FLAG_RELIABLE for this slave
+ */
+constexpr bool RS485_isReliable(const RS485_dispatch& dispatch, uint8_t slave, uint8_t cmd)
+{
+    return slave < RS485_MAX_SLAVE && cmd < RS485_NB_CMD && (dispatch.reliable[slave] & (1UL << cmd));
+}
+
+#endif
@@ -0,0 +1,109 @@
+/**
+ * @file RS485_schema.h
+ * @brief Description of the payload of a command, used by RS485Serializer
+ *
+ * A schema is a constexpr array of fields, one per value of the payload.
+ * The values are integers in the unit of the field (mV, mA, 0.01 degC...),
+ * the scale of the field gives the value in the usual unit on the receiving side.
+ * The multi-byte fields are little-endian on the wire, whatever the board.
+ *
+ */
+
+#ifndef RS485_SCHEMA_H
+#define RS485_SCHEMA_H
+
+#include <stdint.h>
+
+#define SCHEMA_VARINT_MAX_SIZE 5
+#define SCHEMA_HEADER_SIZE 1 // only when the schema has delta fields
+#define SCHEMA_HEADER_KEY_FRAME 0x01
+#define SCHEMA_HEADER_SEQUENCE_SHIFT 1 // rolling number of the frame in the 7 high bits of the header
+#define SCHEMA_HEADER_SEQUENCE_MASK 0x7F
+
+/**
+ * @brief encoding of one field
+ *
+ */
+typedef enum
+{
+    FIELD_U8 = 0,
+    FIELD_I8,
+    FIELD_U16,
+    FIELD_I16,
+    FIELD_U32,
+    FIELD_I32,
+    FIELD_VARINT, // zig-zag varint, 1 byte from -64 to 63
+    FIELD_DELTA   // zig-zag varint of the change since the last frame, absolute in a key frame
+} schema_encoding;
+
+/**
+ * @brief one field of a payload
+ *
+ */
+typedef struct schema_field_struct
+{
+    schema_encoding encoding;
+    float scale; // usual unit per LSB, for the receiving side only
+} schema_field;
+
+/**
+ * @brief the payload of one command
+ *
+ */
+typedef struct RS485_schema_struct
+{
+    const schema_field* fields;
+    uint8_t nb_field;
+} RS485_schema;
+
+#define SCHEMA(fields) RS485_schema{fields, sizeof(fields)/sizeof(fields[0])}
+
+/**
+ * @brief maximum size of a field on the wire
+ *
+ * @param encoding the encoding of the field
+ * @return constexpr uint8_t the size in bytes
+ */
+constexpr uint8_t schemaFieldMaxSize(schema_encoding encoding)
+{
+    return encoding == FIELD_U8 || encoding == FIELD_I8 ? 1 :
+           encoding == FIELD_U16 || encoding == FIELD_I16 ? 2 :
+           encoding == FIELD_U32 || encoding == FIELD_I32 ? 4 : SCHEMA_VARINT_MAX_SIZE;
+}
+
+/**
+ * @brief check if a schema has delta fields, and so a header
+ *
+ * @param schema the schema
+ * @return true if one field is FIELD_DELTA
+ */
+constexpr bool schemaHasDelta(RS485_schema schema)
+{
+    for(uint8_t i = 0; i < schema.nb_field; ++i)
+    {
+        if(schema.fields[i].encoding == FIELD_DELTA)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief maximum size of an encoded payload, to check at compile time that it fits in a frame
+ *
+ * @param schema the schema
+ * @return constexpr uint32_t the size in bytes
+ */
+constexpr uint32_t schemaMaxSize(RS485_schema schema)
+{
+    uint32_t size = schemaHasDelta(schema) ? SCHEMA_HEADER_SIZE : 0;
+
+    for(uint8_t i = 0; i < schema.nb_field; ++i)
+    {
+        size += schemaFieldMaxSize(schema.fields[i].encoding);
+    }
+    return size;
+}
+
+#endif
@@ -1,20 +1,140 @@
-
 #include "TC74A5.h"
 
 TC74A5::TC74A5(I2C * i2c, char address)
 {
     _i2c = i2c;
+    _bus = NULL;
     adrr = address;
+    pointer = POINTER_UNKNOWN;
+}
+
+TC74A5::TC74A5(I2CBus * bus, char address) : TC74A5(bus->getI2C(), address)
+{
+    _bus = bus;
+    temp_transaction.pending = false;
 }
 
 char TC74A5::getTemp()
 {
-    char cmd[3];
+    char value = 0;
+
+    readRegister(TEMP, &value);
+
+    return value;
+}
+
+int TC74A5::readTemp(char * temperature)
+{
+    char value;
+
+    int result = readRegister(TEMP, &value);
+    if(result == 0)
+    {
+        *temperature = value;
+    }
+
+    return result;
+}
+
+bool TC74A5::getTempAsync(Callback<void(int, char)> done)
+{
+    if(_bus == NULL || !_bus->claim(&temp_transaction))
+    {
+        return false;
+    }
 
-    cmd[0] = TEMP;
-    cmd[1] = adrr; 
+    temp_done = done;
+    temp_transaction.address = adrr;
+    temp_transaction.tx[0] = TEMP;
+    temp_transaction.tx_length = pointer == TEMP ? 0 : 1;
+    temp_transaction.rx = &temp_rx;
+    temp_transaction.rx_length = 1;
+    temp_transaction.priority = I2C_PRIORITY_LOW;
+    temp_transaction.done = callback(this, &TC74A5::tempDone);
 
-    _i2c->read(adrr+1,cmd,3);
+    // the pointer is TEMP once the read is done, see tempDone()
+    return _bus->submit(&temp_transaction, true);
+}
 
-    return cmd[0];
-}
\ No newline at end of file
+void TC74A5::standby()
+{
+    writeRegister(CONFIGT, CONFIGT_STANDBY);
+}
+
+void TC74A5::wake()
+{
+    writeRegister(CONFIGT, 0x00);
+}
+
+bool TC74A5::isDataReady()
+{
+    char value = 0;
+
+    if(readRegister(CONFIGT, &value) != 0)
+    {
+        return false;
+    }
+
+    return (value & CONFIGT_DATA_READY) != 0;
+}
+
+void TC74A5::invalidatePointer()
+{
+    pointer = POINTER_UNKNOWN;
+}
+
+void TC74A5::tempDone(int result)
+{
+    pointer = result == 0 ? TEMP : POINTER_UNKNOWN;
+
+    if(temp_done)
+    {
+        temp_done(result, temp_rx);
+    }
+}
+
+int TC74A5::readRegister(char reg, char * value)
+{
+    int result;
+    uint8_t tx_length = pointer == reg ? 0 : 1;
+
+    if(_bus)
+    {
+        result = _bus->transact(adrr, &reg, tx_length, value, 1);
+    }
+    else
+    {
+        _i2c->lock();
+        result = tx_length ? _i2c->write(adrr, &reg, 1, true) : 0;
+        if(result == 0)
+        {
+            result = _i2c->read(adrr+1, value, 1);
+        }
+        _i2c->unlock();
+    }
+
+    // after an error the pointer of the sensor is not known anymore
+    pointer = result == 0 ? reg : POINTER_UNKNOWN;
+    return result;
+}
+
+int TC74A5::writeRegister(char reg, char value)
+{
+    int result;
+    char cmd[2];
+
+    cmd[0] = reg;
+    cmd[1] = value;
+
+    if(_bus)
+    {
+        result = _bus->transact(adrr, cmd, 2, NULL, 0);
+    }
+    else
+    {
+        result = _i2c->write(adrr, cmd, 2);
+    }
+
+    pointer = result == 0 ? reg : POINTER_UNKNOWN;
+    return result;
+}
@@ -3,11 +3,20 @@
 
 #include "mbed.h"
 
+#include "I2CBus/I2CBus.h"
+
 #define CONFIGT 0x01
 #define TEMP 0x00
 
+#define CONFIGT_STANDBY 0x80 // SHDN bit of the configuration register
+#define CONFIGT_DATA_READY 0x40 // DATA_RDY bit of the configuration register
+#define POINTER_UNKNOWN 0xFF
+
 /** @file
  * @brief TC74A5 I2C
+ *
+ * The TC74 keeps its register pointer between transactions. The driver remembers
+ * the pointer it wrote last, so reading the same register again is a single byte read.
  */
 
 class TC74A5 
@@ -15,6 +24,37 @@ class TC74A5
 private :
     char adrr; 
     I2C * _i2c;
+    I2CBus * _bus;
+    volatile char pointer;
+
+    I2C_transaction temp_transaction;
+    char temp_rx;
+    Callback<void(int, char)> temp_done;
+
+    /**
+     * Completion of getTempAsync()
+     * 
+     * @param result result of the transaction
+    */
+    void tempDone(int result);
+
+    /**
+     * Read one register, the pointer is only written if it changed
+     * 
+     * @param reg the register to read
+     * @param value the value read
+     * @return 0 on success
+    */
+    int readRegister(char reg, char * value);
+
+    /**
+     * Write one register, the pointer is left on this register
+     * 
+     * @param reg the register to write
+     * @param value the value to write
+     * @return 0 on success
+    */
+    int writeRegister(char reg, char value);
 
 public :
     /**
@@ -25,6 +65,14 @@ public :
     */
     TC74A5(I2C * i2c, char address);
 
+    /**
+     * Init of the class on a shared bus
+     * 
+     * @param bus pointer of the shared I2C bus
+     * @param address of the TC74A5 
+    */
+    TC74A5(I2CBus * bus, char address);
+
     /**
      * Get the temperature of the board
      *  
@@ -32,6 +80,48 @@ public :
     */
     char getTemp();
 
+    /**
+     * Get the temperature of the board with the result of the transaction
+     * 
+     * @param temperature the temperature in °C, unchanged on error
+     * @return 0 on success, the result of the I2C transaction otherwise
+    */
+    int readTemp(char * temperature);
+
+    /**
+     * Start the read of the temperature on the shared bus
+     * 
+     * Only available with the I2CBus constructor, one read at a time.
+     * 
+     * @param done function called from the bus thread with the result of the transaction (0 on success) and the temperature in °C
+     * @return true if the read is queued
+    */
+    bool getTempAsync(Callback<void(int, char)> done);
+
+    /**
+     * Put the sensor in standby, the conversions stop
+    */
+    void standby();
+
+    /**
+     * Wake up the sensor, the first temperature is ready after one conversion
+    */
+    void wake();
+
+    /**
+     * Check if a conversion is done since the wake up
+     * 
+     * @return true if the temperature is valid
+    */
+    bool isDataReady();
+
+    /**
+     * Forget the register pointer, the next read writes it again
+     * 
+     * Call it if something else than this driver talked to the sensor.
+    */
+    void invalidatePointer();
+
 };
 
-#endif
\ No newline at end of file
+#endif
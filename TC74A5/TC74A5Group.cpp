@@ -0,0 +1,128 @@
+#include "TC74A5Group.h"
+
+#include "Utility/MemoryAlloc.h"
+
+TC74A5Group::TC74A5Group(TC74A5 ** sensors, uint8_t nb_sensor)
+{
+    this->sensors = sensors;
+    this->nb_sensor = nb_sensor;
+
+    ready = (bool*)memoryAlloc(MEMORY_MODULE_TC74A5, sizeof(bool)*nb_sensor);
+    reads = (TC74A5_read*)memoryAlloc(MEMORY_MODULE_TC74A5, sizeof(TC74A5_read)*nb_sensor);
+    for(uint8_t i = 0; i < nb_sensor; ++i)
+    {
+        reads[i].done = &reads_done;
+    }
+}
+
+TC74A5Group::~TC74A5Group()
+{
+    memoryFree(ready);
+    memoryFree(reads);
+    ready = NULL;
+    reads = NULL;
+}
+
+void TC74A5Group::setStandbyBetweenPolls(bool enable)
+{
+    standby_between_polls = enable;
+
+    for(uint8_t i = 0; i < nb_sensor; ++i)
+    {
+        if(enable)
+        {
+            sensors[i]->standby();
+        }
+        else
+        {
+            sensors[i]->wake();
+        }
+    }
+}
+
+void TC74A5Group::setTimebase(Timebase * timebase)
+{
+    this->timebase = timebase;
+}
+
+void TC74A5Group::poll(TC74A5_sample * samples)
+{
+    for(uint8_t i = 0; i < nb_sensor; ++i)
+    {
+        ready[i] = true;
+    }
+
+    if(standby_between_polls)
+    {
+        for(uint8_t i = 0; i < nb_sensor; ++i)
+        {
+            sensors[i]->wake();
+            ready[i] = false;
+        }
+
+        // all the sensors convert at the same time
+        ThisThread::sleep_for(TC74A5_CONVERSION_TIME_MS);
+
+        uint64_t timeout = Kernel::get_ms_count() + TC74A5_READY_TIMEOUT_MS;
+        bool all_ready = false;
+        while(!all_ready && Kernel::get_ms_count() < timeout)
+        {
+            all_ready = true;
+            for(uint8_t i = 0; i < nb_sensor; ++i)
+            {
+                if(!ready[i])
+                {
+                    ready[i] = sensors[i]->isDataReady();
+                    all_ready = all_ready && ready[i];
+                }
+            }
+            if(!all_ready)
+            {
+                ThisThread::sleep_for(10);
+            }
+        }
+    }
+
+    // every read is queued before the first one is waited for, the bus runs them back to back
+    uint8_t nb_queued = 0;
+    for(uint8_t i = 0; i < nb_sensor; ++i)
+    {
+        if(sensors[i]->getTempAsync(callback(readDone, &reads[i])))
+        {
+            nb_queued++;
+        }
+        else
+        {
+            // a plain I2C or a read already running, the error keeps the sample invalid
+            reads[i].temperature = 0;
+            reads[i].result = sensors[i]->readTemp(&reads[i].temperature);
+        }
+    }
+    for(uint8_t i = 0; i < nb_queued; ++i)
+    {
+        reads_done.wait();
+    }
+
+    uint64_t timestamp_ms = timebase ? timebase->getTime()/1000 : Kernel::get_ms_count();
+    for(uint8_t i = 0; i < nb_sensor; ++i)
+    {
+        samples[i].temperature = reads[i].temperature;
+        samples[i].timestamp_ms = timestamp_ms;
+        samples[i].valid = ready[i] && reads[i].result == 0;
+    }
+
+    if(standby_between_polls)
+    {
+        for(uint8_t i = 0; i < nb_sensor; ++i)
+        {
+            sensors[i]->standby();
+        }
+    }
+}
+
+void TC74A5Group::readDone(TC74A5_read * read, int result, char temperature)
+{
+    read->result = result;
+    read->temperature = temperature;
+    read->done->release();
+}
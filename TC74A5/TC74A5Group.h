@@ -0,0 +1,103 @@
+#ifndef TC74A5_GROUP_H
+#define TC74A5_GROUP_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "TC74A5.h"
+#include "Utility/Timebase.h"
+
+#define TC74A5_CONVERSION_TIME_MS 125 // 8 samples per second
+#define TC74A5_READY_TIMEOUT_MS 250
+
+/** @file
+ * @brief Batched polling of many TC74A5
+ */
+
+/**
+ * Temperature of one sensor of the group
+*/
+typedef struct TC74A5_sample_struct
+{
+    char temperature;
+    uint64_t timestamp_ms; // shared time when a timebase is set
+    bool valid;
+} TC74A5_sample;
+
+/**
+ * Read of one sensor queued on the shared bus
+*/
+typedef struct TC74A5_read_struct
+{
+    Semaphore * done;
+    int result;
+    char temperature;
+} TC74A5_read;
+
+class TC74A5Group
+{
+private :
+    TC74A5 ** sensors;
+    uint8_t nb_sensor;
+    bool standby_between_polls = false;
+    bool * ready = NULL;
+    TC74A5_read * reads = NULL;
+    Semaphore reads_done;
+    Timebase * timebase = NULL;
+
+    /**
+     * Completion of the read of one sensor, called from the bus thread
+     * 
+     * @param read the read of the sensor
+     * @param result result of the transaction
+     * @param temperature the temperature
+    */
+    static void readDone(TC74A5_read * read, int result, char temperature);
+
+public :
+    /**
+     * Init of the group
+     * 
+     * @param sensors array of pointers of the sensors, it must stay valid
+     * @param nb_sensor number of sensors in the array
+    */
+    TC74A5Group(TC74A5 ** sensors, uint8_t nb_sensor);
+
+    /**
+     * Destroy the group
+    */
+    ~TC74A5Group();
+
+    /**
+     * Put the sensors in standby between two polls
+     * 
+     * For slow polls (more than a few seconds) the sensors only convert during the poll,
+     * the poll then takes one conversion time (TC74A5_CONVERSION_TIME_MS) more.
+     * 
+     * @param enable true to use the standby
+    */
+    void setStandbyBetweenPolls(bool enable);
+
+    /**
+     * Set the timebase used to stamp the samples
+     * 
+     * Without timebase the samples are stamped with the kernel time.
+     * 
+     * @param timebase the timebase of the board
+    */
+    void setTimebase(Timebase * timebase);
+
+    /**
+     * Read the temperature of all the sensors in one pass
+     * 
+     * Every read is a single byte transaction once the register pointer of a sensor is on TEMP.
+     * On a shared bus the reads of all the sensors are queued at once and the poll waits
+     * for the last one, the sensors without bus are read one after the other.
+     * 
+     * @param samples array of nb_sensor samples for the results
+    */
+    void poll(TC74A5_sample * samples);
+
+};
+
+#endif
@@ -0,0 +1,108 @@
+/**
+ * @file Trace.cpp
+ * @brief Trace ring and dump over RS485
+ *
+ */
+
+#include "Trace.h"
+
+#include "RS485/RS485_definition.h"
+#include "RS485/RS485.h"
+
+#if TRACE_ENABLED
+
+trace_entry trace_ring[TRACE_RING_SIZE];
+volatile uint32_t trace_head = 0;
+volatile uint32_t trace_writers = 0;
+volatile bool trace_frozen = false;
+
+#endif
+
+void traceInit()
+{
+#if TRACE_ENABLED && defined(DWT_CTRL_CYCCNTENA_Msk)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+uint32_t traceFrequency()
+{
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+    return SystemCoreClock;
+#else
+    return 1000000;
+#endif
+}
+
+void traceDumpThread(RS485* rs)
+{
+    uint8_t cmd_array[1] = {CMD_TRACE};
+    uint8_t buffer[255] = {0};
+
+    while(true)
+    {
+        rs->read(cmd_array, 1, buffer);
+
+#if TRACE_ENABLED
+        // the trace points are dropped during the dump, the ring doesn't move once the writers are done
+        trace_frozen = true;
+        while(trace_writers)
+        {
+            ThisThread::sleep_for(1);
+        }
+
+        uint32_t head = trace_head;
+        uint16_t count = head < TRACE_RING_SIZE ? head : TRACE_RING_SIZE;
+        uint8_t nb_frame = (count + 1 + TRACE_ENTRY_PER_FRAME - 1)/TRACE_ENTRY_PER_FRAME;
+        uint16_t sent = 0;
+
+        for(uint8_t frame = 0; frame < nb_frame; ++frame)
+        {
+            uint8_t size = 2;
+
+            buffer[0] = frame;
+            buffer[1] = nb_frame;
+            uint8_t nb_entry = TRACE_ENTRY_PER_FRAME;
+            if(frame == 0)
+            {
+                uint32_t frequency = traceFrequency();
+                for(uint8_t i = 0; i < 4; ++i)
+                {
+                    buffer[size++] = (uint8_t)(frequency >> (8*i));
+                }
+                nb_entry--;
+            }
+
+            for(uint8_t i = 0; i < nb_entry && sent < count; ++i, ++sent)
+            {
+                const trace_entry* entry = &trace_ring[(head - count + sent) & (TRACE_RING_SIZE - 1)];
+
+                for(uint8_t j = 0; j < 4; ++j)
+                {
+                    buffer[size++] = (uint8_t)(entry->timestamp >> (8*j));
+                }
+                buffer[size++] = entry->event;
+                buffer[size++] = entry->type;
+                buffer[size++] = (uint8_t)(entry->arg & 0xFF);
+                buffer[size++] = (uint8_t)(entry->arg >> 8);
+            }
+
+            rs->write(rs->getBoardAdress(), CMD_TRACE, size, buffer);
+        }
+
+        trace_head = 0;
+        trace_frozen = false;
+#else
+        uint32_t frequency = traceFrequency();
+        buffer[0] = 0;
+        buffer[1] = 1;
+        for(uint8_t i = 0; i < 4; ++i)
+        {
+            buffer[2 + i] = (uint8_t)(frequency >> (8*i));
+        }
+        rs->write(rs->getBoardAdress(), CMD_TRACE, 6, buffer);
+#endif
+    }
+}
@@ -0,0 +1,138 @@
+/**
+ * @file Trace.h
+ * @brief Trace points on the hot paths, stamped with the DWT cycle counter
+ *
+ * The trace is compiled only when TRACE_ENABLED is 1 (build flag -DTRACE_ENABLED=1),
+ * otherwise the TRACE_ macros are empty and the ring doesn't exist.
+ *
+ * A trace point writes (timestamp, event, type, arg) in a ring of TRACE_RING_SIZE entries.
+ * The slot is reserved with an atomic increment, so the trace points can be used from any
+ * thread or interrupt without lock. traceDumpThread() sends the ring with CMD_TRACE when
+ * the master asks for it, tools/trace_to_timeline.py converts it to a timeline.
+ * A trace point counts itself in trace_writers while it runs: the dump freezes the ring, then
+ * waits for the trace points already started, so it never reads a half written entry and
+ * nothing moves the head when it is reset.
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "mbed.h"
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 0
+#endif
+
+#define TRACE_RING_SIZE 512 // power of 2
+#define TRACE_ENTRY_PER_FRAME 30
+#define TRACE_ENTRY_SIZE 8
+
+#define TRACE_TYPE_INSTANT 0
+#define TRACE_TYPE_BEGIN 1
+#define TRACE_TYPE_END 2
+
+// events of the library, the boards use TRACE_EVENT_USER and up
+#define TRACE_EVENT_RS485_RX 1    // arg: slave << 8 | cmd
+#define TRACE_EVENT_RS485_TX 2    // arg: slave << 8 | cmd
+#define TRACE_EVENT_RS485_READ 3  // arg: cmd given to a reader
+#define TRACE_EVENT_I2C 4         // arg: address << 8 | rx_length
+#define TRACE_EVENT_TASK 5        // arg: index of the job of the TaskScheduler
+#define TRACE_EVENT_USER 32
+
+/**
+ * @brief one trace point
+ *
+ */
+typedef struct trace_entry_struct
+{
+    uint32_t timestamp; // cycles
+    uint8_t event;
+    uint8_t type;
+    uint16_t arg;
+} trace_entry;
+
+class RS485;
+
+#if TRACE_ENABLED
+
+extern trace_entry trace_ring[TRACE_RING_SIZE];
+extern volatile uint32_t trace_head;
+extern volatile uint32_t trace_writers;
+extern volatile bool trace_frozen;
+
+/**
+ * @brief Get the time of the trace
+ *
+ * @return uint32_t the cycle counter, or the microsecond ticker without DWT
+ */
+static inline uint32_t trace_timestamp()
+{
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+    return DWT->CYCCNT;
+#elif defined(HOST_MBED_H)
+    return (uint32_t)host_time_us();
+#else
+    return us_ticker_read();
+#endif
+}
+
+/**
+ * @brief Write a trace point in the ring
+ *
+ * @param event the event
+ * @param type TRACE_TYPE_INSTANT, TRACE_TYPE_BEGIN or TRACE_TYPE_END
+ * @param arg the argument of the event
+ */
+static inline void trace_record(uint8_t event, uint8_t type, uint16_t arg)
+{
+    // counted before the check: once the dump sees no writer, every new one sees the freeze
+    core_util_atomic_incr_u32(&trace_writers, 1);
+    if(!trace_frozen)
+    {
+        trace_entry* entry = &trace_ring[(core_util_atomic_incr_u32(&trace_head, 1) - 1) & (TRACE_RING_SIZE - 1)];
+        entry->timestamp = trace_timestamp();
+        entry->event = event;
+        entry->type = type;
+        entry->arg = arg;
+    }
+    core_util_atomic_decr_u32(&trace_writers, 1);
+}
+
+#define TRACE(event, arg) trace_record((event), TRACE_TYPE_INSTANT, (uint16_t)(arg))
+#define TRACE_BEGIN(event, arg) trace_record((event), TRACE_TYPE_BEGIN, (uint16_t)(arg))
+#define TRACE_END(event, arg) trace_record((event), TRACE_TYPE_END, (uint16_t)(arg))
+
+#else
+
+#define TRACE(event, arg) ((void)0)
+#define TRACE_BEGIN(event, arg) ((void)0)
+#define TRACE_END(event, arg) ((void)0)
+
+#endif
+
+/**
+ * @brief Start the cycle counter, to call once at the start of main
+ *
+ */
+void traceInit();
+
+/**
+ * @brief Get the frequency of the trace timestamps
+ *
+ * @return uint32_t the frequency in Hz
+ */
+uint32_t traceFrequency();
+
+/**
+ * @brief thread that sends the trace when the master asks for it
+ *
+ * Frame i of n: [i][n] then the entries, oldest first. The first frame starts with the
+ * frequency of the timestamps (4 bytes little-endian) and has one entry less.
+ * With TRACE_ENABLED at 0 the answer is one empty frame.
+ *
+ * @param rs the RS485 of the board
+ */
+void traceDumpThread(RS485* rs);
+
+#endif
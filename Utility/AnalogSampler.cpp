@@ -0,0 +1,251 @@
+/**
+ * @file AnalogSampler.cpp
+ * @brief AnalogSampler class source file
+ *
+ */
+
+#include "AnalogSampler.h"
+
+#include "utility.h"
+#include "MemoryAlloc.h"
+
+AnalogSampler::AnalogSampler(osPriority thread_priority, uint32_t stack_size)
+    : samplerThread(thread_priority, stack_size, NULL, "analog")
+{
+    samplerThread.start(callback(this, &AnalogSampler::sampler_thread));
+}
+
+AnalogSampler::~AnalogSampler()
+{
+    // the thread may be sampling a channel, the histories are freed after it ends
+    wakeup_event.set(ANALOG_SAMPLER_STOP_FLAG);
+    samplerThread.join();
+
+    for(uint8_t i = 0; i < nb_channel; ++i)
+    {
+        memoryFree(channels[i].history);
+    }
+}
+
+int8_t AnalogSampler::addChannel(AnalogIn* input, uint32_t period_ms, analog_filter filter, uint8_t length)
+{
+    if(period_ms == 0 || (filter == ANALOG_FILTER_AVERAGE && (length == 0 || length > ANALOG_AVERAGE_MAX_LENGTH)) ||
+       (filter == ANALOG_FILTER_IIR && length > ANALOG_IIR_MAX_SHIFT))
+    {
+        return -1;
+    }
+
+    channel_mutex.lock();
+
+    if(nb_channel >= ANALOG_SAMPLER_MAX_CHANNEL)
+    {
+        channel_mutex.unlock();
+        return -1;
+    }
+
+    analog_channel* channel = &channels[nb_channel];
+    channel->input = input;
+    channel->period_ms = period_ms;
+    channel->filter = filter;
+    channel->length = length;
+    channel->history = NULL;
+    channel->history_index = 0;
+    channel->accumulator = 0;
+    channel->nb_sample = 0;
+    channel->value = 0;
+    channel->next_sample_ms = Kernel::get_ms_count();
+    channel->last_sample_ms = 0;
+    channel->timestamp_us = 0;
+
+    if(filter == ANALOG_FILTER_AVERAGE)
+    {
+        channel->history = (uint16_t*)memoryAlloc(MEMORY_MODULE_UTILITY, length*sizeof(uint16_t));
+        if(channel->history == NULL)
+        {
+            channel_mutex.unlock();
+            return -1;
+        }
+    }
+
+    int8_t index = nb_channel++;
+    channel_mutex.unlock();
+
+    // the new channel may be due before the thread wakes up
+    wakeup_event.set(ANALOG_SAMPLER_WAKEUP_FLAG);
+
+    return index;
+}
+
+uint16_t AnalogSampler::read_u16(uint8_t channel)
+{
+    if(channel >= nb_channel)
+    {
+        return 0;
+    }
+
+    return channels[channel].value;
+}
+
+float_t AnalogSampler::read(uint8_t channel)
+{
+    return read_u16(channel) / 65535.0f;
+}
+
+float_t AnalogSampler::readVoltage(uint8_t channel, double_t voltageRef, double_t R1, double_t R2)
+{
+    return calcul_tension(read(channel), voltageRef, R1, R2);
+}
+
+uint32_t AnalogSampler::readMillivolts(uint8_t channel, const VoltageDivider& divider)
+{
+    return divider.toMillivolts(read_u16(channel));
+}
+
+uint32_t AnalogSampler::getAge(uint8_t channel)
+{
+    uint32_t age = osWaitForever;
+
+    if(channel >= nb_channel)
+    {
+        return age;
+    }
+
+    channel_mutex.lock();
+    if(channels[channel].nb_sample)
+    {
+        age = (uint32_t)(Kernel::get_ms_count() - channels[channel].last_sample_ms);
+    }
+    channel_mutex.unlock();
+
+    return age;
+}
+
+uint64_t AnalogSampler::getTimestamp(uint8_t channel)
+{
+    uint64_t timestamp = 0;
+
+    if(channel >= nb_channel)
+    {
+        return timestamp;
+    }
+
+    channel_mutex.lock();
+    timestamp = channels[channel].timestamp_us;
+    channel_mutex.unlock();
+
+    return timestamp;
+}
+
+void AnalogSampler::setTimebase(Timebase* timebase)
+{
+    this->timebase = timebase;
+}
+
+bool AnalogSampler::isSettled(uint8_t channel)
+{
+    if(channel >= nb_channel)
+    {
+        return false;
+    }
+
+    switch(channels[channel].filter)
+    {
+        case ANALOG_FILTER_AVERAGE:
+            return channels[channel].nb_sample >= channels[channel].length;
+
+        case ANALOG_FILTER_IIR:
+            // 4 time constants, within 2% of a step
+            return channels[channel].nb_sample >= (4UL << channels[channel].length);
+
+        default:
+            return channels[channel].nb_sample > 0;
+    }
+}
+
+void AnalogSampler::sample(analog_channel* channel, uint64_t now)
+{
+    uint16_t raw = channel->input->read_u16();
+    uint64_t timestamp = timebase ? timebase->getTime() : now*1000;
+
+    channel_mutex.lock();
+
+    switch(channel->filter)
+    {
+        case ANALOG_FILTER_AVERAGE:
+            // running sum, the oldest sample leaves when the window is full
+            if(channel->nb_sample >= channel->length)
+            {
+                channel->accumulator -= channel->history[channel->history_index];
+            }
+            channel->accumulator += raw;
+            channel->history[channel->history_index] = raw;
+            channel->history_index = (channel->history_index + 1) % channel->length;
+            channel->value = channel->accumulator / (channel->nb_sample < channel->length ? channel->nb_sample + 1 : channel->length);
+            break;
+
+        case ANALOG_FILTER_IIR:
+            // the accumulator holds the output times 2^length
+            if(channel->nb_sample == 0)
+            {
+                channel->accumulator = (uint32_t)raw << channel->length;
+            }
+            else
+            {
+                channel->accumulator = channel->accumulator - (channel->accumulator >> channel->length) + raw;
+            }
+            channel->value = channel->accumulator >> channel->length;
+            break;
+
+        default:
+            channel->value = raw;
+            break;
+    }
+
+    channel->nb_sample++;
+    channel->last_sample_ms = now;
+    channel->timestamp_us = timestamp;
+
+    channel_mutex.unlock();
+}
+
+void AnalogSampler::sampler_thread()
+{
+    while(1)
+    {
+        uint64_t now = Kernel::get_ms_count();
+        uint64_t next_wakeup = UINT64_MAX;
+
+        for(uint8_t i = 0; i < nb_channel; ++i)
+        {
+            analog_channel* channel = &channels[i];
+
+            if(channel->next_sample_ms <= now)
+            {
+                sample(channel, now);
+
+                // keep the rate, unless a whole period was missed
+                channel->next_sample_ms += channel->period_ms;
+                if(channel->next_sample_ms <= now)
+                {
+                    channel->next_sample_ms = now + channel->period_ms;
+                }
+            }
+
+            if(channel->next_sample_ms < next_wakeup)
+            {
+                next_wakeup = channel->next_sample_ms;
+            }
+        }
+
+        uint32_t timeout = osWaitForever;
+        if(next_wakeup != UINT64_MAX)
+        {
+            timeout = (uint32_t)(next_wakeup - now);
+        }
+        uint32_t flags = wakeup_event.wait_any(ANALOG_SAMPLER_WAKEUP_FLAG | ANALOG_SAMPLER_STOP_FLAG, timeout);
+        if(!(flags & osFlagsError) && (flags & ANALOG_SAMPLER_STOP_FLAG))
+        {
+            return;
+        }
+    }
+}
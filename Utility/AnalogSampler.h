@@ -0,0 +1,187 @@
+/**
+ * @file AnalogSampler.h
+ * @brief Background sampler of the analog inputs
+ *
+ * The channels are converted by the sampler thread, each at its own period, and filtered
+ * as they arrive. read() returns the last filtered value right away instead of blocking
+ * like readfromAnalog().
+ *
+ */
+
+#ifndef ANALOG_SAMPLER_H
+#define ANALOG_SAMPLER_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "VoltageDivider.h"
+#include "Timebase.h"
+
+#define ANALOG_SAMPLER_MAX_CHANNEL 8
+#define ANALOG_SAMPLER_WAKEUP_FLAG 0x1
+#define ANALOG_SAMPLER_STOP_FLAG 0x2
+#define ANALOG_AVERAGE_MAX_LENGTH 64
+#define ANALOG_IIR_MAX_SHIFT 12
+
+/**
+ * @brief filter of one channel
+ *
+ */
+typedef enum
+{
+    ANALOG_FILTER_NONE = 0,
+    ANALOG_FILTER_AVERAGE, // moving average of length samples
+    ANALOG_FILTER_IIR      // y += (x - y) / 2^length
+} analog_filter;
+
+/**
+ * @brief one analog channel of the sampler
+ *
+ */
+typedef struct analog_channel_struct
+{
+    AnalogIn* input;
+    uint32_t period_ms;
+    analog_filter filter;
+    uint8_t length;
+
+    uint16_t* history; // moving average only
+    uint8_t history_index;
+    uint32_t accumulator;
+    uint32_t nb_sample;
+
+    uint16_t value;
+    uint64_t next_sample_ms;
+    uint64_t last_sample_ms;
+    uint64_t timestamp_us; // shared time when a timebase is set
+} analog_channel;
+
+/**
+ * @brief background sampler of the analog inputs
+ *
+ */
+class AnalogSampler
+{
+    public:
+
+        /**
+         * @brief AnalogSampler constructor, the sampler thread starts right away
+         *
+         * @param thread_priority priority of the sampler thread
+         * @param stack_size stack size of the sampler thread
+         */
+        AnalogSampler(osPriority thread_priority = osPriorityBelowNormal, uint32_t stack_size = OS_STACK_SIZE);
+
+        /**
+         * @brief Destroy the AnalogSampler object, the thread is stopped and joined first
+         *
+         */
+        ~AnalogSampler();
+
+        /**
+         * @brief Add a channel to the sampler
+         *
+         * @param input the analog input, it must stay valid as long as the sampler
+         * @param period_ms the time between two conversions in ms
+         * @param filter the filter of the channel
+         * @param length number of samples of the moving average, or shift of the IIR filter
+         * @return int8_t index of the channel, -1 if the channel can't be added
+         */
+        int8_t addChannel(AnalogIn* input, uint32_t period_ms, analog_filter filter = ANALOG_FILTER_AVERAGE, uint8_t length = 10);
+
+        /**
+         * @brief Get the filtered value of a channel
+         *
+         * @param channel index of the channel
+         * @return uint16_t the value scaled like AnalogIn::read_u16()
+         */
+        uint16_t read_u16(uint8_t channel);
+
+        /**
+         * @brief Get the filtered value of a channel
+         *
+         * @param channel index of the channel
+         * @return float_t the normalized value (0.0 to 1.0) like AnalogIn::read()
+         */
+        float_t read(uint8_t channel);
+
+        /**
+         * @brief Get the filtered voltage at the input of a voltage divider
+         *
+         * @param channel index of the channel
+         * @param voltageRef reference voltage of the board
+         * @param R1 resistor between the input and the pin
+         * @param R2 resistor between the pin and the ground
+         * @return float_t the voltage
+         */
+        float_t readVoltage(uint8_t channel, double_t voltageRef, double_t R1, double_t R2);
+
+        /**
+         * @brief Get the filtered voltage at the input of a voltage divider with integer math only
+         *
+         * @param channel index of the channel
+         * @param divider the voltage divider of the channel
+         * @return uint32_t the voltage in mV
+         */
+        uint32_t readMillivolts(uint8_t channel, const VoltageDivider& divider);
+
+        /**
+         * @brief Get the time since the last conversion of a channel
+         *
+         * @param channel index of the channel
+         * @return uint32_t the age in ms, osWaitForever if the channel was never converted
+         */
+        uint32_t getAge(uint8_t channel);
+
+        /**
+         * @brief Get the time of the last conversion of a channel
+         *
+         * @param channel index of the channel
+         * @return uint64_t the time in us, see setTimebase()
+         */
+        uint64_t getTimestamp(uint8_t channel);
+
+        /**
+         * @brief Set the timebase used to stamp the conversions
+         *
+         * Without timebase the conversions are stamped with the kernel time.
+         *
+         * @param timebase the timebase of the board
+         */
+        void setTimebase(Timebase* timebase);
+
+        /**
+         * @brief Check if the filter of a channel is filled
+         *
+         * @param channel index of the channel
+         * @return true if the channel got at least length samples
+         */
+        bool isSettled(uint8_t channel);
+
+    private:
+
+        Thread samplerThread;
+        Mutex channel_mutex;
+        EventFlags wakeup_event;
+
+        Timebase* timebase = NULL;
+
+        analog_channel channels[ANALOG_SAMPLER_MAX_CHANNEL];
+        uint8_t nb_channel = 0;
+
+        /**
+         * @brief convert a channel and update its filter
+         *
+         * @param channel the channel
+         * @param now the time of the conversion in ms
+         */
+        void sample(analog_channel* channel, uint64_t now);
+
+        /**
+         * @brief the sampler thread
+         *
+         */
+        void sampler_thread();
+};
+
+#endif
@@ -0,0 +1,92 @@
+/**
+ * @file MemoryAlloc.cpp
+ * @brief Heap of the library by module source file
+ *
+ */
+
+#include "MemoryAlloc.h"
+
+/**
+ * @brief header in front of each block of memoryAlloc(), 8 bytes to keep the alignment of malloc()
+ *
+ */
+typedef struct
+{
+    uint32_t size;
+    uint8_t module;
+    uint8_t reserved[3];
+} memory_block_header;
+
+static memory_module_stats module_stats[MEMORY_NB_MODULE];
+
+void* memoryAlloc(uint8_t module, size_t size)
+{
+    if(module >= MEMORY_NB_MODULE)
+    {
+        module = MEMORY_MODULE_APPLICATION;
+    }
+
+    memory_block_header* header = (memory_block_header*)malloc(sizeof(memory_block_header) + size);
+    if(header == NULL)
+    {
+        return NULL;
+    }
+
+    header->size = size;
+    header->module = module;
+
+    memoryAccount(module, (int32_t)size);
+    {
+        CriticalSectionLock lock;
+        module_stats[module].nb_block++;
+    }
+
+    return header + 1;
+}
+
+void memoryFree(void* block)
+{
+    if(block == NULL)
+    {
+        return;
+    }
+
+    memory_block_header* header = (memory_block_header*)block - 1;
+
+    memoryAccount(header->module, -(int32_t)header->size);
+    {
+        CriticalSectionLock lock;
+        module_stats[header->module].nb_block--;
+    }
+
+    free(header);
+}
+
+void memoryAccount(uint8_t module, int32_t size)
+{
+    if(module >= MEMORY_NB_MODULE)
+    {
+        module = MEMORY_MODULE_APPLICATION;
+    }
+
+    CriticalSectionLock lock;
+
+    memory_module_stats* stats = &module_stats[module];
+    stats->current += size;
+    if(stats->current > stats->peak)
+    {
+        stats->peak = stats->current;
+    }
+}
+
+memory_module_stats memoryGetModule(uint8_t module)
+{
+    memory_module_stats stats = {0, 0, 0};
+
+    if(module < MEMORY_NB_MODULE)
+    {
+        CriticalSectionLock lock;
+        stats = module_stats[module];
+    }
+    return stats;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file MemoryAlloc.h
+ * @brief Heap of the library by module
+ *
+ * The heap of the library is allocated with memoryAlloc() and the owner module is recorded,
+ * so the current and peak heap of each module is known. This file has no dependency on RS485,
+ * the report over the bus is in MemoryReport.h.
+ *
+ */
+
+#ifndef MEMORY_ALLOC_H
+#define MEMORY_ALLOC_H
+
+#include "mbed.h"
+
+// owner of a heap block, one per directory of the library
+#define MEMORY_MODULE_RS485 0
+#define MEMORY_MODULE_I2CBUS 1
+#define MEMORY_MODULE_INA228 2
+#define MEMORY_MODULE_TC74A5 3
+#define MEMORY_MODULE_PCA9531 4
+#define MEMORY_MODULE_UTILITY 5
+#define MEMORY_MODULE_APPLICATION 6
+#define MEMORY_NB_MODULE 7
+
+/**
+ * @brief heap of one module
+ *
+ */
+typedef struct
+{
+    uint32_t current;
+    uint32_t peak;
+    uint16_t nb_block;
+} memory_module_stats;
+
+/**
+ * @brief Allocate a block for a module
+ *
+ * @param module the owner, MEMORY_MODULE_
+ * @param size the size in bytes
+ * @return void* the block, NULL if the heap is full
+ */
+void* memoryAlloc(uint8_t module, size_t size);
+
+/**
+ * @brief Free a block of memoryAlloc()
+ *
+ * @param block the block, NULL is ignored
+ */
+void memoryFree(void* block);
+
+/**
+ * @brief Account an object made with new for a module
+ *
+ * @param module the owner, MEMORY_MODULE_
+ * @param size the size added (positive) or freed (negative)
+ */
+void memoryAccount(uint8_t module, int32_t size);
+
+/**
+ * @brief Get the heap of a module
+ *
+ * @param module the module, MEMORY_MODULE_
+ * @return memory_module_stats the heap of the module
+ */
+memory_module_stats memoryGetModule(uint8_t module);
+
+#endif
@@ -0,0 +1,146 @@
+/**
+ * @file MemoryReport.cpp
+ * @brief Memory report source file
+ *
+ */
+
+#include "MemoryReport.h"
+
+#include "RS485/RS485_definition.h"
+#include "RS485/RS485.h"
+
+// symbols of the GCC_ARM linker scripts of mbed, 0 when they don't exist
+extern "C"
+{
+    extern uint8_t __data_start__[] __attribute__((weak));
+    extern uint8_t __data_end__[] __attribute__((weak));
+    extern uint8_t __bss_start__[] __attribute__((weak));
+    extern uint8_t __bss_end__[] __attribute__((weak));
+    extern uint8_t __end__[] __attribute__((weak));
+    extern uint8_t __HeapLimit[] __attribute__((weak));
+    extern uint8_t __StackLimit[] __attribute__((weak));
+    extern uint8_t __StackTop[] __attribute__((weak));
+}
+
+/**
+ * @brief Put a u32 in a buffer, little endian
+ *
+ */
+static uint8_t putU32(uint8_t* buffer, uint32_t value)
+{
+    for(uint8_t i = 0; i < 4; ++i)
+    {
+        buffer[i] = (uint8_t)(value >> (8*i));
+    }
+    return 4;
+}
+
+uint8_t memoryGetThreads(memory_thread_stats* stats, uint8_t max_thread)
+{
+    osThreadId_t thread[MEMORY_MAX_THREAD];
+
+    uint32_t nb_thread = osThreadEnumerate(thread, MEMORY_MAX_THREAD);
+    if(nb_thread > max_thread)
+    {
+        nb_thread = max_thread;
+    }
+
+    for(uint8_t i = 0; i < nb_thread; ++i)
+    {
+        const char* name = osThreadGetName(thread[i]);
+        uint32_t size = osThreadGetStackSize(thread[i]);
+
+        stats[i].name = name ? name : "?";
+        stats[i].size = size;
+        stats[i].max_used = 0;
+#if MBED_STACK_STATS_ENABLED
+        // without the watermark the space is 0, the stack would look full
+        uint32_t space = osThreadGetStackSpace(thread[i]);
+        stats[i].max_used = space < size ? size - space : 0;
+#endif
+    }
+    return (uint8_t)nb_thread;
+}
+
+memory_static_stats memoryGetStatic()
+{
+    memory_static_stats stats;
+
+    stats.data = (uint32_t)(__data_end__ - __data_start__);
+    stats.bss = (uint32_t)(__bss_end__ - __bss_start__);
+    stats.heap = (uint32_t)(__HeapLimit - __end__);
+    stats.main_stack = (uint32_t)(__StackTop - __StackLimit);
+
+    return stats;
+}
+
+void memoryReportThread(RS485* rs)
+{
+    uint8_t cmd_array[1] = {CMD_MEMORY};
+    uint8_t buffer[255] = {0};
+    memory_thread_stats thread[MEMORY_MAX_THREAD];
+
+    while(true)
+    {
+        uint8_t nb_byte = rs->read(cmd_array, 1, buffer);
+        uint8_t page = nb_byte > 0 ? buffer[0] : MEMORY_PAGE_THREAD;
+        uint8_t first = nb_byte > 1 ? buffer[1] : 0;
+        uint8_t size = 0;
+
+        buffer[size++] = page;
+
+        if(page == MEMORY_PAGE_THREAD)
+        {
+            uint8_t nb_thread = memoryGetThreads(thread, MEMORY_MAX_THREAD);
+
+            buffer[size++] = first;
+            buffer[size++] = nb_thread;
+            for(uint8_t i = first; i < nb_thread && i < first + MEMORY_THREAD_PER_PAGE; ++i)
+            {
+                // the name is cut or padded with zeros
+                strncpy((char*)&buffer[size], thread[i].name, MEMORY_NAME_SIZE);
+                size += MEMORY_NAME_SIZE;
+                size += putU32(&buffer[size], thread[i].size);
+                size += putU32(&buffer[size], thread[i].max_used);
+            }
+        }
+        else if(page == MEMORY_PAGE_HEAP)
+        {
+            uint32_t heap[4] = {0, 0, 0, 0};
+#if MBED_HEAP_STATS_ENABLED
+            mbed_stats_heap_t heap_stats;
+            mbed_stats_heap_get(&heap_stats);
+            heap[0] = heap_stats.current_size;
+            heap[1] = heap_stats.max_size;
+            heap[2] = heap_stats.reserved_size;
+            heap[3] = heap_stats.alloc_fail_cnt;
+#endif
+
+            buffer[size++] = MEMORY_NB_MODULE;
+            for(uint8_t i = 0; i < 4; ++i)
+            {
+                size += putU32(&buffer[size], heap[i]);
+            }
+            for(uint8_t i = 0; i < MEMORY_NB_MODULE; ++i)
+            {
+                memory_module_stats stats = memoryGetModule(i);
+                size += putU32(&buffer[size], stats.current);
+                size += putU32(&buffer[size], stats.peak);
+                buffer[size++] = (uint8_t)(stats.nb_block & 0xFF);
+                buffer[size++] = (uint8_t)(stats.nb_block >> 8);
+            }
+        }
+        else
+        {
+            memory_static_stats stats = memoryGetStatic();
+
+            buffer[0] = MEMORY_PAGE_STATIC;
+            size += putU32(&buffer[size], stats.data);
+            size += putU32(&buffer[size], stats.bss);
+            size += putU32(&buffer[size], stats.heap);
+            size += putU32(&buffer[size], stats.main_stack);
+        }
+
+        rs->write(rs->getBoardAdress(), CMD_MEMORY, size, buffer);
+    }
+}
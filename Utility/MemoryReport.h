@@ -0,0 +1,86 @@
+/**
+ * @file MemoryReport.h
+ * @brief Stack high-water marks, heap usage by module and static memory of the board
+ *
+ * The heap of each module comes from memoryAlloc() (MemoryAlloc.h). The stacks are read from the RTOS:
+ * every thread (library, application, main and idle) with its size and its high-water mark.
+ * memoryReportThread() answers CMD_MEMORY with one page of the report.
+ *
+ * @note the high-water mark needs the stack watermark of RTX (MBED_STACK_STATS_ENABLED=1),
+ * otherwise the max used of every stack is 0, not available. The heap totals need MBED_HEAP_STATS_ENABLED=1.
+ * tools/memory_report.py gives the flash and RAM of each module from the map file of the build.
+ *
+ */
+
+#ifndef MEMORY_REPORT_H
+#define MEMORY_REPORT_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+#include "MemoryAlloc.h"
+
+class RS485;
+
+// first byte of the CMD_MEMORY request and response
+#define MEMORY_PAGE_THREAD 0
+#define MEMORY_PAGE_HEAP 1
+#define MEMORY_PAGE_STATIC 2
+
+#define MEMORY_MAX_THREAD 32
+#define MEMORY_THREAD_PER_PAGE 15
+#define MEMORY_NAME_SIZE 8
+
+/**
+ * @brief stack of one thread
+ *
+ */
+typedef struct
+{
+    const char* name;
+    uint32_t size;
+    uint32_t max_used; // 0 without MBED_STACK_STATS_ENABLED
+} memory_thread_stats;
+
+/**
+ * @brief sections of the image and regions of the RAM, from the symbols of the linker script
+ *
+ */
+typedef struct
+{
+    uint32_t data;
+    uint32_t bss;
+    uint32_t heap;       // size of the heap region
+    uint32_t main_stack; // stack of the interrupts (MSP)
+} memory_static_stats;
+
+/**
+ * @brief Get the stacks of the threads
+ *
+ * @param stats the array for the stacks
+ * @param max_thread the size of the array
+ * @return uint8_t the number of threads
+ */
+uint8_t memoryGetThreads(memory_thread_stats* stats, uint8_t max_thread);
+
+/**
+ * @brief Get the static memory of the image
+ *
+ * @return memory_static_stats the sizes, 0 when the linker script doesn't give them
+ */
+memory_static_stats memoryGetStatic();
+
+/**
+ * @brief thread answering the CMD_MEMORY requests of the master
+ *
+ * The request is [page][first thread]. The responses are:
+ *  - MEMORY_PAGE_THREAD: [page][first][nb thread] then [name 8][size u32][max used u32] per thread
+ *  - MEMORY_PAGE_HEAP: [page][nb module][current u32][max u32][reserved u32][failed u32] of the heap,
+ *    then [current u32][peak u32][nb block u16] per module
+ *  - MEMORY_PAGE_STATIC: [page][data u32][bss u32][heap u32][main stack u32]
+ *
+ * @param rs the RS485 of the board, CMD_MEMORY is read and answered on it
+ */
+void memoryReportThread(RS485* rs);
+
+#endif
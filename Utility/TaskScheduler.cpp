@@ -0,0 +1,210 @@
+/**
+ * @file TaskScheduler.cpp
+ * @brief TaskScheduler class source file
+ *
+ */
+
+#include "TaskScheduler.h"
+
+#include "Trace/Trace.h"
+
+TaskScheduler::TaskScheduler(osPriority thread_priority, uint32_t stack_size)
+    : schedulerThread(thread_priority, stack_size, NULL, "scheduler")
+{
+    this->stack_size = stack_size;
+
+    timer.start();
+    schedulerThread.start(callback(this, &TaskScheduler::scheduler_thread));
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    // a job is never cut in the middle, it may hold a bus or a mutex
+    wakeup_event.set(TASK_SCHEDULER_STOP_FLAG);
+    schedulerThread.join();
+}
+
+int8_t TaskScheduler::addTask(Callback<void()> job, uint32_t period_ms, uint32_t deadline_ms, uint32_t budget_us, uint32_t stack_size)
+{
+    if(period_ms == 0)
+    {
+        return -1;
+    }
+
+    scheduler_mutex.lock();
+
+    if(nb_task >= TASK_SCHEDULER_MAX_TASK)
+    {
+        scheduler_mutex.unlock();
+        return -1;
+    }
+
+    scheduled_task* task = &tasks[nb_task];
+    task->job = job;
+    task->period_ms = period_ms;
+    task->deadline_ms = deadline_ms ? deadline_ms : period_ms;
+    task->budget_us = budget_us;
+    task->stack_size = stack_size;
+    task->release_ms = Kernel::get_ms_count();
+    memset(&task->stats, 0, sizeof(task_stats));
+    task->stats.min_us = UINT32_MAX;
+
+    int8_t index = nb_task++;
+    scheduler_mutex.unlock();
+
+    wakeup_event.set(TASK_SCHEDULER_WAKEUP_FLAG);
+
+    return index;
+}
+
+bool TaskScheduler::getStats(uint8_t task, task_stats& stats)
+{
+    if(task >= nb_task)
+    {
+        return false;
+    }
+
+    scheduler_mutex.lock();
+    stats = tasks[task].stats;
+    scheduler_mutex.unlock();
+
+    return true;
+}
+
+void TaskScheduler::resetStats()
+{
+    scheduler_mutex.lock();
+    for(uint8_t i = 0; i < nb_task; ++i)
+    {
+        memset(&tasks[i].stats, 0, sizeof(task_stats));
+        tasks[i].stats.min_us = UINT32_MAX;
+    }
+    stats_start_us = timer.read_high_resolution_us();
+    scheduler_mutex.unlock();
+}
+
+float_t TaskScheduler::getUtilization()
+{
+    uint64_t busy_us = 0;
+
+    scheduler_mutex.lock();
+    for(uint8_t i = 0; i < nb_task; ++i)
+    {
+        busy_us += tasks[i].stats.total_us;
+    }
+    uint64_t elapsed_us = timer.read_high_resolution_us() - stats_start_us;
+    scheduler_mutex.unlock();
+
+    return elapsed_us ? (float_t)busy_us/elapsed_us : 0;
+}
+
+uint32_t TaskScheduler::getRamSaved()
+{
+    uint32_t thread_per_job = 0;
+
+    scheduler_mutex.lock();
+    for(uint8_t i = 0; i < nb_task; ++i)
+    {
+        thread_per_job += tasks[i].stack_size + sizeof(Thread);
+    }
+    scheduler_mutex.unlock();
+
+    uint32_t scheduler = stack_size + sizeof(Thread);
+
+    return thread_per_job > scheduler ? thread_per_job - scheduler : 0;
+}
+
+void TaskScheduler::run(scheduled_task* task, uint64_t now)
+{
+    uint32_t latency_us = (uint32_t)((now - task->release_ms)*1000);
+
+    uint64_t start = timer.read_high_resolution_us();
+    TRACE_BEGIN(TRACE_EVENT_TASK, task - tasks);
+    task->job();
+    TRACE_END(TRACE_EVENT_TASK, task - tasks);
+    uint32_t duration = (uint32_t)(timer.read_high_resolution_us() - start);
+
+    uint64_t finish = Kernel::get_ms_count();
+
+    scheduler_mutex.lock();
+
+    task_stats* stats = &task->stats;
+    stats->nb_run++;
+    stats->total_us += duration;
+    if(duration < stats->min_us) stats->min_us = duration;
+    if(duration > stats->max_us) stats->max_us = duration;
+    if(latency_us > stats->max_latency_us) stats->max_latency_us = latency_us;
+    if(task->budget_us && duration > task->budget_us)
+    {
+        stats->nb_overrun++;
+    }
+    if(finish > task->release_ms + task->deadline_ms)
+    {
+        stats->nb_miss++;
+    }
+
+    // the next release, without a burst of runs if the job is late by more than a period
+    task->release_ms += task->period_ms;
+    if(task->release_ms + task->period_ms <= finish)
+    {
+        uint32_t skipped = (uint32_t)((finish - task->release_ms)/task->period_ms);
+        stats->nb_skipped += skipped;
+        task->release_ms += (uint64_t)skipped*task->period_ms;
+    }
+
+    scheduler_mutex.unlock();
+}
+
+void TaskScheduler::scheduler_thread()
+{
+    while(1)
+    {
+        uint64_t now = Kernel::get_ms_count();
+        uint64_t next_release = UINT64_MAX;
+        scheduled_task* ready = NULL;
+
+        // rate monotonic: the released job with the shortest period, then the oldest release
+        scheduler_mutex.lock();
+        for(uint8_t i = 0; i < nb_task; ++i)
+        {
+            scheduled_task* task = &tasks[i];
+
+            if(task->release_ms <= now)
+            {
+                if(ready == NULL || task->period_ms < ready->period_ms ||
+                   (task->period_ms == ready->period_ms && task->release_ms < ready->release_ms))
+                {
+                    ready = task;
+                }
+            }
+            else if(task->release_ms < next_release)
+            {
+                next_release = task->release_ms;
+            }
+        }
+        scheduler_mutex.unlock();
+
+        // checked between the jobs too, they may be released back to back
+        if(wakeup_event.get() & TASK_SCHEDULER_STOP_FLAG)
+        {
+            return;
+        }
+
+        if(ready)
+        {
+            run(ready, now);
+            continue;
+        }
+
+        uint32_t timeout = osWaitForever;
+        if(next_release != UINT64_MAX)
+        {
+            timeout = (uint32_t)(next_release - now);
+        }
+        uint32_t flags = wakeup_event.wait_any(TASK_SCHEDULER_WAKEUP_FLAG | TASK_SCHEDULER_STOP_FLAG, timeout);
+        if(!(flags & osFlagsError) && (flags & TASK_SCHEDULER_STOP_FLAG))
+        {
+            return;
+        }
+    }
+}
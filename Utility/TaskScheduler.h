@@ -0,0 +1,144 @@
+/**
+ * @file TaskScheduler.h
+ * @brief Cooperative rate monotonic scheduler of the periodic jobs of a board
+ *
+ * The periodic jobs (sensor polling, LED updates, telemetry) run one after the other in the thread
+ * of the scheduler instead of one thread each, they share one stack. When several jobs are due,
+ * the one with the shortest period runs first. A job is never preempted by another job: it must
+ * return quickly and never wait on RS485::read() or another blocking call, those stay in their own thread.
+ * Two schedulers at different thread priorities can split the fast jobs from the slow ones.
+ *
+ */
+
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+#define TASK_SCHEDULER_MAX_TASK 16
+#define TASK_SCHEDULER_WAKEUP_FLAG 0x1
+#define TASK_SCHEDULER_STOP_FLAG 0x2
+
+/**
+ * @brief execution statistics of one job
+ *
+ */
+typedef struct task_stats_struct
+{
+    uint32_t nb_run;
+    uint32_t nb_miss;      // finished after its deadline
+    uint32_t nb_skipped;   // releases lost because the job was late by more than a period
+    uint32_t nb_overrun;   // ran longer than its budget
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t max_latency_us; // from the release to the start
+} task_stats;
+
+/**
+ * @brief one periodic job
+ *
+ */
+typedef struct scheduled_task_struct
+{
+    Callback<void()> job;
+    uint32_t period_ms;
+    uint32_t deadline_ms;
+    uint32_t budget_us;
+    uint32_t stack_size; // stack the job would need in its own thread
+    uint64_t release_ms;
+    task_stats stats;
+} scheduled_task;
+
+/**
+ * @brief cooperative rate monotonic scheduler
+ *
+ */
+class TaskScheduler
+{
+    public:
+
+        /**
+         * @brief TaskScheduler constructor, the scheduler thread starts right away
+         *
+         * @param thread_priority priority of the scheduler thread
+         * @param stack_size stack size of the scheduler thread, enough for the largest job
+         */
+        TaskScheduler(osPriority thread_priority = osPriorityNormal, uint32_t stack_size = OS_STACK_SIZE);
+
+        /**
+         * @brief Destroy the TaskScheduler object, the job in progress ends and the thread is joined
+         *
+         */
+        ~TaskScheduler();
+
+        /**
+         * @brief Add a periodic job, its first release is now
+         *
+         * @param job the job
+         * @param period_ms the period of the job
+         * @param deadline_ms the time after the release the job must be finished, the period if 0
+         * @param budget_us the expected maximum execution time, not checked if 0
+         * @param stack_size the stack the job would need in its own thread, for getRamSaved()
+         * @return int8_t index of the job, -1 if the job can't be added
+         */
+        int8_t addTask(Callback<void()> job, uint32_t period_ms, uint32_t deadline_ms = 0, uint32_t budget_us = 0, uint32_t stack_size = OS_STACK_SIZE);
+
+        /**
+         * @brief Get the execution statistics of a job
+         *
+         * @param task index of the job
+         * @param stats the structure where the statistics gonna be written
+         * @return true if the job exists
+         */
+        bool getStats(uint8_t task, task_stats& stats);
+
+        /**
+         * @brief Reset the statistics of all the jobs
+         *
+         */
+        void resetStats();
+
+        /**
+         * @brief Get the part of the time spent in the jobs since the last reset
+         *
+         * @return float_t the utilization (0.0 to 1.0)
+         */
+        float_t getUtilization();
+
+        /**
+         * @brief Get the RAM saved against one thread per job
+         *
+         * @return uint32_t the stacks and thread objects of the jobs minus the ones of the scheduler, in bytes
+         */
+        uint32_t getRamSaved();
+
+    private:
+
+        Thread schedulerThread;
+        Mutex scheduler_mutex;
+        EventFlags wakeup_event;
+        Timer timer;
+
+        uint32_t stack_size;
+        scheduled_task tasks[TASK_SCHEDULER_MAX_TASK];
+        uint8_t nb_task = 0;
+        uint64_t stats_start_us = 0;
+
+        /**
+         * @brief run one job and update its statistics
+         *
+         * @param task the job
+         * @param now the time of the start in ms
+         */
+        void run(scheduled_task* task, uint64_t now);
+
+        /**
+         * @brief the scheduler thread
+         *
+         */
+        void scheduler_thread();
+};
+
+#endif
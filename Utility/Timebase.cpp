@@ -0,0 +1,58 @@
+/**
+ * @file Timebase.cpp
+ * @brief Timebase class source file
+ *
+ */
+
+#include "Timebase.h"
+
+Timebase::Timebase(Callback<uint64_t()> local_clock)
+{
+    this->local_clock = local_clock;
+
+    timer.start();
+}
+
+uint64_t Timebase::getLocalTime()
+{
+    if(local_clock)
+    {
+        return local_clock();
+    }
+    return timer.read_high_resolution_us();
+}
+
+uint64_t Timebase::getTime()
+{
+    return toShared(getLocalTime());
+}
+
+uint64_t Timebase::toShared(uint64_t local_us)
+{
+    timebase_mutex.lock();
+    int64_t elapsed = (int64_t)(local_us - base_local);
+    int64_t shared = (int64_t)local_us + base_offset + elapsed*drift_ppb/1000000000LL;
+    timebase_mutex.unlock();
+
+    return (uint64_t)shared;
+}
+
+void Timebase::adjust(uint64_t local_us, int64_t offset_us, int32_t drift_ppb)
+{
+    timebase_mutex.lock();
+    base_local = local_us;
+    base_offset = offset_us;
+    this->drift_ppb = drift_ppb;
+    synchronized = true;
+    timebase_mutex.unlock();
+}
+
+bool Timebase::isSynchronized()
+{
+    return synchronized;
+}
+
+int32_t Timebase::getDrift()
+{
+    return drift_ppb;
+}
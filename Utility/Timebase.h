@@ -0,0 +1,92 @@
+/**
+ * @file Timebase.h
+ * @brief Time of the board, disciplined to the time of the bus master
+ *
+ * The local time is a free running microsecond counter. The shared time is the local time
+ * corrected by the offset and the drift measured by RS485TimeSync, it is the same on every
+ * synchronized board and is used to stamp the samples of the sensors.
+ * Before the first synchronization the shared time is the local time.
+ *
+ */
+
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+/**
+ * @brief local and shared time of one board
+ *
+ */
+class Timebase
+{
+    public:
+
+        /**
+         * @brief Timebase constructor
+         *
+         * @param local_clock clock of the board in us, a Timer started by the constructor by default
+         */
+        Timebase(Callback<uint64_t()> local_clock = Callback<uint64_t()>());
+
+        /**
+         * @brief Get the local time
+         *
+         * @return uint64_t the local time in us
+         */
+        uint64_t getLocalTime();
+
+        /**
+         * @brief Get the shared time
+         *
+         * @return uint64_t the shared time in us
+         */
+        uint64_t getTime();
+
+        /**
+         * @brief Convert a local time to the shared time
+         *
+         * @param local_us the local time in us
+         * @return uint64_t the shared time in us
+         */
+        uint64_t toShared(uint64_t local_us);
+
+        /**
+         * @brief Set the correction of the local time
+         *
+         * shared = local + offset_us + (local - local_us)*drift_ppb/1e9
+         *
+         * @param local_us the local time of the measure of the offset
+         * @param offset_us the offset of the shared time at local_us
+         * @param drift_ppb the drift of the shared time against the local time in ppb
+         */
+        void adjust(uint64_t local_us, int64_t offset_us, int32_t drift_ppb);
+
+        /**
+         * @brief Check if the time was adjusted at least once
+         *
+         * @return true if the shared time follows the bus master
+         */
+        bool isSynchronized();
+
+        /**
+         * @brief Get the drift of the shared time against the local time
+         *
+         * @return int32_t the drift in ppb
+         */
+        int32_t getDrift();
+
+    private:
+
+        Callback<uint64_t()> local_clock;
+        Timer timer;
+        Mutex timebase_mutex;
+
+        uint64_t base_local = 0;
+        int64_t base_offset = 0;
+        int32_t drift_ppb = 0;
+        bool synchronized = false;
+};
+
+#endif
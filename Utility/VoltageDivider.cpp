@@ -0,0 +1,23 @@
+/**
+ * @file VoltageDivider.cpp
+ * @brief VoltageDivider class source file
+ *
+ */
+
+#include "VoltageDivider.h"
+
+void VoltageDivider::toVolts(const float_t* values, float_t* volts, uint16_t nb_value) const
+{
+    for(uint16_t i = 0; i < nb_value; ++i)
+    {
+        volts[i] = values[i]*scale;
+    }
+}
+
+void VoltageDivider::toMillivolts(const uint16_t* raw, uint32_t* millivolts, uint16_t nb_value) const
+{
+    for(uint16_t i = 0; i < nb_value; ++i)
+    {
+        millivolts[i] = toMillivolts(raw[i]);
+    }
+}
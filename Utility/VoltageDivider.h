@@ -0,0 +1,100 @@
+/**
+ * @file VoltageDivider.h
+ * @brief Voltage divider conversion with the scale computed once
+ *
+ * calcul_tension() computes (voltageRef*value*(R1+R2))/R2 in double for every sample,
+ * which is emulated in software on the Cortex-M4. A VoltageDivider computes the scale
+ * once, at compile time when it is declared constexpr:
+ *
+ *     constexpr VoltageDivider battery(3.3, 100000, 10000);
+ *     uint32_t mv = battery.toMillivolts(input.read_u16());
+ *
+ */
+
+#ifndef VOLTAGE_DIVIDER_H
+#define VOLTAGE_DIVIDER_H
+
+#include "mbed.h"
+
+#define VOLTAGE_DIVIDER_FRACTION_BITS 16
+#define VOLTAGE_DIVIDER_ADC_BITS 16 // AnalogIn::read_u16() is always 16 bits
+
+/**
+ * @brief conversion of the voltage at the pin of a divider to the voltage at its input
+ *
+ */
+class VoltageDivider
+{
+    public:
+
+        /**
+         * @brief VoltageDivider constructor
+         *
+         * @param voltageRef reference voltage of the ADC
+         * @param R1 resistor between the input and the pin
+         * @param R2 resistor between the pin and the ground, must not be 0
+         * @param adc_bits resolution of the raw values given to toMillivolts()
+         */
+        constexpr VoltageDivider(double_t voltageRef, double_t R1, double_t R2, uint8_t adc_bits = VOLTAGE_DIVIDER_ADC_BITS)
+            : scale((float_t)(voltageRef*(R1 + R2)/R2)),
+              millivolt_scale((uint64_t)(voltageRef*1000.0*(R1 + R2)/R2*(1UL << VOLTAGE_DIVIDER_FRACTION_BITS)/((1UL << adc_bits) - 1) + 0.5))
+        {
+        }
+
+        /**
+         * @brief Convert a normalized value like calcul_tension()
+         *
+         * @param value the normalized value (0.0 to 1.0) from AnalogIn::read()
+         * @return float_t the voltage at the input in V
+         */
+        constexpr float_t toVolts(float_t value) const
+        {
+            return value*scale;
+        }
+
+        /**
+         * @brief Convert a raw ADC value with integer math only
+         *
+         * @param raw the raw value, from AnalogIn::read_u16() by default
+         * @return uint32_t the voltage at the input in mV
+         */
+        constexpr uint32_t toMillivolts(uint16_t raw) const
+        {
+            return (uint32_t)(((uint64_t)raw*millivolt_scale + (1ULL << (VOLTAGE_DIVIDER_FRACTION_BITS - 1))) >> VOLTAGE_DIVIDER_FRACTION_BITS);
+        }
+
+        /**
+         * @brief Convert an array of normalized values
+         *
+         * @param values the normalized values
+         * @param volts the voltages at the input in V, can be the same array as values
+         * @param nb_value the number of values
+         */
+        void toVolts(const float_t* values, float_t* volts, uint16_t nb_value) const;
+
+        /**
+         * @brief Convert an array of raw ADC values with integer math only
+         *
+         * @param raw the raw values
+         * @param millivolts the voltages at the input in mV
+         * @param nb_value the number of values
+         */
+        void toMillivolts(const uint16_t* raw, uint32_t* millivolts, uint16_t nb_value) const;
+
+        /**
+         * @brief Get the scale from the pin to the input
+         *
+         * @return float_t the voltage at the input for a normalized value of 1.0
+         */
+        constexpr float_t getScale() const
+        {
+            return scale;
+        }
+
+    private:
+
+        float_t scale;
+        uint64_t millivolt_scale; // mV per raw count, VOLTAGE_DIVIDER_FRACTION_BITS fraction bits, 32 bits overflow with a low adc_bits
+};
+
+#endif
@@ -47,6 +47,7 @@ float_t putCharInFloat(char * data, float_t multiplicator = 1);
  * @param input Analog pin 
  * @param voltageref Reference voltage of the board
  * @return double_t Out value of the average
+ * @note blocks the caller for 200 ms, AnalogSampler::readVoltage() returns the filtered value right away
  */
 double_t readfromAnalog(AnalogIn input, double_t voltageref, double_t R1, double_t R2);
 
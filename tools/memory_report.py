@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+"""Static memory of each module of the library, from the map file of a GCC_ARM build.
+
+The input sections of the map file are attributed to the directory of the library their object
+comes from (RS485, INA228, ...), everything else is "application" or "mbed-os".
+
+    python3 tools/memory_report.py .pio/build/<env>/firmware.map
+
+The payload of a CMD_MEMORY response (hex, as given by a bus capture) can be decoded too:
+
+    python3 tools/memory_report.py --response "00 00 02 72 73 ..."
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+MODULES = ["RS485", "I2CBus", "INA228", "TC74A5", "PCA9531", "Utility", "Trace"]
+
+SECTION = re.compile(r"^ (\.[^\s]+|COMMON)(?:\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(.+))?$")
+CONTINUATION = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(.+)$")
+
+
+def source_modules():
+    """Map the object names of the library to their module."""
+    objects = {}
+    for module in MODULES:
+        directory = os.path.join(ROOT, module)
+        if not os.path.isdir(directory):
+            continue
+        for name in os.listdir(directory):
+            if name.endswith(".cpp"):
+                objects[name + ".o"] = module
+                objects[name[:-4] + ".o"] = module
+    return objects
+
+
+def module_of(path, objects):
+    for module in MODULES:
+        if "/%s/" % module in path.replace("\\", "/"):
+            return module
+    # objects in an archive: lib.a(RS485.cpp.o)
+    match = re.search(r"\(([^)]+)\)$", path)
+    name = os.path.basename(match.group(1) if match else path)
+    if name in objects:
+        return objects[name]
+    if "mbed-os" in path or "framework-mbed" in path:
+        return "mbed-os"
+    return "application"
+
+
+def kind_of(section):
+    if section.startswith((".text", ".rodata", ".ARM", ".init", ".fini")):
+        return "flash"
+    if section.startswith(".data"):
+        return "data"
+    if section.startswith((".bss", "COMMON")):
+        return "bss"
+    return None
+
+
+def parse_map(path):
+    objects = source_modules()
+    report = {}
+    pending = None
+    in_map = False
+
+    with open(path) as f:
+        for line in f:
+            if line.startswith("Linker script and memory map"):
+                in_map = True
+                continue
+            if not in_map:
+                continue
+
+            match = SECTION.match(line)
+            if match:
+                section, address, size, source = match.groups()
+                if address is None:
+                    # the name is too long, the address and the size are on the next line
+                    pending = section
+                    continue
+            elif pending:
+                match = CONTINUATION.match(line)
+                section = pending
+                pending = None
+                if not match:
+                    continue
+                address, size, source = match.groups()
+            else:
+                continue
+
+            kind = kind_of(section)
+            size = int(size, 16)
+            if kind is None or size == 0 or int(address, 16) == 0:
+                continue
+            module = module_of(source.strip(), objects)
+            entry = report.setdefault(module, {"flash": 0, "data": 0, "bss": 0})
+            entry[kind] += size
+
+    return report
+
+
+def print_report(report):
+    print("%-12s %10s %10s %10s %10s" % ("module", "flash", "data", "bss", "ram"))
+    total = {"flash": 0, "data": 0, "bss": 0}
+    for module in MODULES + ["application", "mbed-os"]:
+        if module not in report:
+            continue
+        entry = report[module]
+        # the initial values of .data are in the flash too
+        print("%-12s %10d %10d %10d %10d" % (module, entry["flash"] + entry["data"], entry["data"], entry["bss"], entry["data"] + entry["bss"]))
+        for kind in total:
+            total[kind] += entry[kind]
+    print("%-12s %10d %10d %10d %10d" % ("total", total["flash"] + total["data"], total["data"], total["bss"], total["data"] + total["bss"]))
+
+
+HEAP_MODULES = ["RS485", "I2CBus", "INA228", "TC74A5", "PCA9531", "Utility", "application"]
+
+
+def decode_response(payload):
+    page = payload[0]
+    if page == 0:
+        first, nb_thread = payload[1], payload[2]
+        print("threads %d to %d of %d" % (first, first + (len(payload) - 3) // 16 - 1, nb_thread))
+        print("%-10s %8s %8s %6s" % ("thread", "size", "used", "%"))
+        for offset in range(3, len(payload) - 15, 16):
+            name = payload[offset:offset + 8].split(b"\0")[0].decode("ascii", "replace")
+            size, used = struct.unpack_from("<II", payload, offset + 8)
+            print("%-10s %8d %8d %5.0f%%" % (name, size, used, 100.0 * used / size if size else 0))
+    elif page == 1:
+        nb_module = payload[1]
+        current, peak, reserved, failed = struct.unpack_from("<IIII", payload, 2)
+        print("heap: %d used, %d peak, %d reserved, %d failed allocations" % (current, peak, reserved, failed))
+        print("%-12s %8s %8s %6s" % ("module", "current", "peak", "blocks"))
+        for i in range(nb_module):
+            current, peak, blocks = struct.unpack_from("<IIH", payload, 18 + 10 * i)
+            name = HEAP_MODULES[i] if i < len(HEAP_MODULES) else "module %d" % i
+            print("%-12s %8d %8d %6d" % (name, current, peak, blocks))
+    elif page == 2:
+        data, bss, heap, stack = struct.unpack_from("<IIII", payload, 1)
+        print("data %d, bss %d, heap region %d, main stack %d" % (data, bss, heap, stack))
+    else:
+        sys.exit("unknown page %d" % page)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("map", nargs="?", help="map file of the build")
+    parser.add_argument("--response", help="payload of a CMD_MEMORY response in hex")
+    args = parser.parse_args()
+
+    if args.response:
+        decode_response(bytes.fromhex(args.response))
+    elif args.map:
+        print_report(parse_map(args.map))
+    else:
+        parser.error("a map file or --response is needed")
+
+
+if __name__ == "__main__":
+    main()
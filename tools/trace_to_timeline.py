@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Convert the trace dump of a board to a Chrome trace (chrome://tracing, Perfetto).
+
+The input is a raw capture of the RS485 bus (the bytes as they are on the wire, from an
+USB adapter for example) taken while the master sends CMD_TRACE to a board. The CMD_TRACE
+frames are taken out of the capture, the entries are put back in order and the 32 bits
+timestamps are unwrapped.
+
+    python3 tools/trace_to_timeline.py capture.bin -o trace.json
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+CMD_TRACE = 27
+ENTRY_SIZE = 8
+
+EVENT_NAMES = {
+    1: "RS485 rx",
+    2: "RS485 tx",
+    3: "RS485 read",
+    4: "I2C",
+    5: "task",
+}
+
+PHASES = {0: "i", 1: "B", 2: "E"}
+
+
+def parse_frames(capture):
+    """Yield (slave, cmd, data) for every frame of the capture with a good checksum."""
+    i = 0
+    while i + 7 <= len(capture):
+        if capture[i] != 0x3A:
+            i += 1
+            continue
+        slave, cmd, nb_byte = capture[i + 1], capture[i + 2], capture[i + 3]
+        end = i + 4 + nb_byte
+        if end + 3 > len(capture):
+            break
+        data = capture[i + 4:end]
+        checksum = (capture[end] << 8) | capture[end + 1]
+        if capture[end + 2] == 0x0D and checksum == (0x3A + slave + cmd + nb_byte + 0x0D + sum(data)) & 0xFFFF:
+            yield slave, cmd, bytes(data)
+            i = end + 3
+        else:
+            i += 1
+
+
+def collect_dumps(capture):
+    """Return {slave: (frequency, [entries])} with the last complete dump of each board."""
+    pending = {}
+    dumps = {}
+    for slave, cmd, data in parse_frames(capture):
+        # the request of the master has no data
+        if cmd != CMD_TRACE or len(data) < 2:
+            continue
+        index, nb_frame = data[0], data[1]
+        if index == 0:
+            pending[slave] = {"frequency": struct.unpack_from("<I", data, 2)[0], "frames": {}}
+            payload = data[6:]
+        else:
+            payload = data[2:]
+        if slave not in pending:
+            continue
+        pending[slave]["frames"][index] = payload
+        if len(pending[slave]["frames"]) == nb_frame:
+            dump = pending.pop(slave)
+            raw = b"".join(dump["frames"][k] for k in range(nb_frame))
+            entries = [struct.unpack_from("<IBBH", raw, k) for k in range(0, len(raw) - ENTRY_SIZE + 1, ENTRY_SIZE)]
+            dumps[slave] = (dump["frequency"], entries)
+    return dumps
+
+
+def to_events(slave, frequency, entries):
+    events = []
+    high = 0
+    previous = None
+    origin = entries[0][0] if entries else 0
+    for timestamp, event, kind, arg in entries:
+        # the entries are in order, a smaller timestamp is a wrap of the counter
+        if previous is not None and timestamp < previous:
+            high += 1 << 32
+        previous = timestamp
+        name = EVENT_NAMES.get(event, "user %d" % (event - 32) if event >= 32 else "event %d" % event)
+        record = {
+            "name": name,
+            "ph": PHASES.get(kind, "i"),
+            "ts": (high + timestamp - origin) * 1e6 / frequency,
+            "pid": slave,
+            "tid": event,
+            "args": {"arg": "0x%04X" % arg},
+        }
+        if record["ph"] == "i":
+            record["s"] = "t"
+        events.append(record)
+    return events
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("capture", help="raw capture of the RS485 bus")
+    parser.add_argument("-o", "--output", help="output json file (default: stdout)")
+    args = parser.parse_args()
+
+    with open(args.capture, "rb") as f:
+        capture = f.read()
+
+    dumps = collect_dumps(capture)
+    if not dumps:
+        sys.exit("no complete CMD_TRACE dump in the capture")
+
+    events = []
+    for slave, (frequency, entries) in sorted(dumps.items()):
+        events.append({"name": "process_name", "ph": "M", "pid": slave, "args": {"name": "slave %d" % slave}})
+        events.extend(to_events(slave, frequency, entries))
+        print("slave %d: %d entries at %d Hz" % (slave, len(entries), frequency), file=sys.stderr)
+
+    output = open(args.output, "w") if args.output else sys.stdout
+    json.dump({"traceEvents": events, "displayTimeUnit": "ns"}, output, indent=1)
+    if args.output:
+        output.close()
+
+
+if __name__ == "__main__":
+    main()